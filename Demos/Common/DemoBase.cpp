@@ -8,6 +8,7 @@
 #include "SPlisHSPlasH/PBF/TimeStepPBF.h"
 #include "SPlisHSPlasH/IISPH/TimeStepIISPH.h"
 #include "SPlisHSPlasH/DFSPH/TimeStepDFSPH.h"
+#include "SPlisHSPlasH/Utilities/PerformanceCounters.h"
 #include "Utilities/PartioReaderWriter.h"
 #include "Visualization/Selection.h"
 #include "GL/glut.h"
@@ -55,8 +56,25 @@ void DemoBase::init(int argc, char** argv, const char* demoName)
     else
         return;
 
+    // must be set before the particle arrays are allocated
+    ParticleMemory::setFirstTouch(m_scene.firstTouch);
+    ParticleMemory::setHugePages(m_scene.hugePages);
+    if(!ParticleMemory::pinThreads((ThreadPinning)m_scene.threadPinning))
+        std::cerr << "Thread pinning is not supported on this system.\n";
+    if(m_scene.performanceCounters && !PerformanceCounters::enable())
+        std::cerr << "Hardware performance counters are not available on this system.\n";
+
+    if(!m_scene.telemetryFile.empty() && !m_telemetryLog.open(m_scene.telemetryFile))
+        std::cerr << "Cannot open telemetry file: " << m_scene.telemetryFile << "\n";
+    if(!m_scene.metricsEndpoint.empty() && !m_metricsServer.open(m_scene.metricsEndpoint))
+        std::cerr << "Cannot open metrics endpoint: " << m_scene.metricsEndpoint << "\n";
+    m_frameBudget.setTargetFrameTime(m_scene.frameBudget);
+    m_frameBudget.setMaxSteps(m_scene.frameBudgetMaxSteps);
+    m_frameBudget.setMaxToleranceScale(m_scene.frameBudgetMaxToleranceScale);
+
     getSimulationMethod().model.setSaveDataPath(m_scene.saveDataPath);
     getSimulationMethod().model.setFrameTime(m_scene.frameTime);
+    getSimulationMethod().model.setFrameOutputThreads(m_scene.frameOutputThreads);
     if(m_MeshWriter == nullptr)
     {
         m_MeshWriter = new DataIO(m_scene.saveDataPath, "SolidFrame", "frame", "pos");
@@ -136,8 +154,16 @@ void DemoBase::init(int argc, char** argv, const char* demoName)
 
 void DemoBase::cleanup()
 {
+    m_simulationThread.stop();
+    m_simulationThread.unsubscribe(&m_renderSnapshots);
+    m_telemetryLog.close();
+    m_metricsServer.close();
+    if(m_frameBudget.getNumberOfFrames() > 0)
+        std::cout << "Frame budget: " << m_frameBudget.getNumberOfExceededFrames() << " of " << m_frameBudget.getNumberOfFrames()
+                  << " frames exceeded the target of " << m_frameBudget.getTargetFrameTime() << " ms\n";
+    if(m_scene.memoryReport && (m_simulationMethod.simulation != nullptr))
+        printMemoryUsage();
     delete m_simulationMethod.simulation;
-    delete TimeManager::getCurrent();
 
     for(unsigned int i = 0; i < m_scene.boundaryModels.size(); i++)
         delete m_scene.boundaryModels[i];
@@ -152,6 +178,12 @@ void DemoBase::cleanup()
     m_scene.fluidBlocks.clear();
 }
 
+void DemoBase::startSimulationThread(const SimulationThread::FrameFct& frameFct)
+{
+    m_simulationThread.subscribe(&m_renderSnapshots);
+    m_simulationThread.start(&m_simulationMethod.model, frameFct);
+}
+
 void DemoBase::initShaders()
 {
     string vertFile = getDataPath() + "/shaders/vs_points.glsl";
@@ -242,9 +274,12 @@ void DemoBase::initParameters()
     m_parameters.clear();
 
     MiniGL::initTweakBarParameters();
-    TwAddVarRW(MiniGL::getTweakBar(), "Pause", TW_TYPE_BOOLCPP, &m_doPause, " label='Pause' group=Simulation key=SPACE ");
-    TwAddVarRW(MiniGL::getTweakBar(), "PauseAt", TW_TYPE_REAL, &m_pauseAt, " label='Pause simulation at' step=0.001 precision=3 group=Simulation ");
-    TwAddVarRW(MiniGL::getTweakBar(), "numberOfStepsPerRenderUpdate", TW_TYPE_UINT32, &m_numberOfStepsPerRenderUpdate, " label='# time steps / update' min=1 group=Simulation ");
+    m_parameters.push_back(Parameter(ParameterIDs::Pause, "Pause", TW_TYPE_BOOLCPP, " label='Pause' group=Simulation key=SPACE ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::PauseAt, "PauseAt", TW_TYPE_REAL, " label='Pause simulation at' step=0.001 precision=3 group=Simulation ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::NumberOfStepsPerRenderUpdate, "numberOfStepsPerRenderUpdate", TW_TYPE_UINT32, " label='# time steps / update' min=1 group=Simulation ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::TargetFrameTime, "TargetFrameTime", TW_TYPE_DOUBLE, " label='Frame budget (ms)' min=0.0 step=1.0 precision=1 help='Target time of the steps of a frame, 0 = fixed number of steps' group=Simulation ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::ExceededFrames, "ExceededFrames", TW_TYPE_UINT32, " label='Frames over budget' readonly=true group=Simulation ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::ToleranceScale, "ToleranceScale", TW_TYPE_REAL, " label='Tolerance scale' readonly=true precision=2 group=Simulation ", this));
 
     m_parameters.push_back(Parameter(ParameterIDs::TimeStepSize, "TimeStepSize", TW_TYPE_REAL, " label='Time step size'  min=0.0 max = 0.1 step=0.001 precision=4 group=Simulation ", this));
 
@@ -267,6 +302,11 @@ void DemoBase::initParameters()
     TwType enumTypeST = TwDefineEnum("SurfaceTensionMethod", NULL, 0);
     m_parameters.push_back(Parameter(ParameterIDs::SurfaceTensionMethod, "SurfaceTensionMethod", enumTypeST, " label='Surface tension' enum='0 {None}, 1 {Becker & Teschner 2007}, 2 {Akinci et al. 2013}, 3 {He et al. 2014}' group=Simulation", this));
 
+    m_parameters.push_back(Parameter(ParameterIDs::NeighborhoodSearchSkin, "NeighborhoodSearchSkin", TW_TYPE_REAL, " label='Neighborhood search skin'  min=0.0 step=0.001 precision=4 group=Simulation ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::TiledTraversal, "TiledTraversal", TW_TYPE_BOOL32, " label='Tiled traversal' group=Simulation ", this));
+    TwType enumTypeOrdering = TwDefineEnum("ParticleOrdering", NULL, 0);
+    m_parameters.push_back(Parameter(ParameterIDs::ParticleOrdering, "ParticleOrdering", enumTypeOrdering, " label='Particle ordering' enum='0 {Morton}, 1 {Hilbert}' group=Simulation", this));
+
     TwType enumType3 = TwDefineEnum("CFL_Method", NULL, 0);
     m_parameters.push_back(Parameter(ParameterIDs::CFL_Method, "CFL_Method", enumType3, " label='CFL - method' enum='0 {None}, 1 {CFL}, 2 {CFL - iterations}' group=CFL ", this));
 
@@ -274,10 +314,10 @@ void DemoBase::initParameters()
     m_parameters.push_back(Parameter(ParameterIDs::CFL_MaxTimeStepSize, "CFL_MaxTimeStepSize", TW_TYPE_REAL, " label='CFL - max. time step size' min=0.0 precision=4 group=CFL ", this));
 
     TwType enumType4 = TwDefineEnum("Kernel_Method", NULL, 0);
-    m_parameters.push_back(Parameter(ParameterIDs::Kernel_Method, "Kernel_Method", enumType4, " label='Kernel' enum='0 {Cubic spline}, 1 {Poly6}, 2 {Spiky}, 3 {Precomputed cubic spline}' group=Kernel ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::Kernel_Method, "Kernel_Method", enumType4, " label='Kernel' enum='0 {Cubic spline}, 1 {Poly6}, 2 {Spiky}, 3 {Precomputed cubic spline}, 4 {Interpolated cubic spline}' group=Kernel ", this));
 
     TwType enumType5 = TwDefineEnum("GradKernel_Method", NULL, 0);
-    m_parameters.push_back(Parameter(ParameterIDs::GradKernel_Method, "GradKernel_Method", enumType5, " label='Gradient of kernel' enum='0 {Cubic spline}, 1 {Poly6}, 2 {Spiky}, 3 {Precomputed cubic spline}' group=Kernel ", this));
+    m_parameters.push_back(Parameter(ParameterIDs::GradKernel_Method, "GradKernel_Method", enumType5, " label='Gradient of kernel' enum='0 {Cubic spline}, 1 {Poly6}, 2 {Spiky}, 3 {Precomputed cubic spline}, 4 {Interpolated cubic spline}' group=Kernel ", this));
 
     if(m_simulationMethod.simulationMethod == SimulationMethods::PBF)
     {
@@ -289,6 +329,7 @@ void DemoBase::initParameters()
     {
         m_parameters.push_back(Parameter(ParameterIDs::WCSPH_Stiffness, "WCSPH_Stiffness", TW_TYPE_REAL, " label='Stiffness (B)' min=0.0 group=WCSPH", this));
         m_parameters.push_back(Parameter(ParameterIDs::WCSPH_Exponent, "WCSPH_Exponent", TW_TYPE_REAL, " label='Exponent (gamma)' min=0.0 group=WCSPH", this));
+        m_parameters.push_back(Parameter(ParameterIDs::WCSPH_TimeStepLevels, "WCSPH_TimeStepLevels", TW_TYPE_UINT32, " label='Time step levels' min=1 max=8 group=WCSPH", this));
     }
 
     if(m_simulationMethod.simulationMethod == SimulationMethods::DFSPH)
@@ -312,7 +353,7 @@ void DemoBase::initParameters()
 
 void DemoBase::buildModel()
 {
-    TimeManager::getCurrent()->setTimeStepSize(m_scene.timeStepSize);
+    m_simulationMethod.model.getTimeManager()->setTimeStepSize(m_scene.timeStepSize);
 
     std::vector<Vector3r> fluidParticles;
     std::vector<Vector3r> fluidVelocities;
@@ -321,6 +362,9 @@ void DemoBase::buildModel()
     m_simulationMethod.model.setParticleRadius(m_scene.particleRadius);
     setPauseAt(m_scene.pauseAt);
     setNumberOfStepsPerRenderUpdate(m_scene.numberOfStepsPerRenderUpdate);
+    m_simulationMethod.model.setNeighborhoodSearchSkin(m_scene.neighborhoodSearchSkin);
+    m_simulationMethod.model.setUseTiledTraversal(m_scene.tiledTraversal);
+    m_simulationMethod.model.setParticleOrdering((SpaceFillingCurve)m_scene.particleOrdering);
 
     m_simulationMethod.model.initModel((unsigned int)fluidParticles.size(), fluidParticles.data());
 
@@ -348,6 +392,7 @@ void DemoBase::buildModel()
     m_simulationMethod.simulation->setMaxErrorV(m_scene.maxErrorV);
     m_simulationMethod.simulation->setViscosityMethod((ViscosityMethods)m_scene.viscosityMethod);
     m_simulationMethod.simulation->setSurfaceTensionMethod((SurfaceTensionMethods)m_scene.surfaceTensionMethod);
+    m_simulationMethod.simulation->setNumberOfTimeStepLevels(m_scene.numberOfTimeStepLevels);
 
 
     m_simulationMethod.model.setEnableDivergenceSolver(m_scene.enableDivergenceSolver);
@@ -360,6 +405,20 @@ void DemoBase::buildModel()
     m_simulationMethod.model.setExponent(m_scene.exponent);
 
     initParameters();
+
+    if(m_scene.memoryReport)
+        printMemoryUsage();
+}
+
+
+void DemoBase::printMemoryUsage()
+{
+    FluidModel& model = m_simulationMethod.model;
+    MemoryUsage usage(model.numParticles(), model.numberOfBoundaryParticles());
+    m_simulationMethod.simulation->getMemoryUsage(usage);
+    if(m_MeshWriter != nullptr)
+        usage.add("output buffers", m_MeshWriter->getMemoryUsage());
+    usage.print(std::cout);
 }
 
 
@@ -454,14 +513,20 @@ void DemoBase::createFluidBlocks(std::vector<Vector3r>& fluidParticles)
 
 void TW_CALL DemoBase::setParameter(const void* value, void* clientData)
 {
-    Parameter*        p    = ((Parameter*)clientData);
+    Parameter* p = ((Parameter*)clientData);
+    // the simulation thread must not be inside a frame while a parameter changes
+    p->base->m_simulationThread.execute([p, value]() { applyParameter(p, value); });
+}
+
+void DemoBase::applyParameter(Parameter* p, const void* value)
+{
     DemoBase*         base = p->base;
     SimulationMethod& sm   = base->getSimulationMethod();
 
     if(p->id == ParameterIDs::TimeStepSize)
     {
         const Real val = *(const Real*)(value);
-        TimeManager::getCurrent()->setTimeStepSize(val);
+        sm.model.getTimeManager()->setTimeStepSize(val);
     }
     else if(p->id == ParameterIDs::Gravitation)
     {
@@ -489,6 +554,38 @@ void TW_CALL DemoBase::setParameter(const void* value, void* clientData)
         const Real val = *(const Real*)(value);
         sm.model.setSurfaceTension(val);
     }
+    else if(p->id == ParameterIDs::NeighborhoodSearchSkin)
+    {
+        const Real val = *(const Real*)(value);
+        sm.model.setNeighborhoodSearchSkin(val);
+    }
+    else if(p->id == ParameterIDs::TiledTraversal)
+    {
+        const bool val = *(const bool*)(value);
+        sm.model.setUseTiledTraversal(val);
+    }
+    else if(p->id == ParameterIDs::ParticleOrdering)
+    {
+        const short val = *(const short*)(value);
+        sm.model.setParticleOrdering((SpaceFillingCurve)val);
+    }
+    else if(p->id == ParameterIDs::TargetFrameTime)
+    {
+        const double val = *(const double*)(value);
+        base->getFrameBudget().setTargetFrameTime(val);
+    }
+    else if(p->id == ParameterIDs::Pause)
+    {
+        base->setPause(*(const bool*)(value));
+    }
+    else if(p->id == ParameterIDs::PauseAt)
+    {
+        base->setPauseAt(*(const Real*)(value));
+    }
+    else if(p->id == ParameterIDs::NumberOfStepsPerRenderUpdate)
+    {
+        base->setNumberOfStepsPerRenderUpdate(*(const unsigned int*)(value));
+    }
     else if(p->id == ParameterIDs::SurfaceTensionMethod)
     {
         const short val = *(const short*)(value);
@@ -509,6 +606,10 @@ void TW_CALL DemoBase::setParameter(const void* value, void* clientData)
         const Real val = *(const Real*)(value);
         sm.model.setExponent(val);
     }
+    else if(p->id == ParameterIDs::WCSPH_TimeStepLevels)
+    {
+        sm.simulation->setNumberOfTimeStepLevels(*(unsigned int*)(value));
+    }
     else if(p->id == ParameterIDs::DFSPH_EnableDivergenceSolver)
     {
         const bool val = *(const bool*)(value);
@@ -560,13 +661,15 @@ void TW_CALL DemoBase::setParameter(const void* value, void* clientData)
 
 void TW_CALL DemoBase::getParameter(void* value, void* clientData)
 {
+    // The GUI reads the displayed values without waiting for the simulation thread. They are
+    // single values which are only written between the steps.
     Parameter*        p    = ((Parameter*)clientData);
     DemoBase*         base = p->base;
     SimulationMethod& sm   = base->getSimulationMethod();
 
     if(p->id == ParameterIDs::TimeStepSize)
     {
-        *(Real*)(value) = TimeManager::getCurrent()->getTimeStepSize();
+        *(Real*)(value) = sm.model.getTimeManager()->getTimeStepSize();
     }
     else if(p->id == ParameterIDs::IterationCount)
     {
@@ -605,6 +708,42 @@ void TW_CALL DemoBase::getParameter(void* value, void* clientData)
     {
         *(Real*)(value) = sm.model.getSurfaceTension();
     }
+    else if(p->id == ParameterIDs::NeighborhoodSearchSkin)
+    {
+        *(Real*)(value) = sm.model.getNeighborhoodSearchSkin();
+    }
+    else if(p->id == ParameterIDs::TiledTraversal)
+    {
+        *(bool*)(value) = sm.model.getUseTiledTraversal();
+    }
+    else if(p->id == ParameterIDs::ParticleOrdering)
+    {
+        *(short*)(value) = (short)sm.model.getParticleOrdering();
+    }
+    else if(p->id == ParameterIDs::TargetFrameTime)
+    {
+        *(double*)(value) = base->getFrameBudget().getTargetFrameTime();
+    }
+    else if(p->id == ParameterIDs::ExceededFrames)
+    {
+        *((unsigned int*)value) = base->getFrameBudget().getNumberOfExceededFrames();
+    }
+    else if(p->id == ParameterIDs::ToleranceScale)
+    {
+        *(Real*)(value) = base->getFrameBudget().getToleranceScale();
+    }
+    else if(p->id == ParameterIDs::Pause)
+    {
+        *(bool*)(value) = base->getPause();
+    }
+    else if(p->id == ParameterIDs::PauseAt)
+    {
+        *(Real*)(value) = base->getPauseAt();
+    }
+    else if(p->id == ParameterIDs::NumberOfStepsPerRenderUpdate)
+    {
+        *(unsigned int*)(value) = base->getNumberOfStepsPerRenderUpdate();
+    }
     else if(p->id == ParameterIDs::SurfaceTensionMethod)
     {
         *(short*)(value) = (short)sm.simulation->getSurfaceTensionMethod();
@@ -621,6 +760,10 @@ void TW_CALL DemoBase::getParameter(void* value, void* clientData)
     {
         *(Real*)(value) = sm.model.getExponent();
     }
+    else if(p->id == ParameterIDs::WCSPH_TimeStepLevels)
+    {
+        *(unsigned int*)(value) = sm.simulation->getNumberOfTimeStepLevels();
+    }
     else if(p->id == ParameterIDs::DFSPH_EnableDivergenceSolver)
     {
         *(bool*)(value) = sm.model.getEnableDivergenceSolver();
@@ -667,7 +810,36 @@ void DemoBase::renderFluid()
 {
     // Draw simulation model
 
-    const unsigned int nParticles = m_simulationMethod.model.numParticles();
+    // with a simulation thread the fluid is drawn from the latest snapshot, the model is changed concurrently
+    const Vector3r* x            = nullptr;
+    const Vector3r* v            = nullptr;
+    unsigned int    nParticles   = 0;
+    Real            time         = 0.0;
+    Real            timeStepSize = 0.0;
+    if(m_simulationThread.isRunning())
+    {
+        m_renderSnapshots.update();
+        const ParticleSnapshot& snapshot = m_renderSnapshots.getReadSnapshot();
+        nParticles   = snapshot.numParticles();
+        time         = snapshot.time;
+        timeStepSize = snapshot.timeStepSize;
+        if(nParticles > 0)
+        {
+            x = snapshot.positions.data();
+            v = snapshot.velocities.data();
+        }
+    }
+    else
+    {
+        nParticles   = m_simulationMethod.model.numParticles();
+        time         = m_simulationMethod.model.getTimeManager()->getTime();
+        timeStepSize = m_simulationMethod.model.getTimeManager()->getTimeStepSize();
+        if(nParticles > 0)
+        {
+            x = &m_simulationMethod.model.getPosition(0, 0);
+            v = &m_simulationMethod.model.getVelocity(0, 0);
+        }
+    }
 
     float              surfaceColor[4] = { 0.2f, 0.6f, 0.8f, 1 };
     float              speccolor[4]    = { 1.0, 1.0, 1.0, 1.0 };
@@ -679,7 +851,7 @@ void DemoBase::renderFluid()
 
 
     const Real supportRadius = m_simulationMethod.model.getSupportRadius();
-    Real       vmax          = 0.4 * 2.0 * supportRadius / TimeManager::getCurrent()->getTimeStepSize();
+    Real       vmax          = 0.4 * 2.0 * supportRadius / timeStepSize;
     Real       vmin          = 0.0;
 
     if(MiniGL::checkOpenGLVersion(3, 3))
@@ -687,13 +859,13 @@ void DemoBase::renderFluid()
         float fluidColor[4] = { 0.3f, 0.5f, 0.9f, 1.0f };
         pointShaderBegin(&fluidColor[0]);
 
-        if(m_simulationMethod.model.numParticles() > 0)
+        if(nParticles > 0)
         {
             glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, &m_simulationMethod.model.getPosition(0, 0));
+            glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, x);
             glEnableVertexAttribArray(1);
-            glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 0, &m_simulationMethod.model.getVelocity(0, 0));
-            glDrawArrays(GL_POINTS, 0, m_simulationMethod.model.numParticles());
+            glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 0, v);
+            glDrawArrays(GL_POINTS, 0, nParticles);
             glDisableVertexAttribArray(0);
             glDisableVertexAttribArray(1);
         }
@@ -707,32 +879,36 @@ void DemoBase::renderFluid()
         glBegin(GL_POINTS);
         for(unsigned int i = 0; i < nParticles; i++)
         {
-            Real v = m_simulationMethod.model.getVelocity(0, i).norm();
-            v = 0.5 * ((v - vmin) / (vmax - vmin));
-            v = min(128.0 * v * v, 0.5);
+            Real vel = v[i].norm();
+            vel = 0.5 * ((vel - vmin) / (vmax - vmin));
+            vel = min(128.0 * vel * vel, 0.5);
             float fluidColor[4] = { 0.2f, 0.2f, 0.2f, 1.0 };
-            MiniGL::hsvToRgb(0.55f, 1.0f, 0.5f + (float)v, fluidColor);
+            MiniGL::hsvToRgb(0.55f, 1.0f, 0.5f + (float)vel, fluidColor);
 
             glColor3fv(fluidColor);
-            glVertex3v(&m_simulationMethod.model.getPosition(0, i)[0]);
+            glVertex3v(&x[i][0]);
         }
         glEnd();
         glEnable(GL_LIGHTING);
     }
 
 
+    // nothing is selected before the first snapshot is available
+    static const std::vector<unsigned int> noSelection;
+    const std::vector<unsigned int>&        selected = (nParticles > 0) ? getSelectedParticles() : noSelection;
+
     float red[4] = { 0.8f, 0.0f, 0.0f, 1 };
     if(MiniGL::checkOpenGLVersion(3, 3))
     {
         pointShaderBegin(&red[0]);
-        if(getSelectedParticles().size() > 0)
+        if(selected.size() > 0)
         {
             glUniform1f(m_shader.getUniform("radius"), (float)m_scene.particleRadius * 1.05f);
             glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, &m_simulationMethod.model.getPosition(0, 0));
+            glVertexAttribPointer(0, 3, GL_DOUBLE, GL_FALSE, 0, x);
             glEnableVertexAttribArray(1);
-            glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 0, &m_simulationMethod.model.getVelocity(0, 0));
-            glDrawElements(GL_POINTS, (GLsizei)getSelectedParticles().size(), GL_UNSIGNED_INT, getSelectedParticles().data());
+            glVertexAttribPointer(1, 3, GL_DOUBLE, GL_FALSE, 0, v);
+            glDrawElements(GL_POINTS, (GLsizei)selected.size(), GL_UNSIGNED_INT, selected.data());
             glDisableVertexAttribArray(0);
             glDisableVertexAttribArray(1);
         }
@@ -743,16 +919,16 @@ void DemoBase::renderFluid()
         glPointSize(4.0);
         glDisable(GL_LIGHTING);
         glBegin(GL_POINTS);
-        for(unsigned int i = 0; i < getSelectedParticles().size(); i++)
+        for(unsigned int i = 0; i < selected.size(); i++)
         {
             glColor3fv(red);
-            glVertex3v(&getSimulationMethod().model.getPosition(0, getSelectedParticles()[i])[0]);
+            glVertex3v(&x[selected[i]][0]);
         }
         glEnd();
         glEnable(GL_LIGHTING);
     }
 
-    MiniGL::drawTime(TimeManager::getCurrent()->getTime());
+    MiniGL::drawTime(time);
 }
 
 
@@ -764,13 +940,16 @@ void DemoBase::mouseMove(int x, int y, void* clientData)
     MiniGL::unproject(x, y, mousePos);
     const Vector3r diff = mousePos - base->m_oldMousePos;
 
-    TimeManager*   tm = TimeManager::getCurrent();
-    const Real     h  = tm->getTimeStepSize();
-
-    for(unsigned int j = 0; j < base->m_selectedParticles.size(); j++)
+    base->m_simulationThread.execute([base, &diff]()
     {
-        base->m_simulationMethod.model.getVelocity(0, base->m_selectedParticles[j]) += 5.0 * diff / h;
-    }
+        TimeManager* tm = base->m_simulationMethod.model.getTimeManager();
+        const Real   h  = tm->getTimeStepSize();
+
+        for(unsigned int j = 0; j < base->m_selectedParticles.size(); j++)
+        {
+            base->m_simulationMethod.model.getVelocity(0, base->m_selectedParticles[j]) += 5.0 * diff / h;
+        }
+    });
     base->m_oldMousePos = mousePos;
 }
 
@@ -780,9 +959,12 @@ void DemoBase::selection(const Eigen::Vector2i& start, const Eigen::Vector2i& en
 
     std::vector<unsigned int> hits;
     base->m_selectedParticles.clear();
-    Selection::selectRect(start, end, &base->m_simulationMethod.model.getPosition(0, 0),
-        &base->m_simulationMethod.model.getPosition(0, base->m_simulationMethod.model.numParticles() - 1),
-        base->m_selectedParticles);
+    base->m_simulationThread.execute([base, &start, &end]()
+    {
+        Selection::selectRect(start, end, &base->m_simulationMethod.model.getPosition(0, 0),
+            &base->m_simulationMethod.model.getPosition(0, base->m_simulationMethod.model.numParticles() - 1),
+            base->m_selectedParticles);
+    });
     if(base->m_selectedParticles.size() > 0)
         MiniGL::setMouseMoveFunc(GLUT_MIDDLE_BUTTON, mouseMove);
     else
@@ -807,7 +989,7 @@ void DemoBase::setSimulationMethod(SimulationMethods method)
             m_simulationMethod.model.setKernel(0);
             m_simulationMethod.model.setGradKernel(0);
             m_simulationMethod.model.updateBoundaryPsi();
-            TimeManager::getCurrent()->setTimeStepSize(0.001);
+            m_simulationMethod.model.getTimeManager()->setTimeStepSize(0.001);
         }
         else if(method == SimulationMethods::PCISPH)
         {
@@ -6,6 +6,10 @@
 #include "Visualization/Shader.h"
 #include "SPlisHSPlasH/TimeStep.h"
 #include "SPlisHSPlasH/FluidModel.h"
+#include "SPlisHSPlasH/TelemetryLog.h"
+#include "SPlisHSPlasH/MetricsServer.h"
+#include "SPlisHSPlasH/FrameBudget.h"
+#include "SPlisHSPlasH/SimulationThread.h"
 #include "extern/AntTweakBar/include/AntTweakBar.h"
 
 namespace SPH
@@ -37,12 +41,15 @@ public:
         TimeStepSize = 1, IterationCount, IterationCountV,
         Gravitation, SimMethod, VelocityUpdateMethod,
         Viscosity, ViscosityMethod,
-        WCSPH_Stiffness, WCSPH_Exponent,
+        WCSPH_Stiffness, WCSPH_Exponent, WCSPH_TimeStepLevels,
         DFSPH_EnableDivergenceSolver,
         CFL_Method, CFL_Factor, CFL_MaxTimeStepSize,
         Kernel_Method, GradKernel_Method,
         SurfaceTension, SurfaceTensionMethod,
-        MaxIterations, MaxError, MaxIterationsV, MaxErrorV
+        MaxIterations, MaxError, MaxIterationsV, MaxErrorV,
+        NeighborhoodSearchSkin, TiledTraversal, ParticleOrdering,
+        TargetFrameTime, ExceededFrames, ToleranceScale,
+        Pause, PauseAt, NumberOfStepsPerRenderUpdate
     };
 
     enum SimulationMethods { WCSPH = 0, PCISPH, PBF, IISPH, DFSPH };
@@ -69,6 +76,12 @@ protected:
     Vector3r                   m_oldMousePos;
     std::vector<unsigned int>  m_selectedParticles;
     SimulationMethodChangedFct m_simulationMethodChangedFct;
+    TelemetryLog               m_telemetryLog;
+    MetricsServer              m_metricsServer;
+    FrameBudget                m_frameBudget;
+    SimulationThread           m_simulationThread;
+    /** Snapshots of the simulation thread which are rendered */
+    SnapshotBuffer             m_renderSnapshots;
 
     void initShaders();
     void initParameters();
@@ -76,6 +89,7 @@ protected:
     void createFluidBlocks(std::vector<Vector3r>& fluidParticles);
 
     static void TW_CALL setParameter(const void* value, void* clientData);
+    static void applyParameter(Parameter* p, const void* value);
     static void TW_CALL getParameter(void* value, void* clientData);
 
     static void selection(const Eigen::Vector2i& start, const Eigen::Vector2i& end, void* clientData);
@@ -88,6 +102,10 @@ public:
     void init(int argc, char** argv, const char* demoName);
     void buildModel();
     void cleanup();
+    /** Run the frames of the simulation on a dedicated thread. The fluid is rendered from the latest snapshot of the thread. */
+    void startSimulationThread(const SimulationThread::FrameFct& frameFct);
+    /** Print the memory usage of the subsystems of the simulation (see MemoryUsage). */
+    void printMemoryUsage();
 
     void renderFluid();
 
@@ -141,6 +159,22 @@ public:
     {
         return m_simulationMethod;
     }
+    TelemetryLog& getTelemetryLog()
+    {
+        return m_telemetryLog;
+    }
+    MetricsServer& getMetricsServer()
+    {
+        return m_metricsServer;
+    }
+    FrameBudget& getFrameBudget()
+    {
+        return m_frameBudget;
+    }
+    SimulationThread& getSimulationThread()
+    {
+        return m_simulationThread;
+    }
 
     int getRenderWalls() const
     {
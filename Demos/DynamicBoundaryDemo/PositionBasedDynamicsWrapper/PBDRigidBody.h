@@ -17,7 +17,7 @@ namespace SPH
 	public:
 		PBDRigidBody(PBD::RigidBody *rigidBody) : m_rigidBody(rigidBody), m_h(0.0) {}
 
-		void updateTimeStepSize() { m_h = TimeManager::getCurrent()->getTimeStepSize(); }
+		void updateTimeStepSize(const Real h) { m_h = h; }
 
 		virtual bool isDynamic() const { return m_rigidBody->getMass() != 0.0; }
 
@@ -127,11 +127,11 @@ void PBDWrapper::initShader()
  
 
  
- void PBDWrapper::timeStep()
+ void PBDWrapper::timeStep(const Real timeStepSize)
  {
 	PBD::ParticleData &pd = m_model.getParticles();
 	PBD::SimulationModel::RigidBodyVector &rb = m_model.getRigidBodies();
-	PBD::TimeManager::getCurrent()->setTimeStepSize(SPH::TimeManager::getCurrent()->getTimeStepSize());
+	PBD::TimeManager::getCurrent()->setTimeStepSize(timeStepSize);
 
 	m_sim.step(m_model);
 
@@ -48,7 +48,7 @@ public:
 	void initTriangleModelConstraints();
 	void initTetModelConstraints();
 
-	void timeStep();
+	void timeStep(const Real timeStepSize);
 	void updateVisModels();
 
 	void initShader();
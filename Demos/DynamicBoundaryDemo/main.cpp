@@ -56,14 +56,17 @@ int main(int argc, char** argv)
     base.setSimulationMethodChangedFct(simulationMethodChanged);
     pbdWrapper.initGUI();
 
-    pbdWrapper.initModel(TimeManager::getCurrent()->getTimeStepSize());
+    pbdWrapper.initModel(base.getSimulationMethod().model.getTimeManager()->getTimeStepSize());
 
+    // the rigid bodies are rendered from the state of the PBD simulation, so the simulation runs
+    // in the idle function (no simulation thread)
     MiniGL::setClientIdleFunc(50, timeStep);
     MiniGL::setKeyFunc(0, 'r', reset);
     MiniGL::setClientSceneFunc(render);
 
     glutMainLoop();
 
+    Timing::printThreadBusyTimes(base.getSimulationMethod().model.getThreadBusyTimes());
     base.cleanup();
 
     Timing::printAverageTimes();
@@ -76,6 +79,9 @@ void reset()
 {
     Timing::printAverageTimes();
     Timing::reset();
+    Timing::printThreadBusyTimes(base.getSimulationMethod().model.getThreadBusyTimes());
+    base.getSimulationMethod().model.resetThreadBusyTimes();
+    base.getFrameBudget().reset();
 
     //////////////////////////////////////////////////////////////////////////
     // PBD
@@ -85,28 +91,32 @@ void reset()
     updateBoundaryParticles(true);
 
     base.getSimulationMethod().simulation->reset();
-    TimeManager::getCurrent()->setTime(0.0);
+    base.getSimulationMethod().model.getTimeManager()->setTime(0.0);
 }
 
 
 
 void timeStep()
 {
-    if((base.getPauseAt() > 0.0) && (base.getPauseAt() < TimeManager::getCurrent()->getTime()))
+    if((base.getPauseAt() > 0.0) && (base.getPauseAt() < base.getSimulationMethod().model.getTimeManager()->getTime()))
         base.setPause(true);
 
     if(base.getPause())
         return;
 
     // Simulation code
-    for(unsigned int i = 0; i < base.getNumberOfStepsPerRenderUpdate(); i++)
+    FrameBudget& budget = base.getFrameBudget();
+    budget.beginFrame(base.getSimulationMethod().simulation, base.getNumberOfStepsPerRenderUpdate());
+    while(budget.nextStep(base.getSimulationMethod().simulation))
     {
         START_TIMING("SimStep");
         base.getSimulationMethod().simulation->step();
         STOP_TIMING_AVG;
+        base.getTelemetryLog().record(base.getSimulationMethod().simulation);
+        base.getMetricsServer().publish(base.getSimulationMethod().simulation);
 
         // if fluid is stabilizing, then don't update solid
-        if(TimeManager::getCurrent()->getTime() < base.getScene().stabilizingTime)
+        if(base.getSimulationMethod().model.getTimeManager()->getTime() < base.getScene().stabilizingTime)
             continue;
 
         updateBoundaryForces();
@@ -115,12 +125,12 @@ void timeStep()
         // PBD
         //////////////////////////////////////////////////////////////////////////
         START_TIMING("SimStep - PBD");
-        pbdWrapper.timeStep();
+        pbdWrapper.timeStep(base.getSimulationMethod().model.getTimeManager()->getTimeStepSize());
         STOP_TIMING_AVG;
 
         updateBoundaryParticles(false);
 
-        int savedFluidFrame = base.getSimulationMethod().model.writeFrameFluidData(TimeManager::getCurrent()->getTime());
+        int savedFluidFrame = base.getSimulationMethod().model.writeFrameFluidData(base.getSimulationMethod().model.getTimeManager()->getTime());
 
 
         static std::vector < Vector3r > vertices;
@@ -170,6 +180,7 @@ void timeStep()
             base.m_MeshWriter->flush_buffer_async(savedFluidFrame);
         }
     }
+    budget.endFrame(base.getSimulationMethod().simulation);
 }
 
 void simulationMethodChanged()
@@ -366,7 +377,7 @@ void updateBoundaryParticles(const bool forceUpdate = false)
 
 void updateBoundaryForces()
 {
-    Real                h        = TimeManager::getCurrent()->getTimeStepSize();
+    Real                h        = base.getSimulationMethod().model.getTimeManager()->getTimeStepSize();
     SceneLoader::Scene& scene    = base.getScene();
     const unsigned int  nObjects = base.getSimulationMethod().model.numberOfRigidBodyParticleObjects();
     for(unsigned int i = 0; i < nObjects; i++)
@@ -375,7 +386,7 @@ void updateBoundaryForces()
         RigidBodyObject*                     rbo  = rbpo->m_rigidBody;
         if(rbo->isDynamic())
         {
-            ((PBDRigidBody*)rbo)->updateTimeStepSize();
+            ((PBDRigidBody*)rbo)->updateTimeStepSize(h);
             Vector3r force, torque;
             force.setZero();
             torque.setZero();
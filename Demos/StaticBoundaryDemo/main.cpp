@@ -24,7 +24,8 @@ using namespace SPH;
 using namespace Eigen;
 using namespace std;
 
-void timeStep();
+bool timeStep();
+void idle();
 void initBoundaryData();
 void render();
 void renderBoundary();
@@ -44,8 +45,8 @@ int main(int argc, char** argv)
     base.buildModel();
 
     ////////////////////////////////////////////////////////////////////////////////
-    auto scene            = base.getScene();
-    auto simulationMethod = base.getSimulationMethod();
+    auto  scene            = base.getScene();
+    auto& simulationMethod = base.getSimulationMethod();
     base.m_MeshWriter->reset_buffer();
     base.m_MeshWriter->getBuffer().push_back(static_cast<unsigned int>(scene.boundaryModels.size() - 1));
 
@@ -90,47 +91,74 @@ int main(int argc, char** argv)
 
 
     ////////////////////////////////////////////////////////////////////////////////
-    MiniGL::setClientIdleFunc(50, timeStep);
+    if(scene.simulationThread)
+        base.startSimulationThread(timeStep);
+    MiniGL::setClientIdleFunc(50, idle);
     MiniGL::setKeyFunc(0, 'r', reset);
     MiniGL::setClientSceneFunc(render);
 
     glutMainLoop();
 
+    // the time measurements are thread-local
+    base.getSimulationThread().post([]()
+    {
+        Timing::printThreadBusyTimes(base.getSimulationMethod().model.getThreadBusyTimes());
+        Timing::printAverageTimes();
+        Timing::printTimeSums();
+    });
     base.cleanup();
 
-    Timing::printAverageTimes();
-    Timing::printTimeSums();
-
     return 0;
 }
 
 void reset()
 {
-    Timing::printAverageTimes();
-    Timing::reset();
+    // runs on the simulation thread since the time measurements are thread-local
+    base.getSimulationThread().post([]()
+    {
+        Timing::printAverageTimes();
+        Timing::reset();
+        Timing::printThreadBusyTimes(base.getSimulationMethod().model.getThreadBusyTimes());
+        base.getSimulationMethod().model.resetThreadBusyTimes();
+        base.getFrameBudget().reset();
+
+        base.getSimulationMethod().simulation->reset();
+        base.getSimulationMethod().model.getTimeManager()->setTime(0.0);
+    });
+}
+
 
-    base.getSimulationMethod().simulation->reset();
-    TimeManager::getCurrent()->setTime(0.0);
+void idle()
+{
+    // with a simulation thread the idle function only triggers the redisplay of the latest snapshot
+    if(!base.getSimulationThread().isRunning())
+        timeStep();
 }
 
 
-void timeStep()
+bool timeStep()
 {
-    if((base.getPauseAt() > 0.0) && (base.getPauseAt() < TimeManager::getCurrent()->getTime()))
+    if((base.getPauseAt() > 0.0) && (base.getPauseAt() < base.getSimulationMethod().model.getTimeManager()->getTime()))
         base.setPause(true);
 
     if(base.getPause())
-        return;
+        return false;
 
     // Simulation code
-    for(unsigned int i = 0; i < base.getNumberOfStepsPerRenderUpdate(); i++)
+    FrameBudget& budget = base.getFrameBudget();
+    budget.beginFrame(base.getSimulationMethod().simulation, base.getNumberOfStepsPerRenderUpdate());
+    while(budget.nextStep(base.getSimulationMethod().simulation))
     {
         START_TIMING("SimStep");
         base.getSimulationMethod().simulation->step();
         STOP_TIMING_AVG;
+        base.getTelemetryLog().record(base.getSimulationMethod().simulation);
+        base.getMetricsServer().publish(base.getSimulationMethod().simulation);
 
-        base.getSimulationMethod().model.writeFrameFluidData(TimeManager::getCurrent()->getTime());
+        base.getSimulationMethod().model.writeFrameFluidData(base.getSimulationMethod().model.getTimeManager()->getTime());
     }
+    budget.endFrame(base.getSimulationMethod().simulation);
+    return true;
 }
 
 
@@ -142,6 +170,8 @@ void render()
     renderBoundary();
 }
 
+// the positions of static boundary particles do not change, so they are read from the model also
+// while the simulation thread is running
 void renderBoundary()
 {
     DemoBase::SimulationMethod& simulationMethod      = base.getSimulationMethod();
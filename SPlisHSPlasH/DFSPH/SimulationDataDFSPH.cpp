@@ -1,5 +1,6 @@
 #include "SimulationDataDFSPH.h"
 #include "SPlisHSPlasH/SPHKernels.h"
+#include <algorithm>
 
 using namespace SPH;
 
@@ -34,11 +35,8 @@ void SimulationDataDFSPH::cleanup()
 
 void SimulationDataDFSPH::reset()
 {
-	for (unsigned int i = 0; i < m_kappa.size(); i++)
-	{
-		m_kappa[i] = 0.0;
-		m_kappaV[i] = 0.0;
-	}
+	std::fill(m_kappa.begin(), m_kappa.end(), 0.0);
+	std::fill(m_kappaV.begin(), m_kappaV.end(), 0.0);
 }
 
 void SimulationDataDFSPH::performNeighborhoodSearchSort()
@@ -47,9 +45,16 @@ void SimulationDataDFSPH::performNeighborhoodSearchSort()
 	if (numPart == 0)
 		return;
 
-	auto const& d = m_model->getNeighborhoodSearch()->point_set(0);
-	d.sort_field(&m_factor[0]);
-	d.sort_field(&m_kappa[0]);
-	d.sort_field(&m_kappaV[0]);
-	d.sort_field(&m_density_adv[0]);
+	m_model->sortField(&m_factor[0]);
+	m_model->sortField(&m_kappa[0]);
+	m_model->sortField(&m_kappaV[0]);
+	m_model->sortField(&m_density_adv[0]);
+}
+
+void SimulationDataDFSPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	usage.addFluidArray("DFSPH", m_factor);
+	usage.addFluidArray("DFSPH", m_kappa);
+	usage.addFluidArray("DFSPH", m_kappaV);
+	usage.addFluidArray("DFSPH", m_density_adv);
 }
@@ -20,13 +20,13 @@ namespace SPH
 			FluidModel *m_model;
 
 			/** \brief factor \f$\alpha_i\f$ \cite Bender:2015 */
-			std::vector<Real> m_factor;
+			ParticleVector<Real> m_factor;
 			/** \brief stores \f$\kappa\f$ value of last time step for a warm start of the pressure solver */
-			std::vector<Real> m_kappa;
+			ParticleVector<Real> m_kappa;
 			/** \brief stores \f$\kappa^v\f$ value of last time step for a warm start of the divergence solver */
-			std::vector<Real> m_kappaV;
+			ParticleVector<Real> m_kappaV;
 			/** \brief advected density */
-			std::vector<Real> m_density_adv;
+			ParticleVector<Real> m_density_adv;
 
 		public:
 
@@ -43,10 +43,13 @@ namespace SPH
 			virtual void reset();
 
 			/** Important: First call m_model->performNeighborhoodSearchSort() 
-			 * to call the z_sort of the neighborhood search.
+			 * to compute the new order of the particles.
 			 */
 			void performNeighborhoodSearchSort();
 
+			/** Add the memory of the particle data (see MemoryUsage). */
+			void getMemoryUsage(MemoryUsage &usage) const;
+
 			FORCE_INLINE const Real getFactor(const unsigned int i) const
 			{
 				return m_factor[i];
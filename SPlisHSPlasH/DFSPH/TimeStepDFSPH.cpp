@@ -26,7 +26,7 @@ TimeStepDFSPH::~TimeStepDFSPH(void)
 
 void TimeStepDFSPH::step()
 {
-	TimeManager *tm = TimeManager::getCurrent ();
+	TimeManager *tm = m_model->getTimeManager();
 	const Real h = tm->getTimeStepSize();
 
 	const unsigned int numParticles = m_model->numParticles();
@@ -34,7 +34,8 @@ void TimeStepDFSPH::step()
 
 	performNeighborhoodSearch();
 
-	computeDensities();
+	// Accelerations are cleared in the density loop, the divergence solver does not use them
+	computeDensities(true);
 
 	START_TIMING("computeDFSPHFactor");
 	computeDFSPHFactor();
@@ -50,23 +51,25 @@ void TimeStepDFSPH::step()
 		m_iterationsV = 0;
 
 	// Compute accelerations: a(t)
-	clearAccelerations();
-
 	computeSurfaceTension();
 	computeViscosity();
 
-	updateTimeStepSize();
-
+	// The max. velocity for the CFL condition is determined in the same loop
 	#pragma omp parallel default(shared)
 	{
-		#pragma omp for schedule(static)  
+		Real maxVelLocal = 0.0;
+		#pragma omp for schedule(static) nowait
 		for (int i = 0; i < (int)numParticles; i++)
 		{
 			Vector3r &vel = m_model->getVelocity(0, i);
 			vel += h * m_model->getAcceleration(i);
+			maxVelLocal = max(maxVelLocal, vel.squaredNorm());
 		}
+		updateMaxVelocity(maxVelLocal);
 	}
 
+	updateTimeStepSize();
+
 	START_TIMING("pressureSolve");
 	pressureSolve();
 	STOP_TIMING_AVG;
@@ -92,7 +95,7 @@ void TimeStepDFSPH::computeDFSPHFactor()
 	// Init parameters
 	//////////////////////////////////////////////////////////////////////////
 
-	const Real h = TimeManager::getCurrent()->getTimeStepSize();
+	const Real h = m_model->getTimeManager()->getTimeStepSize();
 	const int numParticles = (int) m_model->numParticles();
 
 	#pragma omp parallel default(shared)
@@ -102,187 +105,287 @@ void TimeStepDFSPH::computeDFSPHFactor()
 		//////////////////////////////////////////////////////////////////////////
 
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			//////////////////////////////////////////////////////////////////////////
-			// Compute gradient dp_i/dx_j * (1/k)  and dp_j/dx_j * (1/k)
-			//////////////////////////////////////////////////////////////////////////
-			const Vector3r &xi = m_model->getPosition(0, i);
-			Real sum_grad_p_k = 0.0;
-			Vector3r grad_p_i;
-			grad_p_i.setZero();
-
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-				if (particleId.point_set_id == 0)
-				{					
-					const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
-					sum_grad_p_k += grad_p_j.squaredNorm();
+				//////////////////////////////////////////////////////////////////////////
+				// Compute gradient dp_i/dx_j * (1/k)  and dp_j/dx_j * (1/k)
+				//////////////////////////////////////////////////////////////////////////
+				const Vector3r &xi = m_model->getPosition(0, i);
+				Real sum_grad_p_k = 0.0;
+				Vector3r grad_p_i;
+				grad_p_i.setZero();
 
-					grad_p_i -= grad_p_j;
-				}
-				else
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
-					sum_grad_p_k += grad_p_j.squaredNorm();
-					grad_p_i -= grad_p_j;
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+					if (particleId.point_set_id == 0)
+					{					
+						const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
+						sum_grad_p_k += grad_p_j.squaredNorm();
+
+						grad_p_i -= grad_p_j;
+					}
+					else
+					{
+						const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
+						sum_grad_p_k += grad_p_j.squaredNorm();
+						grad_p_i -= grad_p_j;
+					}
 				}
-			}
 
-			sum_grad_p_k += grad_p_i.squaredNorm();
+				sum_grad_p_k += grad_p_i.squaredNorm();
 
-			//////////////////////////////////////////////////////////////////////////
-			// Compute pressure stiffness denominator
-			//////////////////////////////////////////////////////////////////////////
-			Real &factor = m_simulationData.getFactor(i);
+				//////////////////////////////////////////////////////////////////////////
+				// Compute pressure stiffness denominator
+				//////////////////////////////////////////////////////////////////////////
+				Real &factor = m_simulationData.getFactor(i);
 
-			sum_grad_p_k = max(sum_grad_p_k, 1.0e-6);
-			factor = -1.0 / (sum_grad_p_k);
+				sum_grad_p_k = max(sum_grad_p_k, 1.0e-6);
+				factor = -1.0 / (sum_grad_p_k);
+			}
 		}
 	}
 }
 
 void TimeStepDFSPH::pressureSolve()
 {
-	const Real h = TimeManager::getCurrent()->getTimeStepSize();
+	const Real h = m_model->getTimeManager()->getTimeStepSize();
 	const Real h2 = h*h;
 	const Real invH = 1.0 / h;
 	const Real invH2 = 1.0/h2;
 	const Real density0 = m_model->getDensity0();
 	const int numParticles = (int)m_model->numParticles();
 	Real avg_density_err = 0.0;
+	Real density_err_sum = 0.0;
+	m_iterations = 0;
+	const bool tiled = m_model->useTiledTraversal();
+	ParticleTiles &tiles = m_model->getParticleTiles();
 
-#ifdef USE_WARMSTART			
+	// Maximal allowed density fluctuation
+	const Real eta = m_maxError * m_toleranceScale * 0.01 * density0;  // maxError is given in percent
+	unsigned int maxIterations = m_maxIterations;
+
+	m_model->ensureThreadForceBuffers();
+	if (tiled)
+		tiles.ensureBlocks();
+
+	// All phases of the solver are executed in a single parallel region
 	#pragma omp parallel default(shared)
 	{
+#ifdef USE_WARMSTART			
 		//////////////////////////////////////////////////////////////////////////
 		// Divide by h^2, the time step size has been removed in 
 		// the last step to make the stiffness value independent 
 		// of the time step size
 		//////////////////////////////////////////////////////////////////////////
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			m_simulationData.getKappa(i) = max(m_simulationData.getKappa(i)*invH2, -0.5);
-			//computeDensityAdv(i, numParticles, h, density0);
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+			{
+				m_simulationData.getKappa(i) = max(m_simulationData.getKappa(i)*invH2, -0.5);
+				//computeDensityAdv(i, numParticles, h, density0);
+			}
 		}
 
 		//////////////////////////////////////////////////////////////////////////
 		// Predict v_adv with external velocities
 		////////////////////////////////////////////////////////////////////////// 
 
-		#pragma omp for schedule(static)  
-		for (int i = 0; i < numParticles; i++)
+		if (tiled)
 		{
-			//if (m_simulationData.getDensityAdv(i) > density0)
+			#pragma omp for schedule(static)
+			for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
 			{
-				Vector3r &vel = m_model->getVelocity(0, i);
-				const Real ki = m_simulationData.getKappa(i);
-				const Vector3r &xi = m_model->getPosition(0, i);
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)
+					const ParticleTiles::Tile &tile = tiles.getTile(t);
+					ParticleTiles::Block &block = tiles.getBlock();
+					ParticleTiles::gatherValues(tile, block, [&](const unsigned int j) { return m_simulationData.getKappa(j); });
+					applyPressureTile(tile, block, h, invH);
+				}
+			}
+		}
+		else
+		{
+			#pragma omp for schedule(static)  
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+			{
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+				{
+					//if (m_simulationData.getDensityAdv(i) > density0)
 					{
-						const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
-						const Real kj = m_simulationData.getKappa(neighborIndex);
-						vel -= h * (ki + kj) * grad_p_j;					// ki, kj already contain inverse density
-					}
-					else
-					{
-						const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
-
-						const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
-						vel += velChange;
-
-						m_model->getForce(particleId.point_set_id, neighborIndex) -= m_model->getMass(i) * velChange * invH;
+						Vector3r &vel = m_model->getVelocity(0, i);
+						const Real ki = m_simulationData.getKappa(i);
+						const Vector3r &xi = m_model->getPosition(0, i);
+						for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+						{
+							const PointID &particleId = m_model->getNeighbor(i, j);
+							const unsigned int &neighborIndex = particleId.point_id;
+							const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+							if (particleId.point_set_id == 0)
+							{
+								const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
+								const Real kj = m_simulationData.getKappa(neighborIndex);
+								vel -= h * (ki + kj) * grad_p_j;					// ki, kj already contain inverse density
+							}
+							else
+							{
+								const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
+
+								const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
+								vel += velChange;
+
+								m_model->addForce(particleId.point_set_id, neighborIndex, -m_model->getMass(i) * velChange * invH);
+							}
+						}
 					}
 				}
 			}
 		}
-	}
 #endif
 
-	//////////////////////////////////////////////////////////////////////////
-	// Compute rho_adv
-	//////////////////////////////////////////////////////////////////////////
-	#pragma omp parallel default(shared)
-	{
-		#pragma omp for schedule(static)  
-		for (int i = 0; i < numParticles; i++)
+		//////////////////////////////////////////////////////////////////////////
+		// Compute rho_adv
+		//////////////////////////////////////////////////////////////////////////
+		if (tiled)
 		{
-			computeDensityAdv(i, numParticles, h, density0);
-			m_simulationData.getFactor(i) *= invH2;
+			#pragma omp for schedule(static)
+			for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
+			{
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
+				{
+					const ParticleTiles::Tile &tile = tiles.getTile(t);
+					computeDensityAdvTile(tile, tiles.getBlock(), h, density0);
+					for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
+					{
+						const unsigned int i = tile.getParticleIndex(l);
+						m_simulationData.getFactor(i) *= invH2;
 #ifdef USE_WARMSTART
-			m_simulationData.getKappa(i) = 0.0;
+						m_simulationData.getKappa(i) = 0.0;
 #endif
+					}
+				}
+			}
+		}
+		else
+		{
+			#pragma omp for schedule(static)  
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+			{
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+				{
+					computeDensityAdv(i, numParticles, h, density0);
+					m_simulationData.getFactor(i) *= invH2;
+#ifdef USE_WARMSTART
+					m_simulationData.getKappa(i) = 0.0;
+#endif
+				}
+			}
 		}
-	}
-
-	m_iterations = 0;
 
-	//////////////////////////////////////////////////////////////////////////
-	// Start solver
-	//////////////////////////////////////////////////////////////////////////
-	
-	// Maximal allowed density fluctuation
-	const Real eta = m_maxError * 0.01 * density0;  // maxError is given in percent
-	
-	while (((avg_density_err > eta) || (m_iterations < 2)) && (m_iterations < m_maxIterations))
-	{
-		avg_density_err = 0.0;
+		//////////////////////////////////////////////////////////////////////////
+		// Start solver
+		//////////////////////////////////////////////////////////////////////////
 
-		#pragma omp parallel default(shared)
+		// The loop condition is evaluated by all threads, the shared error, iteration 
+		// count and iteration limit are only changed in the single section at the end.
+		while (((avg_density_err > eta) || (m_iterations < 2)) && (m_iterations < maxIterations))
 		{
 			//////////////////////////////////////////////////////////////////////////
 			// Compute pressure forces
 			//////////////////////////////////////////////////////////////////////////
-			#pragma omp for schedule(static) 
-			for (int i = 0; i < numParticles; i++)
+			if (tiled)
 			{
-				//////////////////////////////////////////////////////////////////////////
-				// Evaluate rhs
-				//////////////////////////////////////////////////////////////////////////
-				const Real b_i = m_simulationData.getDensityAdv(i) - density0;
-				const Real ki = b_i*m_simulationData.getFactor(i);
-#ifdef USE_WARMSTART
-				m_simulationData.getKappa(i) += ki;
-#endif
-
-				Vector3r &v_i = m_model->getVelocity(0, i);
-				const Vector3r &xi = m_model->getPosition(0, i);
-
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				#pragma omp for schedule(static)
+				for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
 					{
-						const Real b_j = m_simulationData.getDensityAdv(neighborIndex) - density0;
-						const Real kj = b_j*m_simulationData.getFactor(neighborIndex);
-						const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
-
-						// Directly update velocities instead of storing pressure accelerations
-						v_i -= h * (ki + kj) * grad_p_j;			// ki, kj already contain inverse density						
+						const ParticleTiles::Tile &tile = tiles.getTile(t);
+						ParticleTiles::Block &block = tiles.getBlock();
+						ParticleTiles::gatherValues(tile, block, [&](const unsigned int j) { return (m_simulationData.getDensityAdv(j) - density0)*m_simulationData.getFactor(j); });
+						applyPressureTile(tile, block, h, invH);
+#ifdef USE_WARMSTART
+						for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
+							m_simulationData.getKappa(tile.getParticleIndex(l)) += block.m_value[l];
+#endif
 					}
-					else
+				}
+			}
+			else
+			{
+				#pragma omp for schedule(static) 
+				for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+				{
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 					{
-						const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
-
-						// Directly update velocities instead of storing pressure accelerations
-						const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
-						v_i += velChange;
+						//////////////////////////////////////////////////////////////////////////
+						// Evaluate rhs
+						//////////////////////////////////////////////////////////////////////////
+						const Real b_i = m_simulationData.getDensityAdv(i) - density0;
+						const Real ki = b_i*m_simulationData.getFactor(i);
+#ifdef USE_WARMSTART
+						m_simulationData.getKappa(i) += ki;
+#endif
 
-						m_model->getForce(particleId.point_set_id, neighborIndex) -= m_model->getMass(i) * velChange * invH;
+						Vector3r &v_i = m_model->getVelocity(0, i);
+						const Vector3r &xi = m_model->getPosition(0, i);
+						const unsigned int numNeighbors = m_model->numberOfNeighbors(i);
+
+						// The kernel gradients are evaluated for a batch of neighbors at once
+						Vector3r xixj[KernelBatchSize];
+						Vector3r gradW_ij[KernelBatchSize];
+						for (unsigned int j0 = 0; j0 < numNeighbors; j0 += KernelBatchSize)
+						{
+							const unsigned int n = std::min(numNeighbors - j0, KernelBatchSize);
+							for (unsigned int k = 0; k < n; k++)
+							{
+								const PointID &particleId = m_model->getNeighbor(i, j0 + k);
+								xixj[k] = xi - m_model->getPosition(particleId.point_set_id, particleId.point_id);
+							}
+							m_model->gradW(n, xixj, gradW_ij);
+
+							for (unsigned int k = 0; k < n; k++)
+							{
+								const PointID &particleId = m_model->getNeighbor(i, j0 + k);
+								const unsigned int &neighborIndex = particleId.point_id;
+
+								if (particleId.point_set_id == 0)
+								{
+									const Real b_j = m_simulationData.getDensityAdv(neighborIndex) - density0;
+									const Real kj = b_j*m_simulationData.getFactor(neighborIndex);
+									const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * gradW_ij[k];
+
+									// Directly update velocities instead of storing pressure accelerations
+									v_i -= h * (ki + kj) * grad_p_j;			// ki, kj already contain inverse density						
+								}
+								else
+								{
+									const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * gradW_ij[k];
+
+									// Directly update velocities instead of storing pressure accelerations
+									const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
+									v_i += velChange;
+
+									m_model->addForce(particleId.point_set_id, neighborIndex, -m_model->getMass(i) * velChange * invH);
+								}
+							}
+						}
 					}
 				}
 			}
@@ -291,31 +394,57 @@ void TimeStepDFSPH::pressureSolve()
 			//////////////////////////////////////////////////////////////////////////
 			// Update rho_adv and density error
 			//////////////////////////////////////////////////////////////////////////
-			#pragma omp for reduction(+:avg_density_err) schedule(static) 
-			for (int i = 0; i < numParticles; i++)
+			if (tiled)
 			{
-				computeDensityAdv(i, numParticles, h, density0);
-
-				const Real density_err = m_simulationData.getDensityAdv(i) - density0;
-				avg_density_err += density_err;
+				#pragma omp for reduction(+:density_err_sum) schedule(static)
+				for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
+				{
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
+					{
+						density_err_sum += computeDensityAdvTile(tiles.getTile(t), tiles.getBlock(), h, density0);
+					}
+				}
 			}
-		}
-
-		avg_density_err /= numParticles;
+			else
+			{
+				#pragma omp for reduction(+:density_err_sum) schedule(static) 
+				for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+				{
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+					{
+						computeDensityAdv(i, numParticles, h, density0);
 
-		m_iterations++;
-	}
+						const Real density_err = m_simulationData.getDensityAdv(i) - density0;
+						density_err_sum += density_err;
+					}
+				}
+			}
 
+			#pragma omp single
+			{
+				avg_density_err = density_err_sum / numParticles;
+				density_err_sum = 0.0;
+				m_iterations++;
+				checkDeadline(m_iterations, 2, avg_density_err <= eta, maxIterations);
+			}
+		}
 
 #ifdef USE_WARMSTART
-	//////////////////////////////////////////////////////////////////////////
-	// Multiply by h^2, the time step size has to be removed 
-	// to make the stiffness value independent 
-	// of the time step size
-	//////////////////////////////////////////////////////////////////////////
-	for (int i = 0; i < numParticles; i++)
-		m_simulationData.getKappa(i) *= h2;
+		//////////////////////////////////////////////////////////////////////////
+		// Multiply by h^2, the time step size has to be removed 
+		// to make the stiffness value independent 
+		// of the time step size
+		//////////////////////////////////////////////////////////////////////////
+		#pragma omp for schedule(static)  
+		for (int i = 0; i < numParticles; i++)
+			m_simulationData.getKappa(i) *= h2;
 #endif
+	}
+	m_densityError = avg_density_err / density0 * 100.0;
+
+	m_model->reduceBoundaryForces();
 }
 
 void TimeStepDFSPH::divergenceSolve()
@@ -324,137 +453,217 @@ void TimeStepDFSPH::divergenceSolve()
 	// Init parameters
 	//////////////////////////////////////////////////////////////////////////
 
-	const Real h = TimeManager::getCurrent()->getTimeStepSize();
+	const Real h = m_model->getTimeManager()->getTimeStepSize();
 	const Real invH = 1.0 / h;
 	const int numParticles = (int)m_model->numParticles();
-	const unsigned int maxIter = m_maxIterationsV;
-	const Real maxError = m_maxErrorV;
+	unsigned int maxIter = m_maxIterationsV;
+	const Real maxError = m_maxErrorV * m_toleranceScale;
 	const Real density0 = m_model->getDensity0();
+	Real avg_density_err = 0.0;
+	Real density_err_sum = 0.0;
+	m_iterationsV = 0;
+	const bool tiled = m_model->useTiledTraversal();
+	ParticleTiles &tiles = m_model->getParticleTiles();
+
+	// Maximal allowed density fluctuation
+	// use maximal density error divided by time step size
+	const Real eta = (1.0/h) * maxError * 0.01 * density0;  // maxError is given in percent
 
+	m_model->ensureThreadForceBuffers();
+	if (tiled)
+		tiles.ensureBlocks();
 
-#ifdef USE_WARMSTART_V
+	// All phases of the solver are executed in a single parallel region
 	#pragma omp parallel default(shared)
 	{
+#ifdef USE_WARMSTART_V
 		//////////////////////////////////////////////////////////////////////////
 		// Divide by h^2, the time step size has been removed in 
 		// the last step to make the stiffness value independent 
 		// of the time step size
 		//////////////////////////////////////////////////////////////////////////
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			m_simulationData.getKappaV(i) = 0.5*max(m_simulationData.getKappaV(i)*invH, -0.5);
-			//computeDensityChange(i, h, density0);
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+			{
+				m_simulationData.getKappaV(i) = 0.5*max(m_simulationData.getKappaV(i)*invH, -0.5);
+				//computeDensityChange(i, h, density0);
+			}
 		}
 
-		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		if (tiled)
 		{
-			//if (m_simulationData.getDensityAdv(i) > 0.0)
+			#pragma omp for schedule(static)
+			for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
 			{
-				Vector3r &vel = m_model->getVelocity(0, i);
-				const Real ki = m_simulationData.getKappaV(i);
-				const Vector3r &xi = m_model->getPosition(0, i);
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)
-					{
-						const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
-						const Real kj = m_simulationData.getKappaV(neighborIndex);
-						vel -= h * (ki + kj) * grad_p_j;					// ki, kj already contain inverse density
-					}
-					else
+					const ParticleTiles::Tile &tile = tiles.getTile(t);
+					ParticleTiles::Block &block = tiles.getBlock();
+					ParticleTiles::gatherValues(tile, block, [&](const unsigned int j) { return m_simulationData.getKappaV(j); });
+					applyPressureTile(tile, block, h, invH);
+				}
+			}
+		}
+		else
+		{
+			#pragma omp for schedule(static)  
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+			{
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+				{
+					//if (m_simulationData.getDensityAdv(i) > 0.0)
 					{
-						const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
-
-						const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
-						vel += velChange;
-
-						m_model->getForce(particleId.point_set_id, neighborIndex) -= m_model->getMass(i) * velChange * invH;
+						Vector3r &vel = m_model->getVelocity(0, i);
+						const Real ki = m_simulationData.getKappaV(i);
+						const Vector3r &xi = m_model->getPosition(0, i);
+						for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+						{
+							const PointID &particleId = m_model->getNeighbor(i, j);
+							const unsigned int &neighborIndex = particleId.point_id;
+							const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+							if (particleId.point_set_id == 0)
+							{
+								const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
+								const Real kj = m_simulationData.getKappaV(neighborIndex);
+								vel -= h * (ki + kj) * grad_p_j;					// ki, kj already contain inverse density
+							}
+							else
+							{
+								const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
+
+								const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
+								vel += velChange;
+
+								m_model->addForce(particleId.point_set_id, neighborIndex, -m_model->getMass(i) * velChange * invH);
+							}
+						}
 					}
 				}
 			}
 		}
-	}
 #endif
 
-	//////////////////////////////////////////////////////////////////////////
-	// Compute velocity of density change
-	//////////////////////////////////////////////////////////////////////////
-	#pragma omp parallel default(shared)
-	{
-		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		//////////////////////////////////////////////////////////////////////////
+		// Compute velocity of density change
+		//////////////////////////////////////////////////////////////////////////
+		if (tiled)
 		{
-			computeDensityChange(i, h, density0);
-			m_simulationData.getFactor(i) *= invH;
-
+			#pragma omp for schedule(static)
+			for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
+			{
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
+				{
+					const ParticleTiles::Tile &tile = tiles.getTile(t);
+					computeDensityChangeTile(tile, tiles.getBlock(), h, density0);
+					for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
+					{
+						const unsigned int i = tile.getParticleIndex(l);
+						m_simulationData.getFactor(i) *= invH;
 #ifdef USE_WARMSTART_V
-			m_simulationData.getKappaV(i) = 0.0;
+						m_simulationData.getKappaV(i) = 0.0;
 #endif
+					}
+				}
+			}
 		}
-	}
-
-	m_iterationsV = 0;
-
-	//////////////////////////////////////////////////////////////////////////
-	// Start solver
-	//////////////////////////////////////////////////////////////////////////
-	
-	// Maximal allowed density fluctuation
-	// use maximal density error divided by time step size
-	const Real eta = (1.0/h) * maxError * 0.01 * density0;  // maxError is given in percent
-	
-	Real avg_density_err = 0.0;
-	while (((avg_density_err > eta) || (m_iterationsV < 1)) && (m_iterationsV < maxIter))
-	{
-		avg_density_err = 0.0;
-		
-		//////////////////////////////////////////////////////////////////////////
-		// Perform Jacobi iteration over all blocks
-		//////////////////////////////////////////////////////////////////////////	
-		#pragma omp parallel default(shared)
+		else
 		{
-			#pragma omp for schedule(static) 
-			for (int i = 0; i < (int)numParticles; i++)
+			#pragma omp for schedule(static)  
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 			{
-				//////////////////////////////////////////////////////////////////////////
-				// Evaluate rhs
-				//////////////////////////////////////////////////////////////////////////
-				const Real b_i = m_simulationData.getDensityAdv(i);
-				const Real ki = b_i*m_simulationData.getFactor(i);
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+				{
+					computeDensityChange(i, h, density0);
+					m_simulationData.getFactor(i) *= invH;
+
 #ifdef USE_WARMSTART_V
-				m_simulationData.getKappaV(i) += ki;
+					m_simulationData.getKappaV(i) = 0.0;
 #endif
+				}
+			}
+		}
 
-				Vector3r &v_i = m_model->getVelocity(0, i);
+		//////////////////////////////////////////////////////////////////////////
+		// Start solver
+		//////////////////////////////////////////////////////////////////////////
 
-				const Vector3r &xi = m_model->getPosition(0, i);
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+		// The loop condition is evaluated by all threads, the shared error, iteration 
+		// count and iteration limit are only changed in the single section at the end.
+		while (((avg_density_err > eta) || (m_iterationsV < 1)) && (m_iterationsV < maxIter))
+		{
+			//////////////////////////////////////////////////////////////////////////
+			// Perform Jacobi iteration over all blocks
+			//////////////////////////////////////////////////////////////////////////	
+			if (tiled)
+			{
+				#pragma omp for schedule(static)
+				for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
 					{
-						const Real b_j = m_simulationData.getDensityAdv(neighborIndex);
-						const Real kj = b_j*m_simulationData.getFactor(neighborIndex);
-						const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
-						v_i -= h * (ki + kj) * grad_p_j;			// ki, kj already contain inverse density
+						const ParticleTiles::Tile &tile = tiles.getTile(t);
+						ParticleTiles::Block &block = tiles.getBlock();
+						ParticleTiles::gatherValues(tile, block, [&](const unsigned int j) { return m_simulationData.getDensityAdv(j)*m_simulationData.getFactor(j); });
+						applyPressureTile(tile, block, h, invH);
+#ifdef USE_WARMSTART_V
+						for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
+							m_simulationData.getKappaV(tile.getParticleIndex(l)) += block.m_value[l];
+#endif
 					}
-					else
+				}
+			}
+			else
+			{
+				#pragma omp for schedule(static) 
+				for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+				{
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 					{
-						const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
-
-						const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
-						v_i += velChange;
+						//////////////////////////////////////////////////////////////////////////
+						// Evaluate rhs
+						//////////////////////////////////////////////////////////////////////////
+						const Real b_i = m_simulationData.getDensityAdv(i);
+						const Real ki = b_i*m_simulationData.getFactor(i);
+#ifdef USE_WARMSTART_V
+						m_simulationData.getKappaV(i) += ki;
+#endif
 
-						m_model->getForce(particleId.point_set_id, neighborIndex) -= m_model->getMass(i) * velChange * invH;
+						Vector3r &v_i = m_model->getVelocity(0, i);
+
+						const Vector3r &xi = m_model->getPosition(0, i);
+						for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+						{
+							const PointID &particleId = m_model->getNeighbor(i, j);
+							const unsigned int &neighborIndex = particleId.point_id;
+							const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+							if (particleId.point_set_id == 0)
+							{
+								const Real b_j = m_simulationData.getDensityAdv(neighborIndex);
+								const Real kj = b_j*m_simulationData.getFactor(neighborIndex);
+								const Vector3r grad_p_j = -m_model->getMass(neighborIndex) * m_model->gradW(xi - xj);
+								v_i -= h * (ki + kj) * grad_p_j;			// ki, kj already contain inverse density
+							}
+							else
+							{
+								const Vector3r grad_p_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->gradW(xi - xj);
+
+								const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
+								v_i += velChange;
+
+								m_model->addForce(particleId.point_set_id, neighborIndex, -m_model->getMass(i) * velChange * invH);
+							}
+						}
 					}
 				}
 			}
@@ -462,32 +671,58 @@ void TimeStepDFSPH::divergenceSolve()
 			//////////////////////////////////////////////////////////////////////////
 			// Update rho_adv and density error
 			//////////////////////////////////////////////////////////////////////////
-			#pragma omp for reduction(+:avg_density_err) schedule(static) 
-			for (int i = 0; i < (int)numParticles; i++)
+			if (tiled)
 			{
-				computeDensityChange(i, h, density0);
-				avg_density_err += m_simulationData.getDensityAdv(i);
+				#pragma omp for reduction(+:density_err_sum) schedule(static)
+				for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
+				{
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
+					{
+						density_err_sum += computeDensityChangeTile(tiles.getTile(t), tiles.getBlock(), h, density0);
+					}
+				}
+			}
+			else
+			{
+				#pragma omp for reduction(+:density_err_sum) schedule(static) 
+				for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+				{
+					const FluidModel::ChunkTimer chunkTimer(m_model, c);
+					for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+					{
+						computeDensityChange(i, h, density0);
+						density_err_sum += m_simulationData.getDensityAdv(i);
+					}
+				}
 			}
-		}	
-	
-		avg_density_err /= numParticles;
-		m_iterationsV++;
-	}
 
-#ifdef USE_WARMSTART_V
-	//////////////////////////////////////////////////////////////////////////
-	// Multiply by h, the time step size has to be removed 
-	// to make the stiffness value independent 
-	// of the time step size
-	//////////////////////////////////////////////////////////////////////////
-	for (int i = 0; i < numParticles; i++)
-		m_simulationData.getKappaV(i) *= h;
- #endif
+			#pragma omp single
+			{
+				avg_density_err = density_err_sum / numParticles;
+				density_err_sum = 0.0;
+				m_iterationsV++;
+				checkDeadline(m_iterationsV, 1, avg_density_err <= eta, maxIter);
+			}
+		}
 
-	for (int i = 0; i < numParticles; i++)
-	{
-		m_simulationData.getFactor(i) *= h;
+		#pragma omp for schedule(static)  
+		for (int i = 0; i < numParticles; i++)
+		{
+#ifdef USE_WARMSTART_V
+			//////////////////////////////////////////////////////////////////////////
+			// Multiply by h, the time step size has to be removed 
+			// to make the stiffness value independent 
+			// of the time step size
+			//////////////////////////////////////////////////////////////////////////
+			m_simulationData.getKappaV(i) *= h;
+#endif
+			m_simulationData.getFactor(i) *= h;
+		}
 	}
+	m_densityErrorV = avg_density_err * h / density0 * 100.0;
+
+	m_model->reduceBoundaryForces();
 }
 
 
@@ -497,21 +732,35 @@ void TimeStepDFSPH::computeDensityAdv(const unsigned int index, const int numPar
 	Real &densityAdv = m_simulationData.getDensityAdv(index);
 	const Vector3r &xi = m_model->getPosition(0, index);
 	const Vector3r &vi = m_model->getVelocity(0, index);
+	const unsigned int numNeighbors = m_model->numberOfNeighbors(index);
 	Real delta = 0.0;
-	for (unsigned int j = 0; j < m_model->numberOfNeighbors(index); j++)
-	{
-		const CompactNSearch::PointID &particleId = m_model->getNeighbor(index, j);
-		const unsigned int &neighborIndex = particleId.point_id;
-		const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-		const Vector3r &vj = m_model->getVelocity(particleId.point_set_id, neighborIndex);
 
-		if (particleId.point_set_id == 0)
+	Vector3r xixj[KernelBatchSize];
+	Vector3r gradW_ij[KernelBatchSize];
+	for (unsigned int j0 = 0; j0 < numNeighbors; j0 += KernelBatchSize)
+	{
+		const unsigned int n = std::min(numNeighbors - j0, KernelBatchSize);
+		for (unsigned int k = 0; k < n; k++)
 		{
-			delta += m_model->getMass(neighborIndex) * (vi - vj).dot(m_model->gradW(xi - xj));
+			const PointID &particleId = m_model->getNeighbor(index, j0 + k);
+			xixj[k] = xi - m_model->getPosition(particleId.point_set_id, particleId.point_id);
 		}
-		else
+		m_model->gradW(n, xixj, gradW_ij);
+
+		for (unsigned int k = 0; k < n; k++)
 		{
-			delta += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (vi - vj).dot(m_model->gradW(xi - xj));
+			const PointID &particleId = m_model->getNeighbor(index, j0 + k);
+			const unsigned int &neighborIndex = particleId.point_id;
+			const Vector3r &vj = m_model->getVelocity(particleId.point_set_id, neighborIndex);
+
+			if (particleId.point_set_id == 0)
+			{
+				delta += m_model->getMass(neighborIndex) * (vi - vj).dot(gradW_ij[k]);
+			}
+			else
+			{
+				delta += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (vi - vj).dot(gradW_ij[k]);
+			}
 		}
 	}
 
@@ -527,7 +776,7 @@ void TimeStepDFSPH::computeDensityChange(const unsigned int index, const Real h,
 	densityAdv = 0.0;
 	for (unsigned int j = 0; j < m_model->numberOfNeighbors(index); j++)
 	{
-		const CompactNSearch::PointID &particleId = m_model->getNeighbor(index, j);
+		const PointID &particleId = m_model->getNeighbor(index, j);
 		const unsigned int &neighborIndex = particleId.point_id;
 		const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
 		const Vector3r &vj = m_model->getVelocity(particleId.point_set_id, neighborIndex);
@@ -549,6 +798,123 @@ void TimeStepDFSPH::computeDensityChange(const unsigned int index, const Real h,
 	densityAdv = (densityAdv - density0) * (1.0 / h);
 }
 
+Real TimeStepDFSPH::computeDensityAdvTile(const ParticleTiles::Tile &tile, ParticleTiles::Block &block, const Real h, const Real density0)
+{
+	ParticleTiles::gatherPositions(m_model, tile, block);
+	ParticleTiles::gatherVelocities(m_model, tile, block);
+
+	Real density_err_sum = 0.0;
+	Vector3r xixj[KernelBatchSize];
+	Vector3r gradW_ij[KernelBatchSize];
+	for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
+	{
+		const unsigned int i = tile.getParticleIndex(l);
+		const Vector3r &xi = block.m_x[l];
+		const Vector3r &vi = block.m_v[l];
+		const unsigned int numNeighbors = tile.numberOfNeighbors(l);
+		Real delta = 0.0;
+		for (unsigned int j0 = 0; j0 < numNeighbors; j0 += KernelBatchSize)
+		{
+			const unsigned int n = std::min(numNeighbors - j0, KernelBatchSize);
+			for (unsigned int k = 0; k < n; k++)
+				xixj[k] = xi - block.m_x[tile.getNeighbor(l, j0 + k)];
+			m_model->gradW(n, xixj, gradW_ij);
+
+			for (unsigned int k = 0; k < n; k++)
+			{
+				const unsigned int j = tile.getNeighbor(l, j0 + k);
+				delta += block.m_weight[j] * (vi - block.m_v[j]).dot(gradW_ij[k]);
+			}
+		}
+
+		Real &densityAdv = m_simulationData.getDensityAdv(i);
+		densityAdv = m_model->getDensity(i) + h*delta;
+		densityAdv = max(densityAdv, density0);
+		density_err_sum += densityAdv - density0;
+	}
+	return density_err_sum;
+}
+
+Real TimeStepDFSPH::computeDensityChangeTile(const ParticleTiles::Tile &tile, ParticleTiles::Block &block, const Real h, const Real density0)
+{
+	ParticleTiles::gatherPositions(m_model, tile, block);
+	ParticleTiles::gatherVelocities(m_model, tile, block);
+
+	Real density_err_sum = 0.0;
+	Vector3r xixj[KernelBatchSize];
+	Vector3r gradW_ij[KernelBatchSize];
+	for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
+	{
+		const unsigned int i = tile.getParticleIndex(l);
+		const Vector3r &xi = block.m_x[l];
+		const Vector3r &vi = block.m_v[l];
+		const unsigned int numNeighbors = tile.numberOfNeighbors(l);
+		Real delta = 0.0;
+		for (unsigned int j0 = 0; j0 < numNeighbors; j0 += KernelBatchSize)
+		{
+			const unsigned int n = std::min(numNeighbors - j0, KernelBatchSize);
+			for (unsigned int k = 0; k < n; k++)
+				xixj[k] = xi - block.m_x[tile.getNeighbor(l, j0 + k)];
+			m_model->gradW(n, xixj, gradW_ij);
+
+			for (unsigned int k = 0; k < n; k++)
+			{
+				const unsigned int j = tile.getNeighbor(l, j0 + k);
+				delta += block.m_weight[j] * (vi - block.m_v[j]).dot(gradW_ij[k]);
+			}
+		}
+
+		Real &densityAdv = m_simulationData.getDensityAdv(i);
+		densityAdv = m_model->getDensity(i) + h*delta;
+		densityAdv = max(densityAdv, density0);
+		densityAdv = (densityAdv - density0) * (1.0 / h);
+		density_err_sum += densityAdv;
+	}
+	return density_err_sum;
+}
+
+void TimeStepDFSPH::applyPressureTile(const ParticleTiles::Tile &tile, ParticleTiles::Block &block, const Real h, const Real invH)
+{
+	ParticleTiles::gatherPositions(m_model, tile, block);
+
+	Vector3r xixj[KernelBatchSize];
+	Vector3r gradW_ij[KernelBatchSize];
+	for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
+	{
+		const unsigned int i = tile.getParticleIndex(l);
+		const Real ki = block.m_value[l];
+		Vector3r &v_i = m_model->getVelocity(0, i);
+		const Vector3r &xi = block.m_x[l];
+		const unsigned int numNeighbors = tile.numberOfNeighbors(l);
+		for (unsigned int j0 = 0; j0 < numNeighbors; j0 += KernelBatchSize)
+		{
+			const unsigned int n = std::min(numNeighbors - j0, KernelBatchSize);
+			for (unsigned int k = 0; k < n; k++)
+				xixj[k] = xi - block.m_x[tile.getNeighbor(l, j0 + k)];
+			m_model->gradW(n, xixj, gradW_ij);
+
+			for (unsigned int k = 0; k < n; k++)
+			{
+				const unsigned int j = tile.getNeighbor(l, j0 + k);
+				const Vector3r grad_p_j = -block.m_weight[j] * gradW_ij[k];
+				if (tile.isFluid(j))
+				{
+					const Real kj = block.m_value[j];
+					v_i -= h * (ki + kj) * grad_p_j;			// ki, kj already contain inverse density
+				}
+				else
+				{
+					const Vector3r velChange = -h * (Real) 1.0 * ki * grad_p_j;				// kj already contains inverse density
+					v_i += velChange;
+
+					const PointID particleId = tile.getPointID(j);
+					m_model->addForce(particleId.point_set_id, particleId.point_id, -m_model->getMass(i) * velChange * invH);
+				}
+			}
+		}
+	}
+}
+
 void TimeStepDFSPH::reset()
 {
 	TimeStep::reset();
@@ -557,6 +923,12 @@ void TimeStepDFSPH::reset()
 	m_iterationsV = 0;
 }
 
+void TimeStepDFSPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	TimeStep::getMemoryUsage(usage);
+	m_simulationData.getMemoryUsage(usage);
+}
+
 void TimeStepDFSPH::performNeighborhoodSearch()
 {
 	const unsigned int numParticles = m_model->numParticles();
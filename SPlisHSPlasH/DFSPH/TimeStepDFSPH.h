@@ -25,6 +25,15 @@ namespace SPH
 		void computeDensityAdv(const unsigned int index, const int numParticles, const Real h, const Real density0);
 		void computeDensityChange(const unsigned int index, const Real h, const Real density0);
 
+		/** Tiled variant of computeDensityAdv() for all particles of a tile. Returns the sum of the density errors. */
+		Real computeDensityAdvTile(const ParticleTiles::Tile &tile, ParticleTiles::Block &block, const Real h, const Real density0);
+		/** Tiled variant of computeDensityChange() for all particles of a tile. Returns the sum of the divergence errors. */
+		Real computeDensityChangeTile(const ParticleTiles::Tile &tile, ParticleTiles::Block &block, const Real h, const Real density0);
+		/** Update the velocities of the particles of a tile by the pressure forces of one Jacobi iteration.
+		* The stiffness values k_i (already divided by the density) must have been gathered as values of the block.
+		*/
+		void applyPressureTile(const ParticleTiles::Tile &tile, ParticleTiles::Block &block, const Real h, const Real invH);
+
 		/** Perform the neighborhood search for all fluid particles.
 		*/
 		virtual void performNeighborhoodSearch();
@@ -35,6 +44,7 @@ namespace SPH
 
 		virtual void step();
 		virtual void reset();
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 	};
 }
 
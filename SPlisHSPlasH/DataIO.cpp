@@ -162,6 +162,19 @@ DataBuffer& DataIO::getBuffer()
     return m_FileBuffer;
 }
 
+//-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+size_t DataIO::getMemoryUsage() const
+{
+    return m_FileBuffer.capacity();
+}
+
+//-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+bool DataIO::isWriting() const
+{
+    return m_WriteFutureObj.valid() &&
+           (m_WriteFutureObj.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+}
+
 //-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 void DataIO::create_output_folders()
 {
@@ -174,8 +187,10 @@ void DataIO::create_output_folders()
     CreateDirectoryA(buff1, NULL);
     CreateDirectoryA(buff2, NULL);
 #else
-    sprintf(buff2, "mkdir -p %s/%s", m_DataRootFolder.c_str(), m_DataFolder.c_str());
-    system(buff2);
+    sprintf(buff1, "mkdir -p %s/%s", m_DataRootFolder.c_str(), m_DataFolder.c_str());
+    system(buff1);
+    sprintf(buff1, "%s", m_DataRootFolder.c_str());
+    sprintf(buff2, "%s/%s", m_DataRootFolder.c_str(), m_DataFolder.c_str());
 #endif
 
     printf("Created dir: %s\n", buff1);
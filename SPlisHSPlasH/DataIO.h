@@ -18,6 +18,7 @@
 #pragma once
 
 #include "SPlisHSPlasH/Common.h"
+#include "SPlisHSPlasH/Utilities/ParticleAllocator.h"
 
 #include <string>
 #include <vector>
@@ -59,6 +60,11 @@ public:
         m_Buffer.reserve(bufferSize);
     }
 
+    size_t capacity() const
+    {
+        return static_cast<size_t>(m_Buffer.capacity());
+    }
+
     const unsigned char* data() const
     {
         return m_Buffer.data();
@@ -231,20 +237,30 @@ public:
 
 
     void push_back_to_float_array(const std::vector<Vector3r>& vData, bool bWriteVectorSize = true)
+    {
+        push_back_to_float_array(vData.data(), vData.size(), bWriteVectorSize);
+    }
+
+    void push_back_to_float_array(const ParticleVector<Vector3r>& vData, bool bWriteVectorSize = true)
+    {
+        push_back_to_float_array(vData.data(), vData.size(), bWriteVectorSize);
+    }
+
+    void push_back_to_float_array(const Vector3r* vData, size_t vSize, bool bWriteVectorSize = true)
     {
         if(bWriteVectorSize)
         {
-            const unsigned int numElements = (unsigned int)vData.size();
+            const unsigned int numElements = (unsigned int)vSize;
             push_back(numElements);
         }
 
-        size_t dataSize = vData.size() * sizeof(float) * 3;
+        size_t dataSize = vSize * sizeof(float) * 3;
         size_t endOffset = m_Buffer.size();
         resize(endOffset + dataSize);
 
         float* buff_ptr = (float*) & (m_Buffer.data()[endOffset]);
 
-        for(size_t i = 0; i < vData.size(); ++i)
+        for(size_t i = 0; i < vSize; ++i)
         {
             const Vector3r& vec = vData[i];
             buff_ptr[i * 3]     = static_cast<float>(vec[0]);
@@ -529,6 +545,10 @@ public:
     void flush_buffer_async(int fileID);
     std::string get_file_name(int fileID);
     DataBuffer& getBuffer();
+    /** Bytes of the file buffer */
+    size_t getMemoryUsage() const;
+    /** True while the file of the last flush_buffer_async() is written */
+    bool isWriting() const;
 
 private:
     void create_output_folders();
@@ -6,22 +6,30 @@ using namespace SPH;
 
 FluidModel::FluidModel()
 {
-    m_density0               = 1000.0;
-    m_particleRadius         = 0.025;
-    m_viscosity              = 0.02;
-    m_neighborhoodSearch     = NULL;
-    m_gravitation            = Vector3r(0.0, -9.81, 0.0);
-    m_stiffness              = 50000.0;
-    m_exponent               = 7.0;
-    m_surfaceTension         = 0.05;
-    m_enableDivergenceSolver = true;
-    m_velocityUpdateMethod   = 0;
+    m_density0                = 1000.0;
+    m_viscosity               = 0.02;
+    m_neighborhoodSearch      = NULL;
+    m_neighborhoodSearchSkin  = 0.0;
+    m_neighborhoodSearchValid = false;
+    m_boundaryPsiValid        = false;
+    m_gravitation             = Vector3r(0.0, -9.81, 0.0);
+    m_stiffness               = 50000.0;
+    m_exponent                = 7.0;
+    m_surfaceTension          = 0.05;
+    m_enableDivergenceSolver  = true;
+    m_velocityUpdateMethod    = 0;
+    m_kernelFct               = NULL;
+    m_kernelMethod            = 0;
+    m_gradKernelMethod        = 0;
+    m_useTiledTraversal       = false;
+    m_particleOrdering        = SpaceFillingCurve::Morton;
 
     ParticleObject* fluidParticles = new ParticleObject();
     m_particleObjects.push_back(fluidParticles);
 
-    setKernel(0);
-    setGradKernel(0);
+    // initializes the kernels
+    setParticleRadius(0.025);
+    updateParticleChunks(false);
 }
 
 FluidModel::~FluidModel(void)
@@ -31,6 +39,7 @@ FluidModel::~FluidModel(void)
 
 void FluidModel::cleanupModel()
 {
+    finishFrameOutput();
     releaseFluidParticles();
     for(unsigned int i = 0; i < m_particleObjects.size(); i++)
     {
@@ -39,6 +48,9 @@ void FluidModel::cleanupModel()
             RigidBodyParticleObject* rbpo = ((RigidBodyParticleObject*)m_particleObjects[i]);
             rbpo->m_boundaryPsi.clear();
             rbpo->m_f.clear();
+            rbpo->m_threadForces.clear();
+            rbpo->m_threadForceBlocks.clear();
+            rbpo->m_xLastSearch.clear();
             delete rbpo->m_rigidBody;
             delete rbpo;
         }
@@ -46,36 +58,48 @@ void FluidModel::cleanupModel()
             delete m_particleObjects[i];
     }
     m_particleObjects.clear();
+    m_boundaryPsiValid = false;
 
     m_a.clear();
     m_masses.clear();
     m_density.clear();
+    m_particleId.clear();
     delete m_neighborhoodSearch;
+    delete m_aniNeighborhoodSearch;
+    m_aniNeighborhoodSearch = nullptr;
+    m_aniSearchPositions    = nullptr;
+    m_aniKernelCenters.clear();
+    m_aniKernelMatrices.clear();
 }
 
 void FluidModel::reset()
 {
     const unsigned int nPoints = numParticles();
 
-    // reset velocities and accelerations
-    for(unsigned int i = 1; i < m_particleObjects.size(); i++)
+#pragma omp parallel default(shared)
     {
-        for(int j = 0; j < (int)m_particleObjects[i]->m_x.size(); j++)
+        // reset velocities and accelerations
+        for(unsigned int i = 1; i < m_particleObjects.size(); i++)
         {
             RigidBodyParticleObject* rbpo = ((RigidBodyParticleObject*)m_particleObjects[i]);
-            rbpo->m_f[j].setZero();
-            rbpo->m_v[j].setZero();
+#pragma omp for schedule(static) nowait
+            for(int j = 0; j < (int)rbpo->m_x.size(); j++)
+            {
+                rbpo->m_f[j].setZero();
+                rbpo->m_v[j].setZero();
+            }
         }
-    }
 
-    // Fluid
-    for(unsigned int i = 0; i < nPoints; i++)
-    {
-        const Vector3r& x0 = getPosition0(0, i);
-        getPosition(0, i) = x0;
-        getVelocity(0, i).setZero();
-        getAcceleration(i).setZero();
-        m_density[i] = 0.0;
+        // Fluid
+#pragma omp for schedule(static)
+        for(int i = 0; i < (int)nPoints; i++)
+        {
+            const Vector3r& x0 = getPosition0(0, i);
+            getPosition(0, i) = x0;
+            getVelocity(0, i).setZero();
+            getAcceleration(i).setZero();
+            m_density[i] = 0.0;
+        }
     }
 
     if(m_neighborhoodSearch != NULL)
@@ -83,6 +107,9 @@ void FluidModel::reset()
         performNeighborhoodSearchSort();
     }
     updateBoundaryPsi();
+
+    // the neighbor lists are not valid until the next search
+    updateParticleChunks(false);
 }
 
 void FluidModel::initMasses()
@@ -106,9 +133,11 @@ void FluidModel::resizeFluidParticles(const unsigned int newSize)
     m_particleObjects[0]->m_x0.resize(newSize);
     m_particleObjects[0]->m_x.resize(newSize);
     m_particleObjects[0]->m_v.resize(newSize);
+    m_particleObjects[0]->m_xLastSearch.resize(newSize);
     m_a.resize(newSize);
     m_masses.resize(newSize);
     m_density.resize(newSize);
+    m_particleId.resize(newSize);
 }
 
 void FluidModel::releaseFluidParticles()
@@ -116,9 +145,11 @@ void FluidModel::releaseFluidParticles()
     m_particleObjects[0]->m_x0.clear();
     m_particleObjects[0]->m_x.clear();
     m_particleObjects[0]->m_v.clear();
+    m_particleObjects[0]->m_xLastSearch.clear();
     m_a.clear();
     m_masses.clear();
     m_density.clear();
+    m_particleId.clear();
 }
 
 void FluidModel::initModel(const unsigned int nFluidParticles, Vector3r* fluidParticles)
@@ -136,6 +167,7 @@ void FluidModel::initModel(const unsigned int nFluidParticles, Vector3r* fluidPa
         for(int i = 0; i < (int)nFluidParticles; i++)
         {
             getPosition0(0, i) = fluidParticles[i];
+            m_particleId[i]    = i;
         }
     }
 
@@ -144,8 +176,8 @@ void FluidModel::initModel(const unsigned int nFluidParticles, Vector3r* fluidPa
 
     // Initialize neighborhood search
     if(m_neighborhoodSearch == NULL)
-        m_neighborhoodSearch = new CompactNSearch::NeighborhoodSearch(m_supportRadius, false);
-    m_neighborhoodSearch->set_radius(m_supportRadius);
+        m_neighborhoodSearch = new NeighborhoodSearch(m_supportRadius);
+    m_neighborhoodSearch->set_radius(m_supportRadius + m_neighborhoodSearchSkin);
 
     // Fluids
     m_neighborhoodSearch->add_point_set(&getPosition(0, 0)[0], nFluidParticles, true, true);
@@ -160,6 +192,137 @@ void FluidModel::initModel(const unsigned int nFluidParticles, Vector3r* fluidPa
     reset();
 }
 
+unsigned int FluidModel::numberOfBoundaryParticles() const
+{
+    unsigned int n = 0;
+    for(unsigned int i = 1; i < m_particleObjects.size(); i++)
+        n += m_particleObjects[i]->numberOfParticles();
+    return n;
+}
+
+unsigned int FluidModel::numberOfPendingWrites() const
+{
+    // the output of a frame writes the pos, vel and ani files
+    if(m_frameOutput.valid() && (m_frameOutput.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+        return 3;
+    return 0;
+}
+
+/** Bytes of a neighborhood search. CompactNSearch does not report its memory, so only its neighbor
+ * lists and sort tables are estimated. The lists of the point sets other than the first one are only
+ * counted if they have been searched (boundaryListsValid).
+ */
+static size_t neighborhoodSearchMemoryUsage(const NeighborhoodSearch* ns, const bool boundaryListsValid)
+{
+    if(ns == NULL)
+        return 0;
+#ifdef SPH_USE_COMPACTNSEARCH
+    size_t bytes = 0;
+    for(unsigned int s = 0; s < ns->n_point_sets(); s++)
+    {
+        const PointSet& ps = ns->point_set(s);
+        bytes += ps.n_points() * sizeof(unsigned int);
+        if((s > 0) && !boundaryListsValid)
+            continue;
+        for(unsigned int i = 0; i < ps.n_points(); i++)
+            bytes += sizeof(std::vector<PointID>) + ps.n_neighbors(i) * sizeof(PointID);
+    }
+    return bytes;
+#else
+    return ns->memory_usage();
+#endif
+}
+
+void FluidModel::getMemoryUsage(MemoryUsage& usage) const
+{
+    // the output buffers and anisotropic kernels are changed by the frame output
+    finishFrameOutput();
+
+    const unsigned int nFluid    = numParticles();
+    const unsigned int nBoundary = numberOfBoundaryParticles();
+
+    const ParticleObject* fluid = m_particleObjects[0];
+    usage.addFluidArray("fluid particles", fluid->m_x0);
+    usage.addFluidArray("fluid particles", fluid->m_x);
+    usage.addFluidArray("fluid particles", fluid->m_v);
+    usage.addFluidArray("fluid particles", fluid->m_xLastSearch);
+    usage.addFluidArray("fluid particles", m_masses);
+    usage.addFluidArray("fluid particles", m_a);
+    usage.addFluidArray("fluid particles", m_density);
+    usage.addFluidArray("fluid particles", m_particleId);
+    usage.addFluidArray("fluid particles", m_sortTable);
+
+    for(unsigned int i = 1; i < m_particleObjects.size(); i++)
+    {
+        const RigidBodyParticleObject* rbpo = (const RigidBodyParticleObject*)m_particleObjects[i];
+        usage.addBoundaryArray("boundary particles", rbpo->m_x0);
+        usage.addBoundaryArray("boundary particles", rbpo->m_x);
+        usage.addBoundaryArray("boundary particles", rbpo->m_v);
+        usage.addBoundaryArray("boundary particles", rbpo->m_xLastSearch);
+        usage.addBoundaryArray("boundary particles", rbpo->m_boundaryPsi);
+        usage.addBoundaryArray("boundary particles", rbpo->m_f);
+        // force buffer of each thread (see addForce()), the block flags are 1/ForceBlockSize bytes per particle
+        for(unsigned int t = 0; t < rbpo->m_threadForces.size(); t++)
+        {
+            usage.addBoundaryArray("boundary particles", rbpo->m_threadForces[t]);
+            usage.addArray("boundary particles", rbpo->m_threadForceBlocks[t]);
+        }
+    }
+
+    // The neighbor lists of the boundary particles which remain from the computation of psi scale
+    // with the boundary particles, the remaining memory of the search is assigned to the fluid particles.
+    const size_t nsBytes         = neighborhoodSearchMemoryUsage(m_neighborhoodSearch, m_boundaryPsiValid);
+    size_t       nsBoundaryBytes = 0;
+    if((m_neighborhoodSearch != NULL) && m_boundaryPsiValid)
+    {
+        for(unsigned int s = 1; s < m_neighborhoodSearch->n_point_sets(); s++)
+        {
+            const PointSet& ps = m_neighborhoodSearch->point_set(s);
+            nsBoundaryBytes += (ps.n_points() + 1) * sizeof(unsigned int);
+            for(unsigned int i = 0; i < ps.n_points(); i++)
+                nsBoundaryBytes += ps.n_neighbors(i) * sizeof(PointID);
+        }
+    }
+    nsBoundaryBytes = std::min(nsBytes, nsBoundaryBytes);
+    const size_t nsBytesPerBoundary = (nBoundary > 0) ? nsBoundaryBytes / nBoundary : 0;
+    const size_t nsBytesPerFluid    = (nFluid > 0) ? (nsBytes - nsBoundaryBytes) / nFluid : 0;
+    usage.add("neighborhood search", nsBytes, nsBytesPerFluid, nsBytesPerBoundary);
+
+    const size_t tileBytes = m_particleTiles.getMemoryUsage();
+    usage.add("particle tiles", tileBytes, m_particleTiles.isValid() && (nFluid > 0) ? tileBytes / nFluid : 0);
+
+    // lookup tables of the precomputed kernels
+    usage.add("kernels", sizeof(m_precomputedCubicKernel) + sizeof(m_interpolatedCubicKernel));
+
+    // pos: 3 floats, vel: 3 floats, ani: 9 floats per particle and the copied positions and velocities
+    size_t outputBytes = m_frameSnapshot.positions.capacity() * sizeof(Vector3r) + m_frameSnapshot.velocities.capacity() * sizeof(Vector3r);
+    size_t outputBytesPerFluid = (m_frameSnapshot.positions.capacity() > 0) ? 2 * sizeof(Vector3r) : 0;
+    if(m_FluidPosWriter != nullptr)
+    {
+        outputBytes         += m_FluidPosWriter->getMemoryUsage();
+        outputBytesPerFluid += 3 * sizeof(float);
+    }
+    if(m_FluidVelWriter != nullptr)
+    {
+        outputBytes         += m_FluidVelWriter->getMemoryUsage();
+        outputBytesPerFluid += 3 * sizeof(float);
+    }
+    if(m_FluidAnisotropyWriter != nullptr)
+    {
+        outputBytes         += m_FluidAnisotropyWriter->getMemoryUsage();
+        outputBytesPerFluid += 9 * sizeof(float);
+    }
+    usage.add("output buffers", outputBytes, outputBytesPerFluid);
+
+    if(m_aniNeighborhoodSearch != nullptr)
+    {
+        usage.addFluidArray("anisotropic kernels", m_aniKernelCenters);
+        usage.addFluidArray("anisotropic kernels", m_aniKernelMatrices);
+        const size_t aniBytes = neighborhoodSearchMemoryUsage(m_aniNeighborhoodSearch, false);
+        usage.add("anisotropic kernels", aniBytes, (nFluid > 0) ? aniBytes / nFluid : 0);
+    }
+}
+
 void FluidModel::updateBoundaryPsi()
 {
     //////////////////////////////////////////////////////////////////////////
@@ -167,48 +330,34 @@ void FluidModel::updateBoundaryPsi()
     // (see Akinci et al. "Versatile rigid - fluid coupling for incompressible SPH", Siggraph 2012
     //////////////////////////////////////////////////////////////////////////
 
-    // Search boundary neighborhood
+    // psi only depends on the rest configuration of the boundaries, so it is computed once
+    // and reused after a reset or when the simulation method is changed.
+    if(m_boundaryPsiValid)
+        return;
 
-    // Activate only static boundaries
+    // Search boundary neighborhood of all bodies at once
     std::cout << "Initialize boundary psi\n";
     m_neighborhoodSearch->point_set(0).enable_neighborsearch(false);
-    for(unsigned int i = 0; i < numberOfRigidBodyParticleObjects(); i++)
-    {
-        if(!getRigidBodyParticleObject(i)->m_rigidBody->isDynamic())
-            m_neighborhoodSearch->point_set(i + 1).enable_neighborsearch(true);
-    }
+    for(unsigned int i = 1; i < m_neighborhoodSearch->point_sets().size(); i++)
+        m_neighborhoodSearch->point_set(i).enable_neighborsearch(true);
 
     m_neighborhoodSearch->find_neighbors();
 
-    // Boundary objects
-    for(unsigned int body = 0; body < numberOfRigidBodyParticleObjects(); body++)
+#pragma omp parallel default(shared)
     {
-        if(!getRigidBodyParticleObject(body)->m_rigidBody->isDynamic())
+        for(unsigned int body = 0; body < numberOfRigidBodyParticleObjects(); body++)
             computeBoundaryPsi(body);
     }
 
-    //////////////////////////////////////////////////////////////////////////
-    // Compute boundary psi for all dynamic bodies
-    //////////////////////////////////////////////////////////////////////////
-    for(unsigned int body = 0; body < numberOfRigidBodyParticleObjects(); body++)
-    {
-        // Deactivate all
-        for(int j = 1; j < m_neighborhoodSearch->point_sets().size(); j++)
-            m_neighborhoodSearch->point_set(j).enable_neighborsearch(false);
-
-        // Only activate next dynamic body
-        if(getRigidBodyParticleObject(body)->m_rigidBody->isDynamic())
-        {
-            m_neighborhoodSearch->point_set(body + 1).enable_neighborsearch(true);
-            m_neighborhoodSearch->find_neighbors();
-            computeBoundaryPsi(body);
-        }
-    }
-
     // Activate only fluids
     m_neighborhoodSearch->point_set(0).enable_neighborsearch(true);
-    for(int i = 1; i < m_neighborhoodSearch->point_sets().size(); i++)
+    for(unsigned int i = 1; i < m_neighborhoodSearch->point_sets().size(); i++)
         m_neighborhoodSearch->point_set(i).enable_neighborsearch(false);
+
+    m_boundaryPsiValid = true;
+
+    // the neighbor lists of the fluid are not up to date anymore
+    m_neighborhoodSearchValid = false;
 }
 
 void FluidModel::computeBoundaryPsi(const unsigned int body)
@@ -217,22 +366,26 @@ void FluidModel::computeBoundaryPsi(const unsigned int body)
 
     RigidBodyParticleObject* rb                   = getRigidBodyParticleObject(body);
     const unsigned int       numBoundaryParticles = rb->numberOfParticles();
+    const bool               isDynamic            = rb->m_rigidBody->isDynamic();
+    const PointSet&          ps                   = m_neighborhoodSearch->point_set(body + 1);
 
-#pragma omp parallel default(shared)
+    // Static boundaries are sampled together. A dynamic body only uses its own particles,
+    // so its psi is invariant under rigid motion.
+#pragma omp for schedule(static) nowait
+    for(int i = 0; i < (int)numBoundaryParticles; i++)
     {
-#pragma omp for schedule(static)
-        for(int i = 0; i < (int)numBoundaryParticles; i++)
+        Real delta = m_W_zero;
+        for(unsigned int j = 0; j < ps.n_neighbors(i); j++)
         {
-            Real delta = m_W_zero;
-            for(unsigned int j = 0; j < m_neighborhoodSearch->point_set(body + 1).n_neighbors(i); j++)
-            {
-                const CompactNSearch::PointID& pid = m_neighborhoodSearch->point_set(body + 1).neighbor(i, j);
-                if(pid.point_set_id != 0)
-                    delta += W(getPosition(body + 1, i) - getPosition(pid.point_set_id, pid.point_id));
-            }
-            const Real volume = 1.0 / delta;
-            rb->m_boundaryPsi[i] = density0 * volume;
+            const PointID& pid = ps.neighbor(i, j);
+            if(pid.point_set_id == 0)
+                continue;
+            const bool contributes = isDynamic ? (pid.point_set_id == body + 1) : !getRigidBodyParticleObject(pid.point_set_id - 1)->m_rigidBody->isDynamic();
+            if(contributes)
+                delta += W(getPosition(body + 1, i) - getPosition(pid.point_set_id, pid.point_id));
         }
+        const Real volume = 1.0 / delta;
+        rb->m_boundaryPsi[i] = density0 * volume;
     }
 }
 
@@ -259,6 +412,84 @@ void FluidModel::addRigidBodyObject(RigidBodyObject* rbo, const unsigned int num
         }
     }
     rb->m_rigidBody = rbo;
+    m_boundaryPsiValid = false;
+
+    // only forces on dynamic bodies are accumulated
+    if(rbo->isDynamic())
+    {
+        ensureThreadForceBuffers();
+        rb->m_xLastSearch.resize(numBoundaryParticles);
+    }
+}
+
+void FluidModel::ensureThreadForceBuffers()
+{
+#ifdef _OPENMP
+    const unsigned int numThreads = (unsigned int)omp_get_max_threads();
+#else
+    const unsigned int numThreads = 1;
+#endif
+    for(unsigned int body = 0; body < numberOfRigidBodyParticleObjects(); body++)
+    {
+        RigidBodyParticleObject* rb = getRigidBodyParticleObject(body);
+        if(!rb->m_rigidBody->isDynamic() || (rb->m_threadForces.size() == numThreads))
+            continue;
+
+        // the buffers are empty between two phases, so buffers of removed threads can be dropped
+        const unsigned int numBlocks = (rb->numberOfParticles() + ForceBlockSize - 1) / ForceBlockSize;
+        rb->m_threadForces.resize(numThreads);
+        rb->m_threadForceBlocks.resize(numThreads);
+#ifdef _OPENMP
+        // a buffer is only written by its thread, so it is first touched by the thread
+#pragma omp parallel default(shared) num_threads(numThreads)
+        {
+            const int t = omp_get_thread_num();
+            rb->m_threadForces[t].resize(rb->numberOfParticles(), Vector3r::Zero());
+            rb->m_threadForceBlocks[t].resize(numBlocks, 0);
+        }
+#endif
+        // buffers of threads which the runtime did not start
+        for(unsigned int t = 0; t < numThreads; t++)
+        {
+            rb->m_threadForces[t].resize(rb->numberOfParticles(), Vector3r::Zero());
+            rb->m_threadForceBlocks[t].resize(numBlocks, 0);
+        }
+    }
+}
+
+void FluidModel::reduceBoundaryForces()
+{
+    for(unsigned int body = 0; body < numberOfRigidBodyParticleObjects(); body++)
+    {
+        RigidBodyParticleObject* rb = getRigidBodyParticleObject(body);
+        if(rb->m_threadForces.empty())
+            continue;
+
+        const int          numThreads   = (int)rb->m_threadForces.size();
+        const unsigned int numParticles = rb->numberOfParticles();
+        const int          numBlocks    = (int)rb->m_threadForceBlocks[0].size();
+#pragma omp parallel default(shared)
+        {
+#pragma omp for schedule(static)
+            for(int b = 0; b < numBlocks; b++)
+            {
+                const unsigned int begin = b * ForceBlockSize;
+                const unsigned int end   = std::min(begin + ForceBlockSize, numParticles);
+                for(int t = 0; t < numThreads; t++)
+                {
+                    if(!rb->m_threadForceBlocks[t][b])
+                        continue;
+                    rb->m_threadForceBlocks[t][b] = 0;
+                    for(unsigned int i = begin; i < end; i++)
+                    {
+                        Vector3r& f = rb->m_threadForces[t][i];
+                        rb->m_f[i] += f;
+                        f.setZero();
+                    }
+                }
+            }
+        }
+    }
 }
 
 void FluidModel::performNeighborhoodSearchSort()
@@ -267,33 +498,184 @@ void FluidModel::performNeighborhoodSearchSort()
     if(numPart == 0)
         return;
 
+    std::vector<std::vector<unsigned int> > sortTables(m_neighborhoodSearch->point_sets().size());
+#ifdef SPH_USE_COMPACTNSEARCH
+    // CompactNSearch has to reorder its own data, so only its Morton order is supported.
+    // The sort tables are obtained by sorting the identity permutation.
     m_neighborhoodSearch->z_sort();
+    for(unsigned int i = 0; i < m_neighborhoodSearch->point_sets().size(); i++)
+    {
+        auto const& d = m_neighborhoodSearch->point_set(i);
+        if(d.is_dynamic())
+        {
+            sortTables[i].resize(d.n_points());
+            for(unsigned int j = 0; j < (unsigned int)d.n_points(); j++)
+                sortTables[i][j] = j;
+            d.sort_field(&sortTables[i][0]);
+        }
+    }
+#else
+    // The grid of the neighborhood search is rebuilt in the next search.
+    const Real cellSize = m_supportRadius + m_neighborhoodSearchSkin;
+    for(unsigned int i = 0; i < m_particleObjects.size(); i++)
+    {
+        if((i == 0) || getRigidBodyParticleObject(i - 1)->m_rigidBody->isDynamic())
+        {
+            ParticleObject* po = m_particleObjects[i];
+            SpaceFillingCurves::computeSortTable(po->m_x.data(), po->numberOfParticles(), cellSize, m_particleOrdering, sortTables[i]);
+        }
+    }
+#endif
 
-    auto const& d = m_neighborhoodSearch->point_set(0);
-    d.sort_field(&m_particleObjects[0]->m_x0[0]);
-    d.sort_field(&m_particleObjects[0]->m_x[0]);
-    d.sort_field(&m_particleObjects[0]->m_v[0]);
-    d.sort_field(&m_a[0]);
-    d.sort_field(&m_masses[0]);
-    d.sort_field(&m_density[0]);
+    m_sortTable.swap(sortTables[0]);
+    sortField(&m_particleObjects[0]->m_x0[0]);
+    sortField(&m_particleObjects[0]->m_x[0]);
+    sortField(&m_particleObjects[0]->m_v[0]);
+    sortField(&m_a[0]);
+    sortField(&m_masses[0]);
+    sortField(&m_density[0]);
+    sortField(&m_particleId[0]);
 
 
     //////////////////////////////////////////////////////////////////////////
     // Boundary
     //////////////////////////////////////////////////////////////////////////
-    for(unsigned int i = 1; i < m_neighborhoodSearch->point_sets().size(); i++)
+    for(unsigned int i = 1; i < m_particleObjects.size(); i++)
     {
         RigidBodyParticleObject* rb = getRigidBodyParticleObject(i - 1);
         if(rb->m_rigidBody->isDynamic())                        // sort only dynamic boundaries
         {
-            auto const& d = m_neighborhoodSearch->point_set(i);
-            d.sort_field(&rb->m_x0[0]);
-            d.sort_field(&rb->m_x[0]);
-            d.sort_field(&rb->m_v[0]);
-            d.sort_field(&rb->m_f[0]);
-            d.sort_field(&rb->m_boundaryPsi[0]);
+            const std::vector<unsigned int>& sortTable = sortTables[i];
+            SpaceFillingCurves::applySortTable(sortTable, &rb->m_x0[0]);
+            SpaceFillingCurves::applySortTable(sortTable, &rb->m_x[0]);
+            SpaceFillingCurves::applySortTable(sortTable, &rb->m_v[0]);
+            SpaceFillingCurves::applySortTable(sortTable, &rb->m_f[0]);
+            SpaceFillingCurves::applySortTable(sortTable, &rb->m_boundaryPsi[0]);
         }
     }
+    m_neighborhoodSearchValid = false;
+    m_particleTiles.invalidate();
+}
+
+void FluidModel::setParticleOrdering(const SpaceFillingCurve val)
+{
+    m_particleOrdering = val;
+    // the new order is applied in the next sort
+    m_particleTiles.invalidate();
+}
+
+void FluidModel::setNeighborhoodSearchSkin(Real val)
+{
+    m_neighborhoodSearchSkin = std::max(val, static_cast<Real>(0.0));
+    if(m_neighborhoodSearch != NULL)
+        m_neighborhoodSearch->set_radius(m_supportRadius + m_neighborhoodSearchSkin);
+    m_neighborhoodSearchValid = false;
+}
+
+bool FluidModel::neighborhoodSearchRequired()
+{
+    if((m_neighborhoodSearchSkin <= 0.0) || !m_neighborhoodSearchValid)
+        return true;
+
+    // only fluid particles and dynamic bodies move
+    Real maxDisplacement2 = 0.0;
+    for(unsigned int k = 0; k < m_particleObjects.size(); k++)
+    {
+        ParticleObject* po = m_particleObjects[k];
+        if(po->m_xLastSearch.empty())
+            continue;
+
+#pragma omp parallel default(shared)
+        {
+            Real maxDisplacement2Local = 0.0;
+#pragma omp for schedule(static) nowait
+            for(int i = 0; i < (int)po->numberOfParticles(); i++)
+            {
+                const Real d2 = (po->m_x[i] - po->m_xLastSearch[i]).squaredNorm();
+                maxDisplacement2Local = std::max(maxDisplacement2Local, d2);
+            }
+#pragma omp critical
+            maxDisplacement2 = std::max(maxDisplacement2, maxDisplacement2Local);
+        }
+    }
+
+    // two particles can approach each other by twice the max. displacement
+    const Real halfSkin = static_cast<Real>(0.5) * m_neighborhoodSearchSkin;
+    return maxDisplacement2 > halfSkin * halfSkin;
+}
+
+void FluidModel::updateParticleChunks(const bool useNeighborCounts)
+{
+#ifdef _OPENMP
+    const unsigned int numChunks = (unsigned int)omp_get_max_threads();
+#else
+    const unsigned int numChunks = 1;
+#endif
+    const unsigned int numPart = numParticles();
+
+    m_particleChunks.resize(numChunks + 1);
+    m_chunkBusyTime.resize(numChunks, 0.0);
+    // the tiles are built from the same neighbor lists
+    m_particleTiles.invalidate();
+    m_particleChunks[0]         = 0;
+    m_particleChunks[numChunks] = numPart;
+
+    if(!useNeighborCounts || (m_neighborhoodSearch == NULL) || (numChunks == 1))
+    {
+        for(unsigned int c = 1; c < numChunks; c++)
+            m_particleChunks[c] = (unsigned int)(((unsigned long long)numPart * c) / numChunks);
+        return;
+    }
+
+    // The work of a particle is about proportional to its number of neighbors. A chunk ends
+    // where the prefix sum of the work reaches the next multiple of the average work per chunk.
+    const PointSet&    fluid = m_neighborhoodSearch->point_set(0);
+    unsigned long long total = 0;
+    for(unsigned int i = 0; i < numPart; i++)
+        total += fluid.n_neighbors(i) + 1;
+
+    unsigned long long sum   = 0;
+    unsigned int       chunk = 1;
+    for(unsigned int i = 0; (i < numPart) && (chunk < numChunks); i++)
+    {
+        sum += fluid.n_neighbors(i) + 1;
+        while((chunk < numChunks) && (sum * numChunks >= total * chunk))
+            m_particleChunks[chunk++] = i + 1;
+    }
+    for(; chunk < numChunks; chunk++)
+        m_particleChunks[chunk] = numPart;
+}
+
+void FluidModel::updateParticleTiles()
+{
+    if(m_useTiledTraversal && !m_particleTiles.isValid() && (numParticles() > 0))
+        m_particleTiles.update(this);
+}
+
+void FluidModel::resetThreadBusyTimes()
+{
+    std::fill(m_chunkBusyTime.begin(), m_chunkBusyTime.end(), 0.0);
+}
+
+void FluidModel::storeNeighborhoodSearchPositions()
+{
+    if(m_neighborhoodSearchSkin <= 0.0)
+        return;
+
+    for(unsigned int k = 0; k < m_particleObjects.size(); k++)
+    {
+        ParticleObject* po = m_particleObjects[k];
+        if(po->m_xLastSearch.empty())
+            continue;
+
+#pragma omp parallel default(shared)
+        {
+#pragma omp for schedule(static)
+            for(int i = 0; i < (int)po->numberOfParticles(); i++)
+                po->m_xLastSearch[i] = po->m_x[i];
+        }
+    }
+    m_neighborhoodSearchValid = true;
 }
 
 void SPH::FluidModel::setParticleRadius(Real val)
@@ -302,12 +684,21 @@ void SPH::FluidModel::setParticleRadius(Real val)
     m_supportRadius  = 4.0 * m_particleRadius;
 
     // init kernel
-    Poly6Kernel::setRadius(m_supportRadius);
-    SpikyKernel::setRadius(m_supportRadius);
-    CubicKernel::setRadius(m_supportRadius);
-    PrecomputedCubicKernel::setRadius(m_supportRadius);
-    CohesionKernel::setRadius(m_supportRadius);
-    AdhesionKernel::setRadius(m_supportRadius);
+    m_poly6Kernel.setRadius(m_supportRadius);
+    m_spikyKernel.setRadius(m_supportRadius);
+    m_cubicKernel.setRadius(m_supportRadius);
+    m_precomputedCubicKernel.setRadius(m_supportRadius);
+    m_interpolatedCubicKernel.setRadius(m_supportRadius);
+    m_cohesionKernel.setRadius(m_supportRadius);
+    m_adhesionKernel.setRadius(m_supportRadius);
+    // W_zero depends on the radius
+    setKernel(m_kernelMethod);
+    setGradKernel(m_gradKernelMethod);
+
+    if(m_neighborhoodSearch != NULL)
+        m_neighborhoodSearch->set_radius(m_supportRadius + m_neighborhoodSearchSkin);
+    m_neighborhoodSearchValid = false;
+    m_boundaryPsiValid        = false;
 }
 
 
@@ -315,38 +706,70 @@ void SPH::FluidModel::setGradKernel(unsigned int val)
 {
     m_gradKernelMethod = val;
     if(m_gradKernelMethod == 0)
-        m_gradKernelFct = CubicKernel::gradW;
+    {
+        m_gradKernelFct      = kernelGradW<CubicKernel, &FluidModel::m_cubicKernel>;
+        m_gradKernelBatchFct = kernelBatchGradW<CubicKernel, &FluidModel::m_cubicKernel>;
+    }
     else if(m_gradKernelMethod == 1)
-        m_gradKernelFct = Poly6Kernel::gradW;
+    {
+        m_gradKernelFct      = kernelGradW<Poly6Kernel, &FluidModel::m_poly6Kernel>;
+        m_gradKernelBatchFct = kernelBatchGradW<Poly6Kernel, &FluidModel::m_poly6Kernel>;
+    }
     else if(m_gradKernelMethod == 2)
-        m_gradKernelFct = SpikyKernel::gradW;
+    {
+        m_gradKernelFct      = kernelGradW<SpikyKernel, &FluidModel::m_spikyKernel>;
+        m_gradKernelBatchFct = kernelBatchGradW<SpikyKernel, &FluidModel::m_spikyKernel>;
+    }
     else if(m_gradKernelMethod == 3)
-        m_gradKernelFct = FluidModel::PrecomputedCubicKernel::gradW;
+    {
+        m_gradKernelFct      = kernelGradW<PrecomputedCubicKernel, &FluidModel::m_precomputedCubicKernel>;
+        m_gradKernelBatchFct = kernelBatchGradW<PrecomputedCubicKernel, &FluidModel::m_precomputedCubicKernel>;
+    }
+    else if(m_gradKernelMethod == 4)
+    {
+        m_gradKernelFct      = kernelGradW<InterpolatedCubicKernel, &FluidModel::m_interpolatedCubicKernel>;
+        m_gradKernelBatchFct = kernelBatchGradW<InterpolatedCubicKernel, &FluidModel::m_interpolatedCubicKernel>;
+    }
 }
 
 void SPH::FluidModel::setKernel(unsigned int val)
 {
+    Real (* const oldKernelFct)(const FluidModel*, const Vector3r&) = m_kernelFct;
     m_kernelMethod = val;
     if(m_kernelMethod == 0)
     {
-        m_W_zero    = CubicKernel::W_zero();
-        m_kernelFct = CubicKernel::W;
+        m_W_zero         = m_cubicKernel.W_zero();
+        m_kernelFct      = kernelW<CubicKernel, &FluidModel::m_cubicKernel>;
+        m_kernelBatchFct = kernelBatchW<CubicKernel, &FluidModel::m_cubicKernel>;
     }
     else if(m_kernelMethod == 1)
     {
-        m_W_zero    = Poly6Kernel::W_zero();
-        m_kernelFct = Poly6Kernel::W;
+        m_W_zero         = m_poly6Kernel.W_zero();
+        m_kernelFct      = kernelW<Poly6Kernel, &FluidModel::m_poly6Kernel>;
+        m_kernelBatchFct = kernelBatchW<Poly6Kernel, &FluidModel::m_poly6Kernel>;
     }
     else if(m_kernelMethod == 2)
     {
-        m_W_zero    = SpikyKernel::W_zero();
-        m_kernelFct = SpikyKernel::W;
+        m_W_zero         = m_spikyKernel.W_zero();
+        m_kernelFct      = kernelW<SpikyKernel, &FluidModel::m_spikyKernel>;
+        m_kernelBatchFct = kernelBatchW<SpikyKernel, &FluidModel::m_spikyKernel>;
     }
     else if(m_kernelMethod == 3)
     {
-        m_W_zero    = FluidModel::PrecomputedCubicKernel::W_zero();
-        m_kernelFct = FluidModel::PrecomputedCubicKernel::W;
+        m_W_zero         = m_precomputedCubicKernel.W_zero();
+        m_kernelFct      = kernelW<PrecomputedCubicKernel, &FluidModel::m_precomputedCubicKernel>;
+        m_kernelBatchFct = kernelBatchW<PrecomputedCubicKernel, &FluidModel::m_precomputedCubicKernel>;
+    }
+    else if(m_kernelMethod == 4)
+    {
+        m_W_zero         = m_interpolatedCubicKernel.W_zero();
+        m_kernelFct      = kernelW<InterpolatedCubicKernel, &FluidModel::m_interpolatedCubicKernel>;
+        m_kernelBatchFct = kernelBatchW<InterpolatedCubicKernel, &FluidModel::m_interpolatedCubicKernel>;
     }
+
+    // the boundary psi values depend on the kernel
+    if(m_kernelFct != oldKernelFct)
+        m_boundaryPsiValid = false;
 }
 
 
@@ -355,30 +778,37 @@ void SPH::FluidModel::setKernel(unsigned int val)
 #define AniGen_NeighborCountThreshold 25
 #define AniGen_Kr                     4
 
-void SPH::FluidModel::generateAniKernels(std::vector<Vector3r>& kernelCenters, std::vector<Matrix3r>& kernelMatrices)
+void SPH::FluidModel::generateAniKernels(const std::vector<Vector3r>& positions, const Real particleRadius, std::vector<Vector3r>& kernelCenters, std::vector<Matrix3r>& kernelMatrices)
 {
-    static Real aniKernelRadius    = 8.0 * m_particleRadius;
-    static Real aniKernelRadiusInv = 1.0 / aniKernelRadius;
-    static Real aniKernelRadiusSqr = aniKernelRadius * aniKernelRadius;
-    const int   numFluidParticles  = (int)numParticles();
-    static auto kernelW = [] (Real d, Real aniKernelRadiusInv)
-                          {
-                              return 1.0 - pow(d * aniKernelRadiusInv, 3);
-                          };
-
-    kernelCenters.resize(m_particleObjects[0]->m_x.size());
-    kernelMatrices.resize(m_particleObjects[0]->m_x.size());
-
-    static CompactNSearch::NeighborhoodSearch* aniNeighborhoodSearch = nullptr;
+    const Real aniKernelRadius    = 8.0 * particleRadius;
+    const Real aniKernelRadiusInv = 1.0 / aniKernelRadius;
+    const Real aniKernelRadiusSqr = aniKernelRadius * aniKernelRadius;
+    const int  numFluidParticles  = (int)positions.size();
+    auto       kernelW            = [] (Real d, Real aniKernelRadiusInv)
+                                    {
+                                        return 1.0 - pow(d * aniKernelRadiusInv, 3);
+                                    };
+
+    kernelCenters.resize(positions.size());
+    kernelMatrices.resize(positions.size());
+    if(numFluidParticles == 0)
+        return;
 
-    if(aniNeighborhoodSearch == nullptr)
+    // the point set refers to the position array, so the search is rebuilt if the array has moved
+    if((m_aniNeighborhoodSearch != nullptr) && (m_aniSearchPositions != positions.data()))
+    {
+        delete m_aniNeighborhoodSearch;
+        m_aniNeighborhoodSearch = nullptr;
+    }
+    if(m_aniNeighborhoodSearch == nullptr)
     {
-        aniNeighborhoodSearch = new CompactNSearch::NeighborhoodSearch(m_supportRadius, false);
-        aniNeighborhoodSearch->set_radius(aniKernelRadius);
-        aniNeighborhoodSearch->add_point_set(&getPosition(0, 0)[0], m_particleObjects[0]->m_x.size(), true, true);
+        m_aniNeighborhoodSearch = new NeighborhoodSearch(m_supportRadius);
+        m_aniNeighborhoodSearch->set_radius(aniKernelRadius);
+        m_aniNeighborhoodSearch->add_point_set(&positions[0][0], positions.size(), true, true);
+        m_aniSearchPositions = positions.data();
     }
 
-    aniNeighborhoodSearch->find_neighbors();
+    m_aniNeighborhoodSearch->find_neighbors();
 
 
 #pragma omp parallel default(shared)
@@ -386,19 +816,19 @@ void SPH::FluidModel::generateAniKernels(std::vector<Vector3r>& kernelCenters, s
 #pragma omp for schedule(static)
         for(int i = 0; i < numFluidParticles; i++)
         {
-            const Vector3r& xi = getPosition(0, i);
+            const Vector3r& xi = positions[i];
 
             Vector3r        pposWM       = xi;
             Real            sumW         = 1.0;
-            unsigned int    numNeighbors = static_cast<unsigned int>(aniNeighborhoodSearch->point_set(0).n_neighbors(i));
+            unsigned int    numNeighbors = static_cast<unsigned int>(m_aniNeighborhoodSearch->point_set(0).n_neighbors(i));
 
             for(unsigned int j = 0; j < numNeighbors; j++)
             {
-                const CompactNSearch::PointID& particleId = aniNeighborhoodSearch->point_set(0).neighbor(i, j);
-                const Vector3r&                xj         = getPosition(0, particleId.point_id);
+                const PointID&  particleId = m_aniNeighborhoodSearch->point_set(0).neighbor(i, j);
+                const Vector3r& xj         = positions[particleId.point_id];
 
-                const Vector3r                 xij = xj - xi;
-                const Real                     d2  = xij.squaredNorm();
+                const Vector3r  xij = xj - xi;
+                const Real      d2  = xij.squaredNorm();
                 if(d2 < aniKernelRadiusSqr)
                 {
                     const Real wij = kernelW(sqrt(d2), aniKernelRadiusInv);
@@ -420,11 +850,11 @@ void SPH::FluidModel::generateAniKernels(std::vector<Vector3r>& kernelCenters, s
 
             for(unsigned int j = 0; j < numNeighbors; j++)
             {
-                const CompactNSearch::PointID& particleId = aniNeighborhoodSearch->point_set(0).neighbor(i, j);
-                const Vector3r&                xj         = getPosition(0, particleId.point_id);
+                const PointID&  particleId = m_aniNeighborhoodSearch->point_set(0).neighbor(i, j);
+                const Vector3r& xj         = positions[particleId.point_id];
 
-                const Vector3r                 xij = xj - pposWM;
-                const Real                     d2  = xij.squaredNorm();
+                const Vector3r  xij = xj - pposWM;
+                const Real      d2  = xij.squaredNorm();
                 if(d2 < aniKernelRadiusSqr)
                 {
                     const Real wij = kernelW(sqrt(d2), aniKernelRadiusInv);
@@ -470,20 +900,17 @@ void SPH::FluidModel::generateAniKernels(std::vector<Vector3r>& kernelCenters, s
 
 int SPH::FluidModel::writeFrameFluidData(Real currentTime)
 {
-    static double savedFrameTime = -1000000000.0;
-    static int    frame          = 0;
-
-    if(currentTime < savedFrameTime + m_FrameTime)
+    if(currentTime < m_savedFrameTime + m_FrameTime)
     {
         return -1;
     }
 
-    savedFrameTime += m_FrameTime;
-    ++frame;
+    m_savedFrameTime += m_FrameTime;
+    ++m_frame;
 
     // for saving frame the first time
-    if(savedFrameTime < 0)
-        savedFrameTime = currentTime;
+    if(m_savedFrameTime < 0)
+        m_savedFrameTime = currentTime;
 
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -504,25 +931,47 @@ int SPH::FluidModel::writeFrameFluidData(Real currentTime)
 
 
     ////////////////////////////////////////////////////////////////////////////////
-    static std::vector<Vector3r> kernelCenters;
-    static std::vector<Matrix3r> kernelMatrices;
-    generateAniKernels(kernelCenters, kernelMatrices);
+    // the snapshot of the previous frame is still in use until its output is finished
+    finishFrameOutput();
+    m_frameSnapshot.capture(*this, m_frame);
+    // the output shares the cores with the simulation, the default is half of the threads of the simulation
+    int numThreads = 1;
+#ifdef _OPENMP
+    numThreads = (m_frameOutputThreads > 0) ? (int)m_frameOutputThreads : std::max(omp_get_max_threads() / 2, 1);
+#endif
+    m_frameOutput = std::async(std::launch::async, &FluidModel::writeFrameSnapshot, this, numThreads);
+
+    ////////////////////////////////////////////////////////////////////////////////
+    return m_frame;
+}
+
+void SPH::FluidModel::finishFrameOutput() const
+{
+    if(m_frameOutput.valid())
+        m_frameOutput.wait();
+}
+
+void SPH::FluidModel::writeFrameSnapshot(const int numThreads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(numThreads);
+#endif
+
+    const int frame = (int)m_frameSnapshot.frame;
+    generateAniKernels(m_frameSnapshot.positions, m_particleRadius, m_aniKernelCenters, m_aniKernelMatrices);
 
     m_FluidPosWriter->reset_buffer();
-    m_FluidPosWriter->getBuffer().push_back(static_cast<unsigned int>(numParticles()));
+    m_FluidPosWriter->getBuffer().push_back(static_cast<unsigned int>(m_frameSnapshot.numParticles()));
     m_FluidPosWriter->getBuffer().push_back_to_float(m_particleRadius);
-    m_FluidPosWriter->getBuffer().push_back_to_float_array(kernelCenters, false);
-    m_FluidPosWriter->flush_buffer_async(frame);
+    m_FluidPosWriter->getBuffer().push_back_to_float_array(m_aniKernelCenters, false);
+    m_FluidPosWriter->flush_buffer(frame);
 
     m_FluidVelWriter->reset_buffer();
-    m_FluidVelWriter->getBuffer().push_back_to_float_array(m_particleObjects[0]->m_v);
-    m_FluidVelWriter->flush_buffer_async(frame);
+    m_FluidVelWriter->getBuffer().push_back_to_float_array(m_frameSnapshot.velocities);
+    m_FluidVelWriter->flush_buffer(frame);
 
 
     m_FluidAnisotropyWriter->reset_buffer();
-    m_FluidAnisotropyWriter->getBuffer().push_back_to_float_array(kernelMatrices);
-    m_FluidAnisotropyWriter->flush_buffer_async(frame);
-
-    ////////////////////////////////////////////////////////////////////////////////
-    return frame;
+    m_FluidAnisotropyWriter->getBuffer().push_back_to_float_array(m_aniKernelMatrices);
+    m_FluidAnisotropyWriter->flush_buffer(frame);
 }
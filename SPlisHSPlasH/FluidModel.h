@@ -3,13 +3,25 @@
 
 #include "Common.h"
 #include <vector>
+#include <chrono>
 
-#include "CompactNSearch.h"
+#include "NeighborhoodSearch.h"
 #include "RigidBodyObject.h"
 #include "SPHKernels.h"
+#include "TimeManager.h"
+#include "Utilities/ParticleAllocator.h"
+#include "Utilities/SpaceFillingCurves.h"
+#include "Utilities/MemoryUsage.h"
+#include "ParticleTiles.h"
 
 #include "DataIO.h"
 #include "SVD.h"
+#include "SnapshotBuffer.h"
+#include <future>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace SPH
 {
@@ -25,10 +37,12 @@ public:
      */
     struct ParticleObject
     {
-        std::vector<Vector3r> m_x0;
-        std::vector<Vector3r> m_x;
-        std::vector<Vector3r> m_v;
-        unsigned int          numberOfParticles() const
+        ParticleVector<Vector3r> m_x0;
+        ParticleVector<Vector3r> m_x;
+        ParticleVector<Vector3r> m_v;
+        /** Positions at the last neighborhood search (only used if a skin is set) */
+        ParticleVector<Vector3r> m_xLastSearch;
+        unsigned int             numberOfParticles() const
         {
             return static_cast<unsigned int>(m_x.size());
         }
@@ -38,16 +52,35 @@ public:
      */
     struct RigidBodyParticleObject : public ParticleObject
     {
-        RigidBodyObject*      m_rigidBody;
-        std::vector<Real>     m_boundaryPsi;
-        std::vector<Vector3r> m_f;
+        RigidBodyObject*         m_rigidBody;
+        ParticleVector<Real>     m_boundaryPsi;
+        ParticleVector<Vector3r> m_f;
+        /** Force buffers of dynamic bodies, one per thread (see addForce()). Each buffer is
+         * allocated by its thread, so it is placed on the NUMA node of the thread. */
+        std::vector<ParticleVector<Vector3r> > m_threadForces;
+        /** Flags of the blocks of ForceBlockSize particles which have forces in the buffer of a thread */
+        std::vector<std::vector<unsigned char> > m_threadForceBlocks;
     };
 
-    typedef PrecomputedKernel<CubicKernel, 10000>   PrecomputedCubicKernel;
+    typedef PrecomputedKernel<CubicKernel, 10000>        PrecomputedCubicKernel;
+    typedef InterpolatedKernel<CubicKernel, 1024, float> InterpolatedCubicKernel;
 
 
-    void generateAniKernels(std::vector<Vector3r>& kernelCenter, std::vector<Matrix3r>& kernelMatrices);
+    /** Compute the anisotropic kernels of the given fluid particle positions. */
+    void generateAniKernels(const std::vector<Vector3r>& positions, const Real particleRadius, std::vector<Vector3r>& kernelCenter, std::vector<Matrix3r>& kernelMatrices);
+    /** Write a frame if the frame time has passed since the last frame and return its index (-1 if
+     * no frame is written). The particle state is copied and the anisotropic kernels, the float
+     * conversion and the file output are done on an output thread while the simulation continues.
+     * A frame waits only for the output of the previous frame.
+     */
     int writeFrameFluidData(Real currentTime);
+    /** Wait until the output of the last frame is written. */
+    void finishFrameOutput() const;
+    /** Number of OpenMP threads of the frame output, 0 = half of the threads of the simulation */
+    void setFrameOutputThreads(unsigned int n)
+    {
+        m_frameOutputThreads = n;
+    }
     void setSaveDataPath(std::string savePath)
     {
         m_SaveDataPath = savePath;
@@ -58,35 +91,107 @@ public:
     }
     std::string m_SaveDataPath;
     Real        m_FrameTime             = 1.0 / 30.0;
+    /** Time and index of the last frame written by writeFrameFluidData() */
+    double      m_savedFrameTime        = -1000000000.0;
+    int         m_frame                 = 0;
     DataIO*     m_FluidPosWriter        = nullptr;
     DataIO*     m_FluidVelWriter        = nullptr;
     DataIO*     m_FluidAnisotropyWriter = nullptr;
+    /** Neighborhood search in the radius of the anisotropic kernels and the kernels of the last written frame */
+    NeighborhoodSearch*   m_aniNeighborhoodSearch = nullptr;
+    /** Positions of the particle set of m_aniNeighborhoodSearch */
+    const Vector3r*       m_aniSearchPositions    = nullptr;
+    std::vector<Vector3r> m_aniKernelCenters;
+    std::vector<Matrix3r> m_aniKernelMatrices;
+    /** State of the frame which is written by m_frameOutput */
+    ParticleSnapshot      m_frameSnapshot;
+    std::future<void>     m_frameOutput;
+    unsigned int          m_frameOutputThreads    = 0;
+
+    /** Compute the anisotropic kernels of m_frameSnapshot and write its files (runs on the output thread). */
+    void writeFrameSnapshot(const int numThreads);
 
     ////////////////////////////////////////////////////////////////////////////////
 protected:
     Vector3r                     m_gravitation;
+    /** Simulation time and time step size of this model */
+    TimeManager                  m_timeManager;
     unsigned int                 m_kernelMethod;
     unsigned int                 m_gradKernelMethod;
     Real                         m_W_zero;
-    Real                         (* m_kernelFct)(const Vector3r&);
-    Vector3r                     (* m_gradKernelFct)(const Vector3r& r);
+    /** Kernels with the support radius of this model (see setParticleRadius()) */
+    CubicKernel                  m_cubicKernel;
+    Poly6Kernel                  m_poly6Kernel;
+    SpikyKernel                  m_spikyKernel;
+    PrecomputedCubicKernel       m_precomputedCubicKernel;
+    InterpolatedCubicKernel      m_interpolatedCubicKernel;
+    CohesionKernel               m_cohesionKernel;
+    AdhesionKernel               m_adhesionKernel;
+    /** Evaluation of the selected kernels (see kernelW()) */
+    Real                         (* m_kernelFct)(const FluidModel*, const Vector3r&);
+    Vector3r                     (* m_gradKernelFct)(const FluidModel*, const Vector3r& r);
+    void                         (* m_kernelBatchFct)(const FluidModel*, const unsigned int, const Vector3r*, Real*);
+    void                         (* m_gradKernelBatchFct)(const FluidModel*, const unsigned int, const Vector3r*, Vector3r*);
+
+    /** Evaluate the kernel member of this model which is given as template parameter. The function
+     * pointers to these functions replace the pointers to the static kernel functions, so that a
+     * kernel evaluation is still a single indirect call.
+     */
+    template<class KernelType, KernelType FluidModel::* kernel>
+    static Real kernelW(const FluidModel* model, const Vector3r& r)
+    {
+        return (model->*kernel).W(r);
+    }
+    template<class KernelType, KernelType FluidModel::* kernel>
+    static Vector3r kernelGradW(const FluidModel* model, const Vector3r& r)
+    {
+        return (model->*kernel).gradW(r);
+    }
+    template<class KernelType, KernelType FluidModel::* kernel>
+    static void kernelBatchW(const FluidModel* model, const unsigned int n, const Vector3r* r, Real* res)
+    {
+        (model->*kernel).W(n, r, res);
+    }
+    template<class KernelType, KernelType FluidModel::* kernel>
+    static void kernelBatchGradW(const FluidModel* model, const unsigned int n, const Vector3r* r, Vector3r* res)
+    {
+        (model->*kernel).gradW(n, r, res);
+    }
 
     std::vector<ParticleObject*> m_particleObjects;
 
     // Mass
     // If the mass is zero, the particle is static
-    std::vector<Real>     m_masses;
-    std::vector<Vector3r> m_a;
+    ParticleVector<Real>     m_masses;
+    ParticleVector<Vector3r> m_a;
 
     // initial position
-    std::vector<Real>                   m_density;
-
-    Real                                m_viscosity;
-    Real                                m_surfaceTension;
-    Real                                m_density0;
-    Real                                m_particleRadius;
-    Real                                m_supportRadius;
-    CompactNSearch::NeighborhoodSearch* m_neighborhoodSearch;
+    ParticleVector<Real> m_density;
+    /** Index of each fluid particle in initModel(), i.e. before any sorting */
+    ParticleVector<unsigned int> m_particleId;
+
+    Real                m_viscosity;
+    Real                m_surfaceTension;
+    Real                m_density0;
+    Real                m_particleRadius;
+    Real                m_supportRadius;
+    NeighborhoodSearch* m_neighborhoodSearch;
+    /** Skin which is added to the support radius in the neighborhood search (Verlet lists) */
+    Real                m_neighborhoodSearchSkin;
+    bool                m_neighborhoodSearchValid;
+    /** The boundary psi values are only recomputed if a body, the kernel or a model parameter has changed */
+    bool                m_boundaryPsiValid;
+    /** Start of each chunk of fluid particles, the last entry is the number of particles (see updateParticleChunks()) */
+    std::vector<unsigned int> m_particleChunks;
+    /** Accumulated busy time of the threads in ms (see ChunkTimer) */
+    std::vector<double>       m_chunkBusyTime;
+    /** Spatial tiles of the fluid particles for the tiled neighbor loops */
+    ParticleTiles             m_particleTiles;
+    bool                      m_useTiledTraversal;
+    /** Curve along which the particles are sorted in performNeighborhoodSearchSort() */
+    SpaceFillingCurve         m_particleOrdering;
+    /** Permutation of the fluid particles of the last sort (see sortField()) */
+    std::vector<unsigned int> m_sortTable;
 
     // PBF
     unsigned int m_velocityUpdateMethod;
@@ -99,6 +204,9 @@ protected:
     bool m_enableDivergenceSolver;
 
     void initMasses();
+    /** Compute the boundary psi values of a body. The particles are distributed over the threads
+     * of the enclosing parallel region.
+     */
     void computeBoundaryPsi(const unsigned int body);
 
     /** Resize the arrays containing the particle data.
@@ -113,9 +221,24 @@ public:
     virtual void cleanupModel();
     virtual void reset();
 
+    /** Compute the boundary psi values of all bodies in a single pass. The values are cached
+     * and only recomputed if a body, the kernel, the particle radius or the rest density has changed.
+     */
     void updateBoundaryPsi();
+    /** Force a recomputation of the boundary psi values in the next call of updateBoundaryPsi(). */
+    void invalidateBoundaryPsi()
+    {
+        m_boundaryPsiValid = false;
+    }
 
     void initModel(const unsigned int nFluidParticles, Vector3r* fluidParticles);
+    /** Add the memory of the particle data, the neighborhood search, the particle tiles and the
+     * output buffers of the model (see MemoryUsage).
+     */
+    void getMemoryUsage(MemoryUsage& usage) const;
+    unsigned int numberOfBoundaryParticles() const;
+    /** Number of frame files which are still prepared or written in the background */
+    unsigned int numberOfPendingWrites() const;
     void addRigidBodyObject(RigidBodyObject* rbo, const unsigned int numBoundaryParticles, Vector3r* boundaryParticles);
 
     RigidBodyParticleObject* getRigidBodyParticleObject(const unsigned int index)
@@ -137,7 +260,8 @@ public:
     }
     FORCE_INLINE void setDensity0(const Real v)
     {
-        m_density0 = v;
+        m_density0         = v;
+        m_boundaryPsiValid = false;
     }
     Real getSupportRadius() const
     {
@@ -175,11 +299,37 @@ public:
     }
     FORCE_INLINE Real W(const Vector3r& r)
     {
-        return m_kernelFct(r);
+        return m_kernelFct(this, r);
     }
     FORCE_INLINE Vector3r gradW(const Vector3r& r)
     {
-        return m_gradKernelFct(r);
+        return m_gradKernelFct(this, r);
+    }
+    /** Evaluate the kernel for n <= KernelBatchSize distance vectors at once (SIMD if supported).
+     */
+    FORCE_INLINE void W(const unsigned int n, const Vector3r* r, Real* res)
+    {
+        m_kernelBatchFct(this, n, r, res);
+    }
+    /** Evaluate the kernel gradient for n <= KernelBatchSize distance vectors at once (SIMD if supported).
+     */
+    FORCE_INLINE void gradW(const unsigned int n, const Vector3r* r, Vector3r* res)
+    {
+        m_gradKernelBatchFct(this, n, r, res);
+    }
+    /** Kernels of the surface tension method of Akinci et al. */
+    const CohesionKernel& getCohesionKernel() const
+    {
+        return m_cohesionKernel;
+    }
+    const AdhesionKernel& getAdhesionKernel() const
+    {
+        return m_adhesionKernel;
+    }
+
+    TimeManager* getTimeManager()
+    {
+        return &m_timeManager;
     }
 
     const SPH::Vector3r& getGravitation() const
@@ -191,18 +341,136 @@ public:
         m_gravitation = val;
     }
 
-    CompactNSearch::NeighborhoodSearch* getNeighborhoodSearch()
+    NeighborhoodSearch* getNeighborhoodSearch()
     {
         return m_neighborhoodSearch;
     }
+    /** Sort the fluid particles and the particles of dynamic bodies along the space-filling curve
+     * of getParticleOrdering(). Afterwards the solver specific particle data has to be reordered
+     * by sortField().
+     */
     void performNeighborhoodSearchSort();
+    /** Reorder an array of fluid particle data by the permutation of the last performNeighborhoodSearchSort().
+     */
+    template<typename T>
+    void sortField(T* lst) const
+    {
+        SpaceFillingCurves::applySortTable(m_sortTable, lst);
+    }
+
+    SpaceFillingCurve getParticleOrdering() const
+    {
+        return m_particleOrdering;
+    }
+    /** Set the space-filling curve which is used for the particle order. With CompactNSearch only
+     * the Morton order is supported.
+     */
+    void setParticleOrdering(const SpaceFillingCurve val);
+
+    Real getNeighborhoodSearchSkin() const
+    {
+        return m_neighborhoodSearchSkin;
+    }
+    /** Set the skin of the Verlet neighbor lists. The neighborhood search collects all neighbors
+     * in the radius supportRadius + skin and the lists are reused until a particle has moved more
+     * than skin/2. A skin of zero performs a new search in each step.
+     */
+    void setNeighborhoodSearchSkin(Real val);
+
+    /** Return true if the neighbor lists must be rebuilt, i.e. if no skin is used, if the lists
+     * were invalidated or if a fluid particle or a particle of a dynamic body has moved more than
+     * half of the skin since the last search.
+     */
+    bool neighborhoodSearchRequired();
+    /** Store the current positions as reference for neighborhoodSearchRequired().
+     * This method must be called after each call of find_neighbors() in the simulation step.
+     */
+    void storeNeighborhoodSearchPositions();
+    /** Force a new neighborhood search in the next step. */
+    void invalidateNeighborhoodSearch()
+    {
+        m_neighborhoodSearchValid = false;
+    }
+
+    /** \brief Measures the time which a thread spends in a particle chunk. The time is added
+     * to the busy time of the chunk, i.e. of the thread which processes it.
+     */
+    class ChunkTimer
+    {
+    public:
+        ChunkTimer(FluidModel* model, const unsigned int chunk) :
+            m_time(model->m_chunkBusyTime[chunk]), m_start(std::chrono::high_resolution_clock::now())
+        {
+        }
+        ~ChunkTimer()
+        {
+            m_time += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+        }
+
+    protected:
+        double&                                        m_time;
+        std::chrono::high_resolution_clock::time_point m_start;
+    };
+
+    /** Partition the fluid particles into one contiguous chunk per thread. If useNeighborCounts
+     * is true, all chunks contain about the same number of neighbors, otherwise the same number
+     * of particles. The neighbor loops distribute the chunks by a static schedule, so that the
+     * work of the threads is balanced. The partition must be updated after each neighborhood search.
+     */
+    void updateParticleChunks(const bool useNeighborCounts = true);
+    unsigned int numberOfParticleChunks() const
+    {
+        return static_cast<unsigned int>(m_particleChunks.size() - 1);
+    }
+    unsigned int getParticleChunkBegin(const unsigned int chunk) const
+    {
+        return m_particleChunks[chunk];
+    }
+    unsigned int getParticleChunkEnd(const unsigned int chunk) const
+    {
+        return m_particleChunks[chunk + 1];
+    }
+    /** Accumulated time in ms which each thread has spent in the neighbor loops (see ChunkTimer).
+     * The difference between the threads shows the load imbalance.
+     */
+    const std::vector<double>& getThreadBusyTimes() const
+    {
+        return m_chunkBusyTime;
+    }
+    void resetThreadBusyTimes();
+
+    /** Use the cache blocked neighbor loops over spatial tiles (see ParticleTiles) where available.
+     */
+    bool getUseTiledTraversal() const
+    {
+        return m_useTiledTraversal;
+    }
+    void setUseTiledTraversal(const bool val)
+    {
+        m_useTiledTraversal = val;
+        m_particleTiles.invalidate();
+    }
+    /** Return true if the tiled neighbor loops are enabled and the tiles match the current neighbor lists.
+     */
+    bool useTiledTraversal() const
+    {
+        return m_useTiledTraversal && m_particleTiles.isValid();
+    }
+    ParticleTiles& getParticleTiles()
+    {
+        return m_particleTiles;
+    }
+    /** Build the tiles if the tiled neighbor loops are enabled and the tiles are outdated.
+     * This method must be called after the neighbor lists and the particle chunks have been updated.
+     */
+    void updateParticleTiles();
 
     FORCE_INLINE unsigned int numberOfNeighbors(const unsigned int index) const
     {
         return static_cast<unsigned int>(m_neighborhoodSearch->point_set(0).n_neighbors(index));
     }
 
-    FORCE_INLINE const CompactNSearch::PointID& getNeighbor(const unsigned int index, const unsigned int k) const
+    FORCE_INLINE const PointID& getNeighbor(const unsigned int index, const unsigned int k) const
     {
         return m_neighborhoodSearch->point_set(0).neighbor(index, k);
     }
@@ -327,6 +595,41 @@ public:
         static_cast<RigidBodyParticleObject*>(m_particleObjects[objectIndex])->m_f[i] = f;
     }
 
+    /** Number of boundary particles per block of the touched flags of the force buffers */
+    static const unsigned int ForceBlockSize = 64;
+
+    /** Add a force to a boundary particle. The force is stored in the buffer of the calling thread,
+     * so the method can be called in parallel loops without synchronization. Forces on static bodies
+     * are ignored. The buffered forces are added to the particle forces by reduceBoundaryForces().
+     * ensureThreadForceBuffers() must be called before the parallel loop.
+     */
+    FORCE_INLINE void addForce(const unsigned int objectIndex, const unsigned int i, const Vector3r& f)
+    {
+        RigidBodyParticleObject* rbpo = static_cast<RigidBodyParticleObject*>(m_particleObjects[objectIndex]);
+        if(rbpo->m_threadForces.empty())
+            return;
+#ifdef _OPENMP
+        const int t = omp_get_thread_num();
+#else
+        const int t = 0;
+#endif
+        rbpo->m_threadForces[t][i] += f;
+        rbpo->m_threadForceBlocks[t][i / ForceBlockSize] = 1;
+    }
+
+    /** Provide a force buffer for each thread of the next parallel region (see addForce()).
+     * Solvers call this method before each phase which adds boundary forces, since the number
+     * of threads may change between two steps. This method must be called outside of a parallel region.
+     */
+    void ensureThreadForceBuffers();
+
+    /** Add the forces of the thread buffers to the boundary particle forces and clear the buffers.
+     * Only the blocks which have been touched by a thread are visited. The buffers are summed up
+     * in a fixed order, so the result does not depend on the scheduling.
+     * This method must be called outside of a parallel region.
+     */
+    void reduceBoundaryForces();
+
     FORCE_INLINE const Real getMass(const unsigned int i) const
     {
         return m_masses[i];
@@ -371,6 +674,13 @@ public:
     {
         m_density[i] = val;
     }
+
+    /** Return the index which the fluid particle i had in initModel(). The ID does not change when the particles are sorted.
+     */
+    FORCE_INLINE unsigned int getParticleId(const unsigned int i) const
+    {
+        return m_particleId[i];
+    }
 };
 }
 
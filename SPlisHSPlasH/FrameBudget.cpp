@@ -0,0 +1,92 @@
+#include "FrameBudget.h"
+#include "TimeStep.h"
+#include <algorithm>
+
+using namespace SPH;
+
+FrameBudget::FrameBudget()
+{
+	m_targetFrameTime = 0.0;
+	m_maxSteps = 20;
+	m_maxToleranceScale = 10.0;
+	m_numberOfSteps = 1;
+	reset();
+}
+
+void FrameBudget::reset()
+{
+	m_toleranceScale = 1.0;
+	m_avgStepTime = 0.0;
+	m_steps = 0;
+	m_deadlineMissed = false;
+	m_exceeded = false;
+	m_lastFrameTime = 0.0;
+	m_lastSteps = 0;
+	m_numFrames = 0;
+	m_numExceededFrames = 0;
+}
+
+void FrameBudget::beginFrame(TimeStep *timeStep, const unsigned int numberOfSteps)
+{
+	m_numberOfSteps = numberOfSteps;
+	m_steps = 0;
+	m_deadlineMissed = false;
+	m_frameStart = std::chrono::high_resolution_clock::now();
+	timeStep->clearDeadline();
+	timeStep->setToleranceScale(isEnabled() ? m_toleranceScale : 1.0);
+}
+
+void FrameBudget::finishStep(TimeStep *timeStep, const std::chrono::high_resolution_clock::time_point &now)
+{
+	const double stepTime = std::chrono::duration<double, std::milli>(now - m_stepStart).count();
+	m_avgStepTime = (m_avgStepTime > 0.0) ? 0.8*m_avgStepTime + 0.2*stepTime : stepTime;
+	m_deadlineMissed = m_deadlineMissed || timeStep->getDeadlineMissed();
+}
+
+bool FrameBudget::nextStep(TimeStep *timeStep)
+{
+	const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	if (m_steps > 0)
+		finishStep(timeStep, now);
+
+	if (!isEnabled())
+	{
+		if (m_steps >= m_numberOfSteps)
+			return false;
+	}
+	else
+	{
+		if (m_steps >= m_maxSteps)
+			return false;
+		// further steps are only started if they are expected to finish within the budget
+		const double elapsed = std::chrono::duration<double, std::milli>(now - m_frameStart).count();
+		if ((m_steps > 0) && (elapsed + m_avgStepTime > m_targetFrameTime))
+			return false;
+		timeStep->setDeadline(m_frameStart + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double, std::milli>(m_targetFrameTime)));
+	}
+	m_stepStart = now;
+	m_steps++;
+	return true;
+}
+
+void FrameBudget::endFrame(TimeStep *timeStep)
+{
+	timeStep->clearDeadline();
+	m_lastSteps = m_steps;
+	m_lastFrameTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_frameStart).count();
+	if (!isEnabled())
+	{
+		m_exceeded = false;
+		return;
+	}
+
+	m_numFrames++;
+	m_exceeded = m_deadlineMissed || (m_lastFrameTime > m_targetFrameTime);
+	if (m_exceeded)
+	{
+		m_numExceededFrames++;
+		m_toleranceScale = std::min(m_toleranceScale * static_cast<Real>(1.5), m_maxToleranceScale);
+	}
+	else
+		m_toleranceScale = std::max(m_toleranceScale / static_cast<Real>(1.1), static_cast<Real>(1.0));
+}
@@ -0,0 +1,91 @@
+#ifndef __FrameBudget_h__
+#define __FrameBudget_h__
+
+#include "Common.h"
+#include <chrono>
+
+namespace SPH
+{
+	class TimeStep;
+
+	/** \brief Wall-clock budget for the simulation steps of a rendered frame.
+	*
+	* Without a budget each frame performs a fixed number of steps. With a target frame time the
+	* number of steps of a frame is chosen so that the steps fit into the target: a step is only
+	* started if the average step time fits into the remaining time of the frame (but at least one
+	* step is performed per frame). The pressure and divergence solvers stop iterating after their
+	* minimal number of iterations when the end of the frame budget is reached (see
+	* TimeStep::setDeadline()).
+	*
+	* If a frame exceeds the target or a solver was stopped at the deadline, the max. density errors
+	* of the solvers are relaxed by increasing the tolerance scale of the time step (up to
+	* maxToleranceScale). In frames within the budget the tolerance scale returns slowly to 1. So the
+	* frame rate stays stable while the simulation becomes less incompressible under load.
+	*
+	* Usage in the render loop:
+	* \code
+	* budget.beginFrame(timeStep, numberOfSteps);
+	* while (budget.nextStep(timeStep))
+	*     timeStep->step();
+	* budget.endFrame(timeStep);
+	* \endcode
+	*/
+	class FrameBudget
+	{
+	protected:
+		/** Target wall-clock time of the steps of a frame in ms, 0 disables the budget */
+		double m_targetFrameTime;
+		unsigned int m_maxSteps;
+		Real m_maxToleranceScale;
+		Real m_toleranceScale;
+		/** Moving average of the wall-clock time of a step in ms */
+		double m_avgStepTime;
+		unsigned int m_numberOfSteps;
+		unsigned int m_steps;
+		std::chrono::high_resolution_clock::time_point m_frameStart;
+		std::chrono::high_resolution_clock::time_point m_stepStart;
+		bool m_deadlineMissed;
+		bool m_exceeded;
+		double m_lastFrameTime;
+		unsigned int m_lastSteps;
+		unsigned int m_numFrames;
+		unsigned int m_numExceededFrames;
+
+		void finishStep(TimeStep *timeStep, const std::chrono::high_resolution_clock::time_point &now);
+
+	public:
+		FrameBudget();
+
+		/** Reset the statistics and the tolerance scale. */
+		void reset();
+
+		bool isEnabled() const { return m_targetFrameTime > 0.0; }
+		double getTargetFrameTime() const { return m_targetFrameTime; }
+		/** Set the target time of the steps of a frame in ms. A value of 0 disables the budget. */
+		void setTargetFrameTime(double val) { m_targetFrameTime = (val > 0.0) ? val : 0.0; }
+		unsigned int getMaxSteps() const { return m_maxSteps; }
+		/** Set the max. number of steps of a frame with a budget. */
+		void setMaxSteps(unsigned int val) { m_maxSteps = (val > 0) ? val : 1; }
+		Real getMaxToleranceScale() const { return m_maxToleranceScale; }
+		void setMaxToleranceScale(Real val) { m_maxToleranceScale = (val > 1.0) ? val : 1.0; }
+
+		/** Start a frame. Without a budget the frame performs numberOfSteps steps. */
+		void beginFrame(TimeStep *timeStep, const unsigned int numberOfSteps);
+		/** Return true if another step of the frame should be performed and set the deadline of the step. */
+		bool nextStep(TimeStep *timeStep);
+		/** End the frame and adapt the tolerance scale of the solvers. */
+		void endFrame(TimeStep *timeStep);
+
+		Real getToleranceScale() const { return m_toleranceScale; }
+		double getAverageStepTime() const { return m_avgStepTime; }
+		/** Wall-clock time of the steps of the last frame in ms */
+		double getLastFrameTime() const { return m_lastFrameTime; }
+		unsigned int getStepsOfLastFrame() const { return m_lastSteps; }
+		/** True if the last frame exceeded the target frame time or a solver stopped at the deadline */
+		bool getExceeded() const { return m_exceeded; }
+		unsigned int getNumberOfFrames() const { return m_numFrames; }
+		unsigned int getNumberOfExceededFrames() const { return m_numExceededFrames; }
+	};
+}
+
+#endif
@@ -51,12 +51,22 @@ void SimulationDataIISPH::performNeighborhoodSearchSort()
 	if (numPart == 0)
 		return;
 
-	auto const& d = m_model->getNeighborhoodSearch()->point_set(0);
-	d.sort_field(&m_aii[0]);
-	d.sort_field(&m_dii[0]);
-	d.sort_field(&m_dij_pj[0]);
-	d.sort_field(&m_density_adv[0]);
-	d.sort_field(&m_pressure[0]);
-	d.sort_field(&m_lastPressure[0]);
-	d.sort_field(&m_pressureAccel[0]);
+	m_model->sortField(&m_aii[0]);
+	m_model->sortField(&m_dii[0]);
+	m_model->sortField(&m_dij_pj[0]);
+	m_model->sortField(&m_density_adv[0]);
+	m_model->sortField(&m_pressure[0]);
+	m_model->sortField(&m_lastPressure[0]);
+	m_model->sortField(&m_pressureAccel[0]);
+}
+
+void SimulationDataIISPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	usage.addFluidArray("IISPH", m_aii);
+	usage.addFluidArray("IISPH", m_dii);
+	usage.addFluidArray("IISPH", m_dij_pj);
+	usage.addFluidArray("IISPH", m_density_adv);
+	usage.addFluidArray("IISPH", m_pressure);
+	usage.addFluidArray("IISPH", m_lastPressure);
+	usage.addFluidArray("IISPH", m_pressureAccel);
 }
@@ -19,13 +19,13 @@ namespace SPH
 		protected:	
 			FluidModel *m_model;
 
-			std::vector<Real> m_aii;
-			std::vector<Vector3r> m_dii;
-			std::vector<Vector3r> m_dij_pj;
-			std::vector<Real> m_density_adv;
-			std::vector<Real> m_pressure;
-			std::vector<Real> m_lastPressure;
-			std::vector<Vector3r> m_pressureAccel;
+			ParticleVector<Real> m_aii;
+			ParticleVector<Vector3r> m_dii;
+			ParticleVector<Vector3r> m_dij_pj;
+			ParticleVector<Real> m_density_adv;
+			ParticleVector<Real> m_pressure;
+			ParticleVector<Real> m_lastPressure;
+			ParticleVector<Vector3r> m_pressureAccel;
 
 		public:
 			/** Initialize the arrays containing the particle data.
@@ -41,10 +41,13 @@ namespace SPH
 			virtual void reset();
 
 			/** Important: First call m_model->performNeighborhoodSearchSort() 
-			 * to call the z_sort of the neighborhood search.
+			 * to compute the new order of the particles.
 			 */
 			void performNeighborhoodSearchSort();
 
+			/** Add the memory of the particle data (see MemoryUsage). */
+			void getMemoryUsage(MemoryUsage &usage) const;
+
 			FORCE_INLINE const Real getAii(const unsigned int i) const
 			{
 				return m_aii[i];
@@ -22,14 +22,13 @@ TimeStepIISPH::~TimeStepIISPH(void)
 
 void TimeStepIISPH::step()
 {
-	TimeManager *tm = TimeManager::getCurrent ();
+	TimeManager *tm = m_model->getTimeManager();
 	const Real h = tm->getTimeStepSize();
 
-	clearAccelerations();
-
 	performNeighborhoodSearch();
 
-	computeDensities();
+	// the accelerations are cleared in the density loop
+	computeDensities(true);
 
 	// Compute viscosity 
 	computeViscosity();
@@ -60,41 +59,51 @@ void TimeStepIISPH::reset()
 	m_counter = 0;
 }
 
+void TimeStepIISPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	TimeStep::getMemoryUsage(usage);
+	m_simulationData.getMemoryUsage(usage);
+}
+
 void TimeStepIISPH::predictAdvection()
 {
 	const unsigned int numParticles = m_model->numParticles();
 
-	const Real h = TimeManager::getCurrent()->getTimeStepSize();
+	const Real h = m_model->getTimeManager()->getTimeStepSize();
 
 	// Predict v_adv
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			Vector3r &vel = m_model->getVelocity(0, i);
-			const Vector3r &accel = m_model->getAcceleration(i);
-			Vector3r &dii = m_simulationData.getDii(i);
-
-			vel += h * accel;
-
-			// Compute d_ii
-			dii.setZero();
-			const Real density2 = m_model->getDensity(i)*m_model->getDensity(i);
-			const Vector3r &xi = m_model->getPosition(0, i);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+				Vector3r &vel = m_model->getVelocity(0, i);
+				const Vector3r &accel = m_model->getAcceleration(i);
+				Vector3r &dii = m_simulationData.getDii(i);
 
-				if (particleId.point_set_id == 0)		// Test if fluid particle
-				{
-					dii -= m_model->getMass(neighborIndex) / density2 * m_model->gradW(xi - xj);
-				}
-				else
+				vel += h * accel;
+
+				// Compute d_ii
+				dii.setZero();
+				const Real density2 = m_model->getDensity(i)*m_model->getDensity(i);
+				const Vector3r &xi = m_model->getPosition(0, i);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					dii -= m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density2 * m_model->gradW(xi - xj);
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+					if (particleId.point_set_id == 0)		// Test if fluid particle
+					{
+						dii -= m_model->getMass(neighborIndex) / density2 * m_model->gradW(xi - xj);
+					}
+					else
+					{
+						dii -= m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density2 * m_model->gradW(xi - xj);
+					}
 				}
 			}
 		}
@@ -104,59 +113,63 @@ void TimeStepIISPH::predictAdvection()
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Real &density = m_model->getDensity(i);
-			Real &densityAdv = m_simulationData.getDensityAdv(i);
-			densityAdv = density;
-			const Vector3r &xi = m_model->getPosition(0, i);
-			const Vector3r &vi = m_model->getVelocity(0, i);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-				const Vector3r &vj = m_model->getVelocity(particleId.point_set_id, neighborIndex);
-
-				if (particleId.point_set_id == 0)		// Test if fluid particle
-				{
-					densityAdv += h*m_model->getMass(neighborIndex) * (vi - vj).dot(m_model->gradW(xi - xj));
-				}
-				else
+				const Real &density = m_model->getDensity(i);
+				Real &densityAdv = m_simulationData.getDensityAdv(i);
+				densityAdv = density;
+				const Vector3r &xi = m_model->getPosition(0, i);
+				const Vector3r &vi = m_model->getVelocity(0, i);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					densityAdv += h*m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (vi - vj).dot(m_model->gradW(xi - xj));
-				}
-			}
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+					const Vector3r &vj = m_model->getVelocity(particleId.point_set_id, neighborIndex);
 
-			const Real &pressure = m_simulationData.getPressure(i);
-			Real &lastPressure = m_simulationData.getLastPressure(i);
-			lastPressure = 0.5*pressure;
+					if (particleId.point_set_id == 0)		// Test if fluid particle
+					{
+						densityAdv += h*m_model->getMass(neighborIndex) * (vi - vj).dot(m_model->gradW(xi - xj));
+					}
+					else
+					{
+						densityAdv += h*m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (vi - vj).dot(m_model->gradW(xi - xj));
+					}
+				}
 
-			// Compute a_ii
-			Real &aii = m_simulationData.getAii(i);
-			aii = 0.0;
-			const Vector3r &dii = m_simulationData.getDii(i);
+				const Real &pressure = m_simulationData.getPressure(i);
+				Real &lastPressure = m_simulationData.getLastPressure(i);
+				lastPressure = 0.5*pressure;
 
-			const Real dpi = m_model->getMass(i) / (density*density);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
-			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+				// Compute a_ii
+				Real &aii = m_simulationData.getAii(i);
+				aii = 0.0;
+				const Vector3r &dii = m_simulationData.getDii(i);
 
-				if (particleId.point_set_id == 0)		// Test if fluid particle
+				const Real dpi = m_model->getMass(i) / (density*density);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					// Compute d_ji
-					const Vector3r kernel = m_model->gradW(xi - xj);
-					const Vector3r dji = dpi * kernel;			
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
 
-					aii += m_model->getMass(neighborIndex) * (dii - dji).dot(kernel);
-				}
-				else
-				{
-					const Vector3r kernel = m_model->gradW(xi - xj);
-					const Vector3r dji = dpi * kernel;			
-					aii += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dii - dji).dot(kernel);
+					if (particleId.point_set_id == 0)		// Test if fluid particle
+					{
+						// Compute d_ji
+						const Vector3r kernel = m_model->gradW(xi - xj);
+						const Vector3r dji = dpi * kernel;			
+
+						aii += m_model->getMass(neighborIndex) * (dii - dji).dot(kernel);
+					}
+					else
+					{
+						const Vector3r kernel = m_model->gradW(xi - xj);
+						const Vector3r dji = dpi * kernel;			
+						aii += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dii - dji).dot(kernel);
+					}
 				}
 			}
 		}
@@ -168,114 +181,129 @@ void TimeStepIISPH::pressureSolve()
 	const unsigned int numParticles = m_model->numParticles();
 
 	const Real density0 = m_model->getDensity0();
-	const Real h = TimeManager::getCurrent()->getTimeStepSize();
+	const Real h = m_model->getTimeManager()->getTimeStepSize();
 	const Real h2 = h*h;
 
 	m_iterations = 0;
 	const Real omega = 0.5;
 
-	const Real eta = m_maxError * 0.01 * density0;  // maxError is given in percent
+	const Real eta = m_maxError * m_toleranceScale * 0.01 * density0;  // maxError is given in percent
+	unsigned int maxIterations = m_maxIterations;
 
 	Real avg_density = 0.0;
-	while ((((avg_density - density0) > eta) || (m_iterations < 2)) && (m_iterations < m_maxIterations))
-	{
-		avg_density = 0.0;
+	Real density_sum = 0.0;
 
-		// Compute dij_pj
-		#pragma omp parallel default(shared)
+	// All iterations of the solver are executed in a single parallel region
+	#pragma omp parallel default(shared)
+	{
+		// The loop condition is evaluated by all threads, the shared density, iteration 
+		// count and iteration limit are only changed in the single section at the end.
+		while ((((avg_density - density0) > eta) || (m_iterations < 2)) && (m_iterations < maxIterations))
 		{
+			// Compute dij_pj
 			#pragma omp for schedule(static)  
-			for (int i = 0; i < (int) numParticles; i++)
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 			{
-				Vector3r &dij_pj = m_simulationData.getDij_pj(i);
-				dij_pj.setZero();
-				const Vector3r &xi = m_model->getPosition(0, i);
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					if (particleId.point_set_id == 0)		// Test if fluid particle
+					Vector3r &dij_pj = m_simulationData.getDij_pj(i);
+					dij_pj.setZero();
+					const Vector3r &xi = m_model->getPosition(0, i);
+					for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 					{
-						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-						const Real &densityj = m_model->getDensity(neighborIndex);
-						dij_pj -= m_model->getMass(neighborIndex) / (densityj*densityj) * m_simulationData.getLastPressure(neighborIndex) * m_model->gradW(xi - xj);
+						const PointID &particleId = m_model->getNeighbor(i, j);
+						const unsigned int &neighborIndex = particleId.point_id;
+						if (particleId.point_set_id == 0)		// Test if fluid particle
+						{
+							const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+							const Real &densityj = m_model->getDensity(neighborIndex);
+							dij_pj -= m_model->getMass(neighborIndex) / (densityj*densityj) * m_simulationData.getLastPressure(neighborIndex) * m_model->gradW(xi - xj);
+						}
 					}
 				}
 			}
-		}
 
-		// Compute new pressure
-		#pragma omp parallel default(shared)
-		{
+			// Compute new pressure
 			#pragma omp for schedule(static)  
-			for (int i = 0; i < (int) numParticles; i++)
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 			{
-				const Real &aii = m_simulationData.getAii(i);
-				const Real density = m_model->getDensity(i);
-				const Vector3r &xi = m_model->getPosition(0, i);
-				const Real dpi = m_model->getMass(i) / (density*density);
-				Real sum = 0.0;
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)		// Test if fluid particle
+					const Real &aii = m_simulationData.getAii(i);
+					const Real density = m_model->getDensity(i);
+					const Vector3r &xi = m_model->getPosition(0, i);
+					const Real dpi = m_model->getMass(i) / (density*density);
+					Real sum = 0.0;
+					for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 					{
-						const Vector3r &d_jk_pk = m_simulationData.getDij_pj(neighborIndex);
+						const PointID &particleId = m_model->getNeighbor(i, j);
+						const unsigned int &neighborIndex = particleId.point_id;
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
 
-						// Compute \sum_{k \neq i} djk*pk
-						// Compute d_ji
-						const Vector3r kernel = m_model->gradW(xi - xj);
-						const Vector3r dji = dpi * kernel;			
-						const Vector3r d_ji_pi = dji * m_simulationData.getLastPressure(i);
+						if (particleId.point_set_id == 0)		// Test if fluid particle
+						{
+							const Vector3r &d_jk_pk = m_simulationData.getDij_pj(neighborIndex);
+
+							// Compute \sum_{k \neq i} djk*pk
+							// Compute d_ji
+							const Vector3r kernel = m_model->gradW(xi - xj);
+							const Vector3r dji = dpi * kernel;			
+							const Vector3r d_ji_pi = dji * m_simulationData.getLastPressure(i);
+
+							// \sum ( mj * (\sum dij*pj - djj*pj - \sum_{k \neq i} djk*pk) * m_model->gradW)
+							sum += m_model->getMass(neighborIndex) * (m_simulationData.getDij_pj(i) - m_simulationData.getDii(neighborIndex)*m_simulationData.getLastPressure(neighborIndex) - (d_jk_pk - d_ji_pi)).dot(kernel);
+						}
+						else
+						{
+							sum += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_simulationData.getDij_pj(i).dot(m_model->gradW(xi - xj));
+						}
+					}
 
-						// \sum ( mj * (\sum dij*pj - djj*pj - \sum_{k \neq i} djk*pk) * m_model->gradW)
-						sum += m_model->getMass(neighborIndex) * (m_simulationData.getDij_pj(i) - m_simulationData.getDii(neighborIndex)*m_simulationData.getLastPressure(neighborIndex) - (d_jk_pk - d_ji_pi)).dot(kernel);
+					const Real b = density0 - m_simulationData.getDensityAdv(i);
+			
+					Real &pi = m_simulationData.getPressure(i);
+					const Real &lastPi = m_simulationData.getLastPressure(i);
+					const Real denom = aii*h2;
+					if (fabs(denom) > 1.0e-9)
+						pi = max((1.0 - omega)*lastPi + omega / denom * (b - h2*sum), 0.0);
+					else
+						pi = 0.0;
+ 
+					if (pi != 0.0)
+					{					
+						const Real newDensity = (aii*pi + sum)*h2 - b + density0;
+
+						#pragma omp atomic
+						density_sum += newDensity;
 					}
 					else
 					{
-						sum += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_simulationData.getDij_pj(i).dot(m_model->gradW(xi - xj));
+						#pragma omp atomic
+						density_sum += density0;
 					}
 				}
+			}
 
-				const Real b = density0 - m_simulationData.getDensityAdv(i);
-			
-				Real &pi = m_simulationData.getPressure(i);
-				const Real &lastPi = m_simulationData.getLastPressure(i);
-				const Real denom = aii*h2;
-				if (fabs(denom) > 1.0e-9)
-					pi = max((1.0 - omega)*lastPi + omega / denom * (b - h2*sum), 0.0);
-				else
-					pi = 0.0;
- 
-				if (pi != 0.0)
-				{					
-					const Real newDensity = (aii*pi + sum)*h2 - b + density0;
-
-					#pragma omp atomic
-					avg_density += newDensity;
-				}
-				else
-				{
-					#pragma omp atomic
-					avg_density += density0;
-				}
+			#pragma omp for schedule(static)  
+			for (int i = 0; i < (int)numParticles; i++)
+			{
+				const Real &pi = m_simulationData.getPressure(i);
+				Real &lastPi = m_simulationData.getLastPressure(i);
+				lastPi = pi;
 			}
-		}
 
-		for (int i = 0; i < (int)numParticles; i++)
-		{
-			const Real &pi = m_simulationData.getPressure(i);
-			Real &lastPi = m_simulationData.getLastPressure(i);
-			lastPi = pi;
+			#pragma omp single
+			{
+				avg_density = density_sum / numParticles;
+				density_sum = 0.0;
+				m_iterations++;
+				checkDeadline(m_iterations, 2, (avg_density - density0) <= eta, maxIterations);
+			}
 		}
-		
-		avg_density /= numParticles;
-
-		m_iterations++;
 	}
+	m_densityError = (avg_density - density0) / density0 * 100.0;
 }
 
 void TimeStepIISPH::integration()
@@ -285,7 +313,7 @@ void TimeStepIISPH::integration()
 	// Compute pressure forces
 	computePressureAccels();
 
-	Real h = TimeManager::getCurrent()->getTimeStepSize();
+	Real h = m_model->getTimeManager()->getTimeStepSize();
 
 	#pragma omp parallel default(shared)
 	{
@@ -304,44 +332,52 @@ void TimeStepIISPH::computePressureAccels()
 {
 	const unsigned int numParticles = m_model->numParticles();
 
+	m_model->ensureThreadForceBuffers();
+
 	// Compute pressure forces
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			const Real &density_i = m_model->getDensity(i);
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+			{
+				const Vector3r &xi = m_model->getPosition(0, i);
+				const Real &density_i = m_model->getDensity(i);
 
-			Vector3r &ai = m_simulationData.getPressureAccel(i);
-			ai.setZero();
+				Vector3r &ai = m_simulationData.getPressureAccel(i);
+				ai.setZero();
 
-			const Real dpi = m_simulationData.getPressure(i) / (density_i*density_i);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
-			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+				const Real dpi = m_simulationData.getPressure(i) / (density_i*density_i);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				{
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
 
-				if (particleId.point_set_id == 0)		// Test if fluid particle
-				{					
-					// Pressure 
-					const Real &density_j = m_model->getDensity(neighborIndex);
+					if (particleId.point_set_id == 0)		// Test if fluid particle
+					{					
+						// Pressure 
+						const Real &density_j = m_model->getDensity(neighborIndex);
 
-					const Real dpj = m_simulationData.getPressure(neighborIndex) / (density_j*density_j);
+						const Real dpj = m_simulationData.getPressure(neighborIndex) / (density_j*density_j);
 
-					ai -= m_model->getMass(neighborIndex) * (dpi + dpj) * m_model->gradW(xi - xj);
-				}
-				else
-				{
-					const Vector3r a = m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dpi)* m_model->gradW(xi - xj);
-					ai -= a;
+						ai -= m_model->getMass(neighborIndex) * (dpi + dpj) * m_model->gradW(xi - xj);
+					}
+					else
+					{
+						const Vector3r a = m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dpi)* m_model->gradW(xi - xj);
+						ai -= a;
 
-					m_model->getForce(particleId.point_set_id, neighborIndex) += m_model->getMass(i) * a;
+						m_model->addForce(particleId.point_set_id, neighborIndex, m_model->getMass(i) * a);
+					}
 				}
 			}
 		}
 	}
+
+	m_model->reduceBoundaryForces();
 }
 
 void TimeStepIISPH::performNeighborhoodSearch()
@@ -36,6 +36,7 @@ namespace SPH
 
 		virtual void step();
 		virtual void reset();
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 	};
 }
 
@@ -0,0 +1,402 @@
+#include "MetricsServer.h"
+#include "TimeStep.h"
+#include "TimeManager.h"
+#include "FluidModel.h"
+#include "Utilities/Timing.h"
+#include "Utilities/ParticleAllocator.h"
+#include "Utilities/MemoryUsage.h"
+#include <sstream>
+#include <cstring>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#define closeSocket closesocket
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#define closeSocket ::close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace SPH;
+
+MetricsServer::MetricsServer()
+{
+	m_stop = false;
+	m_socket = -1;
+	m_steps = 0;
+	m_time = 0.0;
+	m_timeStepSize = 0.0;
+	m_stepWallTime = 0.0;
+	m_stepsPerSecond = 0.0;
+	m_iterations = 0;
+	m_iterationsV = 0;
+	m_iterationsTotal = 0;
+	m_iterationsVTotal = 0;
+	m_densityError = 0.0;
+	m_densityErrorV = 0.0;
+	m_toleranceScale = 1.0;
+	m_deadlineMisses = 0;
+	m_numFluidParticles = 0;
+	m_numBoundaryParticles = 0;
+	m_pendingWrites = 0;
+	m_numPhases = 0;
+	for (unsigned int i = 0; i < MaxPhases; i++)
+	{
+		m_phases[i].totalTime = 0.0;
+		m_phases[i].counter = 0;
+	}
+	m_rateStartStep = 0;
+}
+
+MetricsServer::~MetricsServer()
+{
+	close();
+}
+
+bool MetricsServer::open(const std::string &endpoint)
+{
+	close();
+
+#if defined(WIN32) || defined(_WIN32)
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return false;
+#endif
+
+	std::intptr_t s = -1;
+	if (endpoint.compare(0, 5, "unix:") == 0)
+	{
+#if defined(WIN32) || defined(_WIN32)
+		return false;
+#else
+		const std::string path = endpoint.substr(5);
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		if (path.empty() || (path.size() >= sizeof(addr.sun_path)))
+			return false;
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		s = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s == -1)
+			return false;
+		// remove the socket of a previous run
+		unlink(path.c_str());
+		if ((bind((int)s, (sockaddr*)&addr, sizeof(addr)) != 0) || (listen((int)s, 8) != 0))
+		{
+			closeSocket((int)s);
+			return false;
+		}
+		m_unixSocketPath = path;
+#endif
+	}
+	else
+	{
+		std::string host = "127.0.0.1";
+		std::string port = endpoint;
+		const size_t colon = endpoint.rfind(':');
+		if (colon != std::string::npos)
+		{
+			host = endpoint.substr(0, colon);
+			port = endpoint.substr(colon + 1);
+		}
+
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		addrinfo *result = nullptr;
+		if (getaddrinfo((host.empty() || (host == "*")) ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0)
+			return false;
+		for (addrinfo *ai = result; ai != nullptr; ai = ai->ai_next)
+		{
+			s = (std::intptr_t)socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+			if (s == -1)
+				continue;
+			const int reuse = 1;
+			setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+			if ((bind(s, ai->ai_addr, (socklen_t)ai->ai_addrlen) == 0) && (listen(s, 8) == 0))
+				break;
+			closeSocket(s);
+			s = -1;
+		}
+		freeaddrinfo(result);
+		if (s == -1)
+			return false;
+	}
+
+	m_socket = s;
+	m_stop = false;
+	m_steps = 0;
+	m_iterationsTotal = 0;
+	m_iterationsVTotal = 0;
+	m_deadlineMisses = 0;
+	m_stepsPerSecond = 0.0;
+	m_lastPublish = std::chrono::high_resolution_clock::now();
+	m_rateStart = m_lastPublish;
+	m_rateStartStep = 0;
+	m_server = std::thread(&MetricsServer::serverLoop, this);
+	return true;
+}
+
+void MetricsServer::close()
+{
+	if (m_socket == -1)
+		return;
+	m_stop = true;
+	m_server.join();
+	closeSocket(m_socket);
+	m_socket = -1;
+#if defined(WIN32) || defined(_WIN32)
+	WSACleanup();
+#else
+	if (!m_unixSocketPath.empty())
+		unlink(m_unixSocketPath.c_str());
+#endif
+	m_unixSocketPath.clear();
+}
+
+int MetricsServer::getPhaseSlot(const int timerId, const std::string &name)
+{
+	auto iter = m_phaseSlots.find(timerId);
+	if (iter != m_phaseSlots.end())
+		return iter->second;
+
+	// timers of different scopes with the same name share a slot
+	const unsigned int numPhases = m_numPhases.load(std::memory_order_relaxed);
+	int slot = -1;
+	for (unsigned int i = 0; i < numPhases; i++)
+	{
+		if (m_phases[i].name == name)
+		{
+			slot = (int)i;
+			break;
+		}
+	}
+	if ((slot == -1) && (numPhases < MaxPhases))
+	{
+		slot = (int)numPhases;
+		m_phases[slot].name = name;
+		// the name must be visible before the server thread reads the slot
+		m_numPhases.store(numPhases + 1, std::memory_order_release);
+	}
+	m_phaseSlots[timerId] = slot;
+	return slot;
+}
+
+void MetricsServer::publish(TimeStep *timeStep)
+{
+	if (m_socket == -1)
+		return;
+
+	FluidModel *model = timeStep->getModel();
+	const std::memory_order order = std::memory_order_relaxed;
+
+	const unsigned long long steps = m_steps.load(order) + 1;
+	const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	m_stepWallTime.store(std::chrono::duration<double>(now - m_lastPublish).count(), order);
+	m_lastPublish = now;
+	// steps per second over intervals of at least one second
+	const double rateInterval = std::chrono::duration<double>(now - m_rateStart).count();
+	if (rateInterval >= 1.0)
+	{
+		m_stepsPerSecond.store((double)(steps - m_rateStartStep) / rateInterval, order);
+		m_rateStart = now;
+		m_rateStartStep = steps;
+	}
+
+	m_time.store(model->getTimeManager()->getTime(), order);
+	m_timeStepSize.store(model->getTimeManager()->getTimeStepSize(), order);
+	m_iterations.store(timeStep->getIterationCount(), order);
+	m_iterationsV.store(timeStep->getIterationCountV(), order);
+	m_iterationsTotal.store(m_iterationsTotal.load(order) + timeStep->getIterationCount(), order);
+	m_iterationsVTotal.store(m_iterationsVTotal.load(order) + timeStep->getIterationCountV(), order);
+	m_densityError.store(timeStep->getDensityError(), order);
+	m_densityErrorV.store(timeStep->getDensityErrorV(), order);
+	m_toleranceScale.store(timeStep->getToleranceScale(), order);
+	if (timeStep->getDeadlineMissed())
+		m_deadlineMisses.store(m_deadlineMisses.load(order) + 1, order);
+	m_numFluidParticles.store(model->numParticles(), order);
+	m_numBoundaryParticles.store(model->numberOfBoundaryParticles(), order);
+	m_pendingWrites.store(model->numberOfPendingWrites(), order);
+
+	//////////////////////////////////////////////////////////////////////////
+	// accumulated phase times
+	//////////////////////////////////////////////////////////////////////////
+	double totalTimes[MaxPhases];
+	unsigned long long counters[MaxPhases];
+	for (unsigned int i = 0; i < MaxPhases; i++)
+	{
+		totalTimes[i] = 0.0;
+		counters[i] = 0;
+	}
+	for (auto iter = Timing::m_averageTimes.begin(); iter != Timing::m_averageTimes.end(); iter++)
+	{
+		const int slot = getPhaseSlot(iter->first, iter->second.name);
+		if (slot == -1)
+			continue;
+		totalTimes[slot] += iter->second.totalTime;
+		counters[slot] += iter->second.counter;
+	}
+	const unsigned int numPhases = m_numPhases.load(order);
+	for (unsigned int i = 0; i < numPhases; i++)
+	{
+		// Timing measures in ms
+		m_phases[i].totalTime.store(totalTimes[i] * 0.001, order);
+		m_phases[i].counter.store(counters[i], order);
+	}
+
+	m_steps.store(steps, std::memory_order_release);
+}
+
+/** Escape a label value of the Prometheus text format. */
+static std::string escapeLabel(const std::string &value)
+{
+	std::string result;
+	for (unsigned int i = 0; i < value.size(); i++)
+	{
+		if ((value[i] == '\\') || (value[i] == '"'))
+			result += '\\';
+		if (value[i] == '\n')
+			result += "\\n";
+		else
+			result += value[i];
+	}
+	return result;
+}
+
+/** Write the HELP and TYPE lines and the value of a metric without labels. */
+template<class T>
+static void writeMetric(std::ostringstream &out, const char *name, const char *type, const char *help, const T value)
+{
+	out << "# HELP " << name << " " << help << "\n";
+	out << "# TYPE " << name << " " << type << "\n";
+	out << name << " " << value << "\n";
+}
+
+std::string MetricsServer::formatMetrics()
+{
+	const std::memory_order order = std::memory_order_relaxed;
+	std::ostringstream out;
+	out.precision(10);
+	writeMetric(out, "splishsplash_steps_total", "counter", "Number of simulation steps.", m_steps.load(std::memory_order_acquire));
+	writeMetric(out, "splishsplash_steps_per_second", "gauge", "Simulation steps per wall-clock second.", m_stepsPerSecond.load(order));
+	writeMetric(out, "splishsplash_step_wall_seconds", "gauge", "Wall-clock time of the last step.", m_stepWallTime.load(order));
+	writeMetric(out, "splishsplash_simulation_time_seconds", "gauge", "Current simulation time.", m_time.load(order));
+	writeMetric(out, "splishsplash_time_step_size_seconds", "gauge", "Current time step size.", m_timeStepSize.load(order));
+	writeMetric(out, "splishsplash_solver_iterations", "gauge", "Pressure solver iterations of the last step.", m_iterations.load(order));
+	writeMetric(out, "splishsplash_solver_iterations_total", "counter", "Pressure solver iterations of all steps.", m_iterationsTotal.load(order));
+	writeMetric(out, "splishsplash_divergence_solver_iterations", "gauge", "Divergence solver iterations of the last step.", m_iterationsV.load(order));
+	writeMetric(out, "splishsplash_divergence_solver_iterations_total", "counter", "Divergence solver iterations of all steps.", m_iterationsVTotal.load(order));
+	writeMetric(out, "splishsplash_density_error", "gauge", "Density error of the pressure solver in the last step.", m_densityError.load(order));
+	writeMetric(out, "splishsplash_divergence_error", "gauge", "Density error of the divergence solver in the last step.", m_densityErrorV.load(order));
+	writeMetric(out, "splishsplash_tolerance_scale", "gauge", "Scale factor of the max. density errors set by the frame budget.", m_toleranceScale.load(order));
+	writeMetric(out, "splishsplash_deadline_misses_total", "counter", "Steps in which a solver stopped at the deadline of the frame budget.", m_deadlineMisses.load(order));
+	writeMetric(out, "splishsplash_fluid_particles", "gauge", "Number of fluid particles.", m_numFluidParticles.load(order));
+	writeMetric(out, "splishsplash_boundary_particles", "gauge", "Number of boundary particles.", m_numBoundaryParticles.load(order));
+	writeMetric(out, "splishsplash_output_pending_writes", "gauge", "Frame files which are still written in the background.", m_pendingWrites.load(order));
+	writeMetric(out, "splishsplash_particle_memory_bytes", "gauge", "Allocated bytes of the particle arrays.", ParticleMemory::getAllocatedBytes());
+	writeMetric(out, "splishsplash_particle_memory_peak_bytes", "gauge", "Peak allocated bytes of the particle arrays.", ParticleMemory::getPeakAllocatedBytes());
+	const std::size_t rss = MemoryUsage::getResidentMemory();
+	if (rss > 0)
+		writeMetric(out, "splishsplash_resident_memory_bytes", "gauge", "Resident set size of the process.", rss);
+	const std::size_t peakRss = MemoryUsage::getPeakResidentMemory();
+	if (peakRss > 0)
+		writeMetric(out, "splishsplash_resident_memory_peak_bytes", "gauge", "Peak resident set size of the process.", peakRss);
+
+	const unsigned int numPhases = m_numPhases.load(std::memory_order_acquire);
+	if (numPhases > 0)
+	{
+		out << "# HELP splishsplash_phase_seconds_total Accumulated wall-clock time of the timed phases.\n";
+		out << "# TYPE splishsplash_phase_seconds_total counter\n";
+		for (unsigned int i = 0; i < numPhases; i++)
+			out << "splishsplash_phase_seconds_total{phase=\"" << escapeLabel(m_phases[i].name) << "\"} " << m_phases[i].totalTime.load(order) << "\n";
+		out << "# HELP splishsplash_phase_calls_total Number of measurements of the timed phases.\n";
+		out << "# TYPE splishsplash_phase_calls_total counter\n";
+		for (unsigned int i = 0; i < numPhases; i++)
+			out << "splishsplash_phase_calls_total{phase=\"" << escapeLabel(m_phases[i].name) << "\"} " << m_phases[i].counter.load(order) << "\n";
+	}
+	return out.str();
+}
+
+void MetricsServer::handleClient(const std::intptr_t client)
+{
+	// read the request header, its content does not matter
+#if defined(WIN32) || defined(_WIN32)
+	DWORD timeout = 1000;
+#else
+	timeval timeout;
+	timeout.tv_sec = 1;
+	timeout.tv_usec = 0;
+#endif
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	std::string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == std::string::npos)
+	{
+		const int n = (int)recv(client, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			break;
+		request.append(buffer, n);
+		if (request.size() > 16384)
+			break;
+	}
+
+	const std::string body = formatMetrics();
+	std::ostringstream response;
+	response << "HTTP/1.1 200 OK\r\n"
+		<< "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Connection: close\r\n\r\n"
+		<< body;
+	const std::string data = response.str();
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		const int n = (int)send(client, data.c_str() + sent, (int)(data.size() - sent), MSG_NOSIGNAL);
+		if (n <= 0)
+			break;
+		sent += n;
+	}
+	closeSocket(client);
+}
+
+void MetricsServer::serverLoop()
+{
+	while (!m_stop)
+	{
+		// wait for a client with a timeout to check the stop flag
+#if defined(WIN32) || defined(_WIN32)
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET((SOCKET)m_socket, &readSet);
+		timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 200000;
+		if (select(0, &readSet, nullptr, nullptr, &timeout) <= 0)
+			continue;
+#else
+		pollfd pfd;
+		pfd.fd = (int)m_socket;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 200) <= 0)
+			continue;
+#endif
+		const std::intptr_t client = (std::intptr_t)accept(m_socket, nullptr, nullptr);
+		if (client == -1)
+			continue;
+		handleClient(client);
+	}
+}
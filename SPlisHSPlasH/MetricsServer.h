@@ -0,0 +1,96 @@
+#ifndef __MetricsServer_h__
+#define __MetricsServer_h__
+
+#include "Common.h"
+#include <string>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+
+namespace SPH
+{
+	class TimeStep;
+
+	/** \brief Live metrics of a running simulation in the Prometheus text format.
+	*
+	* A background thread serves the metrics over HTTP (any request path) on a TCP port or, on POSIX
+	* systems, on a Unix domain socket. After each step publish() stores the simulation time, the time
+	* step size, the solver iterations and density errors, the state of the frame budget (see FrameBudget),
+	* the particle counts, the pending output writes and the accumulated time of each timed phase (see
+	* START_TIMING) in atomic variables.
+	* The server thread only reads these variables, so the simulation never waits for a lock or for
+	* a client. The memory metrics (particle arrays, resident set size) are read by the server thread
+	* when a client requests the metrics.
+	*
+	* The endpoint is given as "port", "address:port" or "unix:path". A port without address is bound
+	* to the loopback interface.
+	*/
+	class MetricsServer
+	{
+	public:
+		/** Maximal number of distinct phase names which are exported */
+		static const unsigned int MaxPhases = 64;
+
+	protected:
+		/** \brief Accumulated time of a timed phase. The name is written before the phase is
+		* published by incrementing m_numPhases and is not changed afterwards. */
+		struct Phase
+		{
+			std::string name;
+			std::atomic<double> totalTime;
+			std::atomic<unsigned long long> counter;
+		};
+
+		std::atomic<bool> m_stop;
+		std::thread m_server;
+		std::intptr_t m_socket;
+		std::string m_unixSocketPath;
+
+		std::atomic<unsigned long long> m_steps;
+		std::atomic<double> m_time;
+		std::atomic<double> m_timeStepSize;
+		std::atomic<double> m_stepWallTime;
+		std::atomic<double> m_stepsPerSecond;
+		std::atomic<unsigned int> m_iterations;
+		std::atomic<unsigned int> m_iterationsV;
+		std::atomic<unsigned long long> m_iterationsTotal;
+		std::atomic<unsigned long long> m_iterationsVTotal;
+		std::atomic<double> m_densityError;
+		std::atomic<double> m_densityErrorV;
+		std::atomic<double> m_toleranceScale;
+		std::atomic<unsigned long long> m_deadlineMisses;
+		std::atomic<unsigned int> m_numFluidParticles;
+		std::atomic<unsigned int> m_numBoundaryParticles;
+		std::atomic<unsigned int> m_pendingWrites;
+		std::atomic<unsigned int> m_numPhases;
+		Phase m_phases[MaxPhases];
+
+		/** Phase slot of each timer id, only used by publish() */
+		std::unordered_map<int, int> m_phaseSlots;
+		std::chrono::high_resolution_clock::time_point m_lastPublish;
+		std::chrono::high_resolution_clock::time_point m_rateStart;
+		unsigned long long m_rateStartStep;
+
+		int getPhaseSlot(const int timerId, const std::string &name);
+		void serverLoop();
+		void handleClient(const std::intptr_t client);
+		std::string formatMetrics();
+
+	public:
+		MetricsServer();
+		~MetricsServer();
+
+		/** Start the server on the given endpoint. Returns false if the socket cannot be opened. */
+		bool open(const std::string &endpoint);
+		/** Stop the server thread and close the socket. */
+		void close();
+		bool isOpen() const { return m_socket != -1; }
+
+		/** Publish the state after a step of the given time step method. */
+		void publish(TimeStep *timeStep);
+	};
+}
+
+#endif
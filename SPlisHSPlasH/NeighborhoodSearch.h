@@ -0,0 +1,28 @@
+#ifndef __NeighborhoodSearch_h__
+#define __NeighborhoodSearch_h__
+
+/** The neighborhood search which is used by the fluid model. By default the in-tree cell grid
+* search is used. If SPH_USE_COMPACTNSEARCH is defined (CMake option USE_COMPACTNSEARCH),
+* CompactNSearch is used instead. Both provide the same interface.
+*/
+#ifdef SPH_USE_COMPACTNSEARCH
+#include "CompactNSearch.h"
+
+namespace SPH
+{
+	typedef CompactNSearch::NeighborhoodSearch NeighborhoodSearch;
+	typedef CompactNSearch::PointSet PointSet;
+	typedef CompactNSearch::PointID PointID;
+}
+#else
+#include "NeighborhoodSearch/NeighborhoodSearch_CellGrid.h"
+
+namespace SPH
+{
+	typedef NeighborhoodSearch_CellGrid NeighborhoodSearch;
+	typedef NeighborhoodSearch_CellGrid::PointSet PointSet;
+	typedef NeighborhoodSearch_CellGrid::PointID PointID;
+}
+#endif
+
+#endif
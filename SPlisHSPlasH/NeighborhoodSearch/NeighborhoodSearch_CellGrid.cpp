@@ -0,0 +1,481 @@
+#include "NeighborhoodSearch_CellGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace SPH;
+
+namespace
+{
+	int getMaxThreads()
+	{
+#ifdef _OPENMP
+		return omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+
+	/** Return the range [begin, end) of the n items which is processed by the calling thread.
+	* The ranges are contiguous and ordered by the thread number. */
+	void threadRange(const unsigned int n, unsigned int &begin, unsigned int &end, int &tid, int &numThreads)
+	{
+#ifdef _OPENMP
+		tid = omp_get_thread_num();
+		numThreads = omp_get_num_threads();
+#else
+		tid = 0;
+		numThreads = 1;
+#endif
+		begin = (unsigned int)(((std::uint64_t)n * tid) / numThreads);
+		end = (unsigned int)(((std::uint64_t)n * (tid + 1)) / numThreads);
+	}
+
+	/** Spread the lower 21 bits of v so that there are two zero bits between all bits. */
+	std::uint64_t spreadBits(std::uint64_t v)
+	{
+		v &= 0x1fffff;
+		v = (v | v << 32) & 0x1f00000000ffffull;
+		v = (v | v << 16) & 0x1f0000ff0000ffull;
+		v = (v | v << 8) & 0x100f00f00f00f00full;
+		v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+		v = (v | v << 2) & 0x1249249249249249ull;
+		return v;
+	}
+}
+
+NeighborhoodSearch_CellGrid::NeighborhoodSearch_CellGrid(const Real radius, const Real cellSizeFactor)
+{
+	m_radius = radius;
+	m_cellSizeFactor = cellSizeFactor;
+	m_gridValid = false;
+	m_staticGridValid = false;
+	m_cellCounterSize = 0;
+}
+
+NeighborhoodSearch_CellGrid::~NeighborhoodSearch_CellGrid()
+{
+}
+
+void NeighborhoodSearch_CellGrid::set_radius(const Real radius)
+{
+	m_radius = radius;
+	m_gridValid = false;
+	m_staticGridValid = false;
+}
+
+void NeighborhoodSearch_CellGrid::set_cell_size_factor(const Real val)
+{
+	m_cellSizeFactor = val;
+	m_gridValid = false;
+	m_staticGridValid = false;
+}
+
+unsigned int NeighborhoodSearch_CellGrid::add_point_set(Real const *x, const std::size_t n, const bool isDynamic, const bool searchNeighbors)
+{
+	m_pointSets.push_back(PointSet(x, n, isDynamic, searchNeighbors));
+	m_pointSets.back().m_neighborOffsets.assign(n + 1, 0);
+	m_gridValid = false;
+	return (unsigned int)m_pointSets.size() - 1;
+}
+
+void NeighborhoodSearch_CellGrid::resize_point_set(const unsigned int i, Real const *x, const std::size_t n)
+{
+	PointSet &ps = m_pointSets[i];
+	ps.m_x = x;
+	ps.m_n = n;
+	ps.m_neighborOffsets.assign(n + 1, 0);
+	ps.m_neighbors.clear();
+	ps.m_sortTable.clear();
+	m_gridValid = false;
+}
+
+void NeighborhoodSearch_CellGrid::cellCoordinates(const CellGrid &grid, Real const *x, int c[3])
+{
+	const Real invCellSize = 1.0 / grid.m_cellSize;
+	for (unsigned int d = 0; d < 3; d++)
+	{
+		const Real t = (x[d] - grid.m_min[d]) * invCellSize;
+		if (t >= (Real) grid.m_res[d])
+			c[d] = grid.m_res[d];
+		else if (t >= 0.0)
+			c[d] = (int)t;
+		else				// also catches NaN
+			c[d] = -1;
+	}
+}
+
+void NeighborhoodSearch_CellGrid::computeBoundingBox(const std::vector<unsigned int> &pointSetIndices, Vector3r &minX, Vector3r &maxX) const
+{
+	minX = Vector3r(REAL_MAX, REAL_MAX, REAL_MAX);
+	maxX = -minX;
+	for (unsigned int k = 0; k < pointSetIndices.size(); k++)
+	{
+		const PointSet &ps = m_pointSets[pointSetIndices[k]];
+		#pragma omp parallel default(shared)
+		{
+			Vector3r minLocal(REAL_MAX, REAL_MAX, REAL_MAX);
+			Vector3r maxLocal = -minLocal;
+			#pragma omp for schedule(static) nowait
+			for (int i = 0; i < (int)ps.m_n; i++)
+			{
+				const Eigen::Map<const Vector3r> xi(ps.point(i));
+				minLocal = minLocal.cwiseMin(xi);
+				maxLocal = maxLocal.cwiseMax(xi);
+			}
+			#pragma omp critical
+			{
+				minX = minX.cwiseMin(minLocal);
+				maxX = maxX.cwiseMax(maxLocal);
+			}
+		}
+	}
+}
+
+void NeighborhoodSearch_CellGrid::updateGrids(const bool pointsChanged)
+{
+	// static point sets which have been changed since the static grid was built
+	std::vector<std::pair<Real const*, std::size_t> > staticPointSets;
+	std::vector<unsigned int> staticIndices, dynamicIndices;
+	for (unsigned int s = 0; s < m_pointSets.size(); s++)
+	{
+		if (m_pointSets[s].m_dynamic)
+			dynamicIndices.push_back(s);
+		else
+		{
+			staticIndices.push_back(s);
+			staticPointSets.push_back(std::make_pair(m_pointSets[s].m_x, m_pointSets[s].m_n));
+		}
+	}
+
+	if (!m_staticGridValid || (staticIndices != m_staticGrid.m_pointSetIndices) || (staticPointSets != m_staticPointSets))
+	{
+		m_staticGrid.m_pointSetIndices = staticIndices;
+		m_staticPointSets = staticPointSets;
+		buildGrid(m_staticGrid);
+		m_staticGridValid = true;
+	}
+
+	if (pointsChanged || !m_gridValid || (dynamicIndices != m_dynamicGrid.m_pointSetIndices))
+	{
+		m_dynamicGrid.m_pointSetIndices = dynamicIndices;
+		buildGrid(m_dynamicGrid);
+		m_gridValid = true;
+	}
+}
+
+void NeighborhoodSearch_CellGrid::buildGrid(CellGrid &grid)
+{
+	const std::vector<unsigned int> &pointSetIndices = grid.m_pointSetIndices;
+
+	// index of the first point of each point set in the grid
+	std::vector<unsigned int> pointSetOffsets(pointSetIndices.size() + 1);
+	pointSetOffsets[0] = 0;
+	for (unsigned int k = 0; k < pointSetIndices.size(); k++)
+		pointSetOffsets[k + 1] = pointSetOffsets[k] + (unsigned int)m_pointSets[pointSetIndices[k]].m_n;
+	const unsigned int numPoints = pointSetOffsets.back();
+
+	Vector3r minX, maxX;
+	computeBoundingBox(pointSetIndices, minX, maxX);
+	if (numPoints == 0)
+	{
+		minX.setZero();
+		maxX.setZero();
+	}
+
+	// Choose the grid resolution. If single points are far away from the others, the grid would
+	// contain mostly empty cells. In this case the cell size is increased.
+	const std::uint64_t maxCells = std::max<std::uint64_t>(8 * (std::uint64_t)numPoints, 4096);
+	grid.m_cellSize = m_cellSizeFactor * m_radius;
+	std::uint64_t numCells = 0;
+	while (true)
+	{
+		numCells = 1;
+		for (unsigned int d = 0; d < 3; d++)
+		{
+			grid.m_res[d] = (int)std::min<Real>(std::floor((maxX[d] - minX[d]) / grid.m_cellSize) + 1.0, (Real)(1 << 21));
+			numCells *= (std::uint64_t)grid.m_res[d];
+		}
+		if (numCells <= maxCells)
+			break;
+		grid.m_cellSize *= 2.0;
+	}
+	grid.m_min = minX;
+	grid.m_searchRange = std::max(1, (int)std::ceil(m_radius / grid.m_cellSize - 1.0e-9));
+
+	const unsigned int nCells = (unsigned int)numCells;
+	if (m_cellCounterSize < nCells)
+	{
+		m_cellCounter.reset(new std::atomic<unsigned int>[nCells]);
+		m_cellCounterSize = nCells;
+	}
+	grid.m_pointCell.resize(numPoints);
+	grid.m_cellStart.resize(nCells + 1);
+	grid.m_points.resize(numPoints);
+	grid.m_positions.resize(numPoints);
+	m_threadOffsets.resize(getMaxThreads() + 1);
+
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)
+		for (int c = 0; c < (int)nCells; c++)
+			m_cellCounter[c].store(0, std::memory_order_relaxed);
+
+		// count points per cell
+		for (unsigned int k = 0; k < pointSetIndices.size(); k++)
+		{
+			const PointSet &ps = m_pointSets[pointSetIndices[k]];
+			const unsigned int offset = pointSetOffsets[k];
+			#pragma omp for schedule(static)
+			for (int i = 0; i < (int)ps.m_n; i++)
+			{
+				int c[3];
+				cellCoordinates(grid, ps.point(i), c);
+				for (unsigned int d = 0; d < 3; d++)
+					c[d] = std::min(std::max(c[d], 0), grid.m_res[d] - 1);
+				const unsigned int cell = c[0] + grid.m_res[0] * (c[1] + grid.m_res[1] * c[2]);
+				grid.m_pointCell[offset + i] = cell;
+				m_cellCounter[cell].fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		// exclusive prefix sum of the cell counts
+		unsigned int begin, end;
+		int tid, numThreads;
+		threadRange(nCells, begin, end, tid, numThreads);
+		unsigned int sum = 0;
+		for (unsigned int c = begin; c < end; c++)
+			sum += m_cellCounter[c].load(std::memory_order_relaxed);
+		m_threadOffsets[tid] = sum;
+		#pragma omp barrier
+
+		#pragma omp single
+		{
+			unsigned int offset = 0;
+			for (int t = 0; t < numThreads; t++)
+			{
+				const unsigned int n = m_threadOffsets[t];
+				m_threadOffsets[t] = offset;
+				offset += n;
+			}
+			grid.m_cellStart[nCells] = offset;
+		}
+
+		unsigned int running = m_threadOffsets[tid];
+		for (unsigned int c = begin; c < end; c++)
+		{
+			const unsigned int n = m_cellCounter[c].load(std::memory_order_relaxed);
+			grid.m_cellStart[c] = running;
+			m_cellCounter[c].store(running, std::memory_order_relaxed);
+			running += n;
+		}
+		#pragma omp barrier
+
+		// scatter the points into the cells
+		for (unsigned int k = 0; k < pointSetIndices.size(); k++)
+		{
+			const unsigned int offset = pointSetOffsets[k];
+			#pragma omp for schedule(static)
+			for (int i = 0; i < (int)m_pointSets[pointSetIndices[k]].m_n; i++)
+			{
+				const unsigned int pos = m_cellCounter[grid.m_pointCell[offset + i]].fetch_add(1, std::memory_order_relaxed);
+				grid.m_points[pos].point_set_id = pointSetIndices[k];
+				grid.m_points[pos].point_id = i;
+			}
+		}
+
+		// The order in a cell depends on the scheduling, sort it to get reproducible neighbor lists.
+		// Then copy the positions, so that a query reads the points of a cell row contiguously.
+		#pragma omp for schedule(static)
+		for (int c = 0; c < (int)nCells; c++)
+		{
+			const unsigned int cBegin = grid.m_cellStart[c];
+			const unsigned int cEnd = grid.m_cellStart[c + 1];
+			for (unsigned int j = cBegin + 1; j < cEnd; j++)
+			{
+				const PointID p = grid.m_points[j];
+				unsigned int k = j;
+				while ((k > cBegin) &&
+					((grid.m_points[k - 1].point_set_id > p.point_set_id) ||
+					((grid.m_points[k - 1].point_set_id == p.point_set_id) && (grid.m_points[k - 1].point_id > p.point_id))))
+				{
+					grid.m_points[k] = grid.m_points[k - 1];
+					k--;
+				}
+				grid.m_points[k] = p;
+			}
+			for (unsigned int j = cBegin; j < cEnd; j++)
+			{
+				const PointID &p = grid.m_points[j];
+				grid.m_positions[j] = Eigen::Map<const Vector3r>(m_pointSets[p.point_set_id].point(p.point_id));
+			}
+		}
+	}
+}
+
+void NeighborhoodSearch_CellGrid::queryGrid(const CellGrid &grid, const Vector3r &xi, const unsigned int pointSetIndex, const unsigned int pointIndex, std::vector<PointID> &neighbors) const
+{
+	if (grid.m_points.empty())
+		return;
+
+	const Real radius2 = m_radius * m_radius;
+	const int range = grid.m_searchRange;
+	int c[3];
+	cellCoordinates(grid, xi.data(), c);
+
+	const int xBegin = std::max(c[0] - range, 0);
+	const int xEnd = std::min(c[0] + range, grid.m_res[0] - 1);
+	const int yEnd = std::min(c[1] + range, grid.m_res[1] - 1);
+	const int zEnd = std::min(c[2] + range, grid.m_res[2] - 1);
+	if (xBegin > xEnd)
+		return;
+	for (int z = std::max(c[2] - range, 0); z <= zEnd; z++)
+	{
+		for (int y = std::max(c[1] - range, 0); y <= yEnd; y++)
+		{
+			// the cells of a row are contiguous in m_points
+			const unsigned int rowCell = grid.m_res[0] * (y + grid.m_res[1] * z);
+			const unsigned int pEnd = grid.m_cellStart[rowCell + xEnd + 1];
+			for (unsigned int p = grid.m_cellStart[rowCell + xBegin]; p < pEnd; p++)
+			{
+				if ((xi - grid.m_positions[p]).squaredNorm() < radius2)
+				{
+					const PointID &pid = grid.m_points[p];
+					if ((pid.point_id != pointIndex) || (pid.point_set_id != pointSetIndex))
+						neighbors.push_back(pid);
+				}
+			}
+		}
+	}
+}
+
+void NeighborhoodSearch_CellGrid::findNeighbors(const unsigned int pointSetIndex)
+{
+	PointSet &ps = m_pointSets[pointSetIndex];
+	const unsigned int numPoints = (unsigned int)ps.m_n;
+
+	ps.m_neighborOffsets.resize(numPoints + 1);
+	m_threadNeighbors.resize(getMaxThreads());
+	// the grids are not rebuilt in each search, so the number of threads may have changed since
+	m_threadOffsets.resize(getMaxThreads() + 1);
+
+	#pragma omp parallel default(shared)
+	{
+		unsigned int begin, end;
+		int tid, numThreads;
+		threadRange(numPoints, begin, end, tid, numThreads);
+
+		// collect the neighbors of a contiguous range of points in the buffer of the thread
+		std::vector<PointID> &neighbors = m_threadNeighbors[tid];
+		neighbors.clear();
+		for (unsigned int i = begin; i < end; i++)
+		{
+			ps.m_neighborOffsets[i] = (unsigned int)neighbors.size();
+			const Vector3r xi = Eigen::Map<const Vector3r>(ps.point(i));
+			queryGrid(m_dynamicGrid, xi, pointSetIndex, i, neighbors);
+			queryGrid(m_staticGrid, xi, pointSetIndex, i, neighbors);
+		}
+		m_threadOffsets[tid] = (unsigned int)neighbors.size();
+		#pragma omp barrier
+
+		#pragma omp single
+		{
+			unsigned int offset = 0;
+			for (int t = 0; t < numThreads; t++)
+			{
+				const unsigned int n = m_threadOffsets[t];
+				m_threadOffsets[t] = offset;
+				offset += n;
+			}
+			ps.m_neighbors.resize(offset);
+			ps.m_neighborOffsets[numPoints] = offset;
+		}
+
+		// copy the buffer to the neighbor array of the point set
+		const unsigned int offset = m_threadOffsets[tid];
+		for (unsigned int i = begin; i < end; i++)
+			ps.m_neighborOffsets[i] += offset;
+		std::copy(neighbors.begin(), neighbors.end(), ps.m_neighbors.begin() + offset);
+	}
+}
+
+void NeighborhoodSearch_CellGrid::find_neighbors(const bool pointsChanged)
+{
+	updateGrids(pointsChanged);
+
+	for (unsigned int s = 0; s < m_pointSets.size(); s++)
+	{
+		if (m_pointSets[s].m_searchNeighbors)
+			findNeighbors(s);
+	}
+}
+
+void NeighborhoodSearch_CellGrid::z_sort()
+{
+	updateGrids(true);
+
+	for (unsigned int s = 0; s < m_pointSets.size(); s++)
+	{
+		PointSet &ps = m_pointSets[s];
+		if (!ps.m_dynamic)
+		{
+			ps.m_sortTable.clear();
+			continue;
+		}
+
+		const int numPoints = (int)ps.m_n;
+		std::vector<std::uint64_t> keys(numPoints);
+		ps.m_sortTable.resize(numPoints);
+
+		#pragma omp parallel default(shared)
+		{
+			#pragma omp for schedule(static)
+			for (int i = 0; i < numPoints; i++)
+			{
+				int c[3];
+				cellCoordinates(m_dynamicGrid, ps.point(i), c);
+				keys[i] = spreadBits(std::max(c[0], 0)) | (spreadBits(std::max(c[1], 0)) << 1) | (spreadBits(std::max(c[2], 0)) << 2);
+				ps.m_sortTable[i] = i;
+			}
+		}
+
+		std::sort(ps.m_sortTable.begin(), ps.m_sortTable.end(),
+			[&keys](const unsigned int a, const unsigned int b) { return (keys[a] < keys[b]) || ((keys[a] == keys[b]) && (a < b)); });
+	}
+
+	// the point data is reordered after sorting
+	m_gridValid = false;
+}
+
+template<typename T>
+static std::size_t vectorBytes(const std::vector<T> &v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+std::size_t NeighborhoodSearch_CellGrid::memory_usage() const
+{
+	std::size_t bytes = 0;
+	for (unsigned int i = 0; i < m_pointSets.size(); i++)
+	{
+		const PointSet &ps = m_pointSets[i];
+		bytes += vectorBytes(ps.m_neighborOffsets) + vectorBytes(ps.m_neighbors) + vectorBytes(ps.m_sortTable);
+	}
+	const CellGrid *grids[2] = { &m_dynamicGrid, &m_staticGrid };
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		const CellGrid &grid = *grids[i];
+		bytes += vectorBytes(grid.m_pointSetIndices) + vectorBytes(grid.m_cellStart) + vectorBytes(grid.m_points)
+			+ vectorBytes(grid.m_positions) + vectorBytes(grid.m_pointCell);
+	}
+	bytes += m_cellCounterSize * sizeof(std::atomic<unsigned int>);
+	for (unsigned int i = 0; i < m_threadNeighbors.size(); i++)
+		bytes += vectorBytes(m_threadNeighbors[i]);
+	bytes += vectorBytes(m_threadOffsets);
+	return bytes;
+}
@@ -0,0 +1,173 @@
+#ifndef __NeighborhoodSearch_CellGrid_h__
+#define __NeighborhoodSearch_CellGrid_h__
+
+#include "SPlisHSPlasH/Common.h"
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace SPH
+{
+	/** \brief Parallel neighborhood search based on uniform cell grids.
+	*
+	* The particles of the dynamic point sets are sorted into the cells of a grid which covers their
+	* bounding box by a parallel counting sort in each search. The particles of static point sets
+	* are sorted into a second grid only once. The cell size is the search radius multiplied by a
+	* configurable factor. For each point of a point set with enabled neighborhood search all points
+	* of all point sets in the search radius are determined. The neighbors are stored in a compact
+	* array per point set. All buffers are reused in the next search.
+	*
+	* The class has the same interface as CompactNSearch::NeighborhoodSearch which is used by
+	* the fluid model.
+	*/
+	class NeighborhoodSearch_CellGrid
+	{
+	public:
+		/** \brief Identifier of a point: index of the point set and index of the point in the set.
+		*/
+		struct PointID
+		{
+			unsigned int point_set_id;
+			unsigned int point_id;
+		};
+
+		/** \brief Point set of the neighborhood search. The positions are not copied,
+		* the point set only stores a pointer to the position array (x0, y0, z0, x1, ...).
+		*/
+		class PointSet
+		{
+		public:
+			PointSet(Real const *x, const std::size_t n, const bool dynamic, const bool searchNeighbors) :
+				m_x(x), m_n(n), m_dynamic(dynamic), m_searchNeighbors(searchNeighbors) {}
+
+			std::size_t n_points() const { return m_n; }
+			Real const* GetPoints() const { return m_x; }
+			Real const* point(const unsigned int i) const { return &m_x[3 * i]; }
+
+			bool is_dynamic() const { return m_dynamic; }
+			void set_dynamic(const bool v) { m_dynamic = v; }
+
+			bool is_neighborsearch_enabled() const { return m_searchNeighbors; }
+			void enable_neighborsearch(const bool v) { m_searchNeighbors = v; }
+
+			FORCE_INLINE std::size_t n_neighbors(const unsigned int i) const
+			{
+				return m_neighborOffsets[i + 1] - m_neighborOffsets[i];
+			}
+
+			FORCE_INLINE const PointID& neighbor(const unsigned int i, const unsigned int k) const
+			{
+				return m_neighbors[m_neighborOffsets[i] + k];
+			}
+
+			/** Reorder the array lst according to the sort table of the last call of z_sort().
+			*/
+			template<typename T>
+			void sort_field(T *lst) const
+			{
+				if (m_sortTable.empty())
+					return;
+				std::vector<T> tmp(lst, lst + m_sortTable.size());
+				#pragma omp parallel default(shared)
+				{
+					#pragma omp for schedule(static)
+					for (int i = 0; i < (int)m_sortTable.size(); i++)
+						lst[i] = tmp[m_sortTable[i]];
+				}
+			}
+
+		protected:
+			friend class NeighborhoodSearch_CellGrid;
+
+			Real const *m_x;
+			std::size_t m_n;
+			bool m_dynamic;
+			bool m_searchNeighbors;
+			/** Start of the neighbors of each point in m_neighbors (size n + 1) */
+			std::vector<unsigned int> m_neighborOffsets;
+			std::vector<PointID> m_neighbors;
+			std::vector<unsigned int> m_sortTable;
+		};
+
+		NeighborhoodSearch_CellGrid(const Real radius, const Real cellSizeFactor = 1.0);
+		~NeighborhoodSearch_CellGrid();
+
+		Real radius() const { return m_radius; }
+		void set_radius(const Real radius);
+
+		/** The edge length of the grid cells is cellSizeFactor * radius. Factors smaller than one
+		* lead to more cells which are tested but the cells fit the search sphere more tightly. */
+		Real cell_size_factor() const { return m_cellSizeFactor; }
+		void set_cell_size_factor(const Real val);
+
+		unsigned int add_point_set(Real const *x, const std::size_t n, const bool isDynamic = true, const bool searchNeighbors = true);
+		void resize_point_set(const unsigned int i, Real const *x, const std::size_t n);
+
+		std::size_t n_point_sets() const { return m_pointSets.size(); }
+		const std::vector<PointSet>& point_sets() const { return m_pointSets; }
+		std::vector<PointSet>& point_sets() { return m_pointSets; }
+		const PointSet& point_set(const unsigned int i) const { return m_pointSets[i]; }
+		PointSet& point_set(const unsigned int i) { return m_pointSets[i]; }
+
+		/** Determine the neighbors of all points of the point sets with enabled neighborhood search.
+		* If pointsChanged is false, the cell grid of the last search is reused. */
+		void find_neighbors(const bool pointsChanged = true);
+
+		/** Compute a sort table for each dynamic point set which orders the points along a z-curve
+		* of the grid cells. The point data is reordered by PointSet::sort_field(). */
+		void z_sort();
+
+		/** Bytes of the neighbor lists, the sort tables, the grids and the thread buffers. */
+		std::size_t memory_usage() const;
+
+	protected:
+		/** \brief Uniform grid which contains the points of some point sets sorted by cell.
+		*/
+		struct CellGrid
+		{
+			Vector3r m_min;
+			Real m_cellSize;
+			int m_res[3];
+			int m_searchRange;
+			/** Point sets in the grid */
+			std::vector<unsigned int> m_pointSetIndices;
+			/** Start of each cell in m_points (size numCells + 1) */
+			std::vector<unsigned int> m_cellStart;
+			/** Points and a copy of their positions sorted by cell */
+			std::vector<PointID> m_points;
+			std::vector<Vector3r> m_positions;
+			/** Cell of each point of the point sets (only used while building the grid) */
+			std::vector<unsigned int> m_pointCell;
+		};
+
+		std::vector<PointSet> m_pointSets;
+		Real m_radius;
+		Real m_cellSizeFactor;
+
+		/** Grid of the dynamic point sets which is rebuilt in each search */
+		CellGrid m_dynamicGrid;
+		bool m_gridValid;
+		/** Grid of the static point sets (e.g. walls) which is only built once. The grid is rebuilt
+		* if a static point set is added or changed or if the radius is changed. */
+		CellGrid m_staticGrid;
+		bool m_staticGridValid;
+		/** Positions and sizes of the static point sets in the static grid */
+		std::vector<std::pair<Real const*, std::size_t> > m_staticPointSets;
+
+		std::unique_ptr<std::atomic<unsigned int>[]> m_cellCounter;
+		std::size_t m_cellCounterSize;
+		/** Neighbor buffers of the threads */
+		std::vector<std::vector<PointID> > m_threadNeighbors;
+		std::vector<unsigned int> m_threadOffsets;
+
+		void updateGrids(const bool pointsChanged);
+		void buildGrid(CellGrid &grid);
+		void computeBoundingBox(const std::vector<unsigned int> &pointSetIndices, Vector3r &minX, Vector3r &maxX) const;
+		void queryGrid(const CellGrid &grid, const Vector3r &xi, const unsigned int pointSetIndex, const unsigned int pointIndex, std::vector<PointID> &neighbors) const;
+		void findNeighbors(const unsigned int pointSetIndex);
+		static void cellCoordinates(const CellGrid &grid, Real const *x, int c[3]);
+	};
+}
+
+#endif
@@ -48,10 +48,16 @@ void SimulationDataPBF::performNeighborhoodSearchSort()
 	if (numPart == 0)
 		return;
 
-	auto const& d = m_model->getNeighborhoodSearch()->point_set(0);
-	d.sort_field(&m_lambda[0]);
-	d.sort_field(&m_deltaX[0]);
-	d.sort_field(&m_oldX[0]);
-	d.sort_field(&m_lastX[0]);
+	m_model->sortField(&m_lambda[0]);
+	m_model->sortField(&m_deltaX[0]);
+	m_model->sortField(&m_oldX[0]);
+	m_model->sortField(&m_lastX[0]);
 }
 
+void SimulationDataPBF::getMemoryUsage(MemoryUsage &usage) const
+{
+	usage.addFluidArray("PBF", m_lambda);
+	usage.addFluidArray("PBF", m_deltaX);
+	usage.addFluidArray("PBF", m_oldX);
+	usage.addFluidArray("PBF", m_lastX);
+}
@@ -19,10 +19,10 @@ namespace SPH
 		protected:	
 			FluidModel *m_model;
 
-			std::vector<Real> m_lambda;		
-			std::vector<Vector3r> m_deltaX;
-			std::vector<Vector3r> m_oldX;
-			std::vector<Vector3r> m_lastX;
+			ParticleVector<Real> m_lambda;		
+			ParticleVector<Vector3r> m_deltaX;
+			ParticleVector<Vector3r> m_oldX;
+			ParticleVector<Vector3r> m_lastX;
 
 		public:
 			/** Initialize the arrays containing the particle data.
@@ -38,10 +38,13 @@ namespace SPH
 			virtual void reset();
 
 			/** Important: First call m_model->performNeighborhoodSearchSort()
-			* to call the z_sort of the neighborhood search.
+			* to compute the new order of the particles.
 			*/
 			void performNeighborhoodSearchSort();
 
+			/** Add the memory of the particle data (see MemoryUsage). */
+			void getMemoryUsage(MemoryUsage &usage) const;
+
 			FORCE_INLINE const Real& getLambda(const unsigned int i) const
 			{
 				return m_lambda[i];
@@ -23,17 +23,18 @@ TimeStepPBF::~TimeStepPBF(void)
 
 void TimeStepPBF::step()
 {
-	TimeManager *tm = TimeManager::getCurrent ();
+	TimeManager *tm = m_model->getTimeManager();
 	const Real h = tm->getTimeStepSize();
 
-	clearAccelerations();
+	const Vector3r &grav = m_model->getGravitation();
 
-	// Time integration
+	// Time integration, the accelerations are cleared in the same loop
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
 		for (int i = 0; i < (int) m_model->numParticles(); i++)
 		{
+			clearAcceleration(i, grav);
 			m_simulationData.getDeltaX(i).setZero();
 			m_simulationData.getLastPosition(i) = m_simulationData.getOldPosition(i);
 			m_simulationData.getOldPosition(i) = m_model->getPosition(0, i);
@@ -79,13 +80,19 @@ void TimeStepPBF::step()
 	computeViscosity();
 	computeSurfaceTension();
 
+	// The max. velocity for the CFL condition is determined in the same loop
 	#pragma omp parallel default(shared)
 	{
-		#pragma omp for schedule(static)  
+		Real maxVelLocal = 0.0;
+		#pragma omp for schedule(static) nowait
 		for (int i = 0; i < (int)m_model->numParticles(); i++)
 		{
-			m_model->getVelocity(0, i) += h * m_model->getAcceleration(i);
+			Vector3r &vel = m_model->getVelocity(0, i);
+			const Vector3r &accel = m_model->getAcceleration(i);
+			vel += h * accel;
+			maxVelLocal = max(maxVelLocal, (vel + h * accel).squaredNorm());
 		}
+		updateMaxVelocity(maxVelLocal);
 	}
 
 	updateTimeStepSize();
@@ -102,6 +109,12 @@ void TimeStepPBF::reset()
 	m_counter = 0;
 }
 
+void TimeStepPBF::getMemoryUsage(MemoryUsage &usage) const
+{
+	TimeStep::getMemoryUsage(usage);
+	m_simulationData.getMemoryUsage(usage);
+}
+
 
 void TimeStepPBF::pressureSolve()
 {
@@ -109,117 +122,131 @@ void TimeStepPBF::pressureSolve()
 	const Real eps = 1.0e-6;
 
 	const unsigned int numParticles = m_model->numParticles();
-	const Real invH = 1.0 / TimeManager::getCurrent()->getTimeStepSize();
+	const Real invH = 1.0 / m_model->getTimeManager()->getTimeStepSize();
 	const Real invH2 = invH*invH;
 
 	const Real density0 = m_model->getDensity0();
 
-	const Real eta = m_maxError * 0.01 * density0;  // maxError is given in percent
+	const Real eta = m_maxError * m_toleranceScale * 0.01 * density0;  // maxError is given in percent
+	unsigned int maxIterations = m_maxIterations;
 
 	Real avg_density_err = 0.0;
-	while (((avg_density_err > eta) || (m_iterations < 2)) && (m_iterations < m_maxIterations))
-	{
-		avg_density_err = 0.0;
+	Real density_err_sum = 0.0;
 
-		#pragma omp parallel default(shared)
+	m_model->ensureThreadForceBuffers();
+
+	// All iterations of the solver are executed in a single parallel region
+	#pragma omp parallel default(shared)
+	{
+		// The loop condition is evaluated by all threads, the shared error, iteration 
+		// count and iteration limit are only changed in the single section at the end.
+		while (((avg_density_err > eta) || (m_iterations < 2)) && (m_iterations < maxIterations))
 		{
 			#pragma omp for schedule(static)  
-			for (int i = 0; i < (int) numParticles; i++)
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 			{
-				Real &density = m_model->getDensity(i);				
-
-				// Compute current density for particle i
-				density = m_model->getMass(i) * m_model->W_zero();
-				const Vector3r &xi = m_model->getPosition(0, i);
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)		// Test if fluid particle
-					{
-						density += m_model->getMass(neighborIndex) * m_model->W(xi - xj);
-					}
-					else 
-					{
-						// Boundary: Akinci2012
-						density += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->W(xi - xj);
-					}
-				}
-
-				const Real density_err = max(density, density0) - density0;
-				#pragma omp atomic
-				avg_density_err += density_err / numParticles;
-
-				// Evaluate constraint function
-				const Real C = std::max(density / density0 - 1.0, 0.0);			// clamp to prevent particle clumping at surface
-
-				if (C != 0.0)
-				{
-					// Compute gradients dC/dx_j 
-					Real sum_grad_C2 = 0.0;
-					Vector3r gradC_i(0.0, 0.0, 0.0);
+					Real &density = m_model->getDensity(i);				
 
+					// Compute current density for particle i
+					density = m_model->getMass(i) * m_model->W_zero();
+					const Vector3r &xi = m_model->getPosition(0, i);
 					for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 					{
-						const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
+						const PointID &particleId = m_model->getNeighbor(i, j);
 						const unsigned int &neighborIndex = particleId.point_id;
 						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
 
 						if (particleId.point_set_id == 0)		// Test if fluid particle
 						{
-							const Vector3r gradC_j = -m_model->getMass(neighborIndex) / density0 * m_model->gradW(xi - xj);
-							sum_grad_C2 += gradC_j.squaredNorm();
-							gradC_i -= gradC_j;
+							density += m_model->getMass(neighborIndex) * m_model->W(xi - xj);
 						}
-						else
+						else 
 						{
 							// Boundary: Akinci2012
-							const Vector3r gradC_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * m_model->gradW(xi - xj);
-							sum_grad_C2 += gradC_j.squaredNorm();
-							gradC_i -= gradC_j;
+							density += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->W(xi - xj);
 						}
 					}
 
-					sum_grad_C2 += gradC_i.squaredNorm();
+					const Real density_err = max(density, density0) - density0;
+					#pragma omp atomic
+					density_err_sum += density_err / numParticles;
+
+					// Evaluate constraint function
+					const Real C = std::max(density / density0 - 1.0, 0.0);			// clamp to prevent particle clumping at surface
+
+					if (C != 0.0)
+					{
+						// Compute gradients dC/dx_j 
+						Real sum_grad_C2 = 0.0;
+						Vector3r gradC_i(0.0, 0.0, 0.0);
 
-					// Compute lambda
-					Real &lambda = m_simulationData.getLambda(i);
-					lambda = -C / (sum_grad_C2 + eps);
+						for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+						{
+							const PointID &particleId = m_model->getNeighbor(i, j);
+							const unsigned int &neighborIndex = particleId.point_id;
+							const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+							if (particleId.point_set_id == 0)		// Test if fluid particle
+							{
+								const Vector3r gradC_j = -m_model->getMass(neighborIndex) / density0 * m_model->gradW(xi - xj);
+								sum_grad_C2 += gradC_j.squaredNorm();
+								gradC_i -= gradC_j;
+							}
+							else
+							{
+								// Boundary: Akinci2012
+								const Vector3r gradC_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * m_model->gradW(xi - xj);
+								sum_grad_C2 += gradC_j.squaredNorm();
+								gradC_i -= gradC_j;
+							}
+						}
+
+						sum_grad_C2 += gradC_i.squaredNorm();
+
+						// Compute lambda
+						Real &lambda = m_simulationData.getLambda(i);
+						lambda = -C / (sum_grad_C2 + eps);
+					}
+					else
+						m_simulationData.getLambda(i) = 0.0;
 				}
-				else
-					m_simulationData.getLambda(i) = 0.0;
 			}
 
 
 			#pragma omp for schedule(static)  
-			for (int i = 0; i < (int)numParticles; i++)
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 			{
-				Vector3r &corr = m_simulationData.getDeltaX(i);
-				
-				// Compute position correction
-				corr.setZero();
-				const Vector3r &xi = m_model->getPosition(0, i);
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)		// Test if fluid particle
-					{
-						const Vector3r gradC_j = -m_model->getMass(neighborIndex) / density0 * m_model->gradW(xi - xj);
-						corr -= (m_simulationData.getLambda(i) + m_simulationData.getLambda(neighborIndex)) * gradC_j;
-					}
-					else 
+					Vector3r &corr = m_simulationData.getDeltaX(i);
+				
+					// Compute position correction
+					corr.setZero();
+					const Vector3r &xi = m_model->getPosition(0, i);
+					for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 					{
-						// Boundary: Akinci2012
-						const Vector3r gradC_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * m_model->gradW(xi - xj);
-						const Vector3r dx = 2.0 * m_simulationData.getLambda(i) * gradC_j;
-						corr -= dx;
+						const PointID &particleId = m_model->getNeighbor(i, j);
+						const unsigned int &neighborIndex = particleId.point_id;
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+						if (particleId.point_set_id == 0)		// Test if fluid particle
+						{
+							const Vector3r gradC_j = -m_model->getMass(neighborIndex) / density0 * m_model->gradW(xi - xj);
+							corr -= (m_simulationData.getLambda(i) + m_simulationData.getLambda(neighborIndex)) * gradC_j;
+						}
+						else 
+						{
+							// Boundary: Akinci2012
+							const Vector3r gradC_j = -m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * m_model->gradW(xi - xj);
+							const Vector3r dx = 2.0 * m_simulationData.getLambda(i) * gradC_j;
+							corr -= dx;
 
-						m_model->getForce(particleId.point_set_id, neighborIndex) += m_model->getMass(i) * dx * invH2;
+							m_model->addForce(particleId.point_set_id, neighborIndex, m_model->getMass(i) * dx * invH2);
+						}
 					}
 				}
 			}
@@ -229,10 +256,19 @@ void TimeStepPBF::pressureSolve()
 			{
 				m_model->getPosition(0, i) += m_simulationData.getDeltaX(i);
 			}
-		}
 
-		m_iterations++;
+			#pragma omp single
+			{
+				avg_density_err = density_err_sum;
+				density_err_sum = 0.0;
+				m_iterations++;
+				checkDeadline(m_iterations, 2, avg_density_err <= eta, maxIterations);
+			}
+		}
 	}
+	m_densityError = avg_density_err / density0 * 100.0;
+
+	m_model->reduceBoundaryForces();
 }
 
 void TimeStepPBF::performNeighborhoodSearch()
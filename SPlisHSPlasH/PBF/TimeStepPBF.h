@@ -39,6 +39,7 @@ namespace SPH
 
 		/** Reset the simulation method. */
 		virtual void reset();
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 	};
 }
 
@@ -32,7 +32,7 @@ void SimulationDataPCISPH::init(FluidModel *model)
 
 	// Find prototype particle
 	// => particle with max. fluid neighbors
-	const Real h = TimeManager::getCurrent()->getTimeStepSize();
+	const Real h = m_model->getTimeManager()->getTimeStepSize();
 	const Real h2 = h*h;
 	const Real density0 = m_model->getDensity0();
 	unsigned int index = 0;
@@ -47,7 +47,7 @@ void SimulationDataPCISPH::init(FluidModel *model)
 			unsigned int counter = 0;
 			for (unsigned int j = 0; j < model->numberOfNeighbors(i); j++)
 			{
-				const CompactNSearch::PointID &particleId = model->getNeighbor(i, j);
+				const PointID &particleId = model->getNeighbor(i, j);
 				if (particleId.point_set_id == 0)
 					counter++;
 			}
@@ -64,7 +64,7 @@ void SimulationDataPCISPH::init(FluidModel *model)
 	const Vector3r &xi = model->getPosition(0, index);
 	for (unsigned int j = 0; j < model->numberOfNeighbors(index); j++)
 	{
-		const CompactNSearch::PointID &particleId = model->getNeighbor(index, j);
+		const PointID &particleId = model->getNeighbor(index, j);
 		if (particleId.point_set_id == 0)
 		{
 			const unsigned int &neighborIndex = particleId.point_id;
@@ -99,10 +99,18 @@ void SimulationDataPCISPH::performNeighborhoodSearchSort()
 	if (numPart == 0)
 		return;
 
-	auto const& d = m_model->getNeighborhoodSearch()->point_set(0);
-	d.sort_field(&m_lastX[0]);
-	d.sort_field(&m_lastV[0]);
-	d.sort_field(&m_densityAdv[0]);
-	d.sort_field(&m_pressure[0]);
-	d.sort_field(&m_pressureAccel[0]);
+	m_model->sortField(&m_lastX[0]);
+	m_model->sortField(&m_lastV[0]);
+	m_model->sortField(&m_densityAdv[0]);
+	m_model->sortField(&m_pressure[0]);
+	m_model->sortField(&m_pressureAccel[0]);
+}
+
+void SimulationDataPCISPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	usage.addFluidArray("PCISPH", m_lastX);
+	usage.addFluidArray("PCISPH", m_lastV);
+	usage.addFluidArray("PCISPH", m_densityAdv);
+	usage.addFluidArray("PCISPH", m_pressure);
+	usage.addFluidArray("PCISPH", m_pressureAccel);
 }
@@ -20,11 +20,11 @@ namespace SPH
 			FluidModel *m_model;
 			Real m_pcisph_factor;
 
-			std::vector<Vector3r> m_lastX;
-			std::vector<Vector3r> m_lastV;
-			std::vector<Real> m_densityAdv;
-			std::vector<Real> m_pressure;
-			std::vector<Vector3r> m_pressureAccel;
+			ParticleVector<Vector3r> m_lastX;
+			ParticleVector<Vector3r> m_lastV;
+			ParticleVector<Real> m_densityAdv;
+			ParticleVector<Real> m_pressure;
+			ParticleVector<Vector3r> m_pressureAccel;
 
 		public:
 			/** Initialize the arrays containing the particle data.
@@ -40,10 +40,13 @@ namespace SPH
 			virtual void reset();
 
 			/** Important: First call m_model->performNeighborhoodSearchSort() 
-			 * to call the z_sort of the neighborhood search.
+			 * to compute the new order of the particles.
 			 */
 			void performNeighborhoodSearchSort();
 
+			/** Add the memory of the particle data (see MemoryUsage). */
+			void getMemoryUsage(MemoryUsage &usage) const;
+
 			Real getPCISPH_ScalingFactor() { return m_pcisph_factor; }
 
 
@@ -23,14 +23,14 @@ TimeStepPCISPH::~TimeStepPCISPH(void)
 void TimeStepPCISPH::step()
 {
 	const int numParticles = (int)m_model->numParticles();
-	TimeManager *tm = TimeManager::getCurrent();
+	TimeManager *tm = m_model->getTimeManager();
 	const Real h = tm->getTimeStepSize();
 
 	performNeighborhoodSearch();
 
 	// Compute accelerations: a(t)
-	clearAccelerations();
-	computeDensities();
+	// the accelerations are cleared in the density loop
+	computeDensities(true);
 	computeViscosity();
 	computeSurfaceTension();
 
@@ -63,32 +63,38 @@ void TimeStepPCISPH::pressureSolve()
 {
 	const int numParticles = (int)m_model->numParticles();
 	const Real density0 = m_model->getDensity0();
-	const Real h = TimeManager::getCurrent()->getTimeStepSize();
+	const Real h = m_model->getTimeManager()->getTimeStepSize();
 	const Real h2 = h*h;
 	const Real invH2 = 1.0 / h2;
 
-	// Initialization
-	for (int i = 0; i <numParticles; i++)
-	{
-		Vector3r &lastX = m_simulationData.getLastPosition(i);
-		Vector3r &lastV = m_simulationData.getLastVelocity(i);
-		lastX = m_model->getPosition(0, i);
-		lastV = m_model->getVelocity(0, i);
-		m_simulationData.getPressure(i) = 0.0;
-		m_simulationData.getPressureAccel(i).setZero();
-	}
-
 	Real avg_density_err = 0;
+	Real density_err_sum = 0.0;
 	m_iterations = 0;
 
 	// Maximal allowed density fluctuation
-	const Real eta = m_maxError * 0.01 * density0;  // maxError is given in percent
+	const Real eta = m_maxError * m_toleranceScale * 0.01 * density0;  // maxError is given in percent
+	unsigned int maxIterations = m_maxIterations;
 
-	while (((avg_density_err > eta) || (m_iterations < 3)) && (m_iterations < m_maxIterations))
+	m_model->ensureThreadForceBuffers();
+
+	// All phases of the solver are executed in a single parallel region
+	#pragma omp parallel default(shared)
 	{
-		avg_density_err = 0.0;
+		// Initialization
+		#pragma omp for schedule(static)  
+		for (int i = 0; i < numParticles; i++)
+		{
+			Vector3r &lastX = m_simulationData.getLastPosition(i);
+			Vector3r &lastV = m_simulationData.getLastVelocity(i);
+			lastX = m_model->getPosition(0, i);
+			lastV = m_model->getVelocity(0, i);
+			m_simulationData.getPressure(i) = 0.0;
+			m_simulationData.getPressureAccel(i).setZero();
+		}
 
-		#pragma omp parallel default(shared)
+		// The loop condition is evaluated by all threads, the shared error, iteration 
+		// count and iteration limit are only changed in the single section at the end.
+		while (((avg_density_err > eta) || (m_iterations < 3)) && (m_iterations < maxIterations))
 		{
 			#pragma omp for schedule(static)  
 			for (int i = 0; i < numParticles; i++)
@@ -101,89 +107,93 @@ void TimeStepPCISPH::pressureSolve()
 				v = lastV + h*accel;
 				x = lastX + h*v;
 			}
-		}
 
-
-		// Predict density 
-		#pragma omp parallel default(shared)
-		{
+			// Predict density 
 			#pragma omp for schedule(static)  
-			for (int i = 0; i < numParticles; i++)
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 			{
-				const Vector3r &xi = m_model->getPosition(0, i);
-				Real &densityAdv = m_simulationData.getDensityAdv(i);
-				densityAdv = m_model->getMass(i) * m_model->W_zero();
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-					if (particleId.point_set_id == 0)
-					{
-						densityAdv += m_model->getMass(neighborIndex) * m_model->W(xi - xj);
-					}
-					else
+					const Vector3r &xi = m_model->getPosition(0, i);
+					Real &densityAdv = m_simulationData.getDensityAdv(i);
+					densityAdv = m_model->getMass(i) * m_model->W_zero();
+					for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 					{
-						densityAdv += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->W(xi - xj);
+						const PointID &particleId = m_model->getNeighbor(i, j);
+						const unsigned int &neighborIndex = particleId.point_id;
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+
+						if (particleId.point_set_id == 0)
+						{
+							densityAdv += m_model->getMass(neighborIndex) * m_model->W(xi - xj);
+						}
+						else
+						{
+							densityAdv += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->W(xi - xj);
+						}
 					}
-				}
 
-				densityAdv = max(densityAdv, density0);
-				const Real density_err = densityAdv - density0;
-				Real &pressure = m_simulationData.getPressure(i);
-				pressure += invH2 * m_simulationData.getPCISPH_ScalingFactor() * density_err;
+					densityAdv = max(densityAdv, density0);
+					const Real density_err = densityAdv - density0;
+					Real &pressure = m_simulationData.getPressure(i);
+					pressure += invH2 * m_simulationData.getPCISPH_ScalingFactor() * density_err;
 
-				#pragma omp atomic
-				avg_density_err += density_err;
+					#pragma omp atomic
+					density_err_sum += density_err;
+				}
 			}
-		}
-
-		avg_density_err /= numParticles;
 
-		// Compute pressure forces
-		#pragma omp parallel default(shared)
-		{
+			// Compute pressure forces
 			#pragma omp for schedule(static)  
-			for (int i = 0; i < (int)numParticles; i++)
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 			{
-				const Vector3r &xi = m_simulationData.getLastPosition(i);
-
-				Vector3r &ai = m_simulationData.getPressureAccel(i);
-				ai.setZero();
-
-				const Real dpi = m_simulationData.getPressure(i) / (density0*density0);
-				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 				{
-					const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xi = m_simulationData.getLastPosition(i);
 
-					if (particleId.point_set_id == 0)
-					{
-						// Pressure 
-						const Real dpj = m_simulationData.getPressure(neighborIndex) / (density0*density0);
-						const Vector3r &xj = m_simulationData.getLastPosition(neighborIndex);
-						ai -= m_model->getMass(neighborIndex) * (dpi + dpj) * m_model->gradW(xi - xj);
-					}
-					else
-					{
-						// Pressure 
-						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-						const Vector3r a = m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dpi)* m_model->gradW(xi - xj);
-						ai -= a;
+					Vector3r &ai = m_simulationData.getPressureAccel(i);
+					ai.setZero();
 
-						m_model->getForce(particleId.point_set_id, neighborIndex) += m_model->getMass(i) * a;
+					const Real dpi = m_simulationData.getPressure(i) / (density0*density0);
+					for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+					{
+						const PointID &particleId = m_model->getNeighbor(i, j);
+						const unsigned int &neighborIndex = particleId.point_id;
+
+						if (particleId.point_set_id == 0)
+						{
+							// Pressure 
+							const Real dpj = m_simulationData.getPressure(neighborIndex) / (density0*density0);
+							const Vector3r &xj = m_simulationData.getLastPosition(neighborIndex);
+							ai -= m_model->getMass(neighborIndex) * (dpi + dpj) * m_model->gradW(xi - xj);
+						}
+						else
+						{
+							// Pressure 
+							const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+							const Vector3r a = m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dpi)* m_model->gradW(xi - xj);
+							ai -= a;
+
+							m_model->addForce(particleId.point_set_id, neighborIndex, m_model->getMass(i) * a);
+						}
 					}
 				}
 			}
-		}
-
-
-		if (m_iterations > m_maxIterations)
-			break;
 
-		m_iterations++;
+			#pragma omp single
+			{
+				avg_density_err = density_err_sum / numParticles;
+				density_err_sum = 0.0;
+				m_iterations++;
+				checkDeadline(m_iterations, 3, avg_density_err <= eta, maxIterations);
+			}
+		}
 	}
+	m_densityError = avg_density_err / density0 * 100.0;
+
+	m_model->reduceBoundaryForces();
 }
 
 
@@ -194,6 +204,12 @@ void TimeStepPCISPH::reset()
 	m_counter = 0;
 }
 
+void TimeStepPCISPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	TimeStep::getMemoryUsage(usage);
+	m_simulationData.getMemoryUsage(usage);
+}
+
 void TimeStepPCISPH::performNeighborhoodSearch()
 {
 	const unsigned int numParticles = m_model->numParticles();
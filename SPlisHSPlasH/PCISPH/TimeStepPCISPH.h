@@ -30,6 +30,7 @@ namespace SPH
 
 		virtual void step();
 		virtual void reset();
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 	};
 }
 
@@ -0,0 +1,246 @@
+#include "ParticleTiles.h"
+#include "FluidModel.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace SPH;
+
+PointID ParticleTiles::Tile::getPointID(const unsigned int l) const
+{
+	if (l < m_particles.size())
+	{
+		PointID id;
+		id.point_set_id = 0;
+		id.point_id = m_particles[l];
+		return id;
+	}
+	return m_halo[l - m_particles.size()];
+}
+
+ParticleTiles::ParticleTiles()
+{
+	m_cacheSize = 256 * 1024;
+	m_valid = false;
+	m_tileChunks.resize(2, 0);
+}
+
+size_t ParticleTiles::getMemoryUsage() const
+{
+	size_t bytes = m_tiles.capacity() * sizeof(Tile) + m_blocks.capacity() * sizeof(Block);
+	for (unsigned int t = 0; t < m_tiles.size(); t++)
+	{
+		const Tile &tile = m_tiles[t];
+		bytes += tile.m_particles.capacity() * sizeof(unsigned int) + tile.m_halo.capacity() * sizeof(PointID)
+			+ tile.m_neighborOffsets.capacity() * sizeof(unsigned int) + tile.m_neighbors.capacity() * sizeof(unsigned int);
+	}
+	for (unsigned int b = 0; b < m_blocks.size(); b++)
+	{
+		const Block &block = m_blocks[b];
+		bytes += (block.m_x.capacity() + block.m_v.capacity()) * sizeof(Vector3r) + (block.m_weight.capacity() + block.m_value.capacity()) * sizeof(Real);
+	}
+	bytes += (m_tileChunks.capacity() + m_tileIndex.capacity() + m_localIndex.capacity()) * sizeof(unsigned int);
+	return bytes;
+}
+
+unsigned int ParticleTiles::computeTileSize(const FluidModel *model) const
+{
+	// A block entry has a position, a velocity, a weight and a value. At rest density there
+	// are (supportRadius / particleDiameter)^3 particles in a cube with edge length supportRadius.
+	// A tile with edge length s*supportRadius has a halo of one support radius on each side.
+	const Real bytesPerPoint = 2 * sizeof(Vector3r) + 2 * sizeof(Real);
+	const Real particlesPerCell = pow(model->getSupportRadius() / (2.0 * model->getParticleRadius()), 3);
+	const Real maxCellsPerBlock = (Real)m_cacheSize / (bytesPerPoint * particlesPerCell);
+	const int tileSize = (int)floor(cbrt(maxCellsPerBlock)) - 2;
+	return (unsigned int)std::max(1, tileSize);
+}
+
+void ParticleTiles::update(FluidModel *model)
+{
+	const unsigned int numParticles = model->numParticles();
+#ifdef _OPENMP
+	const unsigned int numChunks = (unsigned int)omp_get_max_threads();
+#else
+	const unsigned int numChunks = 1;
+#endif
+	ensureBlocks();
+
+	//////////////////////////////////////////////////////////////////////////
+	// Sort the particles by their tile. Within a tile the particles keep
+	// their order, i.e. the locality of the last z-sort.
+	//////////////////////////////////////////////////////////////////////////
+	const Real invTileLength = 1.0 / (computeTileSize(model) * model->getSupportRadius());
+	std::vector<std::pair<std::uint64_t, unsigned int> > keys(numParticles);
+
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)
+		for (int i = 0; i < (int)numParticles; i++)
+		{
+			const Vector3r &xi = model->getPosition(0, i);
+			std::uint64_t key = 0;
+			for (unsigned int d = 0; d < 3; d++)
+			{
+				const std::int64_t c = (std::int64_t)floor(xi[d] * invTileLength) + (1 << 20);
+				key = (key << 21) | ((std::uint64_t)c & 0x1fffff);
+			}
+			keys[i] = std::make_pair(key, (unsigned int)i);
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+
+	m_tileIndex.resize(numParticles);
+	m_localIndex.resize(numParticles);
+	unsigned int numTiles = 0;
+	for (unsigned int k = 0; k < numParticles; k++)
+	{
+		if ((k == 0) || (keys[k].first != keys[k - 1].first))
+			numTiles++;
+	}
+	m_tiles.resize(numTiles);
+	for (unsigned int t = 0; t < numTiles; t++)
+		m_tiles[t].m_particles.clear();
+	for (unsigned int k = 0, t = 0; k < numParticles; k++)
+	{
+		if ((k > 0) && (keys[k].first != keys[k - 1].first))
+			t++;
+		const unsigned int i = keys[k].second;
+		m_tileIndex[i] = t;
+		m_localIndex[i] = m_tiles[t].numberOfParticles();
+		m_tiles[t].m_particles.push_back(i);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Local neighbor lists: neighbors in the same tile use their local index,
+	// all other neighbors are appended to the halo of the tile once.
+	//////////////////////////////////////////////////////////////////////////
+	#pragma omp parallel default(shared)
+	{
+		std::unordered_map<std::uint64_t, unsigned int> haloIndex;
+
+		#pragma omp for schedule(static)
+		for (int t = 0; t < (int)numTiles; t++)
+		{
+			Tile &tile = m_tiles[t];
+			const unsigned int numTileParticles = tile.numberOfParticles();
+			haloIndex.clear();
+			tile.m_halo.clear();
+			tile.m_neighbors.clear();
+			tile.m_neighborOffsets.resize(numTileParticles + 1);
+			for (unsigned int l = 0; l < numTileParticles; l++)
+			{
+				const unsigned int i = tile.m_particles[l];
+				tile.m_neighborOffsets[l] = (unsigned int)tile.m_neighbors.size();
+				for (unsigned int k = 0; k < model->numberOfNeighbors(i); k++)
+				{
+					const PointID &particleId = model->getNeighbor(i, k);
+					if ((particleId.point_set_id == 0) && (m_tileIndex[particleId.point_id] == (unsigned int)t))
+						tile.m_neighbors.push_back(m_localIndex[particleId.point_id]);
+					else
+					{
+						const std::uint64_t key = ((std::uint64_t)particleId.point_set_id << 32) | particleId.point_id;
+						const auto res = haloIndex.insert(std::make_pair(key, numTileParticles + (unsigned int)tile.m_halo.size()));
+						if (res.second)
+							tile.m_halo.push_back(particleId);
+						tile.m_neighbors.push_back(res.first->second);
+					}
+				}
+			}
+			tile.m_neighborOffsets[numTileParticles] = (unsigned int)tile.m_neighbors.size();
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// One chunk of consecutive tiles per thread with about the same number
+	// of neighbors (see FluidModel::updateParticleChunks())
+	//////////////////////////////////////////////////////////////////////////
+	m_tileChunks.resize(numChunks + 1);
+	m_tileChunks[0] = 0;
+	m_tileChunks[numChunks] = numTiles;
+	unsigned long long total = 0;
+	for (unsigned int t = 0; t < numTiles; t++)
+		total += m_tiles[t].m_neighbors.size() + m_tiles[t].numberOfParticles();
+
+	unsigned long long sum = 0;
+	unsigned int chunk = 1;
+	for (unsigned int t = 0; (t < numTiles) && (chunk < numChunks); t++)
+	{
+		sum += m_tiles[t].m_neighbors.size() + m_tiles[t].numberOfParticles();
+		while ((chunk < numChunks) && (sum * numChunks >= total * chunk))
+			m_tileChunks[chunk++] = t + 1;
+	}
+	for (; chunk < numChunks; chunk++)
+		m_tileChunks[chunk] = numTiles;
+
+	m_valid = true;
+}
+
+void ParticleTiles::ensureBlocks()
+{
+#ifdef _OPENMP
+	const unsigned int numThreads = (unsigned int)omp_get_max_threads();
+#else
+	const unsigned int numThreads = 1;
+#endif
+	if (m_blocks.size() < numThreads)
+		m_blocks.resize(numThreads);
+}
+
+ParticleTiles::Block& ParticleTiles::getBlock()
+{
+#ifdef _OPENMP
+	const unsigned int t = (unsigned int)omp_get_thread_num();
+	assert(t < m_blocks.size());
+	return m_blocks[t];
+#else
+	return m_blocks[0];
+#endif
+}
+
+void ParticleTiles::gatherPositions(FluidModel *model, const Tile &tile, Block &block)
+{
+	const unsigned int numTileParticles = tile.numberOfParticles();
+	const unsigned int numLocalPoints = tile.numberOfLocalPoints();
+	if (block.m_x.size() < numLocalPoints)
+	{
+		block.m_x.resize(numLocalPoints);
+		block.m_weight.resize(numLocalPoints);
+	}
+	for (unsigned int l = 0; l < numTileParticles; l++)
+	{
+		const unsigned int i = tile.m_particles[l];
+		block.m_x[l] = model->getPosition(0, i);
+		block.m_weight[l] = model->getMass(i);
+	}
+	for (unsigned int l = numTileParticles; l < numLocalPoints; l++)
+	{
+		const PointID &particleId = tile.m_halo[l - numTileParticles];
+		block.m_x[l] = model->getPosition(particleId.point_set_id, particleId.point_id);
+		if (particleId.point_set_id == 0)
+			block.m_weight[l] = model->getMass(particleId.point_id);
+		else
+			block.m_weight[l] = model->getBoundaryPsi(particleId.point_set_id, particleId.point_id);
+	}
+}
+
+void ParticleTiles::gatherVelocities(FluidModel *model, const Tile &tile, Block &block)
+{
+	const unsigned int numTileParticles = tile.numberOfParticles();
+	const unsigned int numLocalPoints = tile.numberOfLocalPoints();
+	if (block.m_v.size() < numLocalPoints)
+		block.m_v.resize(numLocalPoints);
+	for (unsigned int l = 0; l < numTileParticles; l++)
+		block.m_v[l] = model->getVelocity(0, tile.m_particles[l]);
+	for (unsigned int l = numTileParticles; l < numLocalPoints; l++)
+	{
+		const PointID &particleId = tile.m_halo[l - numTileParticles];
+		block.m_v[l] = model->getVelocity(particleId.point_set_id, particleId.point_id);
+	}
+}
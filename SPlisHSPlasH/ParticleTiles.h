@@ -0,0 +1,132 @@
+#ifndef __ParticleTiles_h__
+#define __ParticleTiles_h__
+
+#include "Common.h"
+#include "NeighborhoodSearch.h"
+#include <vector>
+
+namespace SPH
+{
+	class FluidModel;
+
+	/** \brief Spatial tiles of the fluid particles for cache blocked neighbor loops.
+	*
+	* The fluid particles are grouped into cubic tiles of several grid cells. The particles of a
+	* tile and all their neighbors (halo) get consecutive local indices and the neighbor lists of
+	* a tile are stored with these local indices. A neighbor loop over a tile first gathers the
+	* required particle data into a small contiguous block (see Block) and then only works on this
+	* block. The tile size is chosen so that the block of a tile fits into the given cache size.
+	*
+	* The order of the neighbors of a particle is the same as in the neighborhood search, so a tiled
+	* loop computes the same sums as the corresponding loop over the neighbor lists.
+	*/
+	class ParticleTiles
+	{
+	public:
+		/** \brief Particles and local neighbor lists of a tile.
+		* Local index l < numberOfParticles() is the fluid particle getParticleIndex(l) of the tile,
+		* the following local indices are the halo points.
+		*/
+		struct Tile
+		{
+			std::vector<unsigned int> m_particles;
+			std::vector<PointID> m_halo;
+			std::vector<unsigned int> m_neighborOffsets;
+			std::vector<unsigned int> m_neighbors;
+
+			unsigned int numberOfParticles() const { return static_cast<unsigned int>(m_particles.size()); }
+			unsigned int numberOfLocalPoints() const { return static_cast<unsigned int>(m_particles.size() + m_halo.size()); }
+			unsigned int getParticleIndex(const unsigned int l) const { return m_particles[l]; }
+			FORCE_INLINE unsigned int numberOfNeighbors(const unsigned int l) const { return m_neighborOffsets[l + 1] - m_neighborOffsets[l]; }
+			FORCE_INLINE unsigned int getNeighbor(const unsigned int l, const unsigned int k) const { return m_neighbors[m_neighborOffsets[l] + k]; }
+			/** Return true if the local point is a fluid particle. */
+			FORCE_INLINE bool isFluid(const unsigned int l) const { return (l < m_particles.size()) || (m_halo[l - m_particles.size()].point_set_id == 0); }
+			/** Return the point ID of a local point in the neighborhood search. */
+			PointID getPointID(const unsigned int l) const;
+		};
+
+		/** \brief Scratch block of a thread which holds the gathered data of a tile.
+		* The entries are indexed by the local indices of the tile.
+		*/
+		struct Block
+		{
+			std::vector<Vector3r> m_x;
+			std::vector<Vector3r> m_v;
+			/** Mass of fluid particles, boundary psi of boundary particles */
+			std::vector<Real> m_weight;
+			/** Solver specific value of the fluid particles */
+			std::vector<Real> m_value;
+		};
+
+	protected:
+		size_t m_cacheSize;
+		bool m_valid;
+		std::vector<Tile> m_tiles;
+		/** First tile of each chunk, one chunk per thread */
+		std::vector<unsigned int> m_tileChunks;
+		std::vector<Block> m_blocks;
+		/** Tile and local index of each fluid particle */
+		std::vector<unsigned int> m_tileIndex;
+		std::vector<unsigned int> m_localIndex;
+
+		unsigned int computeTileSize(const FluidModel *model) const;
+
+	public:
+		ParticleTiles();
+
+		/** Cache size in bytes which the block of a tile should fit into (default 256 KB, i.e. a typical L2 cache). */
+		size_t getCacheSize() const { return m_cacheSize; }
+		void setCacheSize(const size_t val) { m_cacheSize = val; m_valid = false; }
+
+		bool isValid() const { return m_valid; }
+		void invalidate() { m_valid = false; }
+
+		/** Bytes of the tiles and the scratch blocks. */
+		size_t getMemoryUsage() const;
+
+		/** Build the tiles from the current neighbor lists of the fluid particles and distribute
+		* them over one chunk per thread with about the same number of neighbors.
+		*/
+		void update(FluidModel *model);
+
+		unsigned int numberOfTiles() const { return static_cast<unsigned int>(m_tiles.size()); }
+		const Tile& getTile(const unsigned int t) const { return m_tiles[t]; }
+		unsigned int numberOfTileChunks() const { return static_cast<unsigned int>(m_tileChunks.size() - 1); }
+		unsigned int getTileChunkBegin(const unsigned int chunk) const { return m_tileChunks[chunk]; }
+		unsigned int getTileChunkEnd(const unsigned int chunk) const { return m_tileChunks[chunk + 1]; }
+
+		/** Provide a scratch block for each thread of the following parallel regions. The number of
+		* threads can change after update(), so this must be called outside of the parallel region
+		* before the tiled loops.
+		*/
+		void ensureBlocks();
+		/** Return the scratch block of the calling thread (see ensureBlocks()). */
+		Block& getBlock();
+
+		/** Gather the positions and the weights (masses and boundary psi) of all local points of a tile. */
+		static void gatherPositions(FluidModel *model, const Tile &tile, Block &block);
+		/** Gather the velocities of all local points of a tile. */
+		static void gatherVelocities(FluidModel *model, const Tile &tile, Block &block);
+
+		/** Gather a value of all fluid particles of a tile, value(i) is called with the index of the
+		* fluid particle. The value of boundary points is zero.
+		*/
+		template<typename ValueFct>
+		static void gatherValues(const Tile &tile, Block &block, ValueFct value)
+		{
+			const unsigned int numTileParticles = tile.numberOfParticles();
+			const unsigned int numLocalPoints = tile.numberOfLocalPoints();
+			if (block.m_value.size() < numLocalPoints)
+				block.m_value.resize(numLocalPoints);
+			for (unsigned int l = 0; l < numTileParticles; l++)
+				block.m_value[l] = value(tile.m_particles[l]);
+			for (unsigned int l = numTileParticles; l < numLocalPoints; l++)
+			{
+				const PointID &particleId = tile.m_halo[l - numTileParticles];
+				block.m_value[l] = (particleId.point_set_id == 0) ? value(particleId.point_id) : static_cast<Real>(0.0);
+			}
+		}
+	};
+}
+
+#endif
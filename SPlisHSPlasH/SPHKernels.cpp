@@ -1,28 +1,332 @@
 #include "SPHKernels.h"
+#include <algorithm>
+#include <atomic>
 
 using namespace SPH;
 
-Real CubicKernel::m_radius;
-Real CubicKernel::m_k;
-Real CubicKernel::m_l;
-Real CubicKernel::m_W_zero;
-
-Real Poly6Kernel::m_radius;
-Real Poly6Kernel::m_k;
-Real Poly6Kernel::m_l;
-Real Poly6Kernel::m_m;
-Real Poly6Kernel::m_W_zero;
-
-Real SpikyKernel::m_radius;
-Real SpikyKernel::m_k;
-Real SpikyKernel::m_l;
-Real SpikyKernel::m_W_zero;
-
-Real CohesionKernel::m_radius;
-Real CohesionKernel::m_k;
-Real CohesionKernel::m_c;
-Real CohesionKernel::m_W_zero;
-
-Real AdhesionKernel::m_radius;
-Real AdhesionKernel::m_k;
-Real AdhesionKernel::m_W_zero;
\ No newline at end of file
+//////////////////////////////////////////////////////////////////////////
+// Batched kernel evaluation
+//////////////////////////////////////////////////////////////////////////
+
+// The SIMD functions are compiled for AVX2/AVX-512 independent of the compiler flags
+// and are only called if the CPU supports the instruction set.
+#if defined(USE_DOUBLE) && (defined(__x86_64__) || defined(_M_X64))
+#define SPH_KERNEL_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SPH_TARGET_AVX2
+#define SPH_TARGET_AVX2_NOFMA
+#define SPH_TARGET_AVX512
+#else
+#define SPH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+// without FMA the compiler cannot contract multiplications and additions
+#define SPH_TARGET_AVX2_NOFMA __attribute__((target("avx2")))
+#define SPH_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+namespace
+{
+	KernelInstructionSet detectInstructionSet()
+	{
+#ifdef SPH_KERNEL_SIMD
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		if (!osxsave)
+			return KernelInstructionSet::Scalar;
+		const unsigned long long xcr0 = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		const bool avx2 = fma && ((info[1] & (1 << 5)) != 0) && ((xcr0 & 0x6) == 0x6);
+		const bool avx512 = ((info[1] & (1 << 16)) != 0) && ((xcr0 & 0xe6) == 0xe6);
+#else
+		__builtin_cpu_init();
+		const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		const bool avx512 = __builtin_cpu_supports("avx512f");
+#endif
+		// the AVX-512 functions use the AVX2 functions for the remainder
+		if (avx512 && avx2)
+			return KernelInstructionSet::AVX512;
+		if (avx2)
+			return KernelInstructionSet::AVX2;
+#endif
+		return KernelInstructionSet::Scalar;
+	}
+
+	const KernelInstructionSet supportedInstructionSet = detectInstructionSet();
+	/** Read by the solvers while a benchmark may change it (see setKernelInstructionSet()) */
+	std::atomic<KernelInstructionSet> activeInstructionSet(supportedInstructionSet);
+
+	inline KernelInstructionSet instructionSet()
+	{
+		return activeInstructionSet.load(std::memory_order_relaxed);
+	}
+
+#ifdef SPH_KERNEL_SIMD
+	SPH_TARGET_AVX2 void cubicKernelW_AVX2(const CubicKernel &kernel, const unsigned int n, const Vector3r *r, Real *res, const Real radius, const Real k)
+	{
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d half = _mm256_set1_pd(0.5);
+		const __m256d six = _mm256_set1_pd(6.0);
+		const __m256d invRadius = _mm256_set1_pd(1.0 / radius);
+		const __m256d vk = _mm256_set1_pd(k);
+		const __m256d k2 = _mm256_set1_pd(2.0 * k);
+
+		unsigned int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			// gather the distance vectors of four neighbors
+			const __m256d x = _mm256_set_pd(r[i + 3][0], r[i + 2][0], r[i + 1][0], r[i][0]);
+			const __m256d y = _mm256_set_pd(r[i + 3][1], r[i + 2][1], r[i + 1][1], r[i][1]);
+			const __m256d z = _mm256_set_pd(r[i + 3][2], r[i + 2][2], r[i + 1][2], r[i][2]);
+			const __m256d r2 = _mm256_fmadd_pd(z, z, _mm256_fmadd_pd(y, y, _mm256_mul_pd(x, x)));
+			const __m256d q = _mm256_mul_pd(_mm256_sqrt_pd(r2), invRadius);
+
+			// evaluate both polynomials and blend the results instead of branching
+			const __m256d q2 = _mm256_mul_pd(q, q);
+			const __m256d inner = _mm256_mul_pd(vk, _mm256_fmadd_pd(_mm256_mul_pd(six, q2), _mm256_sub_pd(q, one), one));
+			const __m256d f = _mm256_sub_pd(one, q);
+			const __m256d outer = _mm256_mul_pd(k2, _mm256_mul_pd(f, _mm256_mul_pd(f, f)));
+			__m256d w = _mm256_blendv_pd(outer, inner, _mm256_cmp_pd(q, half, _CMP_LE_OQ));
+			w = _mm256_and_pd(w, _mm256_cmp_pd(q, one, _CMP_LE_OQ));
+			_mm256_storeu_pd(&res[i], w);
+		}
+		for (; i < n; i++)
+			res[i] = kernel.W(r[i]);
+	}
+
+	SPH_TARGET_AVX2 void cubicKernelGradW_AVX2(const CubicKernel &kernel, const unsigned int n, const Vector3r *r, Vector3r *res, const Real radius, const Real l)
+	{
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d half = _mm256_set1_pd(0.5);
+		const __m256d two = _mm256_set1_pd(2.0);
+		const __m256d three = _mm256_set1_pd(3.0);
+		const __m256d eps = _mm256_set1_pd(1.0e-6);
+		const __m256d vRadius = _mm256_set1_pd(radius);
+		const __m256d invRadius = _mm256_set1_pd(1.0 / radius);
+		const __m256d vl = _mm256_set1_pd(l);
+
+		unsigned int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m256d x = _mm256_set_pd(r[i + 3][0], r[i + 2][0], r[i + 1][0], r[i][0]);
+			const __m256d y = _mm256_set_pd(r[i + 3][1], r[i + 2][1], r[i + 1][1], r[i][1]);
+			const __m256d z = _mm256_set_pd(r[i + 3][2], r[i + 2][2], r[i + 1][2], r[i][2]);
+			const __m256d r2 = _mm256_fmadd_pd(z, z, _mm256_fmadd_pd(y, y, _mm256_mul_pd(x, x)));
+			const __m256d rl = _mm256_sqrt_pd(r2);
+			const __m256d q = _mm256_mul_pd(rl, invRadius);
+
+			const __m256d inner = _mm256_mul_pd(_mm256_mul_pd(vl, q), _mm256_fmsub_pd(three, q, two));
+			const __m256d f = _mm256_sub_pd(one, q);
+			const __m256d outer = _mm256_mul_pd(vl, _mm256_mul_pd(_mm256_sub_pd(_mm256_setzero_pd(), f), f));
+			__m256d factor = _mm256_blendv_pd(outer, inner, _mm256_cmp_pd(q, half, _CMP_LE_OQ));
+			// gradq = r / (|r| h), the gradient is zero outside the support and for |r| <= 1e-6
+			factor = _mm256_div_pd(factor, _mm256_mul_pd(_mm256_max_pd(rl, eps), vRadius));
+			const __m256d mask = _mm256_and_pd(_mm256_cmp_pd(q, one, _CMP_LE_OQ), _mm256_cmp_pd(rl, eps, _CMP_GT_OQ));
+			factor = _mm256_and_pd(factor, mask);
+
+			double gx[4], gy[4], gz[4];
+			_mm256_storeu_pd(gx, _mm256_mul_pd(factor, x));
+			_mm256_storeu_pd(gy, _mm256_mul_pd(factor, y));
+			_mm256_storeu_pd(gz, _mm256_mul_pd(factor, z));
+			for (unsigned int j = 0; j < 4; j++)
+				res[i + j] = Vector3r(gx[j], gy[j], gz[j]);
+		}
+		for (; i < n; i++)
+			res[i] = kernel.gradW(r[i]);
+	}
+
+	SPH_TARGET_AVX512 void cubicKernelW_AVX512(const CubicKernel &kernel, const unsigned int n, const Vector3r *r, Real *res, const Real radius, const Real k)
+	{
+		const __m512d one = _mm512_set1_pd(1.0);
+		const __m512d half = _mm512_set1_pd(0.5);
+		const __m512d six = _mm512_set1_pd(6.0);
+		const __m512d invRadius = _mm512_set1_pd(1.0 / radius);
+		const __m512d vk = _mm512_set1_pd(k);
+		const __m512d k2 = _mm512_set1_pd(2.0 * k);
+		// the components of eight consecutive vectors have a stride of three doubles
+		const __m256i index = _mm256_set_epi32(21, 18, 15, 12, 9, 6, 3, 0);
+
+		unsigned int i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			const double *p = r[i].data();
+			const __m512d x = _mm512_i32gather_pd(index, p, 8);
+			const __m512d y = _mm512_i32gather_pd(index, p + 1, 8);
+			const __m512d z = _mm512_i32gather_pd(index, p + 2, 8);
+			const __m512d r2 = _mm512_fmadd_pd(z, z, _mm512_fmadd_pd(y, y, _mm512_mul_pd(x, x)));
+			const __m512d q = _mm512_mul_pd(_mm512_sqrt_pd(r2), invRadius);
+
+			const __m512d q2 = _mm512_mul_pd(q, q);
+			const __m512d inner = _mm512_mul_pd(vk, _mm512_fmadd_pd(_mm512_mul_pd(six, q2), _mm512_sub_pd(q, one), one));
+			const __m512d f = _mm512_sub_pd(one, q);
+			const __m512d outer = _mm512_mul_pd(k2, _mm512_mul_pd(f, _mm512_mul_pd(f, f)));
+			__m512d w = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(q, half, _CMP_LE_OQ), outer, inner);
+			w = _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(q, one, _CMP_LE_OQ), w);
+			_mm512_storeu_pd(&res[i], w);
+		}
+		if (i < n)
+			cubicKernelW_AVX2(kernel, n - i, &r[i], &res[i], radius, k);
+	}
+
+	SPH_TARGET_AVX512 void cubicKernelGradW_AVX512(const CubicKernel &kernel, const unsigned int n, const Vector3r *r, Vector3r *res, const Real radius, const Real l)
+	{
+		const __m512d one = _mm512_set1_pd(1.0);
+		const __m512d half = _mm512_set1_pd(0.5);
+		const __m512d two = _mm512_set1_pd(2.0);
+		const __m512d three = _mm512_set1_pd(3.0);
+		const __m512d eps = _mm512_set1_pd(1.0e-6);
+		const __m512d vRadius = _mm512_set1_pd(radius);
+		const __m512d invRadius = _mm512_set1_pd(1.0 / radius);
+		const __m512d vl = _mm512_set1_pd(l);
+		const __m256i index = _mm256_set_epi32(21, 18, 15, 12, 9, 6, 3, 0);
+
+		unsigned int i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			const double *p = r[i].data();
+			const __m512d x = _mm512_i32gather_pd(index, p, 8);
+			const __m512d y = _mm512_i32gather_pd(index, p + 1, 8);
+			const __m512d z = _mm512_i32gather_pd(index, p + 2, 8);
+			const __m512d r2 = _mm512_fmadd_pd(z, z, _mm512_fmadd_pd(y, y, _mm512_mul_pd(x, x)));
+			const __m512d rl = _mm512_sqrt_pd(r2);
+			const __m512d q = _mm512_mul_pd(rl, invRadius);
+
+			const __m512d inner = _mm512_mul_pd(_mm512_mul_pd(vl, q), _mm512_fmsub_pd(three, q, two));
+			const __m512d f = _mm512_sub_pd(one, q);
+			const __m512d outer = _mm512_mul_pd(vl, _mm512_mul_pd(_mm512_sub_pd(_mm512_setzero_pd(), f), f));
+			__m512d factor = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(q, half, _CMP_LE_OQ), outer, inner);
+			factor = _mm512_div_pd(factor, _mm512_mul_pd(_mm512_max_pd(rl, eps), vRadius));
+			const __mmask8 mask = _mm512_cmp_pd_mask(q, one, _CMP_LE_OQ) & _mm512_cmp_pd_mask(rl, eps, _CMP_GT_OQ);
+			factor = _mm512_maskz_mov_pd(mask, factor);
+
+			// scatter the gradients back to the vector array
+			double *g = res[i].data();
+			_mm512_i32scatter_pd(g, index, _mm512_mul_pd(factor, x), 8);
+			_mm512_i32scatter_pd(g + 1, index, _mm512_mul_pd(factor, y), 8);
+			_mm512_i32scatter_pd(g + 2, index, _mm512_mul_pd(factor, z), 8);
+		}
+		if (i < n)
+			cubicKernelGradW_AVX2(kernel, n - i, &r[i], &res[i], radius, l);
+	}
+
+	// The table index is computed as in the scalar functions of PrecomputedKernel (without FMA),
+	// so the gathered values are equal to the scalar ones. Lanes outside of the support are
+	// masked out of the gather.
+	SPH_TARGET_AVX2_NOFMA inline __m128i precomputedKernelIndex_AVX2(const __m256d x, const __m256d y, const __m256d z,
+		const __m256d radius2, const __m256d invStepSize, const __m128i maxIndex, __m256d &mask)
+	{
+		const __m256d r2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z));
+		mask = _mm256_cmp_pd(r2, radius2, _CMP_LE_OQ);
+		const __m256d pos = _mm256_mul_pd(_mm256_sqrt_pd(r2), invStepSize);
+		return _mm_min_epi32(_mm256_cvttpd_epi32(_mm256_and_pd(pos, mask)), maxIndex);
+	}
+
+	SPH_TARGET_AVX2_NOFMA unsigned int precomputedKernelW_AVX2(const Real *table, const unsigned int resolution, const Real radius,
+		const Real invStepSize, const unsigned int n, const Vector3r *r, Real *res)
+	{
+		const __m256d radius2 = _mm256_set1_pd(radius*radius);
+		const __m256d vInvStepSize = _mm256_set1_pd(invStepSize);
+		const __m128i maxIndex = _mm_set1_epi32((int)resolution);
+
+		unsigned int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m256d x = _mm256_set_pd(r[i + 3][0], r[i + 2][0], r[i + 1][0], r[i][0]);
+			const __m256d y = _mm256_set_pd(r[i + 3][1], r[i + 2][1], r[i + 1][1], r[i][1]);
+			const __m256d z = _mm256_set_pd(r[i + 3][2], r[i + 2][2], r[i + 1][2], r[i][2]);
+			__m256d mask;
+			const __m128i index = precomputedKernelIndex_AVX2(x, y, z, radius2, vInvStepSize, maxIndex, mask);
+			_mm256_storeu_pd(&res[i], _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table, index, mask, 8));
+		}
+		return i;
+	}
+
+	SPH_TARGET_AVX2_NOFMA unsigned int precomputedKernelGradW_AVX2(const Real *table, const unsigned int resolution, const Real radius,
+		const Real invStepSize, const unsigned int n, const Vector3r *r, Vector3r *res)
+	{
+		const __m256d radius2 = _mm256_set1_pd(radius*radius);
+		const __m256d vInvStepSize = _mm256_set1_pd(invStepSize);
+		const __m128i maxIndex = _mm_set1_epi32((int)resolution);
+
+		unsigned int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m256d x = _mm256_set_pd(r[i + 3][0], r[i + 2][0], r[i + 1][0], r[i][0]);
+			const __m256d y = _mm256_set_pd(r[i + 3][1], r[i + 2][1], r[i + 1][1], r[i][1]);
+			const __m256d z = _mm256_set_pd(r[i + 3][2], r[i + 2][2], r[i + 1][2], r[i][2]);
+			__m256d mask;
+			const __m128i index = precomputedKernelIndex_AVX2(x, y, z, radius2, vInvStepSize, maxIndex, mask);
+			const __m256d factor = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table, index, mask, 8);
+
+			double gx[4], gy[4], gz[4];
+			_mm256_storeu_pd(gx, _mm256_mul_pd(factor, x));
+			_mm256_storeu_pd(gy, _mm256_mul_pd(factor, y));
+			_mm256_storeu_pd(gz, _mm256_mul_pd(factor, z));
+			for (unsigned int j = 0; j < 4; j++)
+				res[i + j] = Vector3r(gx[j], gy[j], gz[j]);
+		}
+		return i;
+	}
+#endif
+}
+
+KernelInstructionSet SPH::getKernelInstructionSet()
+{
+	return instructionSet();
+}
+
+void SPH::setKernelInstructionSet(const KernelInstructionSet set)
+{
+	activeInstructionSet = std::min(set, supportedInstructionSet);
+}
+
+void CubicKernel::W(const unsigned int n, const Vector3r *r, Real *res) const
+{
+#ifdef SPH_KERNEL_SIMD
+	const KernelInstructionSet set = instructionSet();
+	if (set == KernelInstructionSet::AVX512)
+		return cubicKernelW_AVX512(*this, n, r, res, m_radius, m_k);
+	if (set == KernelInstructionSet::AVX2)
+		return cubicKernelW_AVX2(*this, n, r, res, m_radius, m_k);
+#endif
+	for (unsigned int i = 0; i < n; i++)
+		res[i] = W(r[i]);
+}
+
+void CubicKernel::gradW(const unsigned int n, const Vector3r *r, Vector3r *res) const
+{
+#ifdef SPH_KERNEL_SIMD
+	const KernelInstructionSet set = instructionSet();
+	if (set == KernelInstructionSet::AVX512)
+		return cubicKernelGradW_AVX512(*this, n, r, res, m_radius, m_l);
+	if (set == KernelInstructionSet::AVX2)
+		return cubicKernelGradW_AVX2(*this, n, r, res, m_radius, m_l);
+#endif
+	for (unsigned int i = 0; i < n; i++)
+		res[i] = gradW(r[i]);
+}
+
+unsigned int SPH::precomputedKernelW(const Real *table, const unsigned int resolution, const Real radius, const Real invStepSize,
+	const unsigned int n, const Vector3r *r, Real *res)
+{
+#ifdef SPH_KERNEL_SIMD
+	// AVX-512 has no advantage for the gathers of four table entries
+	if (instructionSet() != KernelInstructionSet::Scalar)
+		return precomputedKernelW_AVX2(table, resolution, radius, invStepSize, n, r, res);
+#endif
+	return 0;
+}
+
+unsigned int SPH::precomputedKernelGradW(const Real *table, const unsigned int resolution, const Real radius, const Real invStepSize,
+	const unsigned int n, const Vector3r *r, Vector3r *res)
+{
+#ifdef SPH_KERNEL_SIMD
+	if (instructionSet() != KernelInstructionSet::Scalar)
+		return precomputedKernelGradW_AVX2(table, resolution, radius, invStepSize, n, r, res);
+#endif
+	return 0;
+}
@@ -8,18 +8,39 @@
 
 namespace SPH
 {
+	/** Maximal number of neighbors which are evaluated in one call of a batched kernel function. */
+	const unsigned int KernelBatchSize = 64;
+
+	/** \brief Instruction sets which are used by the batched kernel functions.
+	*/
+	enum class KernelInstructionSet { Scalar = 0, AVX2, AVX512 };
+
+	/** Return the instruction set which is used by the batched kernel functions.
+	* The best instruction set of the CPU is selected at program start.
+	*/
+	KernelInstructionSet getKernelInstructionSet();
+	/** Limit the batched kernel functions to an instruction set (e.g. to compare them in a benchmark).
+	* If the CPU does not support the instruction set, the best supported one is used.
+	* The instruction set is a process-global setting which is read atomically, so it may be
+	* changed while other threads simulate, but it applies to the kernels of all models.
+	*/
+	void setKernelInstructionSet(const KernelInstructionSet set);
+
+	// The kernels store the constants of their support radius (see setRadius()) per object,
+	// so that models with different particle radii can be simulated in the same process.
+
 	/** \brief Cubic spline kernel.
 	*/
 	class CubicKernel
 	{
 	protected:
-		static Real m_radius;
-		static Real m_k;
-		static Real m_l;
-		static Real m_W_zero;
+		Real m_radius;
+		Real m_k;
+		Real m_l;
+		Real m_W_zero;
 	public:
-		static Real getRadius() { return m_radius; }
-		static void setRadius(Real val)
+		Real getRadius() const { return m_radius; }
+		void setRadius(Real val)
 		{
 			m_radius = val;
 			static const Real pi = static_cast<Real>(M_PI);
@@ -31,7 +52,7 @@ namespace SPH
 		}
 
 	public:
-		static Real W(const Real r)
+		Real W(const Real r) const
 		{
 			Real res = 0.0;
 			const Real q = r / m_radius;
@@ -51,12 +72,12 @@ namespace SPH
 			return res;
 		}
 
-		static Real W(const Vector3r &r)
+		Real W(const Vector3r &r) const
 		{
 			return W(r.norm());
 		}
 
-		static Vector3r gradW(const Vector3r &r)
+		Vector3r gradW(const Vector3r &r) const
 		{
 			Vector3r res;
 			const Real rl = r.norm();
@@ -76,6 +97,8 @@ namespace SPH
 						res = m_l*(-factor*factor)*gradq;
 					}
 				}
+				else
+					res.setZero();
 			}
 			else
 				res.setZero();
@@ -83,7 +106,16 @@ namespace SPH
 			return res;
 		}
 
-		static Real W_zero()
+		/** Evaluate the kernel for n <= KernelBatchSize distance vectors. The vectors are processed
+		* in SIMD registers without branches if the CPU supports AVX2 or AVX-512.
+		*/
+		void W(const unsigned int n, const Vector3r *r, Real *res) const;
+
+		/** Evaluate the kernel gradient for n <= KernelBatchSize distance vectors (see W()).
+		*/
+		void gradW(const unsigned int n, const Vector3r *r, Vector3r *res) const;
+
+		Real W_zero() const
 		{
 			return m_W_zero;
 		}
@@ -94,14 +126,14 @@ namespace SPH
 	class Poly6Kernel
 	{
 	protected:
-		static Real m_radius;
-		static Real m_k;
-		static Real m_l;
-		static Real m_m;
-		static Real m_W_zero;
+		Real m_radius;
+		Real m_k;
+		Real m_l;
+		Real m_m;
+		Real m_W_zero;
 	public:
-		static Real getRadius() { return m_radius; }
-		static void setRadius(Real val)
+		Real getRadius() const { return m_radius; }
+		void setRadius(Real val)
 		{
 			m_radius = val;
 			static const Real pi = static_cast<Real>(M_PI);
@@ -117,7 +149,7 @@ namespace SPH
 		* W(r,h) = (315/(64 pi h^9))(h^2-|r|^2)^3
 		*        = (315/(64 pi h^9))(h^2-r*r)^3
 		*/
-		static Real W(const Real r)
+		Real W(const Real r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r*r;
@@ -129,7 +161,7 @@ namespace SPH
 			return res;
 		}
 
-		static Real W(const Vector3r &r)
+		Real W(const Vector3r &r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r.squaredNorm();
@@ -146,7 +178,7 @@ namespace SPH
 		* grad(W(r,h)) = r(-945/(32 pi h^9))(h^2-|r|^2)^2
 		*              = r(-945/(32 pi h^9))(h^2-r*r)^2
 		*/
-		static Vector3r gradW(const Vector3r &r)
+		Vector3r gradW(const Vector3r &r) const
 		{
 			Vector3r res;
 			const Real r2 = r.squaredNorm();
@@ -166,7 +198,7 @@ namespace SPH
 		* laplacian(W(r,h)) = (-945/(32 pi h^9))(h^2-|r|^2)(-7|r|^2+3h^2)
 		*                   = (-945/(32 pi h^9))(h^2-r*r)(3 h^2-7 r*r)
 		*/
-		static Real laplacianW(const Vector3r &r)
+		Real laplacianW(const Vector3r &r) const
 		{
 			Real res;
 			const Real r2 = r.squaredNorm();
@@ -183,7 +215,19 @@ namespace SPH
 			return res;
 		}
 
-		static Real W_zero()
+		void W(const unsigned int n, const Vector3r *r, Real *res) const
+		{
+			for (unsigned int i = 0; i < n; i++)
+				res[i] = W(r[i]);
+		}
+
+		void gradW(const unsigned int n, const Vector3r *r, Vector3r *res) const
+		{
+			for (unsigned int i = 0; i < n; i++)
+				res[i] = gradW(r[i]);
+		}
+
+		Real W_zero() const
 		{
 			return m_W_zero;
 		}
@@ -194,13 +238,13 @@ namespace SPH
 	class SpikyKernel
 	{
 	protected:
-		static Real m_radius;
-		static Real m_k;
-		static Real m_l;
-		static Real m_W_zero;
+		Real m_radius;
+		Real m_k;
+		Real m_l;
+		Real m_W_zero;
 	public:
-		static Real getRadius() { return m_radius; }
-		static void setRadius(Real val)
+		Real getRadius() const { return m_radius; }
+		void setRadius(Real val)
 		{
 			m_radius = val;
 			const Real radius6 = pow(m_radius, 6);
@@ -215,7 +259,7 @@ namespace SPH
 		/**
 		* W(r,h) = 15/(pi*h^6) * (h-r)^3
 		*/
-		static Real W(const Real r)
+		Real W(const Real r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r*r;
@@ -228,7 +272,7 @@ namespace SPH
 			return res;
 		}
 
-		static Real W(const Vector3r &r)
+		Real W(const Vector3r &r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r.squaredNorm();
@@ -245,7 +289,7 @@ namespace SPH
 		/**
 		* grad(W(r,h)) = -r(45/(pi*h^6) * (h-r)^2)
 		*/
-		static Vector3r gradW(const Vector3r &r)
+		Vector3r gradW(const Vector3r &r) const
 		{
 			Vector3r res;
 			const Real r2 = r.squaredNorm();
@@ -263,7 +307,19 @@ namespace SPH
 			return res;
 		}
 
-		static Real W_zero()
+		void W(const unsigned int n, const Vector3r *r, Real *res) const
+		{
+			for (unsigned int i = 0; i < n; i++)
+				res[i] = W(r[i]);
+		}
+
+		void gradW(const unsigned int n, const Vector3r *r, Vector3r *res) const
+		{
+			for (unsigned int i = 0; i < n; i++)
+				res[i] = gradW(r[i]);
+		}
+
+		Real W_zero() const
 		{
 			return m_W_zero;
 		}
@@ -274,13 +330,13 @@ namespace SPH
 	class CohesionKernel
 	{
 	protected:
-		static Real m_radius;
-		static Real m_k;
-		static Real m_c;
-		static Real m_W_zero;
+		Real m_radius;
+		Real m_k;
+		Real m_c;
+		Real m_W_zero;
 	public:
-		static Real getRadius() { return m_radius; }
-		static void setRadius(Real val)
+		Real getRadius() const { return m_radius; }
+		void setRadius(Real val)
 		{
 			m_radius = val;
 			static const Real pi = static_cast<Real>(M_PI);
@@ -295,7 +351,7 @@ namespace SPH
 		* W(r,h) = (32/(pi h^9))(h-r)^3*r^3					if h/2 < r <= h
 		*          (32/(pi h^9))(2*(h-r)^3*r^3 - h^6/64		if 0 < r <= h/2
 		*/
-		static Real W(const Real r)
+		Real W(const Real r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r*r;
@@ -313,7 +369,7 @@ namespace SPH
 			return res;
 		}
 
-		static Real W(const Vector3r &r)
+		Real W(const Vector3r &r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r.squaredNorm();
@@ -331,7 +387,7 @@ namespace SPH
 			return res;
 		}
 
-		static Real W_zero()
+		Real W_zero() const
 		{
 			return m_W_zero;
 		}
@@ -342,12 +398,12 @@ namespace SPH
 	class AdhesionKernel
 	{
 	protected:
-		static Real m_radius;
-		static Real m_k;
-		static Real m_W_zero;
+		Real m_radius;
+		Real m_k;
+		Real m_W_zero;
 	public:
-		static Real getRadius() { return m_radius; }
-		static void setRadius(Real val)
+		Real getRadius() const { return m_radius; }
+		void setRadius(Real val)
 		{
 			m_radius = val;
 			m_k = 0.007 / pow(m_radius, 3.25);
@@ -359,7 +415,7 @@ namespace SPH
 		/**
 		* W(r,h) = (0.007/h^3.25)(-4r^2/h + 6r -2h)^0.25					if h/2 < r <= h
 		*/
-		static Real W(const Real r)
+		Real W(const Real r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r*r;
@@ -373,7 +429,7 @@ namespace SPH
 			return res;
 		}
 
-		static Real W(const Vector3r &r)
+		Real W(const Vector3r &r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r.squaredNorm();
@@ -387,13 +443,25 @@ namespace SPH
 			return res;
 		}
 
-		static Real W_zero()
+		Real W_zero() const
 		{
 			return m_W_zero;
 		}
 	};
 
 
+	/** Evaluate the lookup table of a PrecomputedKernel for the first distance vectors of a batch with
+	* AVX2 gathers. Returns the number of evaluated vectors (a multiple of four, zero if the CPU does
+	* not support AVX2), the caller evaluates the remaining ones.
+	*/
+	unsigned int precomputedKernelW(const Real *table, const unsigned int resolution, const Real radius, const Real invStepSize,
+		const unsigned int n, const Vector3r *r, Real *res);
+	/** Evaluate the gradient table (gradW(r)/|r|) of a PrecomputedKernel for the first distance vectors
+	* of a batch (see precomputedKernelW()).
+	*/
+	unsigned int precomputedKernelGradW(const Real *table, const unsigned int resolution, const Real radius, const Real invStepSize,
+		const unsigned int n, const Vector3r *r, Vector3r *res);
+
 	/** \brief Precomputed kernel which is based on a lookup table as described by Bender and Koschier \cite Bender:2015, \cite Bender2016.
 	*
 	* The lookup tables can be used in combination with any kernel. 
@@ -402,26 +470,26 @@ namespace SPH
 	class PrecomputedKernel
 	{
 	protected:
-		static Real m_W[resolution];
-		static Real m_gradW[resolution + 1];
-		static Real m_radius;
-		static Real m_invStepSize;
-		static Real m_W_zero;
+		Real m_W[resolution];
+		Real m_gradW[resolution + 1];
+		Real m_radius;
+		Real m_invStepSize;
+		Real m_W_zero;
 	public:
-		static Real getRadius() { return m_radius; }
-		static void setRadius(Real val)
+		Real getRadius() const { return m_radius; }
+		void setRadius(Real val)
 		{
 			m_radius = val;
-			KernelType::setRadius(val);
+			KernelType kernel;
+			kernel.setRadius(val);
 			const Real stepSize = m_radius / (Real)resolution;
 			m_invStepSize = 1.0 / stepSize;
 			for (unsigned int i = 0; i < resolution; i++)
 			{
 				const Real posX = stepSize * (Real)i;		// Store kernel values in the middle of an interval
-				m_W[i] = KernelType::W(posX);
-				KernelType::setRadius(val);
+				m_W[i] = kernel.W(posX);
 				if (posX > 1.0e-9)
-					m_gradW[i] = KernelType::gradW(Vector3r(posX, 0.0, 0.0))[0] / posX;
+					m_gradW[i] = kernel.gradW(Vector3r(posX, 0.0, 0.0))[0] / posX;
 				else
 					m_gradW[i] = 0.0;
 			}
@@ -430,7 +498,7 @@ namespace SPH
 		}
 
 	public:
-		static Real W(const Vector3r &r)
+		Real W(const Vector3r &r) const
 		{
 			Real res = 0.0;
 			const Real r2 = r.squaredNorm();
@@ -444,7 +512,7 @@ namespace SPH
 			return res;
 		}
 
-		static Real W(const Real r)
+		Real W(const Real r) const
 		{
 			Real res = 0.0;
 			if (r <= m_radius)
@@ -455,7 +523,7 @@ namespace SPH
 			return res;
 		}
 
-		static Vector3r gradW(const Vector3r &r)
+		Vector3r gradW(const Vector3r &r) const
 		{
 			Vector3r res;
 			const Real r2 = r.squaredNorm();
@@ -472,22 +540,129 @@ namespace SPH
 			return res;
 		}
 
-		static Real W_zero()
+		/** Evaluate the kernel for n <= KernelBatchSize distance vectors. The table entries are gathered
+		* in SIMD registers if the CPU supports AVX2. The results are equal to the ones of W(r).
+		*/
+		void W(const unsigned int n, const Vector3r *r, Real *res) const
+		{
+			for (unsigned int i = precomputedKernelW(m_W, resolution, m_radius, m_invStepSize, n, r, res); i < n; i++)
+				res[i] = W(r[i]);
+		}
+
+		/** Evaluate the kernel gradient for n <= KernelBatchSize distance vectors (see W()).
+		*/
+		void gradW(const unsigned int n, const Vector3r *r, Vector3r *res) const
+		{
+			for (unsigned int i = precomputedKernelGradW(m_gradW, resolution, m_radius, m_invStepSize, n, r, res); i < n; i++)
+				res[i] = gradW(r[i]);
+		}
+
+		Real W_zero() const
 		{
 			return m_W_zero;
 		}
 	};
 
-	template<typename KernelType, unsigned int resolution>
-	Real PrecomputedKernel<KernelType, resolution>::m_radius;
-	template<typename KernelType, unsigned int resolution>
-	Real PrecomputedKernel<KernelType, resolution>::m_W[resolution];
-	template<typename KernelType, unsigned int resolution>
-	Real PrecomputedKernel<KernelType, resolution>::m_gradW[resolution + 1];
-	template<typename KernelType, unsigned int resolution>
-	Real PrecomputedKernel<KernelType, resolution>::m_invStepSize;
-	template<typename KernelType, unsigned int resolution>
-	Real PrecomputedKernel<KernelType, resolution>::m_W_zero;
+	/** \brief Precomputed kernel with a small lookup table which is interpolated.
+	*
+	* In contrast to PrecomputedKernel the tables are sampled uniformly in the squared distance
+	* s = |r|^2 / h^2, so that a lookup does not need a square root. The values between two entries
+	* are interpolated linearly (order 1) or by a cubic Catmull-Rom spline (order 3). A few hundred
+	* entries are sufficient, with float tables (TableReal) the tables of the kernel and its gradient
+	* fit in the L1 cache. The gradient table stores gradW(r)/|r|.
+	*/
+	template<typename KernelType, unsigned int resolution = 1024u, typename TableReal = Real, unsigned int order = 1u>
+	class InterpolatedKernel
+	{
+	protected:
+		/** Entry i + 1 contains the value at s = i / resolution. Entry 0 and the two entries
+		* after the last one are only required by the cubic interpolation. */
+		TableReal m_W[resolution + 3];
+		TableReal m_gradW[resolution + 3];
+		Real m_radius;
+		Real m_scale;
+		Real m_W_zero;
+
+		FORCE_INLINE Real interpolate(const TableReal *table, const Real s) const
+		{
+			const unsigned int i = (unsigned int)s;
+			const Real t = s - (Real)i;
+			const TableReal *p = &table[i];
+			if (order == 3u)
+			{
+				const Real p0 = p[0], p1 = p[1], p2 = p[2], p3 = p[3];
+				return p1 + 0.5*t*((p2 - p0) + t*((2.0*p0 - 5.0*p1 + 4.0*p2 - p3) + t*(3.0*(p1 - p2) + p3 - p0)));
+			}
+			return (Real)p[1] + t*((Real)p[2] - (Real)p[1]);
+		}
+
+	public:
+		Real getRadius() const { return m_radius; }
+		void setRadius(Real val)
+		{
+			static_assert((order == 1u) || (order == 3u), "Only linear and cubic interpolation are supported.");
+			m_radius = val;
+			KernelType kernel;
+			kernel.setRadius(val);
+			m_scale = (Real)resolution / (m_radius*m_radius);
+			for (unsigned int i = 0; i <= resolution; i++)
+			{
+				const Real posX = m_radius * sqrt((Real)i / (Real)resolution);
+				m_W[i + 1] = (TableReal)kernel.W(posX);
+				// the limit of gradW(r)/|r| for r -> 0 is approximated at a small distance
+				const Real x = std::max(posX, (Real) 1.0e-3 * m_radius);
+				m_gradW[i + 1] = (TableReal)(kernel.gradW(Vector3r(x, 0.0, 0.0))[0] / x);
+			}
+			// linear extrapolation at s = 0, the kernel is zero outside the support radius
+			m_W[0] = 2 * m_W[1] - m_W[2];
+			m_gradW[0] = 2 * m_gradW[1] - m_gradW[2];
+			m_W[resolution + 2] = 0;
+			m_gradW[resolution + 2] = 0;
+			m_W_zero = W(Vector3r::Zero());
+		}
+
+	public:
+		Real W(const Vector3r &r) const
+		{
+			const Real s = r.squaredNorm() * m_scale;
+			if (s < (Real)resolution)
+				return interpolate(m_W, s);
+			return 0.0;
+		}
+
+		Real W(const Real r) const
+		{
+			const Real s = r*r * m_scale;
+			if (s < (Real)resolution)
+				return interpolate(m_W, s);
+			return 0.0;
+		}
+
+		Vector3r gradW(const Vector3r &r) const
+		{
+			const Real s = r.squaredNorm() * m_scale;
+			if (s < (Real)resolution)
+				return interpolate(m_gradW, s) * r;
+			return Vector3r::Zero();
+		}
+
+		void W(const unsigned int n, const Vector3r *r, Real *res) const
+		{
+			for (unsigned int i = 0; i < n; i++)
+				res[i] = W(r[i]);
+		}
+
+		void gradW(const unsigned int n, const Vector3r *r, Vector3r *res) const
+		{
+			for (unsigned int i = 0; i < n; i++)
+				res[i] = gradW(r[i]);
+		}
+
+		Real W_zero() const
+		{
+			return m_W_zero;
+		}
+	};
 }
 
 #endif
@@ -0,0 +1,124 @@
+#include "SimulationThread.h"
+#include "FluidModel.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace SPH;
+
+SimulationThread::SimulationThread() :
+	m_model(nullptr),
+	m_stop(false),
+	m_waiting(0),
+	m_frame(0)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+	stop();
+}
+
+void SimulationThread::start(FluidModel *model, const FrameFct &frameFct)
+{
+	stop();
+	m_model = model;
+	m_frameFct = frameFct;
+	m_stop = false;
+	m_thread = std::thread(&SimulationThread::threadLoop, this);
+}
+
+void SimulationThread::stop()
+{
+	if (!isRunning())
+		return;
+	m_stop = true;
+	m_thread.join();
+	m_stop = false;
+	// functions which were posted while the thread was finishing
+	runPosted();
+}
+
+void SimulationThread::threadLoop()
+{
+	while (!m_stop)
+	{
+		runPosted();
+
+		bool advanced;
+		{
+			std::lock_guard<std::mutex> lock(m_frameMutex);
+			advanced = m_frameFct();
+			if (advanced)
+				publish(*m_model);
+		}
+
+		// let the callers of execute() take the mutex before the next frame starts
+		while ((m_waiting > 0) && !m_stop)
+			std::this_thread::yield();
+
+		// a paused simulation is polled
+		if (!advanced)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	runPosted();
+}
+
+void SimulationThread::runPosted()
+{
+	std::vector<std::function<void()>> posted;
+	{
+		std::lock_guard<std::mutex> lock(m_postMutex);
+		posted.swap(m_posted);
+	}
+	for (auto &fct : posted)
+		fct();
+}
+
+void SimulationThread::execute(const std::function<void()> &fct)
+{
+	if (!isRunning() || (std::this_thread::get_id() == m_thread.get_id()))
+	{
+		fct();
+		return;
+	}
+
+	m_waiting++;
+	std::lock_guard<std::mutex> lock(m_frameMutex);
+	m_waiting--;
+	fct();
+}
+
+void SimulationThread::post(const std::function<void()> &fct)
+{
+	if (!isRunning())
+	{
+		fct();
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_postMutex);
+	m_posted.push_back(fct);
+}
+
+void SimulationThread::subscribe(SnapshotBuffer *buffer)
+{
+	std::lock_guard<std::mutex> lock(m_subscriberMutex);
+	if (std::find(m_subscribers.begin(), m_subscribers.end(), buffer) == m_subscribers.end())
+		m_subscribers.push_back(buffer);
+}
+
+void SimulationThread::unsubscribe(SnapshotBuffer *buffer)
+{
+	std::lock_guard<std::mutex> lock(m_subscriberMutex);
+	m_subscribers.erase(std::remove(m_subscribers.begin(), m_subscribers.end(), buffer), m_subscribers.end());
+}
+
+void SimulationThread::publish(FluidModel &model)
+{
+	const unsigned int frame = ++m_frame;
+	std::lock_guard<std::mutex> lock(m_subscriberMutex);
+	for (SnapshotBuffer *buffer : m_subscribers)
+	{
+		buffer->getWriteSnapshot().capture(model, frame);
+		buffer->publish();
+	}
+}
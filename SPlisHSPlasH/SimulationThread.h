@@ -0,0 +1,77 @@
+#ifndef __SimulationThread_h__
+#define __SimulationThread_h__
+
+#include "Common.h"
+#include "SnapshotBuffer.h"
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+namespace SPH
+{
+	class FluidModel;
+
+	/** \brief Runs the simulation loop on a dedicated thread and publishes a particle snapshot
+	* after each frame.
+	*
+	* The frame function performs the steps of a frame (e.g. with a FrameBudget) and returns false
+	* if the simulation did not advance, e.g. because it is paused. After each frame which advanced
+	* the simulation, the fluid particles are captured into every subscribed SnapshotBuffer. So the
+	* render loop, output writers and monitors read the latest state without blocking the solver.
+	*
+	* Other threads must not access the simulation directly while the thread is running:
+	* execute() runs a function between two frames (e.g. to change parameters), post() runs a
+	* function on the simulation thread (e.g. for the thread-local time measurements).
+	* Without a running thread both functions are called immediately, so the same code works in a
+	* synchronous loop which calls publish() itself.
+	*/
+	class SimulationThread
+	{
+	public:
+		typedef std::function<bool()> FrameFct;
+
+	protected:
+		FluidModel *m_model;
+		FrameFct m_frameFct;
+		std::thread m_thread;
+		std::atomic<bool> m_stop;
+		/** Held by the simulation thread during a frame and by execute() */
+		std::mutex m_frameMutex;
+		/** Number of threads waiting in execute() */
+		std::atomic<int> m_waiting;
+		std::mutex m_postMutex;
+		std::vector<std::function<void()>> m_posted;
+		std::mutex m_subscriberMutex;
+		std::vector<SnapshotBuffer*> m_subscribers;
+		std::atomic<unsigned int> m_frame;
+
+		void threadLoop();
+		void runPosted();
+
+	public:
+		SimulationThread();
+		~SimulationThread();
+
+		/** Start the simulation loop of the model on a new thread. */
+		void start(FluidModel *model, const FrameFct &frameFct);
+		/** Finish the current frame, run the posted functions and join the thread. */
+		void stop();
+		bool isRunning() const { return m_thread.joinable(); }
+
+		/** Call the function on the calling thread while the simulation is between two frames. */
+		void execute(const std::function<void()> &fct);
+		/** Call the function on the simulation thread before the next frame. */
+		void post(const std::function<void()> &fct);
+
+		/** Publish the snapshots of each frame to the buffer. The caller is the only consumer of the buffer. */
+		void subscribe(SnapshotBuffer *buffer);
+		void unsubscribe(SnapshotBuffer *buffer);
+		/** Capture the fluid particles of the model into all subscribed buffers. */
+		void publish(FluidModel &model);
+		unsigned int getNumberOfFrames() const { return m_frame; }
+	};
+}
+
+#endif
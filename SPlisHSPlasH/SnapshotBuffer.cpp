@@ -0,0 +1,47 @@
+#include "SnapshotBuffer.h"
+#include "FluidModel.h"
+#include "TimeManager.h"
+
+using namespace SPH;
+
+void ParticleSnapshot::capture(FluidModel &model, const unsigned int frameNumber)
+{
+	const int numParticles = (int)model.numParticles();
+	frame = frameNumber;
+	time = model.getTimeManager()->getTime();
+	timeStepSize = model.getTimeManager()->getTimeStepSize();
+	positions.resize(numParticles);
+	velocities.resize(numParticles);
+
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)
+		for (int i = 0; i < numParticles; i++)
+		{
+			positions[i] = model.getPosition(0, i);
+			velocities[i] = model.getVelocity(0, i);
+		}
+	}
+}
+
+SnapshotBuffer::SnapshotBuffer() :
+	m_latest(0),
+	m_write(1),
+	m_read(2)
+{
+}
+
+void SnapshotBuffer::publish()
+{
+	// the release makes the snapshot visible to the consumer, the acquire returns a snapshot
+	// which the consumer has finished reading
+	m_write = m_latest.exchange(m_write | FreshBit, std::memory_order_acq_rel) & ~FreshBit;
+}
+
+bool SnapshotBuffer::update()
+{
+	if ((m_latest.load(std::memory_order_relaxed) & FreshBit) == 0)
+		return false;
+	m_read = m_latest.exchange(m_read, std::memory_order_acq_rel) & ~FreshBit;
+	return true;
+}
@@ -0,0 +1,70 @@
+#ifndef __SnapshotBuffer_h__
+#define __SnapshotBuffer_h__
+
+#include "Common.h"
+#include <vector>
+#include <atomic>
+
+namespace SPH
+{
+	class FluidModel;
+
+	/** \brief Copy of the fluid particle state after a simulation frame. */
+	struct ParticleSnapshot
+	{
+		/** Number of the frame, 0 if nothing has been captured yet */
+		unsigned int frame;
+		Real time;
+		Real timeStepSize;
+		std::vector<Vector3r> positions;
+		std::vector<Vector3r> velocities;
+
+		ParticleSnapshot() : frame(0), time(0.0), timeStepSize(0.0) {}
+
+		unsigned int numParticles() const { return static_cast<unsigned int>(positions.size()); }
+		/** Copy the positions and velocities of the fluid particles of the model. */
+		void capture(FluidModel &model, const unsigned int frameNumber);
+	};
+
+	/** \brief Lock-free triple buffer which passes particle snapshots from a single producer to a
+	* single consumer.
+	*
+	* The producer fills the write snapshot and publishes it, the consumer takes the latest
+	* published snapshot with update() and reads it until the next update. Neither side ever waits:
+	* the third snapshot always holds the latest published state, so the producer can continue
+	* writing while the consumer reads. If the producer publishes faster than the consumer updates,
+	* intermediate snapshots are skipped.
+	*
+	* The buffer does not depend on OpenGL. Renderers, output writers and monitors each use their
+	* own buffer (see SimulationThread::subscribe()).
+	*/
+	class SnapshotBuffer
+	{
+	protected:
+		/** Set in m_latest if the latest snapshot has not been taken by the consumer yet */
+		static const unsigned int FreshBit = 4u;
+
+		ParticleSnapshot m_snapshots[3];
+		/** Index of the latest published snapshot (and FreshBit), exchanged by both sides */
+		std::atomic<unsigned int> m_latest;
+		/** Snapshot which is written by the producer */
+		unsigned int m_write;
+		/** Snapshot which is read by the consumer */
+		unsigned int m_read;
+
+	public:
+		SnapshotBuffer();
+
+		/** Producer: snapshot which is filled before the next publish(). */
+		ParticleSnapshot &getWriteSnapshot() { return m_snapshots[m_write]; }
+		/** Producer: make the write snapshot the latest one. */
+		void publish();
+
+		/** Consumer: take the latest published snapshot. Returns false if no new snapshot was published since the last update. */
+		bool update();
+		/** Consumer: snapshot which was taken by the last update(). */
+		const ParticleSnapshot &getReadSnapshot() const { return m_snapshots[m_read]; }
+	};
+}
+
+#endif
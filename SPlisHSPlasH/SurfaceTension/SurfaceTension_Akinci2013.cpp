@@ -24,24 +24,28 @@ void SurfaceTension_Akinci2013::computeNormals()
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			Vector3r &ni = getNormal(i);
-			ni.setZero();
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-
-				if (particleId.point_set_id == 0)
+				const Vector3r &xi = m_model->getPosition(0, i);
+				Vector3r &ni = getNormal(i);
+				ni.setZero();
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					const Vector3r &xj = m_model->getPosition(0, neighborIndex);	
-					const Real density_j = m_model->getDensity(neighborIndex);
-					ni += m_model->getMass(neighborIndex) / density_j * m_model->gradW(xi - xj);
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+
+					if (particleId.point_set_id == 0)
+					{
+						const Vector3r &xj = m_model->getPosition(0, neighborIndex);	
+						const Real density_j = m_model->getDensity(neighborIndex);
+						ni += m_model->getMass(neighborIndex) / density_j * m_model->gradW(xi - xj);
+					}
 				}
+				ni = supportRadius*ni;
 			}
-			ni = supportRadius*ni;
 		}
 	}
 
@@ -60,50 +64,54 @@ void SurfaceTension_Akinci2013::step()
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			const Vector3r &ni = getNormal(i);
-			const Real &rhoi = m_model->getDensity(i);
-			Vector3r &ai = m_model->getAcceleration(i);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-
-				if (particleId.point_set_id == 0)
+				const Vector3r &xi = m_model->getPosition(0, i);
+				const Vector3r &ni = getNormal(i);
+				const Real &rhoi = m_model->getDensity(i);
+				Vector3r &ai = m_model->getAcceleration(i);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					const Real &rhoj = m_model->getDensity(neighborIndex);
-					const Real K_ij = 2.0*density0 / (rhoi + rhoj);
-
-					Vector3r accel;
-					accel.setZero();
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
 
-					// Cohesion force
-					Vector3r xixj = (xi - xj);
-					const Real length2 = xixj.squaredNorm();
-					if (length2 > 1.0e-9)
+					if (particleId.point_set_id == 0)
 					{
-						xixj = ((Real) 1.0 / sqrt(length2)) * xixj;
-						accel -= k * m_model->getMass(neighborIndex) * xixj * CohesionKernel::W(xi - xj);
+						const Real &rhoj = m_model->getDensity(neighborIndex);
+						const Real K_ij = 2.0*density0 / (rhoi + rhoj);
+
+						Vector3r accel;
+						accel.setZero();
+
+						// Cohesion force
+						Vector3r xixj = (xi - xj);
+						const Real length2 = xixj.squaredNorm();
+						if (length2 > 1.0e-9)
+						{
+							xixj = ((Real) 1.0 / sqrt(length2)) * xixj;
+							accel -= k * m_model->getMass(neighborIndex) * xixj * m_model->getCohesionKernel().W(xi - xj);
+						}
+
+						// Curvature
+						const Vector3r &nj = getNormal(neighborIndex);
+						accel -= k * supportRadius* (ni - nj);
+
+						ai += K_ij * accel;
 					}
-
-					// Curvature
-					const Vector3r &nj = getNormal(neighborIndex);
-					accel -= k * supportRadius* (ni - nj);
-
-					ai += K_ij * accel;
-				}
-				else
-				{
-					// adhesion force					
-					Vector3r xixj = (xi - xj);
-					const Real length2 = xixj.squaredNorm();
-					if (length2 > 1.0e-9)
+					else
 					{
-						xixj = ((Real) 1.0 / sqrt(length2)) * xixj;
-						ai -= k * m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * xixj * AdhesionKernel::W(xi - xj);
+						// adhesion force					
+						Vector3r xixj = (xi - xj);
+						const Real length2 = xixj.squaredNorm();
+						if (length2 > 1.0e-9)
+						{
+							xixj = ((Real) 1.0 / sqrt(length2)) * xixj;
+							ai -= k * m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * xixj * m_model->getAdhesionKernel().W(xi - xj);
+						}
 					}
 				}
 			}
@@ -122,7 +130,10 @@ void SurfaceTension_Akinci2013::performNeighborhoodSearchSort()
 	if (numPart == 0)
 		return;
 
-	auto const& d = m_model->getNeighborhoodSearch()->point_set(0);
-	d.sort_field(&m_normals[0]);
+	m_model->sortField(&m_normals[0]);
 }
 
+void SurfaceTension_Akinci2013::getMemoryUsage(MemoryUsage &usage) const
+{
+	usage.addFluidArray("surface tension", m_normals);
+}
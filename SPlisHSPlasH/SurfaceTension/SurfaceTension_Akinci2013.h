@@ -13,7 +13,7 @@ namespace SPH
 	class SurfaceTension_Akinci2013 : public SurfaceTensionBase
 	{
 	protected: 
-		std::vector<Vector3r> m_normals;
+		ParticleVector<Vector3r> m_normals;
 
 	public:
 		SurfaceTension_Akinci2013(FluidModel *model);
@@ -25,6 +25,7 @@ namespace SPH
 		void computeNormals();
 
 		virtual void performNeighborhoodSearchSort();
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 
 		FORCE_INLINE Vector3r &getNormal(const unsigned int i)
 		{
@@ -23,32 +23,36 @@ void SurfaceTension_Becker2007::step()
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			Vector3r &ai = m_model->getAcceleration(i);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-				const Vector3r xixj = xi - xj;
-				const Real r2 = xixj.dot(xixj);
-
-				if (particleId.point_set_id == 0)
+				const Vector3r &xi = m_model->getPosition(0, i);
+				Vector3r &ai = m_model->getAcceleration(i);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					if (r2 > diameter2)
-						ai -= k / m_model->getMass(i) * m_model->getMass(neighborIndex) * (xi - xj) * m_model->W(xi - xj);
-					else
-						ai -= k / m_model->getMass(i) * m_model->getMass(neighborIndex) * (xi - xj) * m_model->W(Vector3r(diameter, 0.0, 0.0));
-				}
-				else
-				{
-					if (r2 > diameter2)
-						ai -= k / m_model->getMass(i) * m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (xi - xj) * m_model->W(xi - xj);
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+					const Vector3r xixj = xi - xj;
+					const Real r2 = xixj.dot(xixj);
+
+					if (particleId.point_set_id == 0)
+					{
+						if (r2 > diameter2)
+							ai -= k / m_model->getMass(i) * m_model->getMass(neighborIndex) * (xi - xj) * m_model->W(xi - xj);
+						else
+							ai -= k / m_model->getMass(i) * m_model->getMass(neighborIndex) * (xi - xj) * m_model->W(Vector3r(diameter, 0.0, 0.0));
+					}
 					else
-						ai -= k / m_model->getMass(i) * m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (xi - xj) * m_model->W(Vector3r(diameter, 0.0, 0.0));
+					{
+						if (r2 > diameter2)
+							ai -= k / m_model->getMass(i) * m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (xi - xj) * m_model->W(xi - xj);
+						else
+							ai -= k / m_model->getMass(i) * m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (xi - xj) * m_model->W(Vector3r(diameter, 0.0, 0.0));
 
+					}
 				}
 			}
 		}
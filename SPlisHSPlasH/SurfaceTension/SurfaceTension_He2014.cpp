@@ -27,26 +27,30 @@ void SurfaceTension_He2014::step()
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			Real &ci = getColor(i);
-			ci = m_model->getMass(i) / m_model->getDensity(i) * m_model->W_zero();
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-
-				if (particleId.point_set_id == 0)
-				{					
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-					const Real density_j = m_model->getDensity(neighborIndex);
-					ci += m_model->getMass(neighborIndex) / density_j * m_model->W(xi - xj);
-				}
-				else
+				const Vector3r &xi = m_model->getPosition(0, i);
+				Real &ci = getColor(i);
+				ci = m_model->getMass(i) / m_model->getDensity(i) * m_model->W_zero();
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-					ci += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * m_model->W(xi - xj);
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+
+					if (particleId.point_set_id == 0)
+					{					
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+						const Real density_j = m_model->getDensity(neighborIndex);
+						ci += m_model->getMass(neighborIndex) / density_j * m_model->W(xi - xj);
+					}
+					else
+					{
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+						ci += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * m_model->W(xi - xj);
+					}
 				}
 			}
 		}
@@ -56,27 +60,31 @@ void SurfaceTension_He2014::step()
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			Vector3r gradC_i;
-			gradC_i.setZero();
-			const Real &density_i = m_model->getDensity(i);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-
-				if (particleId.point_set_id == 0)
+				const Vector3r &xi = m_model->getPosition(0, i);
+				Vector3r gradC_i;
+				gradC_i.setZero();
+				const Real &density_i = m_model->getDensity(i);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-					const Real &density_j = m_model->getDensity(neighborIndex);
-					gradC_i += m_model->getMass(neighborIndex) / density_j * getColor(neighborIndex) * m_model->gradW(xi - xj);
-				}				
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+
+					if (particleId.point_set_id == 0)
+					{
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+						const Real &density_j = m_model->getDensity(neighborIndex);
+						gradC_i += m_model->getMass(neighborIndex) / density_j * getColor(neighborIndex) * m_model->gradW(xi - xj);
+					}				
+				}
+				gradC_i *= (1.0 / getColor(i));
+				Real &gradC2_i = getGradC2(i);
+				gradC2_i = gradC_i.squaredNorm();
 			}
-			gradC_i *= (1.0 / getColor(i));
-			Real &gradC2_i = getGradC2(i);
-			gradC2_i = gradC_i.squaredNorm();
 		}
 	}
 
@@ -84,29 +92,33 @@ void SurfaceTension_He2014::step()
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			const Real &gradC2_i = getGradC2(i);
-			Vector3r &ai = m_model->getAcceleration(i);
-			const Real &density_i = m_model->getDensity(i);
-			const Real factor = 0.25*k / density_i;
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-
-				if (particleId.point_set_id == 0)
+				const Vector3r &xi = m_model->getPosition(0, i);
+				const Real &gradC2_i = getGradC2(i);
+				Vector3r &ai = m_model->getAcceleration(i);
+				const Real &density_i = m_model->getDensity(i);
+				const Real factor = 0.25*k / density_i;
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
 				{
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-					const Real &gradC2_j = getGradC2(neighborIndex);
-					const Real &density_j = m_model->getDensity(neighborIndex);
-					ai += factor*m_model->getMass(neighborIndex) / density_j * (gradC2_i + gradC2_j) * m_model->gradW(xi - xj);
-				}
-				else
-				{
-					const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-					ai += factor*m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * gradC2_i * m_model->gradW(xi - xj);
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					const unsigned int &neighborIndex = particleId.point_id;
+
+					if (particleId.point_set_id == 0)
+					{
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+						const Real &gradC2_j = getGradC2(neighborIndex);
+						const Real &density_j = m_model->getDensity(neighborIndex);
+						ai += factor*m_model->getMass(neighborIndex) / density_j * (gradC2_i + gradC2_j) * m_model->gradW(xi - xj);
+					}
+					else
+					{
+						const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+						ai += factor*m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) / density0 * gradC2_i * m_model->gradW(xi - xj);
+					}
 				}
 			}
 		}
@@ -124,8 +136,12 @@ void SPH::SurfaceTension_He2014::performNeighborhoodSearchSort()
 	if (numPart == 0)
 		return;
 
-	auto const& d = m_model->getNeighborhoodSearch()->point_set(0);
-	d.sort_field(&m_color[0]);
-	d.sort_field(&m_gradC2[0]);
+	m_model->sortField(&m_color[0]);
+	m_model->sortField(&m_gradC2[0]);
 }
 
+void SurfaceTension_He2014::getMemoryUsage(MemoryUsage &usage) const
+{
+	usage.addFluidArray("surface tension", m_color);
+	usage.addFluidArray("surface tension", m_gradC2);
+}
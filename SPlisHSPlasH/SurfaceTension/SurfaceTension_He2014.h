@@ -13,8 +13,8 @@ namespace SPH
 	class SurfaceTension_He2014 : public SurfaceTensionBase
 	{
 	protected: 
-		std::vector<Real> m_color;
-		std::vector<Real> m_gradC2;
+		ParticleVector<Real> m_color;
+		ParticleVector<Real> m_gradC2;
 
 	public:
 		SurfaceTension_He2014(FluidModel *model);
@@ -24,6 +24,7 @@ namespace SPH
 		virtual void reset();
 
 		virtual void performNeighborhoodSearchSort();
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 
 		FORCE_INLINE const Real getColor(const unsigned int i) const
 		{
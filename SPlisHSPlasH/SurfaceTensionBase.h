@@ -19,6 +19,8 @@ namespace SPH
 
 		virtual void step() = 0;
 		virtual void reset() {};
+		/** Add the memory of the method specific particle data (see MemoryUsage). */
+		virtual void getMemoryUsage(MemoryUsage &usage) const {}
 
 		FluidModel *getModel() { return m_model; }
 	};
@@ -0,0 +1,200 @@
+#include "TelemetryLog.h"
+#include "TimeStep.h"
+#include "TimeManager.h"
+#include "FluidModel.h"
+#include "Utilities/Timing.h"
+#include <algorithm>
+#include <limits>
+
+using namespace SPH;
+
+TelemetryLog::TelemetryLog()
+{
+	m_open = false;
+	m_stop = false;
+	m_step = 0;
+}
+
+TelemetryLog::~TelemetryLog()
+{
+	close();
+}
+
+bool TelemetryLog::open(const std::string &fileName)
+{
+	close();
+	m_file.open(fileName.c_str(), std::ios::out);
+	if (!m_file)
+		return false;
+
+	m_open = true;
+	m_stop = false;
+	m_step = 0;
+	m_phaseNames.clear();
+	m_lastPhaseTotals.clear();
+	m_lastRecord = std::chrono::high_resolution_clock::now();
+	m_writer = std::thread(&TelemetryLog::writerLoop, this);
+	return true;
+}
+
+void TelemetryLog::close()
+{
+	if (!m_open)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_one();
+	m_writer.join();
+	m_file.close();
+	m_open = false;
+}
+
+void TelemetryLog::record(TimeStep *timeStep)
+{
+	if (!m_open)
+		return;
+
+	FluidModel *model = timeStep->getModel();
+	const int numParticles = (int)model->numParticles();
+
+	Record rec;
+	rec.step = m_step++;
+	rec.time = model->getTimeManager()->getTime();
+	rec.timeStepSize = model->getTimeManager()->getTimeStepSize();
+	rec.iterations = timeStep->getIterationCount();
+	rec.iterationsV = timeStep->getIterationCountV();
+	rec.densityError = timeStep->getDensityError();
+	rec.densityErrorV = timeStep->getDensityErrorV();
+	rec.toleranceScale = timeStep->getToleranceScale();
+	rec.deadlineMissed = timeStep->getDeadlineMissed();
+
+	//////////////////////////////////////////////////////////////////////////
+	// particle statistics
+	//////////////////////////////////////////////////////////////////////////
+	Real densitySum = 0.0;
+	Real maxVel2 = 0.0;
+	unsigned long long neighborSum = 0;
+	unsigned int minNeighbors = std::numeric_limits<unsigned int>::max();
+	unsigned int maxNeighbors = 0;
+	#pragma omp parallel default(shared)
+	{
+		Real densitySumLocal = 0.0;
+		Real maxVel2Local = 0.0;
+		unsigned long long neighborSumLocal = 0;
+		unsigned int minNeighborsLocal = std::numeric_limits<unsigned int>::max();
+		unsigned int maxNeighborsLocal = 0;
+		#pragma omp for schedule(static) nowait
+		for (int i = 0; i < numParticles; i++)
+		{
+			densitySumLocal += model->getDensity(i);
+			maxVel2Local = std::max(maxVel2Local, model->getVelocity(0, i).squaredNorm());
+			const unsigned int n = model->numberOfNeighbors(i);
+			neighborSumLocal += n;
+			minNeighborsLocal = std::min(minNeighborsLocal, n);
+			maxNeighborsLocal = std::max(maxNeighborsLocal, n);
+		}
+		#pragma omp critical
+		{
+			densitySum += densitySumLocal;
+			maxVel2 = std::max(maxVel2, maxVel2Local);
+			neighborSum += neighborSumLocal;
+			minNeighbors = std::min(minNeighbors, minNeighborsLocal);
+			maxNeighbors = std::max(maxNeighbors, maxNeighborsLocal);
+		}
+	}
+	rec.avgDensity = (numParticles > 0) ? densitySum / numParticles : 0.0;
+	rec.maxVelocity = sqrt(maxVel2);
+	rec.minNeighbors = (numParticles > 0) ? minNeighbors : 0;
+	rec.maxNeighbors = maxNeighbors;
+	rec.avgNeighbors = (numParticles > 0) ? (Real)neighborSum / numParticles : 0.0;
+
+	const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	rec.wallTime = std::chrono::duration<double, std::milli>(now - m_lastRecord).count();
+	m_lastRecord = now;
+
+	//////////////////////////////////////////////////////////////////////////
+	// phase times: difference of the accumulated times since the last record
+	//////////////////////////////////////////////////////////////////////////
+	std::map<std::string, double> totals;
+	for (auto iter = Timing::m_averageTimes.begin(); iter != Timing::m_averageTimes.end(); iter++)
+		totals[iter->second.name] += iter->second.totalTime;
+
+	// phases which are measured for the first time get a new column
+	bool newPhases = false;
+	for (auto iter = totals.begin(); iter != totals.end(); iter++)
+	{
+		if (std::find(m_phaseNames.begin(), m_phaseNames.end(), iter->first) == m_phaseNames.end())
+		{
+			m_phaseNames.push_back(iter->first);
+			newPhases = true;
+		}
+	}
+	if ((rec.step == 0) || newPhases)
+		rec.header = m_phaseNames;
+	rec.phaseTimes.resize(m_phaseNames.size(), 0.0);
+	for (unsigned int p = 0; p < m_phaseNames.size(); p++)
+	{
+		auto iter = totals.find(m_phaseNames[p]);
+		if (iter == totals.end())
+			continue;
+		const double last = m_lastPhaseTotals[m_phaseNames[p]];
+		// the totals start again from zero after Timing::reset()
+		rec.phaseTimes[p] = (iter->second >= last) ? iter->second - last : iter->second;
+	}
+	m_lastPhaseTotals.swap(totals);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(rec);
+	}
+	m_condition.notify_one();
+}
+
+void TelemetryLog::writeHeader(const std::vector<std::string> &phaseNames)
+{
+	m_file << "step,time,h,iterations,iterations_v,density_error,density_error_v,tolerance_scale,deadline_missed,avg_density,max_velocity,"
+		<< "min_neighbors,avg_neighbors,max_neighbors,wall_ms";
+	for (unsigned int p = 0; p < phaseNames.size(); p++)
+		m_file << "," << phaseNames[p] << "_ms";
+	m_file << "\n";
+}
+
+void TelemetryLog::writerLoop()
+{
+	std::vector<Record> records;
+	while (true)
+	{
+		bool stop;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+			records.swap(m_queue);
+			stop = m_stop;
+		}
+
+		for (unsigned int r = 0; r < records.size(); r++)
+		{
+			const Record &rec = records[r];
+			if (!rec.header.empty() || (rec.step == 0))
+				writeHeader(rec.header);
+			m_file << rec.step << "," << rec.time << "," << rec.timeStepSize << "," << rec.iterations << "," << rec.iterationsV << ","
+				<< rec.densityError << "," << rec.densityErrorV << "," << rec.toleranceScale << "," << rec.deadlineMissed << "," << rec.avgDensity << "," << rec.maxVelocity << ","
+				<< rec.minNeighbors << "," << rec.avgNeighbors << "," << rec.maxNeighbors << "," << rec.wallTime;
+			for (unsigned int p = 0; p < rec.phaseTimes.size(); p++)
+				m_file << "," << rec.phaseTimes[p];
+			m_file << "\n";
+		}
+		if (!records.empty())
+			m_file.flush();
+		records.clear();
+
+		if (stop)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_queue.empty())
+				break;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef __TelemetryLog_h__
+#define __TelemetryLog_h__
+
+#include "Common.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace SPH
+{
+	class TimeStep;
+
+	/** \brief Per-step telemetry of a simulation written to a CSV file.
+	*
+	* After each simulation step record() collects the time step size, the solver iterations and
+	* density errors, the average density, the maximal velocity, neighbor count statistics and the
+	* time of each timed phase (see START_TIMING) in this step. The records are formatted and written
+	* by a background thread, so the simulation only pays for the statistics loop over the particles.
+	* If the log is not open, record() returns immediately.
+	*
+	* There is one column for each timed phase. If a phase is measured for the first time after the
+	* first record (e.g. a solver which is enabled later), its column is appended and the extended
+	* header is written again before the record. The previous columns keep their position.
+	*/
+	class TelemetryLog
+	{
+	public:
+		/** \brief Telemetry of a single step. */
+		struct Record
+		{
+			unsigned int step;
+			Real time;
+			Real timeStepSize;
+			unsigned int iterations;
+			unsigned int iterationsV;
+			Real densityError;
+			Real densityErrorV;
+			/** Tolerance scale and deadline miss of the frame budget (see FrameBudget) */
+			Real toleranceScale;
+			bool deadlineMissed;
+			Real avgDensity;
+			Real maxVelocity;
+			unsigned int minNeighbors;
+			unsigned int maxNeighbors;
+			Real avgNeighbors;
+			/** Wall-clock time since the previous record in ms */
+			double wallTime;
+			std::vector<double> phaseTimes;
+			/** Names of the phase columns if the header must be written before this record, otherwise empty */
+			std::vector<std::string> header;
+		};
+
+	protected:
+		bool m_open;
+		std::ofstream m_file;
+		std::thread m_writer;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::vector<Record> m_queue;
+		bool m_stop;
+		unsigned int m_step;
+		/** Phase columns, only used by record() */
+		std::vector<std::string> m_phaseNames;
+		/** Total time of each phase at the previous record */
+		std::map<std::string, double> m_lastPhaseTotals;
+		std::chrono::high_resolution_clock::time_point m_lastRecord;
+
+		void writeHeader(const std::vector<std::string> &phaseNames);
+		void writerLoop();
+
+	public:
+		TelemetryLog();
+		~TelemetryLog();
+
+		/** Open the CSV file and start the writer thread. Returns false if the file cannot be created. */
+		bool open(const std::string &fileName);
+		/** Write all pending records and close the file. */
+		void close();
+		bool isOpen() const { return m_open; }
+
+		/** Record the state after a step of the given time step method. */
+		void record(TimeStep *timeStep);
+	};
+}
+
+#endif
@@ -2,8 +2,6 @@
 
 using namespace SPH;
 
-TimeManager* TimeManager::current = 0;
-
 TimeManager::TimeManager () 
 {
 	time = 0;
@@ -12,26 +10,6 @@ TimeManager::TimeManager ()
 
 TimeManager::~TimeManager () 
 {
-	current = 0;
-}
-
-TimeManager* TimeManager::getCurrent ()
-{
-	if (current == 0)
-	{
-		current = new TimeManager ();
-	}
-	return current;
-}
-
-void TimeManager::setCurrent (TimeManager* tm)
-{
-	current = tm;
-}
-
-bool TimeManager::hasCurrent()
-{
-	return (current != 0);
 }
 
 Real TimeManager::getTime()
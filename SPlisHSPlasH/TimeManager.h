@@ -6,24 +6,18 @@
 namespace SPH
 {
 	/** \brief Class to manage the current simulation time and the time step size. 
-	* This class is a singleton.
+	* Each fluid model has its own time manager (see FluidModel::getTimeManager()).
 	*/
 	class TimeManager
 	{
 	private:
 		Real time;
-		static TimeManager *current;
 		Real h;
 
 	public:
 		TimeManager ();
 		~TimeManager ();
 
-		// Singleton
-		static TimeManager* getCurrent ();
-		static void setCurrent (TimeManager* tm);
-		static bool hasCurrent();
-
 		Real getTime();
 		void setTime(Real t);
 		Real getTimeStepSize();
@@ -17,16 +17,28 @@ TimeStep::TimeStep(FluidModel *model)
 {
 	m_model = model;
 	m_iterations = 0;
+	m_iterationsV = 0;
 	m_cflMethod = 1;
 	m_cflFactor = 0.5;
 	m_cflMaxTimeStepSize = 0.005;
+	m_numberOfTimeStepLevels = 1;
 	m_maxIterations = 100;
 	m_maxError = 0.01;
 	m_maxIterationsV = 100;
 	m_maxErrorV = 0.1;
+	m_maxVel = 0.0;
+	m_maxVelValid = false;
+	m_densityError = 0.0;
+	m_densityErrorV = 0.0;
+	m_toleranceScale = 1.0;
+	m_useDeadline = false;
+	m_deadlineMissed = false;
+	// the methods are compared with the current ones in the setters
 	m_viscosity = NULL;
+	m_viscosityMethod = ViscosityMethods::None;
 	setViscosityMethod(ViscosityMethods::XSPH);
 	m_surfaceTension = NULL;
+	m_surfaceTensionMethod = SurfaceTensionMethods::None;
 	setSurfaceTensionMethod(SurfaceTensionMethods::None);
 }
 
@@ -38,47 +50,122 @@ void TimeStep::clearAccelerations()
 {
 	const unsigned int count = m_model->numParticles();
 	const Vector3r &grav = m_model->getGravitation();
-	for (unsigned int i=0; i < count; i++)
+
+	#pragma omp parallel default(shared)
 	{
-		// Clear accelerations of dynamic particles
-		if (m_model->getMass(i) != 0.0)
+		#pragma omp for schedule(static)  
+		for (int i = 0; i < (int)count; i++)
+			clearAcceleration(i, grav);
+	}
+}
+
+void TimeStep::computeDensity(const unsigned int i)
+{
+	Real &density = m_model->getDensity(i);
+
+	// Compute current density for particle i
+	density = m_model->getMass(i) * m_model->W_zero();
+	const Vector3r &xi = m_model->getPosition(0, i);
+	const unsigned int numNeighbors = m_model->numberOfNeighbors(i);
+
+	// The kernel is evaluated for a batch of neighbors at once
+	Vector3r xixj[KernelBatchSize];
+	Real W_ij[KernelBatchSize];
+	for (unsigned int j0 = 0; j0 < numNeighbors; j0 += KernelBatchSize)
+	{
+		const unsigned int n = std::min(numNeighbors - j0, KernelBatchSize);
+		for (unsigned int k = 0; k < n; k++)
+		{
+			const PointID &particleId = m_model->getNeighbor(i, j0 + k);
+			xixj[k] = xi - m_model->getPosition(particleId.point_set_id, particleId.point_id);
+		}
+		m_model->W(n, xixj, W_ij);
+
+		for (unsigned int k = 0; k < n; k++)
 		{
-			Vector3r &a = m_model->getAcceleration(i);
-			a = grav;
+			const PointID &particleId = m_model->getNeighbor(i, j0 + k);
+			const unsigned int &neighborIndex = particleId.point_id;
+
+			if (particleId.point_set_id == 0)		// Test if fluid particle
+			{
+				density += m_model->getMass(neighborIndex) * W_ij[k];
+			}
+			else 
+			{
+				// Boundary: Akinci2012
+				density += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * W_ij[k];
+			}
 		}
 	}
 }
 
-void TimeStep::computeDensities()
+void TimeStep::computeDensities(const bool clearAccels)
 {
-	const unsigned int numParticles = m_model->numParticles();
-	const Real density0 = m_model->getDensity0();
+	if (m_model->useTiledTraversal())
+	{
+		computeDensitiesTiled(clearAccels);
+		return;
+	}
+
+	const Vector3r &grav = m_model->getGravitation();
 	
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int) numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			Real &density = m_model->getDensity(i);
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+			{
+				if (clearAccels)
+					clearAcceleration(i, grav);
+				computeDensity(i);
+			}
+		}
+	}
+}
 
-			// Compute current density for particle i
-			density = m_model->getMass(i) * m_model->W_zero();
-			const Vector3r &xi = m_model->getPosition(0, i);
+void TimeStep::computeDensitiesTiled(const bool clearAccels)
+{
+	ParticleTiles &tiles = m_model->getParticleTiles();
+	const Real W0 = m_model->W_zero();
+	const Vector3r &grav = m_model->getGravitation();
+	tiles.ensureBlocks();
+
+	#pragma omp parallel default(shared)
+	{
+		ParticleTiles::Block &block = tiles.getBlock();
+		Vector3r xixj[KernelBatchSize];
+		Real W_ij[KernelBatchSize];
 
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+		#pragma omp for schedule(static)  
+		for (int c = 0; c < (int)tiles.numberOfTileChunks(); c++)
+		{
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (unsigned int t = tiles.getTileChunkBegin(c); t < tiles.getTileChunkEnd(c); t++)
 			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+				const ParticleTiles::Tile &tile = tiles.getTile(t);
+				ParticleTiles::gatherPositions(m_model, tile, block);
 
-				if (particleId.point_set_id == 0)		// Test if fluid particle
+				for (unsigned int l = 0; l < tile.numberOfParticles(); l++)
 				{
-					density += m_model->getMass(neighborIndex) * m_model->W(xi - xj);
-				}
-				else 
-				{
-					// Boundary: Akinci2012
-					density += m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * m_model->W(xi - xj);
+					Real density = block.m_weight[l] * W0;
+					const Vector3r &xi = block.m_x[l];
+					const unsigned int numNeighbors = tile.numberOfNeighbors(l);
+					for (unsigned int j0 = 0; j0 < numNeighbors; j0 += KernelBatchSize)
+					{
+						const unsigned int n = std::min(numNeighbors - j0, KernelBatchSize);
+						for (unsigned int k = 0; k < n; k++)
+							xixj[k] = xi - block.m_x[tile.getNeighbor(l, j0 + k)];
+						m_model->W(n, xixj, W_ij);
+
+						// masses and boundary psi are both stored as weight
+						for (unsigned int k = 0; k < n; k++)
+							density += block.m_weight[tile.getNeighbor(l, j0 + k)] * W_ij[k];
+					}
+					m_model->getDensity(tile.getParticleIndex(l)) = density;
+					if (clearAccels)
+						clearAcceleration(tile.getParticleIndex(l), grav);
 				}
 			}
 		}
@@ -91,58 +178,98 @@ void TimeStep::updateTimeStepSize()
 		updateTimeStepSizeCFL(0.0001);
 	else if(m_cflMethod == 2)
 	{
-		Real h = TimeManager::getCurrent()->getTimeStepSize();
+		Real h = m_model->getTimeManager()->getTimeStepSize();
 		updateTimeStepSizeCFL(0.0001);
 		if (m_iterations > 10)
 			h *= 0.9;
 		else if (m_iterations < 5)
 			h *= 1.1;
-		h = min(h, TimeManager::getCurrent()->getTimeStepSize());
-		TimeManager::getCurrent()->setTimeStepSize(h);
+		h = min(h, m_model->getTimeManager()->getTimeStepSize());
+		m_model->getTimeManager()->setTimeStepSize(h);
 	}
+	m_maxVelValid = false;
 }
 
 void TimeStep::updateTimeStepSizeCFL(const Real minTimeStepSize)
 {
 	const Real radius = m_model->getParticleRadius();
-	Real h = TimeManager::getCurrent()->getTimeStepSize();
+	Real h = m_model->getTimeManager()->getTimeStepSize();
 
 	// Approximate max. position change due to current velocities
 	Real maxVel = 0.1;
-	const unsigned int numParticles = m_model->numParticles();
 	const Real diameter = 2.0*radius;
-	for (unsigned int i = 0; i < numParticles; i++)
-	{
-		const Vector3r &vel = m_model->getVelocity(0, i);
-		const Vector3r &accel = m_model->getAcceleration(i);
-		const Real velMag = (vel + accel*h).squaredNorm();
-		if (velMag > maxVel)
-			maxVel = velMag;
-	}
+	if (m_maxVelValid)
+		maxVel = max(maxVel, m_maxVel);
+	maxVel = max(maxVel, computeMaxVelocity(h, !m_maxVelValid));
+	m_maxVelValid = false;
 
-	// boundary particles
-	for (unsigned int i = 0; i < m_model->numberOfRigidBodyParticleObjects(); i++)
+	// Approximate max. time step size 		
+	h = m_cflFactor * .4 * (diameter / (sqrt(maxVel)));
+
+	h = min(h, m_cflMaxTimeStepSize);
+	h = max(h, minTimeStepSize);
+
+	m_model->getTimeManager()->setTimeStepSize(h);
+}
+
+Real TimeStep::computeMaxVelocity(const Real h, const bool fluid)
+{
+	const unsigned int numParticles = m_model->numParticles();
+	Real maxVel = 0.0;
+
+	#pragma omp parallel default(shared)
 	{
-		FluidModel::RigidBodyParticleObject *rbpo = m_model->getRigidBodyParticleObject(i);
-		if (rbpo->m_rigidBody->isDynamic())
+		Real maxVelLocal = 0.0;
+		if (fluid)
 		{
-			for (unsigned int j = 0; j < rbpo->numberOfParticles(); j++)
+			#pragma omp for schedule(static) nowait
+			for (int i = 0; i < (int)numParticles; i++)
 			{
-				const Vector3r &vel = rbpo->m_v[j];
-				const Real velMag = vel.squaredNorm();
-				if (velMag > maxVel)
-					maxVel = velMag;
+				const Vector3r &vel = m_model->getVelocity(0, i);
+				const Vector3r &accel = m_model->getAcceleration(i);
+				const Real velMag = (vel + accel*h).squaredNorm();
+				if (velMag > maxVelLocal)
+					maxVelLocal = velMag;
 			}
 		}
-	}
 
-	// Approximate max. time step size 		
-	h = m_cflFactor * .4 * (diameter / (sqrt(maxVel)));
+		// boundary particles
+		for (unsigned int i = 0; i < m_model->numberOfRigidBodyParticleObjects(); i++)
+		{
+			FluidModel::RigidBodyParticleObject *rbpo = m_model->getRigidBodyParticleObject(i);
+			if (rbpo->m_rigidBody->isDynamic())
+			{
+				#pragma omp for schedule(static) nowait
+				for (int j = 0; j < (int)rbpo->numberOfParticles(); j++)
+				{
+					const Real velMag = rbpo->m_v[j].squaredNorm();
+					if (velMag > maxVelLocal)
+						maxVelLocal = velMag;
+				}
+			}
+		}
 
-	h = min(h, m_cflMaxTimeStepSize);
-	h = max(h, minTimeStepSize);
+		#pragma omp critical
+		{
+			if (maxVelLocal > maxVel)
+				maxVel = maxVelLocal;
+		}
+	}
+	return maxVel;
+}
 
-	TimeManager::getCurrent()->setTimeStepSize(h);
+void TimeStep::updateMaxVelocity(const Real maxVelLocal)
+{
+	#pragma omp critical
+	{
+		if (!m_maxVelValid)
+		{
+			m_maxVel = maxVelLocal;
+			m_maxVelValid = true;
+		}
+		else if (maxVelLocal > m_maxVel)
+			m_maxVel = maxVelLocal;
+	}
 }
 
 void TimeStep::computeSurfaceTension()
@@ -160,7 +287,14 @@ void TimeStep::computeViscosity()
 void TimeStep::performNeighborhoodSearch()
 {
 	START_TIMING("neighborhood_search");
-	m_model->getNeighborhoodSearch()->find_neighbors();
+	// with Verlet lists the search is only performed if a particle has left the skin
+	if (m_model->neighborhoodSearchRequired())
+	{
+		m_model->getNeighborhoodSearch()->find_neighbors();
+		m_model->storeNeighborhoodSearchPositions();
+		m_model->updateParticleChunks();
+	}
+	m_model->updateParticleTiles();
 	STOP_TIMING_AVG;
 }
 
@@ -172,6 +306,29 @@ void TimeStep::reset()
 	if (m_viscosity)
 		m_viscosity->reset();
 	m_iterations = 0;
+	m_iterationsV = 0;
+	m_densityError = 0.0;
+	m_densityErrorV = 0.0;
+}
+
+void TimeStep::checkDeadline(const unsigned int iterations, const unsigned int minIterations, const bool converged, unsigned int &maxIterations)
+{
+	if (!m_useDeadline || converged || (iterations < minIterations) || (iterations >= maxIterations))
+		return;
+	if (std::chrono::high_resolution_clock::now() >= m_deadline)
+	{
+		maxIterations = iterations;
+		m_deadlineMissed = true;
+	}
+}
+
+void TimeStep::getMemoryUsage(MemoryUsage &usage) const
+{
+	m_model->getMemoryUsage(usage);
+	if (m_surfaceTension)
+		m_surfaceTension->getMemoryUsage(usage);
+	if (m_viscosity)
+		m_viscosity->getMemoryUsage(usage);
 }
 
 void TimeStep::setSurfaceTensionMethod(SurfaceTensionMethods val)
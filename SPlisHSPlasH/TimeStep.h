@@ -5,6 +5,7 @@
 #include "FluidModel.h"
 #include "SurfaceTensionBase.h"
 #include "ViscosityBase.h"
+#include <chrono>
 
 namespace SPH
 {
@@ -12,6 +13,12 @@ namespace SPH
 	enum class ViscosityMethods { None = 0, Standard, XSPH }; 
 
 	/** \brief Base class for the simulation methods. 
+	*
+	* The iterative pressure solvers run their initialization, all iterations and the finalization 
+	* in a single persistent parallel region. The other phases of a step (neighborhood search, 
+	* non-pressure forces, integration, CFL condition) open their own regions, since they are 
+	* implemented by separate modules like the neighborhood search backends, which cannot take 
+	* part in a region of the caller.
 	*/
 	class TimeStep
 	{
@@ -22,6 +29,9 @@ namespace SPH
 		unsigned int m_cflMethod;
 		Real m_cflFactor;
 		Real m_cflMaxTimeStepSize;
+		/** Number of power-of-two time step levels of the multi-rate integration. 
+		* A value of 1 means that all particles use the global time step size. */
+		unsigned int m_numberOfTimeStepLevels;
 		Real m_maxError;
 		unsigned int m_maxIterations;
 		Real m_maxErrorV;
@@ -30,14 +40,48 @@ namespace SPH
 		SurfaceTensionBase *m_surfaceTension;
 		ViscosityMethods m_viscosityMethod;
 		ViscosityBase *m_viscosity;
+		/** Max. squared velocity of the fluid particles which was determined in an integration loop 
+		* of the solver. If it is valid, updateTimeStepSizeCFL() does not loop over the fluid particles. */
+		Real m_maxVel;
+		bool m_maxVelValid;
+		/** Average density error of the last pressure solve and divergence solve in percent */
+		Real m_densityError;
+		Real m_densityErrorV;
+		/** Scale factor of the max. density errors m_maxError and m_maxErrorV. A frame budget
+		* (see FrameBudget) increases it to trade incompressibility for a stable frame rate. */
+		Real m_toleranceScale;
+		/** Wall-clock deadline of the current step (see setDeadline()) */
+		bool m_useDeadline;
+		std::chrono::high_resolution_clock::time_point m_deadline;
+		/** True if a solver of the current step stopped at the deadline */
+		bool m_deadlineMissed;
 
 		/** Clear accelerations and add gravitation.
 		*/
 		void clearAccelerations();
 
-		/** Determine densities of all fluid particles.
+		/** Clear the acceleration of particle i and add gravitation.
 		*/
-		void computeDensities();
+		FORCE_INLINE void clearAcceleration(const unsigned int i, const Vector3r &grav)
+		{
+			// Clear accelerations of dynamic particles
+			if (m_model->getMass(i) != 0.0)
+				m_model->getAcceleration(i) = grav;
+		}
+
+		/** Determine densities of all fluid particles. If clearAccels is set, the accelerations 
+		* are cleared in the same loop (see clearAccelerations()).
+		*/
+		void computeDensities(const bool clearAccels = false);
+
+		/** Determine densities of all fluid particles by a loop over the particle tiles
+		* (see FluidModel::useTiledTraversal()).
+		*/
+		void computeDensitiesTiled(const bool clearAccels);
+
+		/** Determine the density of the fluid particle with index i.
+		*/
+		void computeDensity(const unsigned int i);
 
 		/** Update time step size depending on the chosen method.
 		*/
@@ -47,6 +91,24 @@ namespace SPH
 		*/
 		void updateTimeStepSizeCFL(const Real minTimeStepSize);
 
+		/** Determine the max. squared velocity (v + a*h) of all fluid particles and of the particles 
+		* of the dynamic boundary objects.
+		*/
+		Real computeMaxVelocity(const Real h, const bool fluid);
+
+		/** Merge the max. squared velocity of the fluid particles which were processed by the calling thread.
+		* A solver which computes v + a*h in an integration loop before the time step size is updated 
+		* can call this method in each thread of the parallel region to avoid an additional pass 
+		* over the particles in updateTimeStepSizeCFL().
+		*/
+		void updateMaxVelocity(const Real maxVelLocal);
+
+		/** Limit the iterations of a solver loop by the deadline of the step. This is called by a single
+		* thread after each iteration. If the solver has not converged, did at least minIterations
+		* iterations and the deadline has passed, maxIterations is set to the current iteration count.
+		*/
+		void checkDeadline(const unsigned int iterations, const unsigned int minIterations, const bool converged, unsigned int &maxIterations);
+
 		/** Perform the neighborhood search for all fluid particles.
 		*/
 		virtual void performNeighborhoodSearch();
@@ -59,10 +121,16 @@ namespace SPH
 
 		virtual void step() = 0;
 		virtual void reset();
+		/** Add the memory of the model, the solver data and the surface tension and viscosity methods (see MemoryUsage). */
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 
 		FluidModel *getModel() { return m_model; }
 		unsigned int getIterationCount() const { return m_iterations; }
 		unsigned int getIterationCountV() const { return m_iterationsV; }
+		/** Average density error of the last pressure solve in percent (zero if the method has no pressure solver). */
+		Real getDensityError() const { return m_densityError; }
+		/** Average density change of the last divergence solve in percent per time step. */
+		Real getDensityErrorV() const { return m_densityErrorV; }
 		
 		unsigned int getCflMethod() const { return m_cflMethod; }
 		void setCflMethod(unsigned int val) { m_cflMethod = val; }
@@ -70,6 +138,8 @@ namespace SPH
 		void setCflFactor(Real val) { m_cflFactor = val; }
 		Real getCflMaxTimeStepSize() const { return m_cflMaxTimeStepSize; }
 		void setCflMaxTimeStepSize(Real val) { m_cflMaxTimeStepSize = val; }
+		unsigned int getNumberOfTimeStepLevels() const { return m_numberOfTimeStepLevels; }
+		void setNumberOfTimeStepLevels(unsigned int val) { m_numberOfTimeStepLevels = (val > 0) ? val : 1; }
 		Real getMaxError() const { return m_maxError; }
 		void setMaxError(Real val) { m_maxError = val; }
 		unsigned int getMaxIterations() const { return m_maxIterations; }
@@ -78,6 +148,14 @@ namespace SPH
 		void setMaxErrorV(Real val) { m_maxErrorV = val; }
 		unsigned int getMaxIterationsV() const { return m_maxIterationsV; }
 		void setMaxIterationsV(unsigned int val) { m_maxIterationsV = val; }
+		Real getToleranceScale() const { return m_toleranceScale; }
+		void setToleranceScale(Real val) { m_toleranceScale = (val > 1.0) ? val : 1.0; }
+		/** The pressure and divergence solvers of the next step stop after their minimal number of 
+		* iterations when the deadline has passed, even if they have not converged. */
+		void setDeadline(const std::chrono::high_resolution_clock::time_point &deadline) { m_deadline = deadline; m_useDeadline = true; m_deadlineMissed = false; }
+		void clearDeadline() { m_useDeadline = false; m_deadlineMissed = false; }
+		/** True if a solver stopped at the deadline before it converged (see setDeadline()). */
+		bool getDeadlineMissed() const { return m_deadlineMissed; }
 		SurfaceTensionMethods getSurfaceTensionMethod() const { return m_surfaceTensionMethod; }
 		void setSurfaceTensionMethod(SurfaceTensionMethods val);
 		ViscosityMethods getViscosityMethod() const { return m_viscosityMethod; }
@@ -0,0 +1,146 @@
+#include "MemoryUsage.h"
+#include "ParticleAllocator.h"
+#include <fstream>
+#include <iomanip>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+using namespace SPH;
+
+MemoryUsage::MemoryUsage(const unsigned int numFluidParticles, const unsigned int numBoundaryParticles) :
+	m_numFluidParticles(numFluidParticles), m_numBoundaryParticles(numBoundaryParticles)
+{
+}
+
+MemoryUsage::Entry& MemoryUsage::getEntry(const std::string &subsystem)
+{
+	for (unsigned int i = 0; i < m_entries.size(); i++)
+		if (m_entries[i].name == subsystem)
+			return m_entries[i];
+	Entry entry;
+	entry.name = subsystem;
+	entry.bytes = 0;
+	entry.bytesPerFluidParticle = 0;
+	entry.bytesPerBoundaryParticle = 0;
+	m_entries.push_back(entry);
+	return m_entries.back();
+}
+
+void MemoryUsage::add(const std::string &subsystem, const std::size_t bytes, const std::size_t bytesPerFluidParticle, const std::size_t bytesPerBoundaryParticle)
+{
+	Entry &entry = getEntry(subsystem);
+	entry.bytes += bytes;
+	entry.bytesPerFluidParticle += bytesPerFluidParticle;
+	entry.bytesPerBoundaryParticle += bytesPerBoundaryParticle;
+}
+
+std::size_t MemoryUsage::getTotalBytes() const
+{
+	std::size_t total = 0;
+	for (unsigned int i = 0; i < m_entries.size(); i++)
+		total += m_entries[i].bytes;
+	return total;
+}
+
+std::size_t MemoryUsage::predict(const Entry &entry, const unsigned int numFluidParticles, const unsigned int numBoundaryParticles) const
+{
+	const std::size_t particleBytes = entry.bytesPerFluidParticle * m_numFluidParticles + entry.bytesPerBoundaryParticle * m_numBoundaryParticles;
+	// the capacity of growing arrays can exceed the particle part
+	const std::size_t fixedBytes = (entry.bytes > particleBytes) ? entry.bytes - particleBytes : 0;
+	return fixedBytes + entry.bytesPerFluidParticle * numFluidParticles + entry.bytesPerBoundaryParticle * numBoundaryParticles;
+}
+
+std::size_t MemoryUsage::predict(const unsigned int numFluidParticles, const unsigned int numBoundaryParticles) const
+{
+	std::size_t total = 0;
+	for (unsigned int i = 0; i < m_entries.size(); i++)
+		total += predict(m_entries[i], numFluidParticles, numBoundaryParticles);
+	return total;
+}
+
+void MemoryUsage::print(std::ostream &out) const
+{
+	const double MB = 1024.0 * 1024.0;
+	const std::size_t total = getTotalBytes();
+	const std::ios_base::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(2);
+	out << "Memory usage (" << m_numFluidParticles << " fluid particles, " << m_numBoundaryParticles << " boundary particles):\n";
+	for (unsigned int i = 0; i < m_entries.size(); i++)
+	{
+		const Entry &e = m_entries[i];
+		if (e.bytes == 0)
+			continue;
+		out << "  " << std::left << std::setw(24) << e.name << std::right << std::setw(10) << e.bytes / MB << " MB"
+			<< std::setw(8) << ((total > 0) ? 100.0 * e.bytes / total : 0.0) << " %";
+		if (e.bytesPerFluidParticle > 0)
+			out << ", " << e.bytesPerFluidParticle << " bytes / fluid particle";
+		if (e.bytesPerBoundaryParticle > 0)
+			out << ", " << e.bytesPerBoundaryParticle << " bytes / boundary particle";
+		out << "\n";
+	}
+	out << "  " << std::left << std::setw(24) << "total" << std::right << std::setw(10) << total / MB << " MB\n";
+	out << "  particle arrays: " << ParticleMemory::getAllocatedBytes() / MB << " MB allocated, "
+		<< ParticleMemory::getPeakAllocatedBytes() / MB << " MB peak\n";
+	const std::size_t rss = getResidentMemory();
+	const std::size_t peakRss = getPeakResidentMemory();
+	if (peakRss > 0)
+		out << "  process: " << rss / MB << " MB resident, " << peakRss / MB << " MB peak\n";
+	out.flags(flags);
+	out.precision(precision);
+}
+
+#ifdef __linux__
+/** Read a value in kB from /proc/self/status. */
+static std::size_t readProcStatus(const std::string &key)
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, key.size(), key) == 0)
+			return (std::size_t)std::stoull(line.substr(key.size())) * 1024;
+	}
+	return 0;
+}
+#endif
+
+std::size_t MemoryUsage::getResidentMemory()
+{
+#if defined(WIN32) || defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return (std::size_t)pmc.WorkingSetSize;
+	return 0;
+#elif defined(__linux__)
+	return readProcStatus("VmRSS:");
+#else
+	return 0;
+#endif
+}
+
+std::size_t MemoryUsage::getPeakResidentMemory()
+{
+#if defined(WIN32) || defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return (std::size_t)pmc.PeakWorkingSetSize;
+	return 0;
+#elif defined(__linux__)
+	return readProcStatus("VmHWM:");
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return (std::size_t)usage.ru_maxrss;
+#else
+	return (std::size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
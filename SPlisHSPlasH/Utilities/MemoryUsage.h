@@ -0,0 +1,89 @@
+#ifndef __MemoryUsage_h__
+#define __MemoryUsage_h__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace SPH
+{
+	/** \brief Memory footprint of the subsystems of a simulation.
+	*
+	* The subsystems add the bytes of their arrays (capacity, not size) by FluidModel::getMemoryUsage()
+	* and TimeStep::getMemoryUsage(). Arrays with one entry per fluid or boundary particle also add
+	* their bytes per particle, so that the footprint for other particle counts can be predicted by
+	* predict() before a simulation with these counts is started. The prediction of the neighbor lists
+	* is based on the average number of neighbors of the measured model.
+	*/
+	class MemoryUsage
+	{
+	public:
+		/** \brief Bytes of a subsystem. */
+		struct Entry
+		{
+			std::string name;
+			std::size_t bytes;
+			std::size_t bytesPerFluidParticle;
+			std::size_t bytesPerBoundaryParticle;
+		};
+
+	protected:
+		std::vector<Entry> m_entries;
+		unsigned int m_numFluidParticles;
+		unsigned int m_numBoundaryParticles;
+
+		Entry& getEntry(const std::string &subsystem);
+
+	public:
+		MemoryUsage(const unsigned int numFluidParticles = 0, const unsigned int numBoundaryParticles = 0);
+
+		/** Add bytes to a subsystem, bytesPerFluidParticle and bytesPerBoundaryParticle are the parts
+		* which scale with the number of particles. */
+		void add(const std::string &subsystem, const std::size_t bytes, const std::size_t bytesPerFluidParticle = 0, const std::size_t bytesPerBoundaryParticle = 0);
+
+		/** Add an array with one entry per fluid particle. */
+		template<class VectorType>
+		void addFluidArray(const std::string &subsystem, const VectorType &v)
+		{
+			add(subsystem, v.capacity() * sizeof(typename VectorType::value_type), sizeof(typename VectorType::value_type), 0);
+		}
+
+		/** Add an array with one entry per boundary particle. */
+		template<class VectorType>
+		void addBoundaryArray(const std::string &subsystem, const VectorType &v)
+		{
+			add(subsystem, v.capacity() * sizeof(typename VectorType::value_type), 0, sizeof(typename VectorType::value_type));
+		}
+
+		/** Add an array whose size does not depend on the number of particles. */
+		template<class VectorType>
+		void addArray(const std::string &subsystem, const VectorType &v)
+		{
+			add(subsystem, v.capacity() * sizeof(typename VectorType::value_type));
+		}
+
+		const std::vector<Entry>& getEntries() const { return m_entries; }
+		unsigned int getNumberOfFluidParticles() const { return m_numFluidParticles; }
+		unsigned int getNumberOfBoundaryParticles() const { return m_numBoundaryParticles; }
+		std::size_t getTotalBytes() const;
+
+		/** Predict the bytes of an entry for the given numbers of particles. The part which does not
+		* scale with the particles is kept. */
+		std::size_t predict(const Entry &entry, const unsigned int numFluidParticles, const unsigned int numBoundaryParticles) const;
+		/** Predict the total bytes for the given numbers of particles. */
+		std::size_t predict(const unsigned int numFluidParticles, const unsigned int numBoundaryParticles) const;
+
+		/** Print the bytes, the bytes per fluid particle and the share of each subsystem together with
+		* the allocated and peak bytes of the particle arrays (see ParticleMemory) and the resident
+		* memory of the process. */
+		void print(std::ostream &out) const;
+
+		/** Resident set size of the process in bytes (0 if not supported) */
+		static std::size_t getResidentMemory();
+		/** Peak resident set size of the process in bytes (0 if not supported) */
+		static std::size_t getPeakResidentMemory();
+	};
+}
+
+#endif
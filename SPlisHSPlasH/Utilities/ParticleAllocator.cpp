@@ -0,0 +1,178 @@
+#include "ParticleAllocator.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(WIN32) || defined(_WIN32)
+#include <malloc.h>
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+using namespace SPH;
+
+bool ParticleMemory::m_firstTouch = true;
+bool ParticleMemory::m_hugePages = false;
+ThreadPinning ParticleMemory::m_threadPinning = ThreadPinning::None;
+std::atomic<size_t> ParticleMemory::m_allocatedBytes(0);
+std::atomic<size_t> ParticleMemory::m_peakAllocatedBytes(0);
+
+/** Smaller arrays are touched by the calling thread */
+static const size_t minParallelFirstTouchBytes = 64 * 1024;
+
+
+void *ParticleMemory::allocate(const size_t numBytes)
+{
+	if (numBytes == 0)
+		return NULL;
+
+	void *p = NULL;
+#if defined(WIN32) || defined(_WIN32)
+	p = _aligned_malloc(numBytes, Alignment);
+#else
+	size_t alignment = Alignment;
+	size_t size = numBytes;
+#ifdef __linux__
+	if (m_hugePages && (numBytes >= HugePageSize))
+	{
+		alignment = HugePageSize;
+		size = ((numBytes + HugePageSize - 1) / HugePageSize) * HugePageSize;
+	}
+#endif
+	if (posix_memalign(&p, alignment, size) != 0)
+		p = NULL;
+#ifdef __linux__
+	// The kernel only backs the range by huge pages if it is aligned and
+	// if the advice is given before the pages are touched.
+	if ((p != NULL) && (alignment == HugePageSize))
+		madvise(p, size, MADV_HUGEPAGE);
+#endif
+#endif
+	if (p == NULL)
+		throw std::bad_alloc();
+
+	const size_t allocatedBytes = (m_allocatedBytes += numBytes);
+	size_t peak = m_peakAllocatedBytes;
+	while ((allocatedBytes > peak) && !m_peakAllocatedBytes.compare_exchange_weak(peak, allocatedBytes)) {}
+
+#ifdef _OPENMP
+	// Touch the memory in equal slices, so that each page is placed on the NUMA node of the
+	// thread that processes the corresponding particles in a uniform partition (see class doc).
+	if (m_firstTouch && (numBytes >= minParallelFirstTouchBytes) && !omp_in_parallel())
+	{
+		char *bytes = static_cast<char*>(p);
+		#pragma omp parallel default(shared)
+		{
+			const size_t numThreads = (size_t)omp_get_num_threads();
+			const size_t t = (size_t)omp_get_thread_num();
+			const size_t begin = (numBytes * t) / numThreads;
+			const size_t end = (numBytes * (t + 1)) / numThreads;
+			memset(bytes + begin, 0, end - begin);
+		}
+	}
+#endif
+	return p;
+}
+
+void ParticleMemory::deallocate(void *p, const size_t numBytes)
+{
+	if (p == NULL)
+		return;
+	m_allocatedBytes -= numBytes;
+#if defined(WIN32) || defined(_WIN32)
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+bool ParticleMemory::pinThreads(const ThreadPinning pinning)
+{
+	bool success = true;
+#if defined(__linux__)
+	// affinity mask of the process before any thread was pinned
+	static cpu_set_t processMask;
+	static bool processMaskValid = (sched_getaffinity(0, sizeof(cpu_set_t), &processMask) == 0);
+	if (!processMaskValid)
+		return false;
+
+	std::vector<int> cpus;
+	for (int i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &processMask))
+			cpus.push_back(i);
+	if (cpus.empty())
+		return false;
+
+	#pragma omp parallel default(shared)
+	{
+#ifdef _OPENMP
+		const size_t numThreads = (size_t)omp_get_num_threads();
+		const size_t t = (size_t)omp_get_thread_num();
+#else
+		const size_t numThreads = 1;
+		const size_t t = 0;
+#endif
+		cpu_set_t mask;
+		if (pinning == ThreadPinning::None)
+			mask = processMask;
+		else
+		{
+			size_t cpu;
+			if (pinning == ThreadPinning::Compact)
+				cpu = t % cpus.size();
+			else
+				cpu = ((t * cpus.size()) / numThreads) % cpus.size();
+			CPU_ZERO(&mask);
+			CPU_SET(cpus[cpu], &mask);
+		}
+		// pid 0 sets the affinity of the calling thread
+		if (sched_setaffinity(0, sizeof(cpu_set_t), &mask) != 0)
+		{
+			#pragma omp critical (pinThreads)
+			success = false;
+		}
+	}
+#elif defined(WIN32) || defined(_WIN32)
+	DWORD_PTR processMask, systemMask;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		return false;
+
+	std::vector<unsigned int> cpus;
+	for (unsigned int i = 0; i < 8 * sizeof(DWORD_PTR); i++)
+		if (processMask & ((DWORD_PTR)1 << i))
+			cpus.push_back(i);
+	if (cpus.empty())
+		return false;
+
+	#pragma omp parallel default(shared)
+	{
+#ifdef _OPENMP
+		const size_t numThreads = (size_t)omp_get_num_threads();
+		const size_t t = (size_t)omp_get_thread_num();
+#else
+		const size_t numThreads = 1;
+		const size_t t = 0;
+#endif
+		DWORD_PTR mask = processMask;
+		if (pinning == ThreadPinning::Compact)
+			mask = (DWORD_PTR)1 << cpus[t % cpus.size()];
+		else if (pinning == ThreadPinning::Spread)
+			mask = (DWORD_PTR)1 << cpus[((t * cpus.size()) / numThreads) % cpus.size()];
+		if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+		{
+			#pragma omp critical (pinThreads)
+			success = false;
+		}
+	}
+#else
+	success = (pinning == ThreadPinning::None);
+#endif
+	if (success)
+		m_threadPinning = pinning;
+	return success;
+}
@@ -0,0 +1,109 @@
+#ifndef __ParticleAllocator_h__
+#define __ParticleAllocator_h__
+
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <vector>
+
+namespace SPH
+{
+	/** \brief Placement of the OpenMP threads on the CPUs (see ParticleMemory::pinThreads()).
+	*/
+	enum class ThreadPinning { None = 0, Compact, Spread };
+
+	/** \brief Memory management of the big particle arrays.
+	*
+	* The pages of an array are placed on the NUMA node of the thread which writes them first.
+	* Therefore, new arrays are first touched in parallel, each thread writes an equal slice of
+	* the array. For per-particle arrays this is the uniform partition of the particles which the
+	* solver loops use until the first neighborhood search. Afterwards the loops use chunks with
+	* the same number of neighbors (see FluidModel::updateParticleChunks()), so the ranges of the
+	* threads differ from the touched slices by the imbalance of the neighbor counts, e.g. near
+	* the free surface. The pages are not migrated when the chunks change. Optionally, arrays
+	* of at least 2 MB are backed by transparent huge pages (Linux only).
+	*
+	* The settings and the byte counts are process-global, they are not part of a FluidModel.
+	* With several models in one process (e.g. EnsembleRunner) the settings apply to the arrays
+	* of all models which are allocated afterwards and the counts are the sums over all models.
+	* The settings should only be changed while no model allocates arrays.
+	*/
+	class ParticleMemory
+	{
+	protected:
+		static bool m_firstTouch;
+		static bool m_hugePages;
+		static ThreadPinning m_threadPinning;
+		static std::atomic<size_t> m_allocatedBytes;
+		static std::atomic<size_t> m_peakAllocatedBytes;
+
+	public:
+		/** Alignment of the arrays in bytes (cache line) */
+		static const size_t Alignment = 64;
+		/** Size of a huge page in bytes */
+		static const size_t HugePageSize = 2 * 1024 * 1024;
+
+		static bool getFirstTouch() { return m_firstTouch; }
+		static void setFirstTouch(const bool val) { m_firstTouch = val; }
+		static bool getHugePages() { return m_hugePages; }
+		static void setHugePages(const bool val) { m_hugePages = val; }
+		static ThreadPinning getThreadPinning() { return m_threadPinning; }
+
+		static void *allocate(const size_t numBytes);
+		static void deallocate(void *p, const size_t numBytes);
+
+		/** Bytes of all particle arrays which are currently allocated */
+		static size_t getAllocatedBytes() { return m_allocatedBytes; }
+		/** Maximum of getAllocatedBytes() since the start or the last resetPeakAllocatedBytes() */
+		static size_t getPeakAllocatedBytes() { return m_peakAllocatedBytes; }
+		static void resetPeakAllocatedBytes() { m_peakAllocatedBytes = (size_t)m_allocatedBytes; }
+
+		/** Pin each OpenMP thread to one CPU of the affinity mask of the process.
+		* Compact places consecutive threads on consecutive CPUs, spread distributes
+		* them evenly over all CPUs (and therefore over all sockets). None restores
+		* the original mask. Returns false if pinning is not supported on this system.
+		* The OpenMP environment variables OMP_PROC_BIND/OMP_PLACES are an alternative.
+		*/
+		static bool pinThreads(const ThreadPinning pinning);
+	};
+
+	/** \brief Allocator for particle arrays, see ParticleMemory.
+	*/
+	template<class T>
+	class ParticleAllocator
+	{
+	public:
+		typedef T value_type;
+
+		ParticleAllocator() {}
+		template<class U>
+		ParticleAllocator(const ParticleAllocator<U> &) {}
+
+		T *allocate(const size_t n)
+		{
+			if (n > ((size_t)-1) / sizeof(T))
+				throw std::bad_alloc();
+			return static_cast<T*>(ParticleMemory::allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T *p, const size_t n)
+		{
+			ParticleMemory::deallocate(p, n * sizeof(T));
+		}
+
+		template<class U>
+		struct rebind { typedef ParticleAllocator<U> other; };
+	};
+
+	template<class T, class U>
+	bool operator==(const ParticleAllocator<T> &, const ParticleAllocator<U> &) { return true; }
+	template<class T, class U>
+	bool operator!=(const ParticleAllocator<T> &, const ParticleAllocator<U> &) { return false; }
+
+	/** \brief Array of per-particle data which is distributed over the NUMA nodes.
+	*/
+	template<class T>
+	using ParticleVector = std::vector<T, ParticleAllocator<T> >;
+}
+
+#endif
@@ -0,0 +1,145 @@
+#include "PerformanceCounters.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__linux__)
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace SPH;
+
+bool PerformanceCounters::m_enabled = false;
+bool PerformanceCounters::m_available[PerformanceCounters::NumEvents] = { false, false, false, false };
+std::vector<PerformanceCounters::Event> PerformanceCounters::m_groupEvents;
+std::vector<int> PerformanceCounters::m_fds;
+
+#if defined(__linux__)
+static int openCounter(const PerformanceCounters::Event e, const int tid, const int groupFd)
+{
+	static const unsigned long long config[PerformanceCounters::NumEvents] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES };
+
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(perf_event_attr));
+	attr.size = sizeof(perf_event_attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config[e];
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// the group is enabled by its leader
+	attr.disabled = (groupFd == -1) ? 1 : 0;
+	return (int)syscall(__NR_perf_event_open, &attr, tid, -1, groupFd, 0);
+}
+#endif
+
+bool PerformanceCounters::enable()
+{
+	disable();
+#if defined(__linux__)
+	// thread ids of the OpenMP team
+	std::vector<int> tids;
+	#pragma omp parallel default(shared)
+	{
+#ifdef _OPENMP
+		const int numThreads = omp_get_num_threads();
+		const int t = omp_get_thread_num();
+#else
+		const int numThreads = 1;
+		const int t = 0;
+#endif
+		#pragma omp single
+		tids.resize(numThreads);
+		tids[t] = (int)syscall(SYS_gettid);
+	}
+
+	m_fds.resize(tids.size() * NumEvents, -1);
+	for (unsigned int t = 0; t < tids.size(); t++)
+	{
+		int *fds = &m_fds[t * NumEvents];
+		int leader = -1;
+		for (unsigned int i = 0; i < NumEvents; i++)
+		{
+			const Event e = (Event)i;
+			// all threads must count the events of the first thread
+			if ((t > 0) && !m_available[e])
+				continue;
+			fds[e] = openCounter(e, tids[t], leader);
+			if (fds[e] == -1)
+			{
+				if (t > 0)
+				{
+					disable();
+					return false;
+				}
+				continue;
+			}
+			if (leader == -1)
+				leader = fds[e];
+			if (t == 0)
+			{
+				m_available[e] = true;
+				m_groupEvents.push_back(e);
+			}
+		}
+		if (leader == -1)
+		{
+			disable();
+			return false;
+		}
+		ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+	m_enabled = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PerformanceCounters::disable()
+{
+#if defined(__linux__)
+	for (unsigned int i = 0; i < m_fds.size(); i++)
+		if (m_fds[i] != -1)
+			close(m_fds[i]);
+#endif
+	m_fds.clear();
+	m_groupEvents.clear();
+	for (unsigned int i = 0; i < NumEvents; i++)
+		m_available[i] = false;
+	m_enabled = false;
+}
+
+const char *PerformanceCounters::getEventName(const Event e)
+{
+	static const char *names[NumEvents] = { "cycles", "instructions", "cache references", "cache misses" };
+	return names[e];
+}
+
+void PerformanceCounters::read(Values &values)
+{
+	values.setZero();
+#if defined(__linux__)
+	if (!m_enabled)
+		return;
+	const unsigned int numThreads = (unsigned int)(m_fds.size() / NumEvents);
+	// PERF_FORMAT_GROUP: number of events followed by the values in the order of the group
+	unsigned long long buffer[1 + NumEvents];
+	for (unsigned int t = 0; t < numThreads; t++)
+	{
+		const int leader = m_fds[t * NumEvents + m_groupEvents[0]];
+		if (::read(leader, buffer, sizeof(buffer)) <= 0)
+			continue;
+		const unsigned int n = (unsigned int)buffer[0];
+		for (unsigned int i = 0; (i < n) && (i < m_groupEvents.size()); i++)
+			values.value[m_groupEvents[i]] += buffer[1 + i];
+	}
+#endif
+}
@@ -0,0 +1,66 @@
+#ifndef __PerformanceCounters_h__
+#define __PerformanceCounters_h__
+
+#include <vector>
+
+namespace SPH
+{
+	/** \brief Hardware performance counters of the OpenMP threads (Linux perf_event_open).
+	*
+	* enable() opens a counter group (cycles, instructions, last level cache references and misses)
+	* for each thread of the current OpenMP team. read() returns the sum over all threads. The time
+	* measurements of Timing read the counters at START_TIMING and STOP_TIMING_AVG if the counters
+	* are enabled and accumulate the difference per scope.
+	*
+	* Only user space events are counted, so that the default perf_event_paranoid level suffices.
+	* If the counters are not supported (other OS, missing permission, virtual machine without PMU),
+	* enable() returns false and the time measurements work as before. Events which the CPU does
+	* not provide are left out and reported as unavailable.
+	*
+	* The counters are process-global. They count the OpenMP team of the thread which called
+	* enable(), so enable() has to be called on the thread which runs the simulation (e.g. via
+	* SimulationThread::post()). enable() and disable() are not synchronized with read() and must
+	* not be called while a step is measured. If several models are simulated in one process on
+	* different threads, the counters measure only the team of one of them.
+	*/
+	class PerformanceCounters
+	{
+	public:
+		enum Event { Cycles = 0, Instructions, CacheReferences, CacheMisses, NumEvents };
+
+		/** \brief Counter values summed over all threads. */
+		struct Values
+		{
+			unsigned long long value[NumEvents];
+
+			Values() { setZero(); }
+			void setZero() { for (unsigned int i = 0; i < NumEvents; i++) value[i] = 0; }
+		};
+
+		/** Size of a cache line in bytes, used to estimate the memory bandwidth from the cache misses */
+		static const unsigned int CacheLineSize = 64;
+
+	protected:
+		static bool m_enabled;
+		static bool m_available[NumEvents];
+		/** Events of the counter groups in the order in which they were added */
+		static std::vector<Event> m_groupEvents;
+		/** File descriptors of the counters, NumEvents per thread (-1 if not available) */
+		static std::vector<int> m_fds;
+
+	public:
+		/** Open the counters for all threads of the current OpenMP team. Call this again after
+		* changing the number of threads. Returns false if the counters are not supported. */
+		static bool enable();
+		/** Close all counters. */
+		static void disable();
+		static bool isEnabled() { return m_enabled; }
+		static bool isAvailable(const Event e) { return m_enabled && m_available[e]; }
+		static const char *getEventName(const Event e);
+
+		/** Read the current counter values summed over all threads. */
+		static void read(Values &values);
+	};
+}
+
+#endif
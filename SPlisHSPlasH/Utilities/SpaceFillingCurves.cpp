@@ -0,0 +1,193 @@
+#include "SpaceFillingCurves.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace SPH;
+
+typedef std::pair<std::uint64_t, unsigned int> SortKey;
+
+// Insert two zero bits between the lower 21 bits of x.
+static std::uint64_t spreadBits(std::uint64_t x)
+{
+	x &= 0x1fffff;
+	x = (x | (x << 32)) & 0x1f00000000ffffull;
+	x = (x | (x << 16)) & 0x1f0000ff0000ffull;
+	x = (x | (x << 8)) & 0x100f00f00f00f00full;
+	x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+	x = (x | (x << 2)) & 0x1249249249249249ull;
+	return x;
+}
+
+std::uint64_t SpaceFillingCurves::mortonCode(const unsigned int c[3])
+{
+	return spreadBits(c[0]) | (spreadBits(c[1]) << 1) | (spreadBits(c[2]) << 2);
+}
+
+std::uint64_t SpaceFillingCurves::hilbertCode(const unsigned int c[3], const unsigned int bits)
+{
+	// J. Skilling, Programming the Hilbert curve, AIP Conference Proceedings 707, 2004.
+	// The coordinates are transformed in place to the transposed Hilbert index.
+	unsigned int X[3] = { c[0], c[1], c[2] };
+	const unsigned int M = 1u << (bits - 1);
+
+	// inverse undo
+	for (unsigned int Q = M; Q > 1; Q >>= 1)
+	{
+		const unsigned int P = Q - 1;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			if (X[i] & Q)
+				X[0] ^= P;
+			else
+			{
+				const unsigned int t = (X[0] ^ X[i]) & P;
+				X[0] ^= t;
+				X[i] ^= t;
+			}
+		}
+	}
+
+	// Gray encode
+	X[1] ^= X[0];
+	X[2] ^= X[1];
+	unsigned int t = 0;
+	for (unsigned int Q = M; Q > 1; Q >>= 1)
+	{
+		if (X[2] & Q)
+			t ^= Q - 1;
+	}
+	for (unsigned int i = 0; i < 3; i++)
+		X[i] ^= t;
+
+	// interleave the bits of the transposed index, X[0] holds the most significant bits
+	std::uint64_t key = 0;
+	for (int b = (int)bits - 1; b >= 0; b--)
+	{
+		for (unsigned int i = 0; i < 3; i++)
+			key = (key << 1) | ((X[i] >> b) & 1u);
+	}
+	return key;
+}
+
+// Sort the keys with one std::sort per thread followed by rounds of pairwise merges.
+static void parallelSort(std::vector<SortKey> &keys)
+{
+	const unsigned int n = (unsigned int)keys.size();
+#ifdef _OPENMP
+	const unsigned int numParts = (unsigned int)omp_get_max_threads();
+#else
+	const unsigned int numParts = 1;
+#endif
+	if ((numParts == 1) || (n < 1024 * numParts))
+	{
+		std::sort(keys.begin(), keys.end());
+		return;
+	}
+
+	std::vector<unsigned int> bounds(numParts + 1);
+	for (unsigned int p = 0; p <= numParts; p++)
+		bounds[p] = (unsigned int)(((unsigned long long) n * p) / numParts);
+
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)
+		for (int p = 0; p < (int)numParts; p++)
+			std::sort(keys.begin() + bounds[p], keys.begin() + bounds[p + 1]);
+	}
+
+	std::vector<SortKey> tmp(n);
+	for (int width = 1; width < (int)numParts; width *= 2)
+	{
+		const int step = 2 * width;
+		#pragma omp parallel default(shared)
+		{
+			#pragma omp for schedule(static)
+			for (int p = 0; p < (int)numParts; p += step)
+			{
+				const unsigned int begin = bounds[p];
+				const unsigned int mid = bounds[std::min(p + width, (int)numParts)];
+				const unsigned int end = bounds[std::min(p + step, (int)numParts)];
+				std::merge(keys.begin() + begin, keys.begin() + mid, keys.begin() + mid, keys.begin() + end, tmp.begin() + begin);
+			}
+		}
+		keys.swap(tmp);
+	}
+}
+
+void SpaceFillingCurves::computeSortTable(const Vector3r *x, const unsigned int n, const Real cellSize,
+	const SpaceFillingCurve curve, std::vector<unsigned int> &sortTable)
+{
+	sortTable.resize(n);
+	if (n == 0)
+		return;
+
+	//////////////////////////////////////////////////////////////////////////
+	// bounding box of the points
+	//////////////////////////////////////////////////////////////////////////
+	Vector3r minX = x[0];
+	Vector3r maxX = x[0];
+	#pragma omp parallel default(shared)
+	{
+		Vector3r localMin = x[0];
+		Vector3r localMax = x[0];
+		#pragma omp for schedule(static)
+		for (int i = 0; i < (int)n; i++)
+		{
+			localMin = localMin.cwiseMin(x[i]);
+			localMax = localMax.cwiseMax(x[i]);
+		}
+		#pragma omp critical
+		{
+			minX = minX.cwiseMin(localMin);
+			maxX = maxX.cwiseMax(localMax);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// The Hilbert curve is defined on a cube of 2^bits cells per dimension.
+	// Outliers (e.g. particles which left the domain) are clamped to the grid.
+	//////////////////////////////////////////////////////////////////////////
+	const Real invCellSize = static_cast<Real>(1.0) / cellSize;
+	const unsigned int maxCell = (1u << MaxBits) - 1;
+	const Real extent = (maxX - minX).maxCoeff() * invCellSize;
+	unsigned int bits = 1;
+	while ((bits < MaxBits) && (extent >= (Real)(1u << bits)))
+		bits++;
+
+	std::vector<SortKey> keys(n);
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)
+		for (int i = 0; i < (int)n; i++)
+		{
+			unsigned int c[3];
+			for (unsigned int d = 0; d < 3; d++)
+			{
+				const Real cd = floor((x[i][d] - minX[d]) * invCellSize);
+				c[d] = (unsigned int)std::min(std::max(cd, static_cast<Real>(0.0)), (Real)maxCell);
+			}
+			if (curve == SpaceFillingCurve::Hilbert)
+			{
+				for (unsigned int d = 0; d < 3; d++)
+					c[d] = std::min(c[d], (1u << bits) - 1);
+				keys[i] = SortKey(hilbertCode(c, bits), (unsigned int)i);
+			}
+			else
+				keys[i] = SortKey(mortonCode(c), (unsigned int)i);
+		}
+	}
+
+	parallelSort(keys);
+
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)
+		for (int i = 0; i < (int)n; i++)
+			sortTable[i] = keys[i].second;
+	}
+}
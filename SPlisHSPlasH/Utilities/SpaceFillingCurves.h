@@ -0,0 +1,59 @@
+#ifndef __SpaceFillingCurves_h__
+#define __SpaceFillingCurves_h__
+
+#include "SPlisHSPlasH/Common.h"
+#include <cstdint>
+#include <vector>
+
+namespace SPH
+{
+	/** \brief Space-filling curve which determines the order of the particles in memory.
+	* Morton (Z-order) codes are cheap to compute but the curve jumps at the boundaries of
+	* its octants. The Hilbert curve only connects neighboring cells, which gives a better
+	* locality of the particles in the neighbor loops.
+	*/
+	enum class SpaceFillingCurve { Morton = 0, Hilbert };
+
+	/** \brief Sorting of particles along a space-filling curve.
+	*/
+	class SpaceFillingCurves
+	{
+	public:
+		/** Number of bits per coordinate of the cell coordinates */
+		static const unsigned int MaxBits = 21;
+
+		/** Morton code of the cell coordinates c (MaxBits per coordinate). */
+		static std::uint64_t mortonCode(const unsigned int c[3]);
+
+		/** Index of the cell c on the Hilbert curve through a cube of 2^bits cells per dimension
+		* (bits <= MaxBits), computed by the algorithm of Skilling (2004).
+		*/
+		static std::uint64_t hilbertCode(const unsigned int c[3], const unsigned int bits);
+
+		/** Compute the permutation which sorts n points along a space-filling curve through a grid
+		* with the given cell size which covers the bounding box of the points. Points in the same cell
+		* keep their order. After the call, entry i of the sort table is the old index of the point
+		* which is moved to index i. The keys are computed and sorted in parallel.
+		*/
+		static void computeSortTable(const Vector3r *x, const unsigned int n, const Real cellSize,
+			const SpaceFillingCurve curve, std::vector<unsigned int> &sortTable);
+
+		/** Reorder the array lst with a sort table of computeSortTable().
+		*/
+		template<typename T>
+		static void applySortTable(const std::vector<unsigned int> &sortTable, T *lst)
+		{
+			if (sortTable.empty())
+				return;
+			std::vector<T> tmp(lst, lst + sortTable.size());
+			#pragma omp parallel default(shared)
+			{
+				#pragma omp for schedule(static)
+				for (int i = 0; i < (int)sortTable.size(); i++)
+					lst[i] = tmp[sortTable[i]];
+			}
+		}
+	};
+}
+
+#endif
@@ -2,12 +2,12 @@
 
 using namespace SPH;
 
-int IDFactory::id = 0;
-std::unordered_map<int, AverageTime> Timing::m_averageTimes;
-std::stack<TimingHelper> Timing::m_timingStack;
+std::atomic<int> IDFactory::id(0);
+thread_local std::unordered_map<int, AverageTime> Timing::m_averageTimes;
+thread_local std::stack<TimingHelper> Timing::m_timingStack;
 bool Timing::m_dontPrintTimes = false;
-unsigned int Timing::m_startCounter = 0;
-unsigned int Timing::m_stopCounter = 0;
+thread_local unsigned int Timing::m_startCounter = 0;
+thread_local unsigned int Timing::m_stopCounter = 0;
 
 
 void SPH::Timing::reset()
@@ -4,8 +4,12 @@
 #include <iostream>
 #include <stack>
 #include <unordered_map>
+#include <vector>
+#include <algorithm>
 #include "SPlisHSPlasH/Common.h"
+#include "PerformanceCounters.h"
 #include <chrono>
+#include <atomic>
 
 namespace SPH
 {
@@ -20,13 +24,13 @@ namespace SPH
 
 	#define STOP_TIMING_AVG \
 	{ \
-	static int timing_timerId = -1; \
+	static const int timing_timerId = IDFactory::getId(); \
 	Timing::stopTiming(false, timing_timerId); \
 	}
 
 	#define STOP_TIMING_AVG_PRINT \
 	{ \
-	static int timing_timerId = -1; \
+	static const int timing_timerId = IDFactory::getId(); \
 	Timing::stopTiming(true, timing_timerId); \
 	}
 
@@ -36,6 +40,9 @@ namespace SPH
 	{
 		std::chrono::time_point<std::chrono::high_resolution_clock> start;
 		std::string name;
+		/** Performance counters at the start (if they were enabled) */
+		bool hasCounters;
+		PerformanceCounters::Values counters;
 	};
 
 	/** \brief Struct to store the total time and the number of steps in order to compute the average time. 
@@ -45,6 +52,8 @@ namespace SPH
 		double totalTime;
 		unsigned int counter;
 		std::string name;
+		/** Sum of the performance counter differences of all measurements */
+		PerformanceCounters::Values counters;
 	};
 
 	/** \brief Factory for unique ids.
@@ -53,30 +62,36 @@ namespace SPH
 	{
 	private:
 		/** Current id */
-		static int id;
+		static std::atomic<int> id;
 
 	public:
 		static int getId() { return id++; }
 	};
 
 	/** \brief Class for time measurements.
+	*
+	* The timing stack and the measurements are thread-local, so simulations which run concurrently
+	* in different threads measure their own scopes.
 	*/
 	class Timing
 	{
 	public:
 		static bool m_dontPrintTimes;
-		static unsigned int m_startCounter;
-		static unsigned int m_stopCounter;
-		static std::stack<TimingHelper> m_timingStack;
-		static std::unordered_map<int, AverageTime> m_averageTimes;
+		static thread_local unsigned int m_startCounter;
+		static thread_local unsigned int m_stopCounter;
+		static thread_local std::stack<TimingHelper> m_timingStack;
+		static thread_local std::unordered_map<int, AverageTime> m_averageTimes;
 
 		static void reset();
 
 		FORCE_INLINE static void startTiming(const std::string& name = std::string(""))
 		{
 			TimingHelper h;
-			h.start = std::chrono::high_resolution_clock::now();
 			h.name = name;
+			h.hasCounters = PerformanceCounters::isEnabled();
+			if (h.hasCounters)
+				PerformanceCounters::read(h.counters);
+			h.start = std::chrono::high_resolution_clock::now();
 			Timing::m_timingStack.push(h);
 			Timing::m_startCounter++;
 		}
@@ -99,10 +114,8 @@ namespace SPH
 			return 0;
 		}
 
-		FORCE_INLINE static double stopTiming(bool print, int &id)
+		FORCE_INLINE static double stopTiming(bool print, const int id)
 		{
-			if (id == -1)
-				id = IDFactory::getId();
 			if (!Timing::m_timingStack.empty())
 			{
 				Timing::m_stopCounter++;
@@ -113,6 +126,14 @@ namespace SPH
 				std::chrono::duration<double> elapsed_seconds = stop - h.start;
 				double t = elapsed_seconds.count() * 1000.0;
 
+				PerformanceCounters::Values counters;
+				if (h.hasCounters && PerformanceCounters::isEnabled())
+				{
+					PerformanceCounters::read(counters);
+					for (unsigned int i = 0; i < PerformanceCounters::NumEvents; i++)
+						counters.value[i] -= h.counters.value[i];
+				}
+
 				if (print && !Timing::m_dontPrintTimes)
 					std::cout << "time " << h.name.c_str() << ": " << t << " ms\n" << std::flush;
 
@@ -122,8 +143,11 @@ namespace SPH
 					iter = Timing::m_averageTimes.find(id);
 					if (iter != Timing::m_averageTimes.end())
 					{
-						Timing::m_averageTimes[id].totalTime += t;
-						Timing::m_averageTimes[id].counter++;
+						AverageTime &at = iter->second;
+						at.totalTime += t;
+						at.counter++;
+						for (unsigned int i = 0; i < PerformanceCounters::NumEvents; i++)
+							at.counters.value[i] += counters.value[i];
 					}
 					else
 					{
@@ -131,6 +155,7 @@ namespace SPH
 						at.counter = 1;
 						at.totalTime = t;
 						at.name = h.name;
+						at.counters = counters;
 						Timing::m_averageTimes[id] = at;
 					}
 				}
@@ -139,6 +164,24 @@ namespace SPH
 			return 0;
 		}
 
+		/** Print the instructions per cycle, the average number of last level cache misses, the miss rate
+		* and the memory bandwidth estimated from the cache misses of a scope. */
+		static void printCounters(const AverageTime &at)
+		{
+			typedef PerformanceCounters PC;
+			const unsigned long long *v = at.counters.value;
+			if (PC::isAvailable(PC::Cycles) && PC::isAvailable(PC::Instructions) && (v[PC::Cycles] > 0))
+				std::cout << ", IPC " << (double)v[PC::Instructions] / (double)v[PC::Cycles];
+			if (PC::isAvailable(PC::CacheMisses))
+			{
+				std::cout << ", cache misses " << (double)v[PC::CacheMisses] / at.counter;
+				if (PC::isAvailable(PC::CacheReferences) && (v[PC::CacheReferences] > 0))
+					std::cout << " (" << 100.0 * (double)v[PC::CacheMisses] / (double)v[PC::CacheReferences] << "%)";
+				if (at.totalTime > 0.0)
+					std::cout << ", bandwidth " << (double)v[PC::CacheMisses] * PC::CacheLineSize / (at.totalTime * 1.0e6) << " GB/s";
+			}
+		}
+
 		FORCE_INLINE static void printAverageTimes()
 		{
 			std::unordered_map<int, AverageTime>::iterator iter;
@@ -146,7 +189,10 @@ namespace SPH
 			{
 				AverageTime &at = iter->second;
 				const double avgTime = at.totalTime / at.counter;
-				std::cout << "Average time " << at.name.c_str() << ": " << avgTime << " ms\n" << std::flush;
+				std::cout << "Average time " << at.name.c_str() << ": " << avgTime << " ms";
+				if (PerformanceCounters::isEnabled())
+					printCounters(at);
+				std::cout << "\n" << std::flush;
 			}
 			if (Timing::m_startCounter != Timing::m_stopCounter)
 				std::cout << "Problem: " << Timing::m_startCounter << " calls of startTiming and " << Timing::m_stopCounter << " calls of stopTiming.\n " << std::flush;
@@ -166,6 +212,25 @@ namespace SPH
 				std::cout << "Problem: " << Timing::m_startCounter << " calls of startTiming and " << Timing::m_stopCounter << " calls of stopTiming.\n " << std::flush;
 			std::cout << "---------------------------------------------------------------------------\n\n";
 		}
+
+		/** Print the busy time of each thread and the load imbalance, i.e. the ratio of the
+		* maximal and the average busy time. */
+		FORCE_INLINE static void printThreadBusyTimes(const std::vector<double> &busyTimes)
+		{
+			if (busyTimes.empty())
+				return;
+			double maxTime = 0.0;
+			double sum = 0.0;
+			for (unsigned int i = 0; i < busyTimes.size(); i++)
+			{
+				std::cout << "Busy time thread " << i << ": " << busyTimes[i] << " ms\n";
+				maxTime = std::max(maxTime, busyTimes[i]);
+				sum += busyTimes[i];
+			}
+			if (sum > 0.0)
+				std::cout << "Load imbalance (max/avg): " << maxTime * busyTimes.size() / sum << "\n";
+			std::cout << "---------------------------------------------------------------------------\n\n" << std::flush;
+		}
 	};
 }
 
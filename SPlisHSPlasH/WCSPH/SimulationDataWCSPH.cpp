@@ -19,12 +19,18 @@ void SimulationDataWCSPH::init(FluidModel *model)
 
 	m_pressure.resize(model->numParticles(), 0.0);
 	m_pressureAccel.resize(model->numParticles(), SPH::Vector3r::Zero());
+	m_timeStepLevel.resize(model->numParticles(), 0);
+	m_neighborLevel.resize(model->numParticles(), 0);
 }
 
 void SimulationDataWCSPH::cleanup()
 {
 	m_pressure.clear();
 	m_pressureAccel.clear();
+	m_timeStepLevel.clear();
+	m_neighborLevel.clear();
+	m_activeList.clear();
+	m_levelOffsets.clear();
 }
 
 void SimulationDataWCSPH::reset()
@@ -37,7 +43,34 @@ void SimulationDataWCSPH::performNeighborhoodSearchSort()
 	if (numPart == 0)
 		return;
 
-	auto const& d = m_model->getNeighborhoodSearch()->point_set(0);
-	d.sort_field(&m_pressure[0]);
-	d.sort_field(&m_pressureAccel[0]);
+	m_model->sortField(&m_pressure[0]);
+	m_model->sortField(&m_pressureAccel[0]);
+	m_model->sortField(&m_timeStepLevel[0]);
+	m_model->sortField(&m_neighborLevel[0]);
+}
+
+void SimulationDataWCSPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	usage.addFluidArray("WCSPH", m_pressure);
+	usage.addFluidArray("WCSPH", m_pressureAccel);
+	usage.addFluidArray("WCSPH", m_timeStepLevel);
+	usage.addFluidArray("WCSPH", m_neighborLevel);
+	usage.addFluidArray("WCSPH", m_activeList);
+}
+
+void SimulationDataWCSPH::updateActiveList(const unsigned int maxLevel)
+{
+	const unsigned int numParticles = m_model->numParticles();
+
+	// counting sort by descending neighbor level, the order of the particles of a level is kept
+	m_levelOffsets.assign(maxLevel + 2, 0);
+	for (unsigned int i = 0; i < numParticles; i++)
+		m_levelOffsets[m_neighborLevel[i]]++;
+	for (int l = (int)maxLevel - 1; l >= 0; l--)
+		m_levelOffsets[l] += m_levelOffsets[l + 1];
+
+	std::vector<unsigned int> next(m_levelOffsets.begin() + 1, m_levelOffsets.end());
+	m_activeList.resize(numParticles);
+	for (unsigned int i = 0; i < numParticles; i++)
+		m_activeList[next[m_neighborLevel[i]]++] = i;
 }
@@ -19,8 +19,18 @@ namespace SPH
 		protected:	
 			FluidModel *m_model;
 
-			std::vector<Real> m_pressure;
-			std::vector<Vector3r> m_pressureAccel;
+			ParticleVector<Real> m_pressure;
+			ParticleVector<Vector3r> m_pressureAccel;
+			/** Time step level of each particle for the multi-rate integration (0 = coarsest level). */
+			ParticleVector<unsigned int> m_timeStepLevel;
+			/** Finest time step level of each particle and its fluid neighbors. The density of a particle 
+			* is required in each sub-step in which a particle of this level is active. */
+			ParticleVector<unsigned char> m_neighborLevel;
+			/** Fluid particles sorted by descending neighbor level, so the particles which are updated in 
+			* a sub-step are a prefix of the list. */
+			std::vector<unsigned int> m_activeList;
+			/** Number of particles in the active list with a neighbor level >= l */
+			std::vector<unsigned int> m_levelOffsets;
 
 		public:
 			/** Initialize the arrays containing the particle data.
@@ -36,10 +46,13 @@ namespace SPH
 			virtual void reset();
 
 			/** Important: First call m_model->performNeighborhoodSearchSort() 
-			 * to call the z_sort of the neighborhood search.
+			 * to compute the new order of the particles.
 			 */
 			void performNeighborhoodSearchSort();
 
+			/** Add the memory of the particle data (see MemoryUsage). */
+			void getMemoryUsage(MemoryUsage &usage) const;
+
 			FORCE_INLINE const Real getPressure(const unsigned int i) const
 			{
 				return m_pressure[i];
@@ -70,6 +83,40 @@ namespace SPH
 				m_pressureAccel[i] = val;
 			}
 
+			FORCE_INLINE const unsigned int getTimeStepLevel(const unsigned int i) const
+			{
+				return m_timeStepLevel[i];
+			}
+
+			FORCE_INLINE unsigned int& getTimeStepLevel(const unsigned int i)
+			{
+				return m_timeStepLevel[i];
+			}
+
+			FORCE_INLINE const unsigned char getNeighborLevel(const unsigned int i) const
+			{
+				return m_neighborLevel[i];
+			}
+
+			FORCE_INLINE unsigned char& getNeighborLevel(const unsigned int i)
+			{
+				return m_neighborLevel[i];
+			}
+
+			/** Sort the particles by their neighbor levels (see m_activeList). */
+			void updateActiveList(const unsigned int maxLevel);
+
+			/** Number of particles which must be updated if the particles of level l and all finer levels are active. */
+			FORCE_INLINE unsigned int numberOfUpdatedParticles(const unsigned int l) const
+			{
+				return m_levelOffsets[l];
+			}
+
+			FORCE_INLINE unsigned int getActiveParticle(const unsigned int k) const
+			{
+				return m_activeList[k];
+			}
+
 	};
 }
 
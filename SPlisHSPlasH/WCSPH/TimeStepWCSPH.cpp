@@ -22,14 +22,20 @@ TimeStepWCSPH::~TimeStepWCSPH(void)
 
 void TimeStepWCSPH::step()
 {
-	TimeManager *tm = TimeManager::getCurrent ();
+	if (m_numberOfTimeStepLevels > 1)
+	{
+		stepMultiRate();
+		return;
+	}
+
+	TimeManager *tm = m_model->getTimeManager();
 	const Real h = tm->getTimeStepSize();
 
 	performNeighborhoodSearch();
 
 	// Compute accelerations: a(t)
-	clearAccelerations();
-	computeDensities();
+	// the accelerations are cleared in the density loop
+	computeDensities(true);
 	computeViscosity();
 	computeSurfaceTension();
 
@@ -79,47 +85,263 @@ void TimeStepWCSPH::reset()
 	m_counter = 0;
 }
 
+void TimeStepWCSPH::getMemoryUsage(MemoryUsage &usage) const
+{
+	TimeStep::getMemoryUsage(usage);
+	m_simulationData.getMemoryUsage(usage);
+}
+
 void TimeStepWCSPH::computePressureAccels()
 {
 	const unsigned int numParticles = m_model->numParticles();
 
+	m_model->ensureThreadForceBuffers();
+
 	// Compute pressure forces
 	#pragma omp parallel default(shared)
 	{
 		#pragma omp for schedule(static)  
-		for (int i = 0; i < (int)numParticles; i++)
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
 		{
-			const Vector3r &xi = m_model->getPosition(0, i);
-			const Real &density_i = m_model->getDensity(i);
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+			{
+				computePressureAccel(i, 1.0);
+			}
+		}
+	}
 
-			Vector3r &ai = m_simulationData.getPressureAccel(i);
-			ai.setZero();
+	m_model->reduceBoundaryForces();
+}
 
-			const Real dpi = m_simulationData.getPressure(i) / (density_i*density_i);
-			for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
-			{
-				const CompactNSearch::PointID &particleId = m_model->getNeighbor(i, j);
-				const unsigned int &neighborIndex = particleId.point_id;
-				const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
-				if (particleId.point_set_id == 0)		// Test if fluid particle
-				{					
-					// Pressure 
-					const Real &density_j = m_model->getDensity(neighborIndex);
+void TimeStepWCSPH::computePressureAccel(const unsigned int i, const Real forceFactor)
+{
+	const Vector3r &xi = m_model->getPosition(0, i);
+	const Real &density_i = m_model->getDensity(i);
+
+	Vector3r &ai = m_simulationData.getPressureAccel(i);
+	ai.setZero();
+
+	const Real dpi = m_simulationData.getPressure(i) / (density_i*density_i);
+	for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+	{
+		const PointID &particleId = m_model->getNeighbor(i, j);
+		const unsigned int &neighborIndex = particleId.point_id;
+		const Vector3r &xj = m_model->getPosition(particleId.point_set_id, neighborIndex);
+		if (particleId.point_set_id == 0)		// Test if fluid particle
+		{					
+			// Pressure 
+			const Real &density_j = m_model->getDensity(neighborIndex);
+
+			const Real dpj = m_simulationData.getPressure(neighborIndex) / (density_j*density_j);
+
+			ai -= m_model->getMass(neighborIndex) * (dpi + dpj) * m_model->gradW(xi - xj);
+		}
+		else
+		{
+			const Vector3r a = m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dpi)* m_model->gradW(xi - xj);
+			ai -= a;
+
+			m_model->addForce(particleId.point_set_id, neighborIndex, forceFactor * m_model->getMass(i) * a);
+		}
+	}
+}
+
+void TimeStepWCSPH::stepMultiRate()
+{
+	TimeManager *tm = m_model->getTimeManager();
+	const Real h = tm->getTimeStepSize();
+	const unsigned int numParticles = m_model->numParticles();
+	const Real stiffness = m_model->getStiffness();
+	const Real density0 = m_model->getDensity0();
+	const Real exponent = m_model->getExponent();
+
+	performNeighborhoodSearch();
+
+	// Non-pressure accelerations are determined once for the whole time step
+	// the accelerations are cleared in the density loop
+	computeDensities(true);
+	computeViscosity();
+	computeSurfaceTension();
+
+	// The CFL condition of the fastest particle determines the finest level,
+	// the coarsest level is limited by the maximum time step size.
+	Real hCoarse = h;
+	if (m_cflMethod != 0)
+	{
+		updateTimeStepSize();
+		const Real hFinest = tm->getTimeStepSize();
+		hCoarse = min(hFinest * (Real)(1u << (m_numberOfTimeStepLevels - 1)), m_cflMaxTimeStepSize);
+		hCoarse = max(hCoarse, hFinest);
+	}
+
+	const unsigned int maxLevel = computeTimeStepLevels(h, hCoarse);
+	const unsigned int numSubSteps = 1u << maxLevel;
+	const Real hFine = hCoarse / (Real)numSubSteps;
+	updateNeighborLevels(maxLevel);
+	m_model->ensureThreadForceBuffers();
+
+	for (unsigned int s = 0; s < numSubSteps; s++)
+	{
+		// A particle on level l is active in every 2^(maxLevel-l)-th sub-step, so the active
+		// particles are the ones of the levels >= minLevel.
+		unsigned int minLevel = 0;
+		while ((s & ((1u << (maxLevel - minLevel)) - 1)) != 0)
+			minLevel++;
+
+		// The neighbor lists are kept over the sub-steps until a particle leaves the skin.
+		// In the first sub-step all particles are active and the densities are already known.
+		if ((s > 0) && m_model->neighborhoodSearchRequired())
+		{
+			TimeStep::performNeighborhoodSearch();
+			updateNeighborLevels(maxLevel);
+		}
 
-					const Real dpj = m_simulationData.getPressure(neighborIndex) / (density_j*density_j);
+		// the active particles and their neighbors are a prefix of the active list
+		const int numUpdated = (int)m_simulationData.numberOfUpdatedParticles(minLevel);
 
-					ai -= m_model->getMass(neighborIndex) * (dpi + dpj) * m_model->gradW(xi - xj);
+		#pragma omp parallel default(shared)
+		{
+			#pragma omp for schedule(static)  
+			for (int k = 0; k < numUpdated; k++)
+			{
+				const unsigned int i = m_simulationData.getActiveParticle(k);
+				if (s > 0)
+					computeDensity(i);
+				Real &density = m_model->getDensity(i);
+				density = max(density, density0);
+				m_simulationData.getPressure(i) = stiffness * (pow(density / density0, exponent) - 1.0);
+			}
+
+			// Kick the active particles with the time step size of their level
+			#pragma omp for schedule(static)  
+			for (int k = 0; k < numUpdated; k++)
+			{
+				const unsigned int i = m_simulationData.getActiveParticle(k);
+				const unsigned int level = m_simulationData.getTimeStepLevel(i);
+				if (level >= minLevel)
+				{
+					const Real dt = hCoarse / (Real)(1u << level);
+					computePressureAccel(i, dt / hCoarse);
+					Vector3r &vel = m_model->getVelocity(0, i);
+					vel += (m_model->getAcceleration(i) + m_simulationData.getPressureAccel(i)) * dt;
 				}
-				else
+			}
+
+			// Positions of all particles are kept in sync
+			#pragma omp for schedule(static)  
+			for (int i = 0; i < (int)numParticles; i++)
+			{
+				m_model->getPosition(0, i) += m_model->getVelocity(0, i) * hFine;
+			}
+		}
+	}
+
+	m_model->reduceBoundaryForces();
+
+	// Compute new time	
+	tm->setTimeStepSize(hCoarse);
+	tm->setTime(tm->getTime() + hCoarse);
+}
+
+unsigned int TimeStepWCSPH::computeTimeStepLevels(const Real h, const Real hCoarse)
+{
+	const unsigned int numParticles = m_model->numParticles();
+	const unsigned int numLevels = m_numberOfTimeStepLevels;
+	// max. position change per time step which is allowed by the CFL condition
+	const Real maxDist = m_cflFactor * .4 * 2.0 * m_model->getParticleRadius();
+
+	// Local CFL condition
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)  
+		for (int i = 0; i < (int)numParticles; i++)
+		{
+			const Vector3r &vel = m_model->getVelocity(0, i);
+			const Vector3r &accel = m_model->getAcceleration(i);
+			const Real velMag = (vel + accel*h).norm();
+			unsigned int level = 0;
+			Real dt = hCoarse;
+			while ((level < numLevels - 1) && (dt * velMag > maxDist))
+			{
+				dt *= 0.5;
+				level++;
+			}
+			m_simulationData.getTimeStepLevel(i) = level;
+		}
+	}
+
+	// Limit the level difference of neighboring particles to one. Each pass propagates the levels 
+	// by one neighbor, the neighbor level is used as temporary storage of the smoothed levels. 
+	// The levels only increase, so the passes stop after at most numLevels passes.
+	bool changed = true;
+	unsigned int maxLevel = 0;
+	while (changed)
+	{
+		changed = false;
+		maxLevel = 0;
+		#pragma omp parallel default(shared)
+		{
+			unsigned int maxLevelLocal = 0;
+			#pragma omp for schedule(static) reduction(||:changed)
+			for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+			{
+				const FluidModel::ChunkTimer chunkTimer(m_model, c);
+				for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
 				{
-					const Vector3r a = m_model->getBoundaryPsi(particleId.point_set_id, neighborIndex) * (dpi)* m_model->gradW(xi - xj);
-					ai -= a;
+					unsigned int level = m_simulationData.getTimeStepLevel(i);
+					for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+					{
+						const PointID &particleId = m_model->getNeighbor(i, j);
+						if (particleId.point_set_id == 0)
+						{
+							const unsigned int levelj = m_simulationData.getTimeStepLevel(particleId.point_id);
+							if (levelj > level + 1)
+								level = levelj - 1;
+						}
+					}
+					if (level != m_simulationData.getTimeStepLevel(i))
+						changed = true;
+					m_simulationData.getNeighborLevel(i) = (unsigned char)level;
+					maxLevelLocal = max(maxLevelLocal, level);
+				}
+			}
 
-					m_model->getForce(particleId.point_set_id, neighborIndex) += m_model->getMass(i) * a;
+			#pragma omp for schedule(static)  
+			for (int i = 0; i < (int)numParticles; i++)
+				m_simulationData.getTimeStepLevel(i) = m_simulationData.getNeighborLevel(i);
+
+			#pragma omp critical
+			{
+				maxLevel = max(maxLevel, maxLevelLocal);
+			}
+		}
+	}
+	return maxLevel;
+}
+
+void TimeStepWCSPH::updateNeighborLevels(const unsigned int maxLevel)
+{
+	#pragma omp parallel default(shared)
+	{
+		#pragma omp for schedule(static)  
+		for (int c = 0; c < (int)m_model->numberOfParticleChunks(); c++)
+		{
+			const FluidModel::ChunkTimer chunkTimer(m_model, c);
+			for (int i = (int)m_model->getParticleChunkBegin(c); i < (int)m_model->getParticleChunkEnd(c); i++)
+			{
+				unsigned int level = m_simulationData.getTimeStepLevel(i);
+				for (unsigned int j = 0; j < m_model->numberOfNeighbors(i); j++)
+				{
+					const PointID &particleId = m_model->getNeighbor(i, j);
+					if (particleId.point_set_id == 0)
+						level = max(level, m_simulationData.getTimeStepLevel(particleId.point_id));
 				}
+				m_simulationData.getNeighborLevel(i) = (unsigned char)level;
 			}
 		}
 	}
+	m_simulationData.updateActiveList(maxLevel);
 }
 
 void TimeStepWCSPH::performNeighborhoodSearch()
@@ -22,6 +22,30 @@ namespace SPH
 		/** Determine the pressure accelerations when the pressure is already known. */
 		void computePressureAccels();
 
+		/** Determine the pressure acceleration of particle i when the pressure is already known. 
+		* The reaction forces on the boundary are scaled by forceFactor.
+		*/
+		void computePressureAccel(const unsigned int i, const Real forceFactor);
+
+		/** Perform a time step with per-particle time step sizes. Each particle is assigned to one 
+		* of m_numberOfTimeStepLevels levels where level l uses the time step size h/2^l. 
+		* Pressure accelerations are only determined for particles which are active in the current 
+		* sub-step, non-pressure accelerations are determined once per time step. The neighbor lists 
+		* are reused in the sub-steps if a neighborhood search skin is set (see FluidModel::setNeighborhoodSearchSkin()).
+		*/
+		void stepMultiRate();
+
+		/** Assign the particles to the time step levels by a local CFL condition where hCoarse is the 
+		* time step size of level 0. A particle is at most one level coarser than its fluid neighbors.
+		* Returns the finest level which is used by a particle.
+		*/
+		unsigned int computeTimeStepLevels(const Real h, const Real hCoarse);
+
+		/** Determine the finest level of the fluid neighbors of each particle and sort the particles 
+		* by it, so that the particles which are updated in a sub-step are a prefix of the active list.
+		*/
+		void updateNeighborLevels(const unsigned int maxLevel);
+
 		/** Perform the neighborhood search for all fluid particles.
 		*/
 		virtual void performNeighborhoodSearch();
@@ -32,6 +56,7 @@ namespace SPH
 
 		virtual void step();
 		virtual void reset();
+		virtual void getMemoryUsage(MemoryUsage &usage) const;
 	};
 }
 
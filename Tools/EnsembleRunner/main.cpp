@@ -0,0 +1,271 @@
+#include "SPlisHSPlasH/Common.h"
+#include "SPlisHSPlasH/FluidModel.h"
+#include "SPlisHSPlasH/TimeManager.h"
+#include "SPlisHSPlasH/StaticRigidBody.h"
+#include "SPlisHSPlasH/WCSPH/TimeStepWCSPH.h"
+#include "SPlisHSPlasH/PCISPH/TimeStepPCISPH.h"
+#include "SPlisHSPlasH/PBF/TimeStepPBF.h"
+#include "SPlisHSPlasH/IISPH/TimeStepIISPH.h"
+#include "SPlisHSPlasH/DFSPH/TimeStepDFSPH.h"
+#include <Eigen/Dense>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Enable memory leak detection
+#ifdef _DEBUG
+#ifndef EIGEN_ALIGN
+	#define new DEBUG_NEW
+#endif
+#endif
+
+using namespace SPH;
+using namespace std;
+
+const char *methodNames[] = { "WCSPH", "PCISPH", "PBF", "IISPH", "DFSPH" };
+const unsigned int numMethods = sizeof(methodNames) / sizeof(methodNames[0]);
+
+unsigned int numScenes = 64;
+unsigned int numWorkers = 1;
+unsigned int threadsPerScene = 1;
+unsigned int numFluidParticles = 2000;
+unsigned int numSteps = 100;
+unsigned int method = 4;
+unsigned int seed = 0;
+string outputDir;
+
+/** Parameters of a randomized dam break scene. */
+struct SceneParameters
+{
+	Vector3r fluidSize;
+	Real viscosity;
+	Vector3r initialVelocity;
+};
+
+/** Statistics of a simulated scene. */
+struct SceneResult
+{
+	unsigned int numFluidParticles;
+	double time;
+	double avgIterations;
+};
+
+/** Random parameters of the scene with the given index. The parameters only depend on the seed
+* and the index, so a scene can be reproduced independently of the worker which simulated it. */
+SceneParameters createSceneParameters(const unsigned int index)
+{
+	std::mt19937 rng(seed * 1000003u + index);
+	std::uniform_real_distribution<Real> sizeDist(0.2, 0.6);
+	std::uniform_real_distribution<Real> heightDist(0.3, 0.9);
+	std::uniform_real_distribution<Real> viscosityDist(0.0, 0.05);
+	std::uniform_real_distribution<Real> velocityDist(-1.0, 1.0);
+
+	SceneParameters params;
+	params.fluidSize = Vector3r(sizeDist(rng), heightDist(rng), 0.5*sizeDist(rng) + 0.2);
+	params.viscosity = viscosityDist(rng);
+	params.initialVelocity = Vector3r(velocityDist(rng), 0.0, velocityDist(rng));
+	return params;
+}
+
+/** Dam break in the box [0,1]x[0,1]x[0,0.5] with a fluid block of about numFluidParticles particles
+* in one corner. The box is sampled by two layers of boundary particles. */
+Real createDamBreak(const Vector3r &fluidSize, vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles)
+{
+	const Real d = cbrt(fluidSize.prod() / (Real)numFluidParticles);
+	const Real r = 0.5*d;
+	const Real eps = 1.0e-9;
+	const Vector3r minX(0.0, 0.0, 0.0);
+	const Vector3r maxX(1.0, 1.0, 0.5);
+
+	const int nx = (int)floor((maxX[0] - minX[0] + 4.0*r) / r + eps) + 1;
+	const int ny = (int)floor((maxX[1] - minX[1] + 4.0*r) / r + eps) + 1;
+	const int nz = (int)floor((maxX[2] - minX[2] + 4.0*r) / r + eps) + 1;
+	boundaryParticles.clear();
+	for (int i = 0; i < nx; i++)
+		for (int j = 0; j < ny; j++)
+		{
+			const Real x = minX[0] - 2.0*r + i*r;
+			const Real y = minX[1] - 2.0*r + j*r;
+			const bool insideXY = (x > minX[0] - eps) && (x < maxX[0] + eps) && (y > minX[1] - eps) && (y < maxX[1] + eps);
+			for (int k = 0; k < nz; k++)
+			{
+				const Real z = minX[2] - 2.0*r + k*r;
+				// only the shell of the box is sampled
+				if (insideXY && (z > minX[2] - eps) && (z < maxX[2] + eps))
+				{
+					k = nz - 3;
+					continue;
+				}
+				boundaryParticles.push_back(Vector3r(x, y, z));
+			}
+		}
+
+	fluidParticles.clear();
+	for (Real x = d; x < fluidSize[0]; x += d)
+		for (Real y = d; y < fluidSize[1]; y += d)
+			for (Real z = d; z < fluidSize[2] - r; z += d)
+				fluidParticles.push_back(Vector3r(x, y, z));
+	return r;
+}
+
+TimeStep *createTimeStep(const unsigned int method, FluidModel *model)
+{
+	switch (method)
+	{
+	case 0: return new TimeStepWCSPH(model);
+	case 1: return new TimeStepPCISPH(model);
+	case 2: return new TimeStepPBF(model);
+	case 3: return new TimeStepIISPH(model);
+	default: return new TimeStepDFSPH(model);
+	}
+}
+
+/** Simulate a scene. Each scene has its own model, time step and time manager, so that the
+* scenes of different workers do not share any state. */
+SceneResult simulate(const unsigned int index)
+{
+	const SceneParameters params = createSceneParameters(index);
+	vector<Vector3r> boundaryParticles;
+	vector<Vector3r> fluidParticles;
+	const Real particleRadius = createDamBreak(params.fluidSize, boundaryParticles, fluidParticles);
+
+	FluidModel model;
+	model.getTimeManager()->setTimeStepSize(0.05 * 2.0 * particleRadius);
+	model.setParticleRadius(particleRadius);
+	// the scenes have different radii, the kernels are selected for the radius of this scene
+	model.setKernel(0);
+	model.setGradKernel(0);
+	model.setViscosity(params.viscosity);
+	StaticRigidBody *rb = new StaticRigidBody();
+	rb->setPosition(Vector3r::Zero());
+	rb->setRotation(Matrix3r::Identity());
+	model.addRigidBodyObject(rb, (unsigned int)boundaryParticles.size(), boundaryParticles.data());
+	model.initModel((unsigned int)fluidParticles.size(), fluidParticles.data());
+	for (unsigned int i = 0; i < model.numParticles(); i++)
+		model.getVelocity(0, i) = params.initialVelocity;
+	if (!outputDir.empty())
+	{
+		ostringstream dir;
+		dir << outputDir << "/scene_" << setw(6) << setfill('0') << index;
+		model.setSaveDataPath(dir.str());
+	}
+
+	TimeStep *timeStep = createTimeStep(method, &model);
+	timeStep->setCflMethod(0);
+	model.updateBoundaryPsi();
+
+	unsigned long long iterations = 0;
+	for (unsigned int i = 0; i < numSteps; i++)
+	{
+		timeStep->step();
+		iterations += timeStep->getIterationCount();
+		if (!outputDir.empty())
+			model.writeFrameFluidData(model.getTimeManager()->getTime());
+	}
+
+	SceneResult res;
+	res.numFluidParticles = model.numParticles();
+	res.time = model.getTimeManager()->getTime();
+	res.avgIterations = (double)iterations / numSteps;
+	delete timeStep;
+	return res;
+}
+
+// main
+int main( int argc, char **argv )
+{
+	REPORT_MEMORY_LEAKS;
+
+	numWorkers = max(1u, std::thread::hardware_concurrency());
+
+	bool ok = true;
+	for (int i = 1; (i < argc) && ok; i++)
+	{
+		string argStr = argv[i];
+		if ((argStr == "-n") && (i + 1 < argc))
+			numScenes = max(1, stoi(argv[++i]));
+		else if ((argStr == "-j") && (i + 1 < argc))
+			numWorkers = max(1, stoi(argv[++i]));
+		else if ((argStr == "-t") && (i + 1 < argc))
+			threadsPerScene = max(1, stoi(argv[++i]));
+		else if ((argStr == "-p") && (i + 1 < argc))
+			numFluidParticles = max(1, stoi(argv[++i]));
+		else if ((argStr == "-s") && (i + 1 < argc))
+			numSteps = max(1, stoi(argv[++i]));
+		else if ((argStr == "--seed") && (i + 1 < argc))
+			seed = (unsigned int)max(0, stoi(argv[++i]));
+		else if ((argStr == "-o") && (i + 1 < argc))
+			outputDir = argv[++i];
+		else if ((argStr == "-m") && (i + 1 < argc))
+		{
+			const string name = argv[++i];
+			ok = false;
+			for (unsigned int m = 0; m < numMethods; m++)
+			{
+				if (name == methodNames[m])
+				{
+					method = m;
+					ok = true;
+				}
+			}
+		}
+		else
+			ok = false;
+	}
+	if (!ok)
+	{
+		std::cerr << "Usage: EnsembleRunner [-n scenes] [-j workers] [-t threads_per_scene] [-p fluid_particles] [-s steps]\n"
+			<< "                      [-m WCSPH|PCISPH|PBF|IISPH|DFSPH] [--seed seed] [-o output_dir]\n"
+			<< "  Simulates independent randomized dam break scenes concurrently. Each worker thread takes\n"
+			<< "  the next scene and simulates it with threads_per_scene OpenMP threads (default 1).\n"
+			<< "  With -o the frames of each scene are written to output_dir/scene_<index>.\n";
+		return -1;
+	}
+	numWorkers = min(numWorkers, numScenes);
+
+	std::atomic<unsigned int> nextScene(0);
+	std::atomic<unsigned long long> particleSteps(0);
+	std::mutex outputMutex;
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	vector<std::thread> workers;
+	for (unsigned int w = 0; w < numWorkers; w++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+#ifdef _OPENMP
+			// the number of OpenMP threads is a setting of the calling thread
+			omp_set_num_threads(threadsPerScene);
+#endif
+			for (unsigned int index = nextScene++; index < numScenes; index = nextScene++)
+			{
+				const SceneResult res = simulate(index);
+				particleSteps += (unsigned long long)res.numFluidParticles * numSteps;
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cerr << "Scene " << index << ": " << res.numFluidParticles << " particles, t = " << res.time
+					<< " s, " << res.avgIterations << " iterations / step\n";
+			}
+		}));
+	}
+	for (unsigned int w = 0; w < numWorkers; w++)
+		workers[w].join();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << numScenes << " scenes (" << methodNames[method] << ", " << numSteps << " steps) with " << numWorkers
+		<< " workers x " << threadsPerScene << " threads: " << seconds << " s, " << numScenes / seconds << " scenes / s, "
+		<< particleSteps / seconds << " particle steps / s\n";
+
+	return 0;
+}
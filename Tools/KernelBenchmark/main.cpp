@@ -0,0 +1,191 @@
+#include "SPlisHSPlasH/Common.h"
+#include "SPlisHSPlasH/SPHKernels.h"
+#include <Eigen/Dense>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// Enable memory leak detection
+#ifdef _DEBUG
+#ifndef EIGEN_ALIGN
+	#define new DEBUG_NEW
+#endif
+#endif
+
+using namespace SPH;
+using namespace std;
+
+Real supportRadius = 0.1;
+unsigned int numVectors = 1000000;
+unsigned int numIterations = 20;
+
+/** Result of a benchmark run. */
+struct BenchmarkResult
+{
+	string name;
+	/** Average time per kernel evaluation in nanoseconds */
+	double timeW;
+	double timeGradW;
+	/** Maximal deviation from the scalar cubic kernel relative to the maximum of the kernel (gradient) */
+	double errorW;
+	double errorGradW;
+	/** Deviation of the gradient for |r| >= 0.1 h (closer particles hardly occur in a simulation) */
+	double errorGradWFar;
+};
+
+double elapsedNs(const std::chrono::high_resolution_clock::time_point &start)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/** Random distance vectors, most of them in the support radius as in a neighbor loop. */
+void createDistanceVectors(vector<Vector3r> &r)
+{
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<Real> dist(-1.1*supportRadius, 1.1*supportRadius);
+	r.resize(numVectors);
+	for (unsigned int i = 0; i < numVectors; i++)
+		r[i] = Vector3r(dist(gen), dist(gen), dist(gen));
+}
+
+/** Evaluate W and gradW of a kernel for all vectors. The vectors are passed in batches of
+* KernelBatchSize as in the neighbor loops of the solvers. */
+template<typename KernelType>
+BenchmarkResult runBatched(const string &name, const KernelType &kernel, const vector<Vector3r> &r, const vector<Real> &refW, const vector<Vector3r> &refGradW)
+{
+	BenchmarkResult res;
+	res.name = name;
+	vector<Real> W(r.size());
+	vector<Vector3r> gradW(r.size());
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int it = 0; it < numIterations; it++)
+		for (unsigned int i = 0; i < r.size(); i += KernelBatchSize)
+			kernel.W(std::min((unsigned int)r.size() - i, KernelBatchSize), &r[i], &W[i]);
+	res.timeW = elapsedNs(start) / ((double)numIterations * r.size());
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int it = 0; it < numIterations; it++)
+		for (unsigned int i = 0; i < r.size(); i += KernelBatchSize)
+			kernel.gradW(std::min((unsigned int)r.size() - i, KernelBatchSize), &r[i], &gradW[i]);
+	res.timeGradW = elapsedNs(start) / ((double)numIterations * r.size());
+
+	Real maxW = 0.0;
+	Real maxGradW = 0.0;
+	res.errorW = 0.0;
+	res.errorGradW = 0.0;
+	res.errorGradWFar = 0.0;
+	for (unsigned int i = 0; i < r.size(); i++)
+	{
+		maxW = max(maxW, fabs(refW[i]));
+		maxGradW = max(maxGradW, refGradW[i].norm());
+		res.errorW = max(res.errorW, (double)fabs(W[i] - refW[i]));
+		const double errorGradW = (gradW[i] - refGradW[i]).norm();
+		res.errorGradW = max(res.errorGradW, errorGradW);
+		if (r[i].norm() >= 0.1*supportRadius)
+			res.errorGradWFar = max(res.errorGradWFar, errorGradW);
+	}
+	res.errorW /= maxW;
+	res.errorGradW /= maxGradW;
+	res.errorGradWFar /= maxGradW;
+	return res;
+}
+
+// main
+int main( int argc, char **argv )
+{
+	REPORT_MEMORY_LEAKS;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string argStr = argv[i];
+		string type_str = argStr.substr(0, 2);
+		if ((type_str == "-n") && (i + 1 < argc))
+			numVectors = max(1, stoi(argv[++i]));
+		else if ((type_str == "-i") && (i + 1 < argc))
+			numIterations = max(1, stoi(argv[++i]));
+		else
+		{
+			std::cerr << "Usage: KernelBenchmark [-n number_of_vectors] [-i iterations]\n";
+			return -1;
+		}
+	}
+
+	typedef PrecomputedKernel<CubicKernel, 10000> Precomputed10000;
+	typedef InterpolatedKernel<CubicKernel, 256, float, 1> InterpolatedLinear256f;
+	typedef InterpolatedKernel<CubicKernel, 1024, float, 1> InterpolatedLinear1024f;
+	typedef InterpolatedKernel<CubicKernel, 1024, double, 1> InterpolatedLinear1024d;
+	typedef InterpolatedKernel<CubicKernel, 256, float, 3> InterpolatedCubic256f;
+	typedef InterpolatedKernel<CubicKernel, 1024, double, 3> InterpolatedCubic1024d;
+
+	CubicKernel cubic;
+	Precomputed10000 precomputed10000;
+	InterpolatedLinear256f interpolatedLinear256f;
+	InterpolatedLinear1024f interpolatedLinear1024f;
+	InterpolatedLinear1024d interpolatedLinear1024d;
+	InterpolatedCubic256f interpolatedCubic256f;
+	InterpolatedCubic1024d interpolatedCubic1024d;
+	cubic.setRadius(supportRadius);
+	precomputed10000.setRadius(supportRadius);
+	interpolatedLinear256f.setRadius(supportRadius);
+	interpolatedLinear1024f.setRadius(supportRadius);
+	interpolatedLinear1024d.setRadius(supportRadius);
+	interpolatedCubic256f.setRadius(supportRadius);
+	interpolatedCubic1024d.setRadius(supportRadius);
+
+	vector<Vector3r> r;
+	createDistanceVectors(r);
+
+	// reference: scalar evaluation of the cubic kernel, one vector at a time
+	BenchmarkResult scalar;
+	scalar.name = "CubicKernel (scalar)";
+	vector<Real> refW(r.size());
+	vector<Vector3r> refGradW(r.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int it = 0; it < numIterations; it++)
+		for (unsigned int i = 0; i < r.size(); i++)
+			refW[i] = cubic.W(r[i]);
+	scalar.timeW = elapsedNs(start) / ((double)numIterations * r.size());
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int it = 0; it < numIterations; it++)
+		for (unsigned int i = 0; i < r.size(); i++)
+			refGradW[i] = cubic.gradW(r[i]);
+	scalar.timeGradW = elapsedNs(start) / ((double)numIterations * r.size());
+	scalar.errorW = 0.0;
+	scalar.errorGradW = 0.0;
+	scalar.errorGradWFar = 0.0;
+
+	vector<BenchmarkResult> results;
+	results.push_back(scalar);
+
+	const KernelInstructionSet best = getKernelInstructionSet();
+	const char *names[] = { "CubicKernel (batch, scalar)", "CubicKernel (batch, AVX2)", "CubicKernel (batch, AVX-512)" };
+	for (unsigned int s = 0; s <= (unsigned int)best; s++)
+	{
+		setKernelInstructionSet((KernelInstructionSet)s);
+		results.push_back(runBatched(names[s], cubic, r, refW, refGradW));
+	}
+	setKernelInstructionSet(best);
+	results.push_back(runBatched("Precomputed (10000, nearest)", precomputed10000, r, refW, refGradW));
+	results.push_back(runBatched("Interpolated (256, float, linear)", interpolatedLinear256f, r, refW, refGradW));
+	results.push_back(runBatched("Interpolated (1024, float, linear)", interpolatedLinear1024f, r, refW, refGradW));
+	results.push_back(runBatched("Interpolated (1024, double, linear)", interpolatedLinear1024d, r, refW, refGradW));
+	results.push_back(runBatched("Interpolated (256, float, cubic)", interpolatedCubic256f, r, refW, refGradW));
+	results.push_back(runBatched("Interpolated (1024, double, cubic)", interpolatedCubic1024d, r, refW, refGradW));
+
+	std::cout << numVectors << " distance vectors, support radius " << supportRadius << "\n";
+	std::cout << std::left << std::setw(38) << "Method" << std::right << std::setw(12) << "W [ns]" << std::setw(12) << "gradW [ns]"
+		<< std::setw(14) << "rel. err. W" << std::setw(16) << "rel. err. gradW" << std::setw(18) << "(|r| >= 0.1 h)" << "\n";
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		std::cout << std::left << std::setw(38) << results[i].name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(12) << results[i].timeW << std::setw(12) << results[i].timeGradW
+			<< std::scientific << std::setprecision(2) << std::setw(14) << results[i].errorW << std::setw(16) << results[i].errorGradW << std::setw(18) << results[i].errorGradWFar << "\n";
+	}
+
+	return 0;
+}
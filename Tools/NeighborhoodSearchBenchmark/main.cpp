@@ -0,0 +1,207 @@
+#include "SPlisHSPlasH/Common.h"
+#include "SPlisHSPlasH/NeighborhoodSearch/NeighborhoodSearch_CellGrid.h"
+#ifdef SPH_USE_COMPACTNSEARCH
+#include "CompactNSearch.h"
+#endif
+#include <Eigen/Dense>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdint>
+
+// Enable memory leak detection
+#ifdef _DEBUG
+#ifndef EIGEN_ALIGN
+	#define new DEBUG_NEW
+#endif
+#endif
+
+using namespace SPH;
+using namespace std;
+
+Real particleRadius = 0.025;
+unsigned int numIterations = 20;
+vector<Real> cellSizeFactors = { 1.0, 0.5 };
+
+/** Result of a benchmark run. */
+struct BenchmarkResult
+{
+	string name;
+	double searchTime;
+	double sortTime;
+	std::uint64_t numNeighbors;
+	/** Sorted neighbor lists of the fluid particles (used to compare the implementations) */
+	vector<vector<std::uint64_t> > neighbors;
+};
+
+/** Generate a dam break scene: a fluid block in a box which is sampled by two layers of boundary particles. */
+void createDamBreak(vector<Vector3r> &fluid, vector<Vector3r> &boundary)
+{
+	const Real diam = 2.0 * particleRadius;
+	const Vector3r boxMin(0.0, 0.0, 0.0);
+	const Vector3r boxMax(2.0, 1.5, 1.0);
+	const Vector3r fluidMax(0.8, 1.0, 1.0);
+
+	fluid.clear();
+	for (Real x = boxMin[0] + particleRadius; x < fluidMax[0]; x += diam)
+		for (Real y = boxMin[1] + particleRadius; y < fluidMax[1]; y += diam)
+			for (Real z = boxMin[2] + particleRadius; z < fluidMax[2]; z += diam)
+				fluid.push_back(Vector3r(x, y, z));
+
+	boundary.clear();
+	for (Real x = boxMin[0] - 2.0*diam; x <= boxMax[0] + 2.0*diam; x += diam)
+		for (Real y = boxMin[1] - 2.0*diam; y <= boxMax[1] + 2.0*diam; y += diam)
+			for (Real z = boxMin[2] - 2.0*diam; z <= boxMax[2] + 2.0*diam; z += diam)
+			{
+				const bool inside = (x > boxMin[0]) && (x < boxMax[0]) && (y > boxMin[1]) && (y < boxMax[1]) && (z > boxMin[2]) && (z < boxMax[2]);
+				if (!inside)
+					boundary.push_back(Vector3r(x, y, z));
+			}
+}
+
+/** Move the fluid particles randomly so that each search has to start from scratch.
+* The displacement of a particle only depends on its original index, so all implementations
+* get the same positions independent of their sort order. */
+void perturb(vector<Vector3r> &fluid, const vector<unsigned int> &originalIndex, std::mt19937 &gen)
+{
+	std::uniform_real_distribution<Real> dist(-0.1*particleRadius, 0.1*particleRadius);
+	vector<Vector3r> displacement(fluid.size());
+	for (unsigned int i = 0; i < fluid.size(); i++)
+		displacement[i] = Vector3r(dist(gen), dist(gen), dist(gen));
+	for (unsigned int i = 0; i < fluid.size(); i++)
+		fluid[i] += displacement[originalIndex[i]];
+}
+
+double elapsedMs(const std::chrono::high_resolution_clock::time_point &start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/** Run the benchmark for one neighborhood search implementation. Both implementations have the same interface. */
+template<typename NeighborhoodSearchType>
+BenchmarkResult runBenchmark(const string &name, NeighborhoodSearchType &nsearch, const vector<Vector3r> &fluidInit, const vector<Vector3r> &boundary)
+{
+	BenchmarkResult res;
+	res.name = name;
+	res.searchTime = 0.0;
+	res.sortTime = 0.0;
+	res.numNeighbors = 0;
+
+	vector<Vector3r> fluid = fluidInit;
+	nsearch.add_point_set(&fluid[0][0], fluid.size(), true, true);
+	nsearch.add_point_set(&boundary[0][0], boundary.size(), false, false);
+
+	// initial search and z-sort as in the simulation
+	nsearch.find_neighbors();
+	auto start = std::chrono::high_resolution_clock::now();
+	nsearch.z_sort();
+	nsearch.point_set(0).sort_field(&fluid[0]);
+	res.sortTime = elapsedMs(start);
+
+	// original index of each particle after sorting (the sort order of the implementations can differ)
+	vector<unsigned int> originalIndex(fluid.size());
+	for (unsigned int i = 0; i < fluid.size(); i++)
+		originalIndex[i] = i;
+	nsearch.point_set(0).sort_field(&originalIndex[0]);
+
+	std::mt19937 gen(42);
+	for (unsigned int it = 0; it < numIterations; it++)
+	{
+		perturb(fluid, originalIndex, gen);
+		start = std::chrono::high_resolution_clock::now();
+		nsearch.find_neighbors();
+		res.searchTime += elapsedMs(start);
+	}
+	res.searchTime /= (double)numIterations;
+
+	// collect the neighbors by the original particle index
+	const auto &ps = nsearch.point_set(0);
+	res.neighbors.resize(fluid.size());
+	for (unsigned int i = 0; i < fluid.size(); i++)
+	{
+		vector<std::uint64_t> &n = res.neighbors[originalIndex[i]];
+		n.clear();
+		for (unsigned int j = 0; j < ps.n_neighbors(i); j++)
+		{
+			const auto &pid = ps.neighbor(i, j);
+			const unsigned int index = (pid.point_set_id == 0) ? originalIndex[pid.point_id] : pid.point_id;
+			n.push_back(((std::uint64_t)pid.point_set_id << 32) | index);
+		}
+		std::sort(n.begin(), n.end());
+		res.numNeighbors += n.size();
+	}
+	return res;
+}
+
+vector<Real> parseList(const string &str)
+{
+	vector<Real> values;
+	stringstream ss(str);
+	string item;
+	while (getline(ss, item, ','))
+		values.push_back(stof(item));
+	return values;
+}
+
+// main
+int main( int argc, char **argv )
+{
+	REPORT_MEMORY_LEAKS;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string argStr = argv[i];
+		string type_str = argStr.substr(0, 2);
+		if ((type_str == "-r") && (i + 1 < argc))
+			particleRadius = stof(argv[++i]);
+		else if ((type_str == "-i") && (i + 1 < argc))
+			numIterations = max(1, stoi(argv[++i]));
+		else if ((type_str == "-c") && (i + 1 < argc))
+			cellSizeFactors = parseList(argv[++i]);
+		else
+		{
+			std::cerr << "Usage: NeighborhoodSearchBenchmark [-r particle_radius] [-i iterations] [-c cell_size_factor1,cell_size_factor2,...]\n";
+			return -1;
+		}
+	}
+
+	vector<Vector3r> fluid, boundary;
+	createDamBreak(fluid, boundary);
+	const Real supportRadius = 4.0 * particleRadius;
+
+	std::cout << "Dam break: " << fluid.size() << " fluid particles, " << boundary.size() << " boundary particles, support radius " << supportRadius << "\n";
+
+	vector<BenchmarkResult> results;
+	for (unsigned int i = 0; i < cellSizeFactors.size(); i++)
+	{
+		NeighborhoodSearch_CellGrid nsearch(supportRadius, cellSizeFactors[i]);
+		stringstream name;
+		name << "CellGrid (cell size " << cellSizeFactors[i] << " r)";
+		results.push_back(runBenchmark(name.str(), nsearch, fluid, boundary));
+	}
+#ifdef SPH_USE_COMPACTNSEARCH
+	{
+		CompactNSearch::NeighborhoodSearch nsearch(supportRadius, false);
+		results.push_back(runBenchmark("CompactNSearch", nsearch, fluid, boundary));
+	}
+#else
+	std::cout << "CompactNSearch is not available (configure with USE_COMPACTNSEARCH=ON for a comparison).\n";
+#endif
+
+	std::cout << std::left << std::setw(32) << "Method" << std::right << std::setw(14) << "search [ms]" << std::setw(14) << "z-sort [ms]"
+		<< std::setw(16) << "neighbors" << std::setw(10) << "equal" << "\n";
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		const bool equal = (results[i].neighbors == results[0].neighbors);
+		std::cout << std::left << std::setw(32) << results[i].name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(14) << results[i].searchTime << std::setw(14) << results[i].sortTime
+			<< std::setw(16) << results[i].numNeighbors << std::setw(10) << (equal ? "yes" : "no") << "\n";
+	}
+
+	return 0;
+}
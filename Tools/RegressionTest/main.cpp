@@ -0,0 +1,473 @@
+#include "SPlisHSPlasH/Common.h"
+#include "SPlisHSPlasH/FluidModel.h"
+#include "SPlisHSPlasH/TimeManager.h"
+#include "SPlisHSPlasH/StaticRigidBody.h"
+#include "SPlisHSPlasH/WCSPH/TimeStepWCSPH.h"
+#include "SPlisHSPlasH/PCISPH/TimeStepPCISPH.h"
+#include "SPlisHSPlasH/PBF/TimeStepPBF.h"
+#include "SPlisHSPlasH/IISPH/TimeStepIISPH.h"
+#include "SPlisHSPlasH/DFSPH/TimeStepDFSPH.h"
+#include <Eigen/Dense>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(WIN32) || defined(_WIN32)
+#include <direct.h>
+#endif
+
+// Enable memory leak detection
+#ifdef _DEBUG
+#ifndef EIGEN_ALIGN
+	#define new DEBUG_NEW
+#endif
+#endif
+
+using namespace SPH;
+using namespace std;
+
+const char *methodNames[] = { "WCSPH", "PCISPH", "PBF", "IISPH", "DFSPH" };
+const unsigned int numMethods = sizeof(methodNames) / sizeof(methodNames[0]);
+
+Real particleRadius = 0.025;
+Real timeStepSize = 0.001;
+unsigned int numSteps = 200;
+unsigned int frameInterval = 50;
+
+/** Tolerances of the comparison. Lengths are relative to the particle radius. */
+struct Tolerances
+{
+	Real positionRMS = 0.05;
+	Real centerOfMass = 0.01;
+	/** Relative difference of the kinetic energy */
+	Real kineticEnergy = 0.01;
+	/** Absolute difference of the average and the maximal density error in percent */
+	Real densityError = 0.1;
+	Real maxDensityError = 1.0;
+	/** Relative difference of the force on the dynamic body (thread comparison) */
+	Real boundaryForce = 0.01;
+} tolerances;
+
+/** Dynamic body which is held in place: the fluid forces on its particles are accumulated
+* (see FluidModel::addForce()), but the body does not move. */
+class HeldDynamicBody : public StaticRigidBody
+{
+public:
+	virtual bool isDynamic() const { return true; }
+	virtual Real const getMass() const { return 1.0; }
+};
+
+/** State of the fluid after a number of steps. The positions are stored by particle ID,
+* so frames can be compared although the particles are sorted in the simulation. */
+struct Frame
+{
+	unsigned int step;
+	Real kineticEnergy;
+	Vector3r centerOfMass;
+	/** Average and maximal density deviation |rho/rho0 - 1| in percent */
+	Real avgDensityError;
+	Real maxDensityError;
+	/** Sum of the forces on the dynamic body since the last frame (not stored in the reference files) */
+	Vector3r boundaryForce;
+	vector<Vector3r> positions;
+};
+
+/** Dam break in the box [0,1]x[0,1]x[0,0.5] with a fluid block in one corner. */
+void createDamBreak(vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles)
+{
+	const Real r = particleRadius;
+	const Real d = 2.0*r;
+	const Real eps = 1.0e-9;
+	const Vector3r minX(0.0, 0.0, 0.0);
+	const Vector3r maxX(1.0, 1.0, 0.5);
+	for (Real x = minX[0] - d; x <= maxX[0] + d + eps; x += r)
+		for (Real y = minX[1] - d; y <= maxX[1] + d + eps; y += r)
+			for (Real z = minX[2] - d; z <= maxX[2] + d + eps; z += r)
+			{
+				const bool inside = (x > minX[0] - eps) && (x < maxX[0] + eps) && (y > minX[1] - eps) && (y < maxX[1] + eps) && (z > minX[2] - eps) && (z < maxX[2] + eps);
+				if (!inside)
+					boundaryParticles.push_back(Vector3r(x, y, z));
+			}
+
+	for (Real x = d; x < 0.5; x += d)
+		for (Real y = d; y < 0.8; y += d)
+			for (Real z = d; z < 0.5 - r; z += d)
+				fluidParticles.push_back(Vector3r(x, y, z));
+}
+
+/** Block which stands in the way of the dam break and is added as dynamic body. */
+void createObstacle(vector<Vector3r> &obstacleParticles)
+{
+	const Real r = particleRadius;
+	const Real eps = 1.0e-9;
+	for (Real x = 0.6; x <= 0.7 + eps; x += r)
+		for (Real y = 0.0; y <= 0.3 + eps; y += r)
+			for (Real z = 0.2; z <= 0.3 + eps; z += r)
+				obstacleParticles.push_back(Vector3r(x, y, z));
+}
+
+TimeStep *createTimeStep(const unsigned int method, FluidModel *model)
+{
+	switch (method)
+	{
+	case 0: return new TimeStepWCSPH(model);
+	case 1: return new TimeStepPCISPH(model);
+	case 2: return new TimeStepPBF(model);
+	case 3: return new TimeStepIISPH(model);
+	default: return new TimeStepDFSPH(model);
+	}
+}
+
+Frame captureFrame(FluidModel &model, const unsigned int step)
+{
+	Frame frame;
+	frame.step = step;
+	frame.kineticEnergy = 0.0;
+	frame.centerOfMass.setZero();
+	frame.avgDensityError = 0.0;
+	frame.maxDensityError = 0.0;
+	frame.boundaryForce.setZero();
+
+	const unsigned int numParticles = model.numParticles();
+	frame.positions.resize(numParticles);
+	Real totalMass = 0.0;
+	for (unsigned int i = 0; i < numParticles; i++)
+	{
+		const Real mass = model.getMass(i);
+		const Vector3r &xi = model.getPosition(0, i);
+		const Vector3r &vi = model.getVelocity(0, i);
+		frame.positions[model.getParticleId(i)] = xi;
+		frame.kineticEnergy += 0.5 * mass * vi.squaredNorm();
+		frame.centerOfMass += mass * xi;
+		totalMass += mass;
+		const Real densityError = fabs(model.getDensity(i) / model.getDensity0() - 1.0) * 100.0;
+		frame.avgDensityError += densityError;
+		frame.maxDensityError = std::max(frame.maxDensityError, densityError);
+	}
+	if (numParticles > 0)
+	{
+		frame.centerOfMass /= totalMass;
+		frame.avgDensityError /= numParticles;
+	}
+	return frame;
+}
+
+/** Simulate the dam break with a solver and capture a frame every frameInterval steps.
+* If obstacle particles are given, they are added as dynamic body. If numThreads > 0, the number
+* of threads is changed after the model has been initialized, so the solver has to adapt its
+* per-thread buffers. */
+void simulate(const unsigned int method, vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles, vector<Vector3r> &obstacleParticles, vector<Frame> &frames, const int numThreads = 0)
+{
+	FluidModel model;
+	model.getTimeManager()->setTimeStepSize(timeStepSize);
+	model.setParticleRadius(particleRadius);
+	// the reference frames are computed with the cubic kernels of this support radius
+	model.setKernel(0);
+	model.setGradKernel(0);
+	StaticRigidBody *rb = new StaticRigidBody();
+	rb->setPosition(Vector3r::Zero());
+	rb->setRotation(Matrix3r::Identity());
+	model.addRigidBodyObject(rb, (unsigned int)boundaryParticles.size(), boundaryParticles.data());
+	if (!obstacleParticles.empty())
+	{
+		HeldDynamicBody *obstacle = new HeldDynamicBody();
+		obstacle->setPosition(Vector3r::Zero());
+		obstacle->setRotation(Matrix3r::Identity());
+		model.addRigidBodyObject(obstacle, (unsigned int)obstacleParticles.size(), obstacleParticles.data());
+	}
+	model.initModel((unsigned int)fluidParticles.size(), fluidParticles.data());
+
+	TimeStep *timeStep = createTimeStep(method, &model);
+	timeStep->setCflMethod(0);
+	model.updateBoundaryPsi();
+#ifdef _OPENMP
+	if (numThreads > 0)
+		omp_set_num_threads(numThreads);
+#endif
+
+	frames.clear();
+	Vector3r boundaryForce = Vector3r::Zero();
+	for (unsigned int i = 1; i <= numSteps; i++)
+	{
+		timeStep->step();
+
+		// the forces on the dynamic body are collected and cleared in each step
+		for (unsigned int b = 0; b < model.numberOfRigidBodyParticleObjects(); b++)
+		{
+			FluidModel::RigidBodyParticleObject *rbpo = model.getRigidBodyParticleObject(b);
+			if (!rbpo->m_rigidBody->isDynamic())
+				continue;
+			for (unsigned int j = 0; j < rbpo->numberOfParticles(); j++)
+			{
+				boundaryForce += rbpo->m_f[j];
+				rbpo->m_f[j].setZero();
+			}
+		}
+
+		if ((i % frameInterval == 0) || (i == numSteps))
+		{
+			frames.push_back(captureFrame(model, i));
+			frames.back().boundaryForce = boundaryForce;
+			boundaryForce.setZero();
+		}
+	}
+	delete timeStep;
+}
+
+/** Create a directory and its parent directories, returns false if the directory does not exist afterwards. */
+bool createDirectory(const string &dir)
+{
+	size_t pos = 0;
+	do
+	{
+		pos = dir.find_first_of("/\\", pos + 1);
+		const string path = dir.substr(0, pos);
+#if defined(WIN32) || defined(_WIN32)
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	} while (pos != string::npos);
+
+	struct stat info;
+	return (stat(dir.c_str(), &info) == 0) && ((info.st_mode & S_IFDIR) != 0);
+}
+
+string frameFileName(const string &dir, const unsigned int method, const unsigned int step)
+{
+	stringstream ss;
+	ss << dir << "/" << methodNames[method] << "_" << std::setw(5) << std::setfill('0') << step << ".txt";
+	return ss.str();
+}
+
+bool writeFrame(const string &fileName, const Frame &frame)
+{
+	ofstream out(fileName.c_str());
+	if (!out)
+		return false;
+	out << std::setprecision(std::numeric_limits<Real>::max_digits10);
+	out << "step " << frame.step << "\n";
+	out << "kinetic_energy " << frame.kineticEnergy << "\n";
+	out << "center_of_mass " << frame.centerOfMass[0] << " " << frame.centerOfMass[1] << " " << frame.centerOfMass[2] << "\n";
+	out << "density_error " << frame.avgDensityError << " " << frame.maxDensityError << "\n";
+	out << "particles " << frame.positions.size() << "\n";
+	for (unsigned int i = 0; i < frame.positions.size(); i++)
+		out << frame.positions[i][0] << " " << frame.positions[i][1] << " " << frame.positions[i][2] << "\n";
+	return (bool) out;
+}
+
+bool readFrame(const string &fileName, Frame &frame)
+{
+	ifstream in(fileName.c_str());
+	if (!in)
+		return false;
+	string key;
+	size_t numParticles = 0;
+	in >> key >> frame.step;
+	in >> key >> frame.kineticEnergy;
+	in >> key >> frame.centerOfMass[0] >> frame.centerOfMass[1] >> frame.centerOfMass[2];
+	in >> key >> frame.avgDensityError >> frame.maxDensityError;
+	in >> key >> numParticles;
+	frame.positions.resize(numParticles);
+	for (size_t i = 0; i < numParticles; i++)
+		in >> frame.positions[i][0] >> frame.positions[i][1] >> frame.positions[i][2];
+	return !in.fail();
+}
+
+/** Compare a frame with its reference, print the deviations and return true if all are within the tolerances. */
+bool compareFrames(const unsigned int method, const Frame &frame, const Frame &reference)
+{
+	if (frame.positions.size() != reference.positions.size())
+	{
+		std::cout << methodNames[method] << " step " << frame.step << ": " << frame.positions.size() << " particles, reference has "
+			<< reference.positions.size() << "  FAILED\n";
+		return false;
+	}
+
+	Real sum = 0.0;
+	for (unsigned int i = 0; i < frame.positions.size(); i++)
+		sum += (frame.positions[i] - reference.positions[i]).squaredNorm();
+	const Real positionRMS = frame.positions.empty() ? 0.0 : sqrt(sum / frame.positions.size()) / particleRadius;
+	const Real comDiff = (frame.centerOfMass - reference.centerOfMass).norm() / particleRadius;
+	const Real keDiff = fabs(frame.kineticEnergy - reference.kineticEnergy) / std::max(fabs(reference.kineticEnergy), static_cast<Real>(1.0e-12));
+	const Real avgDensityDiff = fabs(frame.avgDensityError - reference.avgDensityError);
+	const Real maxDensityDiff = fabs(frame.maxDensityError - reference.maxDensityError);
+
+	const bool passed = (positionRMS <= tolerances.positionRMS) && (comDiff <= tolerances.centerOfMass) && (keDiff <= tolerances.kineticEnergy) &&
+		(avgDensityDiff <= tolerances.densityError) && (maxDensityDiff <= tolerances.maxDensityError);
+	std::cout << std::left << std::setw(8) << methodNames[method] << std::right << std::setw(6) << frame.step
+		<< std::scientific << std::setprecision(3) << std::setw(13) << positionRMS << std::setw(13) << comDiff
+		<< std::setw(13) << keDiff << std::setw(13) << avgDensityDiff << std::setw(13) << maxDensityDiff
+		<< (passed ? "  ok" : "  FAILED") << "\n";
+	return passed;
+}
+
+/** Compare the force on the dynamic body of a frame with its reference. */
+bool compareBoundaryForces(const unsigned int method, const Frame &frame, const Frame &reference)
+{
+	const Real forceDiff = (frame.boundaryForce - reference.boundaryForce).norm() / std::max(reference.boundaryForce.norm(), static_cast<Real>(1.0e-12));
+	const bool passed = forceDiff <= tolerances.boundaryForce;
+	std::cout << std::left << std::setw(8) << methodNames[method] << std::right << std::setw(6) << frame.step
+		<< std::scientific << std::setprecision(3) << std::setw(13) << reference.boundaryForce.norm() << std::setw(13) << forceDiff
+		<< (passed ? "  ok" : "  FAILED") << "\n";
+	return passed;
+}
+
+/** Simulate the dam break with a dynamic body with one thread and with numThreads threads and compare
+* the frames and the forces on the body. Returns true if all deviations are within the tolerances. */
+bool compareThreads(const int numThreads, vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles)
+{
+	vector<Vector3r> obstacleParticles;
+	createObstacle(obstacleParticles);
+
+	std::cout << "Comparison of 1 and " << numThreads << " threads\n";
+	std::cout << std::left << std::setw(8) << "Method" << std::right << std::setw(6) << "Step" << std::setw(13) << "Pos. RMS"
+		<< std::setw(13) << "COM" << std::setw(13) << "Kin. energy" << std::setw(13) << "Avg. rho err" << std::setw(13) << "Max. rho err" << "\n";
+
+	bool passed = true;
+	vector<vector<Frame> > singleThreadFrames(numMethods), multiThreadFrames(numMethods);
+	for (unsigned int m = 0; m < numMethods; m++)
+	{
+		// the models are created with the other number of threads
+#ifdef _OPENMP
+		omp_set_num_threads(numThreads);
+#endif
+		simulate(m, boundaryParticles, fluidParticles, obstacleParticles, singleThreadFrames[m], 1);
+#ifdef _OPENMP
+		omp_set_num_threads(1);
+#endif
+		simulate(m, boundaryParticles, fluidParticles, obstacleParticles, multiThreadFrames[m], numThreads);
+		for (unsigned int f = 0; f < multiThreadFrames[m].size(); f++)
+			passed = compareFrames(m, multiThreadFrames[m][f], singleThreadFrames[m][f]) && passed;
+	}
+
+	std::cout << std::left << std::setw(8) << "Method" << std::right << std::setw(6) << "Step" << std::setw(13) << "Force" << std::setw(13) << "Force diff." << "\n";
+	for (unsigned int m = 0; m < numMethods; m++)
+	{
+		for (unsigned int f = 0; f < multiThreadFrames[m].size(); f++)
+			passed = compareBoundaryForces(m, multiThreadFrames[m][f], singleThreadFrames[m][f]) && passed;
+	}
+	return passed;
+}
+
+// main
+int main( int argc, char **argv )
+{
+	REPORT_MEMORY_LEAKS;
+
+	string referenceDir;
+	bool generate = false;
+	int numThreads = 0;
+	bool ok = true;
+	for (int i = 1; (i < argc) && ok; i++)
+	{
+		string argStr = argv[i];
+		if ((argStr == "--generate") && (i + 1 < argc))
+		{
+			referenceDir = argv[++i];
+			generate = true;
+		}
+		else if ((argStr == "--compare") && (i + 1 < argc))
+			referenceDir = argv[++i];
+		else if ((argStr == "--threads") && (i + 1 < argc))
+			numThreads = max(1, stoi(argv[++i]));
+		else if ((argStr == "-s") && (i + 1 < argc))
+			numSteps = max(1, stoi(argv[++i]));
+		else if ((argStr == "-f") && (i + 1 < argc))
+			frameInterval = max(1, stoi(argv[++i]));
+		else if ((argStr == "--tol-pos") && (i + 1 < argc))
+			tolerances.positionRMS = stod(argv[++i]);
+		else if ((argStr == "--tol-com") && (i + 1 < argc))
+			tolerances.centerOfMass = stod(argv[++i]);
+		else if ((argStr == "--tol-ke") && (i + 1 < argc))
+			tolerances.kineticEnergy = stod(argv[++i]);
+		else if ((argStr == "--tol-density") && (i + 1 < argc))
+			tolerances.densityError = stod(argv[++i]);
+		else if ((argStr == "--tol-density-max") && (i + 1 < argc))
+			tolerances.maxDensityError = stod(argv[++i]);
+		else if ((argStr == "--tol-force") && (i + 1 < argc))
+			tolerances.boundaryForce = stod(argv[++i]);
+		else
+			ok = false;
+	}
+	if (!ok || (referenceDir.empty() && (numThreads == 0)))
+	{
+		std::cerr << "Usage: RegressionTest (--generate dir | --compare dir | --threads n) [-s steps] [-f frame_interval]\n"
+			<< "                      [--tol-pos rms] [--tol-com dist] [--tol-ke rel] [--tol-density percent] [--tol-density-max percent] [--tol-force rel]\n"
+			<< "  Position RMS and center of mass tolerances are relative to the particle radius.\n"
+			<< "  --threads: compare a dam break with a dynamic body simulated with one and with n threads.\n";
+		return -1;
+	}
+
+	if (generate && !createDirectory(referenceDir))
+	{
+		std::cerr << "Cannot create " << referenceDir << "\n";
+		return -1;
+	}
+
+	vector<Vector3r> boundaryParticles;
+	vector<Vector3r> fluidParticles;
+	createDamBreak(boundaryParticles, fluidParticles);
+
+	if (numThreads > 0)
+	{
+#ifndef _OPENMP
+		// e.g. a debug build without OpenMP support
+		std::cout << "OpenMP is disabled, the thread comparison is skipped.\n";
+		return 0;
+#endif
+		const bool passed = compareThreads(numThreads, boundaryParticles, fluidParticles);
+		std::cout << (passed ? "Results do not depend on the number of threads.\n" : "Thread comparison FAILED.\n");
+		return passed ? 0 : 1;
+	}
+
+	if (!generate)
+		std::cout << std::left << std::setw(8) << "Method" << std::right << std::setw(6) << "Step" << std::setw(13) << "Pos. RMS"
+			<< std::setw(13) << "COM" << std::setw(13) << "Kin. energy" << std::setw(13) << "Avg. rho err" << std::setw(13) << "Max. rho err" << "\n";
+
+	bool passed = true;
+	for (unsigned int m = 0; m < numMethods; m++)
+	{
+		vector<Frame> frames;
+		vector<Vector3r> noObstacle;
+		simulate(m, boundaryParticles, fluidParticles, noObstacle, frames);
+		for (unsigned int f = 0; f < frames.size(); f++)
+		{
+			const string fileName = frameFileName(referenceDir, m, frames[f].step);
+			if (generate)
+			{
+				if (!writeFrame(fileName, frames[f]))
+				{
+					std::cerr << "Cannot write " << fileName << "\n";
+					return -1;
+				}
+				continue;
+			}
+
+			Frame reference;
+			if (!readFrame(fileName, reference))
+			{
+				std::cout << "Cannot read reference frame " << fileName << "\n";
+				passed = false;
+				continue;
+			}
+			passed = compareFrames(m, frames[f], reference) && passed;
+		}
+	}
+
+	if (generate)
+		std::cout << "Reference frames written to " << referenceDir << "\n";
+	else
+		std::cout << (passed ? "All frames match the reference.\n" : "Regression test FAILED.\n");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,561 @@
+#include "SPlisHSPlasH/Common.h"
+#include "SPlisHSPlasH/FluidModel.h"
+#include "SPlisHSPlasH/TimeManager.h"
+#include "SPlisHSPlasH/StaticRigidBody.h"
+#include "SPlisHSPlasH/WCSPH/TimeStepWCSPH.h"
+#include "SPlisHSPlasH/PCISPH/TimeStepPCISPH.h"
+#include "SPlisHSPlasH/PBF/TimeStepPBF.h"
+#include "SPlisHSPlasH/IISPH/TimeStepIISPH.h"
+#include "SPlisHSPlasH/DFSPH/TimeStepDFSPH.h"
+#include "SPlisHSPlasH/Utilities/Timing.h"
+#include <Eigen/Dense>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+// Enable memory leak detection
+#ifdef _DEBUG
+#ifndef EIGEN_ALIGN
+	#define new DEBUG_NEW
+#endif
+#endif
+
+using namespace SPH;
+using namespace std;
+
+const char *methodNames[] = { "WCSPH", "PCISPH", "PBF", "IISPH", "DFSPH" };
+const unsigned int numMethods = sizeof(methodNames) / sizeof(methodNames[0]);
+
+vector<unsigned int> methods;
+vector<unsigned int> sizes;
+vector<unsigned int> threadCounts;
+unsigned int numSteps = 20;
+unsigned int numWarmupSteps = 2;
+/** Time step size relative to the particle diameter (in s/m) */
+Real timeStepFactor = 0.05;
+bool json = false;
+/** Measure hardware performance counters of the timed phases */
+bool counters = false;
+/** Use the tiled neighbor loops (see FluidModel::setUseTiledTraversal()) */
+bool tiled = false;
+/** Number of fluid particles of the model from which the memory is predicted (see --predict) */
+unsigned int calibrationSize = 10000;
+string outputFile;
+const double MB = 1024.0 * 1024.0;
+
+/** Result of a benchmark run. */
+struct BenchmarkResult
+{
+	string method;
+	unsigned int numFluidParticles;
+	unsigned int numBoundaryParticles;
+	unsigned int numThreads;
+	Real particleRadius;
+	Real timeStepSize;
+	double msPerStep;
+	double particleStepsPerSecond;
+	double avgIterations;
+	double peakMemoryMB;
+	/** Memory of the subsystems at the end of the run */
+	MemoryUsage memoryUsage;
+	/** Average time per step of the timed phases (see START_TIMING) in ms */
+	map<string, double> phases;
+	/** Instructions per cycle of the timed phases (if counters are enabled) */
+	map<string, double> phaseIPC;
+	/** Memory bandwidth of the timed phases in GB/s, estimated from the last level cache misses */
+	map<string, double> phaseBandwidth;
+};
+
+/** Reset the peak memory of the process, if supported by the OS (Linux). */
+void resetPeakMemory()
+{
+#ifdef __linux__
+	ofstream clearRefs("/proc/self/clear_refs");
+	if (clearRefs)
+		clearRefs << "5";
+#endif
+}
+
+/** Peak resident set size of the process in MB since the last resetPeakMemory(). Where the
+* peak cannot be reset, this is the peak of the whole process. */
+double peakMemoryMB()
+{
+#if defined(WIN32) || defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return (double)pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+	return 0.0;
+#elif defined(__linux__)
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line))
+	{
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return stod(line.substr(6)) / 1024.0;
+	}
+	return 0.0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return (double)usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return (double)usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+/** Dam break in the box [0,1]x[0,1]x[0,0.5] with a fluid block of about numFluidParticles particles
+* in one corner. The box is sampled by two layers of boundary particles. */
+Real createDamBreak(const unsigned int numFluidParticles, vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles)
+{
+	const Vector3r fluidSize(0.5, 0.8, 0.5);
+	const Real d = cbrt(fluidSize.prod() / (Real)numFluidParticles);
+	const Real r = 0.5*d;
+	const Real eps = 1.0e-9;
+	const Vector3r minX(0.0, 0.0, 0.0);
+	const Vector3r maxX(1.0, 1.0, 0.5);
+
+	const int nx = (int)floor((maxX[0] - minX[0] + 4.0*r) / r + eps) + 1;
+	const int ny = (int)floor((maxX[1] - minX[1] + 4.0*r) / r + eps) + 1;
+	const int nz = (int)floor((maxX[2] - minX[2] + 4.0*r) / r + eps) + 1;
+	boundaryParticles.clear();
+	for (int i = 0; i < nx; i++)
+		for (int j = 0; j < ny; j++)
+		{
+			const Real x = minX[0] - 2.0*r + i*r;
+			const Real y = minX[1] - 2.0*r + j*r;
+			const bool insideXY = (x > minX[0] - eps) && (x < maxX[0] + eps) && (y > minX[1] - eps) && (y < maxX[1] + eps);
+			for (int k = 0; k < nz; k++)
+			{
+				const Real z = minX[2] - 2.0*r + k*r;
+				// only the shell of the box is sampled
+				if (insideXY && (z > minX[2] - eps) && (z < maxX[2] + eps))
+				{
+					k = nz - 3;
+					continue;
+				}
+				boundaryParticles.push_back(Vector3r(x, y, z));
+			}
+		}
+
+	fluidParticles.clear();
+	for (Real x = d; x < fluidSize[0]; x += d)
+		for (Real y = d; y < fluidSize[1]; y += d)
+			for (Real z = d; z < fluidSize[2] - r; z += d)
+				fluidParticles.push_back(Vector3r(x, y, z));
+	return r;
+}
+
+TimeStep *createTimeStep(const unsigned int method, FluidModel *model)
+{
+	switch (method)
+	{
+	case 0: return new TimeStepWCSPH(model);
+	case 1: return new TimeStepPCISPH(model);
+	case 2: return new TimeStepPBF(model);
+	case 3: return new TimeStepIISPH(model);
+	default: return new TimeStepDFSPH(model);
+	}
+}
+
+/** Simulate the dam break with a fixed time step size and a fixed number of steps. */
+BenchmarkResult run(const unsigned int method, const unsigned int numThreads, const Real particleRadius,
+	vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(numThreads);
+#endif
+	// the counters are opened per thread
+	if (counters && !PerformanceCounters::enable())
+	{
+		std::cerr << "Hardware performance counters are not available on this system.\n";
+		counters = false;
+	}
+	resetPeakMemory();
+
+	BenchmarkResult res;
+	res.method = methodNames[method];
+	res.numFluidParticles = (unsigned int)fluidParticles.size();
+	res.numBoundaryParticles = (unsigned int)boundaryParticles.size();
+	res.numThreads = numThreads;
+	res.particleRadius = particleRadius;
+	res.timeStepSize = timeStepFactor * 2.0 * particleRadius;
+
+	FluidModel model;
+	model.getTimeManager()->setTimeStepSize(res.timeStepSize);
+	model.setParticleRadius(particleRadius);
+	// set the kernels after the radius, so that the kernels and W_zero use the support radius of the model
+	model.setKernel(0);
+	model.setGradKernel(0);
+	model.setUseTiledTraversal(tiled);
+	StaticRigidBody *rb = new StaticRigidBody();
+	rb->setPosition(Vector3r::Zero());
+	rb->setRotation(Matrix3r::Identity());
+	model.addRigidBodyObject(rb, (unsigned int)boundaryParticles.size(), boundaryParticles.data());
+	model.initModel((unsigned int)fluidParticles.size(), fluidParticles.data());
+
+	TimeStep *timeStep = createTimeStep(method, &model);
+	timeStep->setCflMethod(0);
+	model.updateBoundaryPsi();
+
+	for (unsigned int i = 0; i < numWarmupSteps; i++)
+		timeStep->step();
+
+	Timing::reset();
+	unsigned long long iterations = 0;
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < numSteps; i++)
+	{
+		timeStep->step();
+		iterations += timeStep->getIterationCount();
+	}
+	const double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	res.msPerStep = time / numSteps;
+	res.particleStepsPerSecond = (double)fluidParticles.size() * numSteps / (time * 0.001);
+	res.avgIterations = (double)iterations / numSteps;
+	for (auto iter = Timing::m_averageTimes.begin(); iter != Timing::m_averageTimes.end(); iter++)
+		res.phases[iter->second.name] += iter->second.totalTime / numSteps;
+	if (counters)
+	{
+		typedef PerformanceCounters PC;
+		map<string, AverageTime> phaseTotals;
+		for (auto iter = Timing::m_averageTimes.begin(); iter != Timing::m_averageTimes.end(); iter++)
+		{
+			AverageTime &at = phaseTotals[iter->second.name];
+			at.totalTime += iter->second.totalTime;
+			for (unsigned int i = 0; i < PC::NumEvents; i++)
+				at.counters.value[i] += iter->second.counters.value[i];
+		}
+		for (auto iter = phaseTotals.begin(); iter != phaseTotals.end(); iter++)
+		{
+			const unsigned long long *v = iter->second.counters.value;
+			if (PC::isAvailable(PC::Cycles) && PC::isAvailable(PC::Instructions) && (v[PC::Cycles] > 0))
+				res.phaseIPC[iter->first] = (double)v[PC::Instructions] / (double)v[PC::Cycles];
+			if (PC::isAvailable(PC::CacheMisses) && (iter->second.totalTime > 0.0))
+				res.phaseBandwidth[iter->first] = (double)v[PC::CacheMisses] * PC::CacheLineSize / (iter->second.totalTime * 1.0e6);
+		}
+	}
+	Timing::reset();
+
+	res.memoryUsage = MemoryUsage(model.numParticles(), model.numberOfBoundaryParticles());
+	timeStep->getMemoryUsage(res.memoryUsage);
+
+	delete timeStep;
+	res.peakMemoryMB = peakMemoryMB();
+	return res;
+}
+
+void writeCSV(ostream &out, const vector<BenchmarkResult> &results)
+{
+	// one column per phase of all solvers
+	vector<string> phaseNames;
+	for (unsigned int i = 0; i < results.size(); i++)
+		for (auto iter = results[i].phases.begin(); iter != results[i].phases.end(); iter++)
+			if (std::find(phaseNames.begin(), phaseNames.end(), iter->first) == phaseNames.end())
+				phaseNames.push_back(iter->first);
+
+	out << "method,fluid_particles,boundary_particles,threads,particle_radius,h,steps,ms_per_step,particle_steps_per_s,avg_iterations,peak_rss_mb,accounted_mb";
+	for (unsigned int p = 0; p < phaseNames.size(); p++)
+		out << "," << phaseNames[p] << "_ms";
+	if (counters)
+	{
+		for (unsigned int p = 0; p < phaseNames.size(); p++)
+			out << "," << phaseNames[p] << "_ipc," << phaseNames[p] << "_gb_per_s";
+	}
+	out << "\n";
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult &r = results[i];
+		out << r.method << "," << r.numFluidParticles << "," << r.numBoundaryParticles << "," << r.numThreads << ","
+			<< r.particleRadius << "," << r.timeStepSize << "," << numSteps << "," << r.msPerStep << ","
+			<< r.particleStepsPerSecond << "," << r.avgIterations << "," << r.peakMemoryMB << "," << r.memoryUsage.getTotalBytes() / MB;
+		for (unsigned int p = 0; p < phaseNames.size(); p++)
+		{
+			out << ",";
+			auto iter = r.phases.find(phaseNames[p]);
+			if (iter != r.phases.end())
+				out << iter->second;
+		}
+		if (counters)
+		{
+			for (unsigned int p = 0; p < phaseNames.size(); p++)
+			{
+				out << ",";
+				auto iter = r.phaseIPC.find(phaseNames[p]);
+				if (iter != r.phaseIPC.end())
+					out << iter->second;
+				out << ",";
+				iter = r.phaseBandwidth.find(phaseNames[p]);
+				if (iter != r.phaseBandwidth.end())
+					out << iter->second;
+			}
+		}
+		out << "\n";
+	}
+}
+
+void writeJSON(ostream &out, const vector<BenchmarkResult> &results)
+{
+	out << "[\n";
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult &r = results[i];
+		out << "  { \"method\": \"" << r.method << "\", \"fluid_particles\": " << r.numFluidParticles
+			<< ", \"boundary_particles\": " << r.numBoundaryParticles << ", \"threads\": " << r.numThreads
+			<< ", \"particle_radius\": " << r.particleRadius << ", \"h\": " << r.timeStepSize << ", \"steps\": " << numSteps
+			<< ", \"ms_per_step\": " << r.msPerStep << ", \"particle_steps_per_s\": " << r.particleStepsPerSecond
+			<< ", \"avg_iterations\": " << r.avgIterations << ", \"peak_rss_mb\": " << r.peakMemoryMB
+			<< ", \"accounted_mb\": " << r.memoryUsage.getTotalBytes() / MB << ", \"phases_ms\": { ";
+		for (auto iter = r.phases.begin(); iter != r.phases.end(); iter++)
+			out << (iter == r.phases.begin() ? "" : ", ") << "\"" << iter->first << "\": " << iter->second;
+		out << " }";
+		if (counters)
+		{
+			out << ", \"phases_ipc\": { ";
+			for (auto iter = r.phaseIPC.begin(); iter != r.phaseIPC.end(); iter++)
+				out << (iter == r.phaseIPC.begin() ? "" : ", ") << "\"" << iter->first << "\": " << iter->second;
+			out << " }, \"phases_gb_per_s\": { ";
+			for (auto iter = r.phaseBandwidth.begin(); iter != r.phaseBandwidth.end(); iter++)
+				out << (iter == r.phaseBandwidth.begin() ? "" : ", ") << "\"" << iter->first << "\": " << iter->second;
+			out << " }";
+		}
+		out << " }" << ((i + 1 < results.size()) ? "," : "") << "\n";
+	}
+	out << "]\n";
+}
+
+/** Predict the memory of the subsystems for each size from the memory of a calibration run
+* with calibrationSize fluid particles. */
+void writePrediction(ostream &out, const vector<BenchmarkResult> &calibration)
+{
+	vector<string> subsystems;
+	for (unsigned int i = 0; i < calibration.size(); i++)
+	{
+		const vector<MemoryUsage::Entry> &entries = calibration[i].memoryUsage.getEntries();
+		for (unsigned int e = 0; e < entries.size(); e++)
+			if (std::find(subsystems.begin(), subsystems.end(), entries[e].name) == subsystems.end())
+				subsystems.push_back(entries[e].name);
+	}
+
+	if (!json)
+	{
+		out << "method,fluid_particles,boundary_particles,threads,predicted_mb";
+		for (unsigned int e = 0; e < subsystems.size(); e++)
+			out << "," << subsystems[e] << "_mb";
+		out << "\n";
+	}
+	else
+		out << "[\n";
+	bool first = true;
+	for (unsigned int n = 0; n < sizes.size(); n++)
+	{
+		vector<Vector3r> boundaryParticles;
+		vector<Vector3r> fluidParticles;
+		createDamBreak(sizes[n], boundaryParticles, fluidParticles);
+		const unsigned int numFluid = (unsigned int)fluidParticles.size();
+		const unsigned int numBoundary = (unsigned int)boundaryParticles.size();
+		for (unsigned int i = 0; i < calibration.size(); i++)
+		{
+			const BenchmarkResult &r = calibration[i];
+			const MemoryUsage &usage = r.memoryUsage;
+			const vector<MemoryUsage::Entry> &entries = usage.getEntries();
+			if (!json)
+			{
+				out << r.method << "," << numFluid << "," << numBoundary << "," << r.numThreads << "," << usage.predict(numFluid, numBoundary) / MB;
+				for (unsigned int s = 0; s < subsystems.size(); s++)
+				{
+					out << ",";
+					for (unsigned int e = 0; e < entries.size(); e++)
+						if (entries[e].name == subsystems[s])
+							out << usage.predict(entries[e], numFluid, numBoundary) / MB;
+				}
+				out << "\n";
+			}
+			else
+			{
+				out << (first ? "" : ",\n") << "  { \"method\": \"" << r.method << "\", \"fluid_particles\": " << numFluid
+					<< ", \"boundary_particles\": " << numBoundary << ", \"threads\": " << r.numThreads
+					<< ", \"predicted_mb\": " << usage.predict(numFluid, numBoundary) / MB << ", \"subsystems_mb\": { ";
+				for (unsigned int e = 0; e < entries.size(); e++)
+					out << (e == 0 ? "" : ", ") << "\"" << entries[e].name << "\": " << usage.predict(entries[e], numFluid, numBoundary) / MB;
+				out << " } }";
+			}
+			first = false;
+		}
+	}
+	if (json)
+		out << "\n]\n";
+}
+
+/** Parse a comma separated list of unsigned integers. */
+bool parseList(const string &str, vector<unsigned int> &values)
+{
+	values.clear();
+	stringstream ss(str);
+	string item;
+	while (getline(ss, item, ','))
+	{
+		try { values.push_back((unsigned int)max(1, stoi(item))); }
+		catch (...) { return false; }
+	}
+	return !values.empty();
+}
+
+/** Parse a comma separated list of solver names or "all". */
+bool parseMethods(const string &str, vector<unsigned int> &values)
+{
+	values.clear();
+	stringstream ss(str);
+	string item;
+	while (getline(ss, item, ','))
+	{
+		bool found = false;
+		for (unsigned int m = 0; m < numMethods; m++)
+		{
+			if ((item == methodNames[m]) || (item == "all"))
+			{
+				values.push_back(m);
+				found = true;
+			}
+		}
+		if (!found)
+			return false;
+	}
+	return !values.empty();
+}
+
+// main
+int main( int argc, char **argv )
+{
+	REPORT_MEMORY_LEAKS;
+
+	unsigned int maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = (unsigned int)omp_get_max_threads();
+#endif
+	bool sweep = false;
+	bool predict = false;
+	for (unsigned int m = 0; m < numMethods; m++)
+		methods.push_back(m);
+	sizes = { 10000, 100000, 1000000 };
+	threadCounts.push_back(maxThreads);
+
+	bool ok = true;
+	for (int i = 1; (i < argc) && ok; i++)
+	{
+		string argStr = argv[i];
+		if ((argStr == "-m") && (i + 1 < argc))
+			ok = parseMethods(argv[++i], methods);
+		else if ((argStr == "-n") && (i + 1 < argc))
+			ok = parseList(argv[++i], sizes);
+		else if ((argStr == "-t") && (i + 1 < argc))
+			ok = parseList(argv[++i], threadCounts);
+		else if ((argStr == "-s") && (i + 1 < argc))
+			numSteps = max(1, stoi(argv[++i]));
+		else if ((argStr == "-w") && (i + 1 < argc))
+			numWarmupSteps = max(0, stoi(argv[++i]));
+		else if ((argStr == "-h") && (i + 1 < argc))
+			timeStepFactor = stod(argv[++i]);
+		else if ((argStr == "-o") && (i + 1 < argc))
+			outputFile = argv[++i];
+		else if (argStr == "--sweep")
+			sweep = true;
+		else if (argStr == "--json")
+			json = true;
+		else if (argStr == "--counters")
+			counters = true;
+		else if (argStr == "--tiled")
+			tiled = true;
+		else if (argStr == "--predict")
+			predict = true;
+		else if ((argStr == "--calibration") && (i + 1 < argc))
+			calibrationSize = max(1, stoi(argv[++i]));
+		else
+			ok = false;
+	}
+	if (!ok)
+	{
+		std::cerr << "Usage: SPHBenchmarks [-m WCSPH,PCISPH,PBF,IISPH,DFSPH|all] [-n fluid_particles,...] [-t threads,...] [--sweep]\n"
+			<< "                      [-s steps] [-w warmup_steps] [-h time_step_per_particle_diameter] [--json] [--counters] [--tiled] [-o file]\n"
+			<< "                      [--predict [--calibration fluid_particles]]\n"
+			<< "  --sweep: run with 1, 2, 4, ... threads up to the maximal number of threads\n"
+			<< "  --counters: measure instructions per cycle and memory bandwidth of the phases (Linux perf events)\n"
+			<< "  --tiled: use the cache blocked neighbor loops over spatial tiles\n"
+			<< "  --predict: predict the memory for the sizes from a short run with --calibration particles (default 10000)\n";
+		return -1;
+	}
+	if (sweep)
+	{
+		threadCounts.clear();
+		for (unsigned int t = 1; t < maxThreads; t *= 2)
+			threadCounts.push_back(t);
+		threadCounts.push_back(maxThreads);
+	}
+
+	// with --predict only the calibration model is simulated for a single step
+	const vector<unsigned int> runSizes = predict ? vector<unsigned int>(1, calibrationSize) : sizes;
+	if (predict)
+	{
+		numWarmupSteps = 0;
+		numSteps = 1;
+	}
+
+	vector<BenchmarkResult> results;
+	for (unsigned int n = 0; n < runSizes.size(); n++)
+	{
+		vector<Vector3r> boundaryParticles;
+		vector<Vector3r> fluidParticles;
+		const Real particleRadius = createDamBreak(runSizes[n], boundaryParticles, fluidParticles);
+		for (unsigned int m = 0; m < methods.size(); m++)
+		{
+			for (unsigned int t = 0; t < threadCounts.size(); t++)
+			{
+				results.push_back(run(methods[m], threadCounts[t], particleRadius, boundaryParticles, fluidParticles));
+				const BenchmarkResult &r = results.back();
+				std::cerr << r.method << ": " << r.numFluidParticles << " particles, " << r.numThreads << " threads, "
+					<< r.msPerStep << " ms / step\n";
+			}
+		}
+	}
+
+	ofstream file;
+	if (!outputFile.empty())
+	{
+		file.open(outputFile.c_str());
+		if (!file)
+		{
+			std::cerr << "Cannot write " << outputFile << "\n";
+			return -1;
+		}
+	}
+	ostream &out = outputFile.empty() ? std::cout : file;
+	if (predict)
+		writePrediction(out, results);
+	else if (json)
+		writeJSON(out, results);
+	else
+		writeCSV(out, results);
+
+	return 0;
+}
@@ -0,0 +1,202 @@
+#include "SPlisHSPlasH/Common.h"
+#include "SPlisHSPlasH/FluidModel.h"
+#include "SPlisHSPlasH/TimeManager.h"
+#include "SPlisHSPlasH/StaticRigidBody.h"
+#include "SPlisHSPlasH/DFSPH/TimeStepDFSPH.h"
+#include "SPlisHSPlasH/Utilities/ParticleAllocator.h"
+#include <Eigen/Dense>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Enable memory leak detection
+#ifdef _DEBUG
+#ifndef EIGEN_ALIGN
+	#define new DEBUG_NEW
+#endif
+#endif
+
+using namespace SPH;
+using namespace std;
+
+Real particleRadius = 0.01;
+unsigned int numSteps = 50;
+unsigned int numWarmupSteps = 5;
+unsigned int maxThreads = 1;
+bool hugePages = false;
+
+/** Memory placement, thread binding, particle order and neighbor loop traversal of a run. */
+struct Configuration
+{
+	string name;
+	bool firstTouch;
+	ThreadPinning pinning;
+	SpaceFillingCurve ordering;
+	/** Cache blocked neighbor loops over particle tiles */
+	bool tiled;
+};
+
+/** Box [0,1]x[0,1]x[0,0.5] with two layers of boundary particles and a fluid block in one corner. */
+void createDamBreak(vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles)
+{
+	const Real r = particleRadius;
+	const Real d = 2.0*r;
+	const Real eps = 1.0e-9;
+	const Vector3r minX(0.0, 0.0, 0.0);
+	const Vector3r maxX(1.0, 1.0, 0.5);
+	for (Real x = minX[0] - d; x <= maxX[0] + d + eps; x += r)
+		for (Real y = minX[1] - d; y <= maxX[1] + d + eps; y += r)
+			for (Real z = minX[2] - d; z <= maxX[2] + d + eps; z += r)
+			{
+				const bool inside = (x > minX[0] - eps) && (x < maxX[0] + eps) && (y > minX[1] - eps) && (y < maxX[1] + eps) && (z > minX[2] - eps) && (z < maxX[2] + eps);
+				if (!inside)
+					boundaryParticles.push_back(Vector3r(x, y, z));
+			}
+
+	for (Real x = d; x < 0.5; x += d)
+		for (Real y = d; y < 0.8; y += d)
+			for (Real z = d; z < 0.5 - r; z += d)
+				fluidParticles.push_back(Vector3r(x, y, z));
+}
+
+/** Average distance |i-j| of the indices of neighboring fluid particles. A small distance means that
+* the neighbors of a particle are close in memory, i.e. the neighbor loops have a good cache locality.
+*/
+double averageNeighborDistance(FluidModel &model)
+{
+	unsigned long long sum = 0;
+	unsigned long long count = 0;
+	for (unsigned int i = 0; i < model.numParticles(); i++)
+	{
+		for (unsigned int k = 0; k < model.numberOfNeighbors(i); k++)
+		{
+			const PointID &particleId = model.getNeighbor(i, k);
+			if (particleId.point_set_id == 0)
+			{
+				sum += (particleId.point_id > i) ? particleId.point_id - i : i - particleId.point_id;
+				count++;
+			}
+		}
+	}
+	return (count > 0) ? (double)sum / (double)count : 0.0;
+}
+
+/** Simulate the dam break with DFSPH and return the average time per step in ms. */
+double run(const unsigned int numThreads, const Configuration &config, vector<Vector3r> &boundaryParticles, vector<Vector3r> &fluidParticles, double &neighborDistance)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(numThreads);
+#endif
+	// The model is created after these settings, so that all particle arrays are allocated with them.
+	ParticleMemory::setFirstTouch(config.firstTouch);
+	ParticleMemory::setHugePages(hugePages);
+	ParticleMemory::pinThreads(config.pinning);
+
+	FluidModel model;
+	model.getTimeManager()->setTimeStepSize(0.001);
+	model.setParticleRadius(particleRadius);
+	// cubic kernels with the support radius of this particle radius
+	model.setKernel(0);
+	model.setGradKernel(0);
+	model.setUseTiledTraversal(config.tiled);
+	model.setParticleOrdering(config.ordering);
+	StaticRigidBody *rb = new StaticRigidBody();
+	rb->setPosition(Vector3r::Zero());
+	rb->setRotation(Matrix3r::Identity());
+	model.addRigidBodyObject(rb, (unsigned int)boundaryParticles.size(), boundaryParticles.data());
+	model.initModel((unsigned int)fluidParticles.size(), fluidParticles.data());
+
+	TimeStepDFSPH timeStep(&model);
+	model.updateBoundaryPsi();
+
+	for (unsigned int i = 0; i < numWarmupSteps; i++)
+		timeStep.step();
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < numSteps; i++)
+		timeStep.step();
+	const double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / numSteps;
+	neighborDistance = averageNeighborDistance(model);
+	return time;
+}
+
+// main
+int main( int argc, char **argv )
+{
+	REPORT_MEMORY_LEAKS;
+
+#ifdef _OPENMP
+	maxThreads = (unsigned int)omp_get_max_threads();
+#endif
+
+	for (int i = 1; i < argc; i++)
+	{
+		string argStr = argv[i];
+		string type_str = argStr.substr(0, 2);
+		if ((type_str == "-r") && (i + 1 < argc))
+			particleRadius = stod(argv[++i]);
+		else if ((type_str == "-s") && (i + 1 < argc))
+			numSteps = max(1, stoi(argv[++i]));
+		else if ((type_str == "-t") && (i + 1 < argc))
+			maxThreads = max(1, stoi(argv[++i]));
+		else if (argStr == "--huge-pages")
+			hugePages = true;
+		else
+		{
+			std::cerr << "Usage: ScalingBenchmark [-r particle_radius] [-s steps] [-t max_threads] [--huge-pages]\n";
+			return -1;
+		}
+	}
+
+	vector<Vector3r> boundaryParticles;
+	vector<Vector3r> fluidParticles;
+	createDamBreak(boundaryParticles, fluidParticles);
+
+	// serial first touch without pinning is the behavior without NUMA-aware allocation
+	const Configuration configs[] = {
+		{ "serial touch", false, ThreadPinning::None, SpaceFillingCurve::Morton, false },
+		{ "first touch", true, ThreadPinning::None, SpaceFillingCurve::Morton, false },
+		{ "first touch + spread", true, ThreadPinning::Spread, SpaceFillingCurve::Morton, false },
+		{ "first touch + compact", true, ThreadPinning::Compact, SpaceFillingCurve::Morton, false },
+		{ "first touch + Hilbert", true, ThreadPinning::None, SpaceFillingCurve::Hilbert, false },
+		{ "first touch + tiled", true, ThreadPinning::None, SpaceFillingCurve::Morton, true }
+	};
+	const unsigned int numConfigs = sizeof(configs) / sizeof(configs[0]);
+
+	vector<unsigned int> threadCounts;
+	for (unsigned int t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(maxThreads);
+
+	std::cout << "DFSPH dam break: " << fluidParticles.size() << " fluid particles, " << boundaryParticles.size() << " boundary particles, "
+		<< numSteps << " steps" << (hugePages ? ", huge pages" : "") << "\n";
+	std::cout << std::left << std::setw(24) << "Configuration" << std::right << std::setw(10) << "Threads"
+		<< std::setw(14) << "ms / step" << std::setw(10) << "Speedup" << std::setw(12) << "Efficiency" << std::setw(12) << "Nbr. dist." << "\n";
+
+	for (unsigned int c = 0; c < numConfigs; c++)
+	{
+		double time1 = 0.0;
+		for (unsigned int i = 0; i < threadCounts.size(); i++)
+		{
+			const unsigned int numThreads = threadCounts[i];
+			double neighborDistance = 0.0;
+			const double time = run(numThreads, configs[c], boundaryParticles, fluidParticles, neighborDistance);
+			if (i == 0)
+				time1 = time * threadCounts[0];
+			std::cout << std::left << std::setw(24) << configs[c].name << std::right << std::setw(10) << numThreads
+				<< std::fixed << std::setprecision(3) << std::setw(14) << time
+				<< std::setprecision(2) << std::setw(10) << time1 / time << std::setw(12) << time1 / (time * numThreads)
+				<< std::setprecision(1) << std::setw(12) << neighborDistance << "\n";
+		}
+	}
+	ParticleMemory::pinThreads(ThreadPinning::None);
+
+	return 0;
+}
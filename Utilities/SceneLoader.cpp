@@ -111,6 +111,54 @@ void SceneLoader::readScene(const char* fileName, Scene& scene)
 
         scene.enableDivergenceSolver = true;
         readValue(config["enableDivergenceSolver"], scene.enableDivergenceSolver);
+
+        scene.numberOfTimeStepLevels = 1;
+        readValue(config["numberOfTimeStepLevels"], scene.numberOfTimeStepLevels);
+
+        scene.neighborhoodSearchSkin = 0.0;
+        readValue(config["neighborhoodSearchSkin"], scene.neighborhoodSearchSkin);
+
+        scene.tiledTraversal = false;
+        readValue(config["tiledTraversal"], scene.tiledTraversal);
+
+        scene.particleOrdering = 0;
+        readValue(config["particleOrdering"], scene.particleOrdering);
+
+        scene.firstTouch = true;
+        readValue(config["firstTouch"], scene.firstTouch);
+
+        scene.hugePages = false;
+        readValue(config["hugePages"], scene.hugePages);
+
+        scene.threadPinning = 0;
+        readValue(config["threadPinning"], scene.threadPinning);
+
+        scene.telemetryFile = "";
+        readValue(config["telemetryFile"], scene.telemetryFile);
+
+        scene.performanceCounters = false;
+        readValue(config["performanceCounters"], scene.performanceCounters);
+
+        scene.memoryReport = false;
+        readValue(config["memoryReport"], scene.memoryReport);
+
+        scene.metricsEndpoint = "";
+        readValue(config["metricsEndpoint"], scene.metricsEndpoint);
+
+        scene.frameBudget = 0.0;
+        readValue(config["frameBudget"], scene.frameBudget);
+
+        scene.frameBudgetMaxSteps = 20;
+        readValue(config["frameBudgetMaxSteps"], scene.frameBudgetMaxSteps);
+
+        scene.frameBudgetMaxToleranceScale = 10.0;
+        readValue(config["frameBudgetMaxToleranceScale"], scene.frameBudgetMaxToleranceScale);
+
+        scene.simulationThread = true;
+        readValue(config["simulationThread"], scene.simulationThread);
+
+        scene.frameOutputThreads = 0;
+        readValue(config["frameOutputThreads"], scene.frameOutputThreads);
     }
 
     //////////////////////////////////////////////////////////////////////////
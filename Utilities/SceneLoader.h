@@ -78,6 +78,22 @@ public:
             unsigned int viscosityMethod;
             unsigned int surfaceTensionMethod;
             unsigned int simulationMethod;
+            unsigned int numberOfTimeStepLevels;
+            Real         neighborhoodSearchSkin;
+            bool         tiledTraversal;
+            unsigned int particleOrdering;
+            bool         firstTouch;
+            bool         hugePages;
+            unsigned int threadPinning;
+            std::string  telemetryFile;
+            bool         performanceCounters;
+            bool         memoryReport;
+            std::string  metricsEndpoint;
+            Real         frameBudget;
+            unsigned int frameBudgetMaxSteps;
+            Real         frameBudgetMaxToleranceScale;
+            bool         simulationThread;
+            unsigned int frameOutputThreads;
 
             ////////////////////////////////////////////////////////////////////////////////
             std::string saveDataPath;
@@ -0,0 +1,73 @@
+# Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+# file Copyright.txt or https://cmake.org/licensing for details.
+
+cmake_minimum_required(VERSION 3.5)
+
+if(EXISTS "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitclone-lastrun.txt" AND EXISTS "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitinfo.txt" AND
+  "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitclone-lastrun.txt" IS_NEWER_THAN "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitinfo.txt")
+  message(STATUS
+    "Avoiding repeated git clone, stamp file is up to date: "
+    "'/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitclone-lastrun.txt'"
+  )
+  return()
+endif()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E rm -rf "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics"
+  RESULT_VARIABLE error_code
+)
+if(error_code)
+  message(FATAL_ERROR "Failed to remove directory: '/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics'")
+endif()
+
+# try the clone 3 times in case there is an odd git clone issue
+set(error_code 1)
+set(number_of_tries 0)
+while(error_code AND number_of_tries LESS 3)
+  execute_process(
+    COMMAND "/usr/bin/git" 
+            clone --no-checkout --config "advice.detachedHead=false" "https://github.com/InteractiveComputerGraphics/PositionBasedDynamics.git" "ExternalProject_PositionBasedDynamics"
+    WORKING_DIRECTORY "/root/repo/extern/PositionBasedDynamics/src"
+    RESULT_VARIABLE error_code
+  )
+  math(EXPR number_of_tries "${number_of_tries} + 1")
+endwhile()
+if(number_of_tries GREATER 1)
+  message(STATUS "Had to git clone more than once: ${number_of_tries} times.")
+endif()
+if(error_code)
+  message(FATAL_ERROR "Failed to clone repository: 'https://github.com/InteractiveComputerGraphics/PositionBasedDynamics.git'")
+endif()
+
+execute_process(
+  COMMAND "/usr/bin/git" 
+          checkout "b81f1119763a01f0b201a68f398a4a1c9592ccb6" --
+  WORKING_DIRECTORY "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics"
+  RESULT_VARIABLE error_code
+)
+if(error_code)
+  message(FATAL_ERROR "Failed to checkout tag: 'b81f1119763a01f0b201a68f398a4a1c9592ccb6'")
+endif()
+
+set(init_submodules TRUE)
+if(init_submodules)
+  execute_process(
+    COMMAND "/usr/bin/git" 
+            submodule update --recursive --init 
+    WORKING_DIRECTORY "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics"
+    RESULT_VARIABLE error_code
+  )
+endif()
+if(error_code)
+  message(FATAL_ERROR "Failed to update submodules in: '/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics'")
+endif()
+
+# Complete success, update the script-last-run stamp file:
+#
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E copy "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitinfo.txt" "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitclone-lastrun.txt"
+  RESULT_VARIABLE error_code
+)
+if(error_code)
+  message(FATAL_ERROR "Failed to copy script-last-run stamp file: '/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/ExternalProject_PositionBasedDynamics-gitclone-lastrun.txt'")
+endif()
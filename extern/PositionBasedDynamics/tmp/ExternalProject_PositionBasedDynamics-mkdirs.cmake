@@ -0,0 +1,22 @@
+# Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+# file Copyright.txt or https://cmake.org/licensing for details.
+
+cmake_minimum_required(VERSION 3.5)
+
+file(MAKE_DIRECTORY
+  "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics"
+  "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-build"
+  "/root/repo/extern/install/PositionBasedDynamics"
+  "/root/repo/extern/PositionBasedDynamics/tmp"
+  "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp"
+  "/root/repo/extern/PositionBasedDynamics/src"
+  "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp"
+)
+
+set(configSubDirs )
+foreach(subDir IN LISTS configSubDirs)
+    file(MAKE_DIRECTORY "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp/${subDir}")
+endforeach()
+if(cfgdir)
+  file(MAKE_DIRECTORY "/root/repo/extern/PositionBasedDynamics/src/ExternalProject_PositionBasedDynamics-stamp${cfgdir}") # cfgdir has leading slash
+endif()